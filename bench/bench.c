@@ -0,0 +1,813 @@
+// Benchmark harness for the core engine
+//
+// Usage: bench [--quick] [--no-perf] [--threads <n>] [--out <results.json>]
+//        bench --compare <baseline.json> [<current.json>] [--threshold <pct>]
+//
+// Every benchmark is timed as a number of samples, each a batch of
+// operations; a result is the median and p99 over samples of the time per
+// operation. Results are written as JSON, one result per line.
+//
+// Where perf_event_open is allowed, step_random and batch_step also
+// report hardware counters per step (cycles, instructions, IPC, L1D and
+// LLC read misses, branch misses), measured over all their samples.
+// Counters the kernel or CPU does not offer are left out; --no-perf skips
+// them all.
+//
+// --compare checks results against a baseline file, running the
+// benchmarks first unless a second file is given, and exits with status 1
+// if any median got worse by more than the threshold (default 10%).
+
+#define _GNU_SOURCE  // syscall
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include "../src/core/api.h"
+#include "../src/core/batch.h"
+#include "../src/core/game.h"
+#include "../src/core/map.h"
+#include "../src/core/mapgen.h"
+#include "../src/core/observation.h"
+
+#define BENCH_MAX_RESULTS 256
+#define BENCH_NAME_MAX    64
+#define BENCH_MAX_MAPS    4
+#define BENCH_ACTIONS     4096  // pre-generated random actions, cycled
+#define BENCH_BATCH_ENVS  256
+
+typedef struct {
+    char name[BENCH_NAME_MAX];
+    char unit[16];
+    int samples;
+    double median;
+    double p99;
+} BenchResult;
+
+typedef struct {
+    BenchResult results[BENCH_MAX_RESULTS];
+    int count;
+} BenchReport;
+
+typedef struct {
+    const char* name;
+    const MapData* map;
+} BenchMap;
+
+typedef struct {
+    int samples;       // per benchmark
+    int step_ops;      // steps per sample
+    int reset_ops;
+    int observe_ops;
+    int thread_steps;  // steps per thread per sample
+    int max_threads;
+    bool perf;         // read hardware counters when available
+} BenchConfig;
+
+static PlayerAction random_actions[BENCH_ACTIONS][2];
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts samples in place
+static void add_result(BenchReport* report, const char* name, const char* unit,
+                       double* samples, int n) {
+    if (report->count >= BENCH_MAX_RESULTS || n < 1) {
+        return;
+    }
+    qsort(samples, (size_t)n, sizeof(double), compare_doubles);
+    BenchResult* r = &report->results[report->count++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->unit, sizeof(r->unit), "%s", unit);
+    r->samples = n;
+    r->median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    r->p99 = samples[(99 * n + 99) / 100 - 1];  // ceil(0.99 n)-th smallest
+    fprintf(stderr, "  %-36s median %10.1f  p99 %10.1f  %s\n", r->name, r->median, r->p99, unit);
+}
+
+// =============================================================================
+// Hardware counters
+// =============================================================================
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_COUNTERS
+} PerfCounter;
+
+static const char* const perf_counter_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+};
+
+typedef struct {
+    int fds[PERF_NUM_COUNTERS];  // -1 where unavailable
+    double counts[PERF_NUM_COUNTERS];
+} PerfCounters;
+
+#ifdef __linux__
+
+static int open_counter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t cache_miss_config(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Each counter is opened on its own rather than as a group, so one the
+// CPU lacks (LLC events are often missing in VMs) does not take the
+// others down with it. Returns false if none opened.
+static bool perf_open(PerfCounters* perf) {
+    perf->fds[PERF_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    perf->fds[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    perf->fds[PERF_L1D_MISSES] =
+        open_counter(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_L1D));
+    perf->fds[PERF_LLC_MISSES] =
+        open_counter(PERF_TYPE_HW_CACHE, cache_miss_config(PERF_COUNT_HW_CACHE_LL));
+    perf->fds[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    bool any = false;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        any = any || perf->fds[i] >= 0;
+    }
+    return any;
+}
+
+static void perf_start(PerfCounters* perf) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (perf->fds[i] >= 0) {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void perf_stop(PerfCounters* perf) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        uint64_t value;
+        perf->counts[i] = -1;
+        if (perf->fds[i] >= 0) {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(perf->fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+                perf->counts[i] = (double)value;
+            }
+        }
+    }
+}
+
+static void perf_close(PerfCounters* perf) {
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+        }
+    }
+}
+
+#else
+
+static bool perf_open(PerfCounters* perf) {
+    (void)perf;
+    return false;
+}
+
+static void perf_start(PerfCounters* perf) {
+    (void)perf;
+}
+
+static void perf_stop(PerfCounters* perf) {
+    (void)perf;
+}
+
+static void perf_close(PerfCounters* perf) {
+    (void)perf;
+}
+
+#endif
+
+static PerfCounters perf_counters;
+static bool perf_available;
+
+static void perf_init(const BenchConfig* config) {
+    perf_available = config->perf && perf_open(&perf_counters);
+    if (config->perf && !perf_available) {
+        fprintf(stderr, "Hardware counters unavailable (perf_event_open failed); "
+                        "reporting wall-clock times only\n");
+    }
+}
+
+static void perf_begin(void) {
+    if (perf_available) {
+        perf_start(&perf_counters);
+    }
+}
+
+// Add one result per counter read, divided over ops, plus IPC
+static void perf_end(BenchReport* report, const char* bench_name, double ops) {
+    if (!perf_available) {
+        return;
+    }
+    perf_stop(&perf_counters);
+    const double* counts = perf_counters.counts;
+    char name[BENCH_NAME_MAX];
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+        if (counts[i] >= 0) {
+            double per_op = counts[i] / ops;
+            snprintf(name, sizeof(name), "%s/%s", perf_counter_names[i], bench_name);
+            add_result(report, name, "events/step", &per_op, 1);
+        }
+    }
+    if (counts[PERF_CYCLES] > 0 && counts[PERF_INSTRUCTIONS] >= 0) {
+        double ipc = counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES];
+        snprintf(name, sizeof(name), "ipc/%s", bench_name);
+        add_result(report, name, "instr/cycle", &ipc, 1);
+    }
+}
+
+// =============================================================================
+// Workloads
+// =============================================================================
+
+// Walk toward the opponent along the longer axis; fire when lined up
+static void scripted_actions(const GameState* state, PlayerAction* actions) {
+    for (int i = 0; i < 2; i++) {
+        Position self = state->players[i].pos;
+        Position other = state->players[1 - i].pos;
+        int dx = other.x - self.x, dy = other.y - self.y;
+        int adx = dx < 0 ? -dx : dx, ady = dy < 0 ? -dy : dy;
+        if (adx >= ady) {
+            actions[i].move = dx > 0 ? ACTION_RIGHT : dx < 0 ? ACTION_LEFT : ACTION_NOOP;
+        } else {
+            actions[i].move = dy > 0 ? ACTION_DOWN : ACTION_UP;
+        }
+        if (dx == 0) {
+            actions[i].shoot = dy > 0 ? ACTION_DOWN : ACTION_UP;
+        } else if (dy == 0) {
+            actions[i].shoot = dx > 0 ? ACTION_RIGHT : ACTION_LEFT;
+        } else {
+            actions[i].shoot = ACTION_NOOP;
+        }
+    }
+}
+
+static void bench_step(BenchReport* report, const BenchConfig* config, const BenchMap* map,
+                       bool scripted) {
+    GameState state;
+    game_init_map(&state, map->map);
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+    int cursor = 0;
+
+    perf_begin();
+    for (int s = 0; s < config->samples; s++) {
+        double start = now_ns();
+        for (int i = 0; i < config->step_ops; i++) {
+            PlayerAction actions[2];
+            if (scripted) {
+                scripted_actions(&state, actions);
+            } else {
+                actions[0] = random_actions[cursor][0];
+                actions[1] = random_actions[cursor][1];
+                cursor = (cursor + 1) & (BENCH_ACTIONS - 1);
+            }
+            game_step(&state, actions);
+            if (state.game_over) {
+                game_reset(&state);
+            }
+        }
+        samples[s] = (now_ns() - start) / config->step_ops;
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "%s/%s", scripted ? "step_scripted" : "step_random", map->name);
+    add_result(report, name, "ns/step", samples, config->samples);
+    if (!scripted) {
+        perf_end(report, name, (double)config->samples * config->step_ops);
+    }
+    free(samples);
+    game_free(&state);
+}
+
+static void bench_reset(BenchReport* report, const BenchConfig* config, const BenchMap* map) {
+    GameState state;
+    game_init_map(&state, map->map);
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+
+    for (int s = 0; s < config->samples; s++) {
+        double start = now_ns();
+        for (int i = 0; i < config->reset_ops; i++) {
+            game_reset(&state);
+        }
+        samples[s] = (now_ns() - start) / config->reset_ops;
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "reset/%s", map->name);
+    add_result(report, name, "ns/reset", samples, config->samples);
+    free(samples);
+    game_free(&state);
+}
+
+// Full-map observation with the distance channel, and an 11x11 crop
+static void bench_observe(BenchReport* report, const BenchConfig* config, const BenchMap* map,
+                          bool crop) {
+    GameState state;
+    game_init_map(&state, map->map);
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    int size = crop ? observation_crop_size(11, flags) : observation_size(&state, flags);
+    float* obs = malloc(sizeof(float) * (size_t)size);
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+
+    for (int s = 0; s < config->samples; s++) {
+        double start = now_ns();
+        for (int i = 0; i < config->observe_ops; i++) {
+            if (crop) {
+                observation_write_crop(&state, i & 1, 11, flags, obs);
+            } else {
+                observation_write(&state, i & 1, flags, obs);
+            }
+        }
+        samples[s] = (now_ns() - start) / config->observe_ops;
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "%s/%s", crop ? "observe_crop11" : "observe", map->name);
+    add_result(report, name, "ns/obs", samples, config->samples);
+    free(samples);
+    free(obs);
+    game_free(&state);
+}
+
+// Dirty-tracked observation update after each random step (the step
+// itself is not timed)
+static void bench_observe_incremental(BenchReport* report, const BenchConfig* config,
+                                      const BenchMap* map) {
+    GameState state;
+    game_init_map(&state, map->map);
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    float* obs = malloc(sizeof(float) * (size_t)observation_size(&state, flags));
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+    ObsCache cache = {0};
+    int cursor = 0;
+
+    for (int s = 0; s < config->samples; s++) {
+        double total = 0.0;
+        for (int i = 0; i < config->observe_ops; i++) {
+            game_step(&state, random_actions[cursor]);
+            cursor = (cursor + 1) & (BENCH_ACTIONS - 1);
+            if (state.game_over) {
+                game_reset(&state);
+            }
+            double start = now_ns();
+            observation_update(&cache, &state, 0, flags, obs);
+            total += now_ns() - start;
+        }
+        samples[s] = total / config->observe_ops;
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "observe_incremental/%s", map->name);
+    add_result(report, name, "ns/obs", samples, config->samples);
+    observation_cache_release(&cache);
+    free(samples);
+    free(obs);
+    game_free(&state);
+}
+
+// Learner-side cost of bit-packed full-map observations
+static void bench_unpack(BenchReport* report, const BenchConfig* config, const BenchMap* map) {
+    GameState state;
+    game_init_map(&state, map->map);
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    int w = map->map->width, h = map->map->height;
+    float* obs = malloc(sizeof(float) * (size_t)observation_size(&state, flags));
+    uint8_t* packed = malloc((size_t)observation_packed_size(w, h, flags, OBS_PACK_BITS));
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+    observation_write(&state, 0, flags, obs);
+    observation_pack(obs, w, h, flags, OBS_PACK_BITS, packed);
+
+    for (int s = 0; s < config->samples; s++) {
+        double start = now_ns();
+        for (int i = 0; i < config->observe_ops; i++) {
+            observation_unpack(packed, 1, w, h, flags, OBS_PACK_BITS, obs);
+        }
+        samples[s] = (now_ns() - start) / config->observe_ops;
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "unpack_bits/%s", map->name);
+    add_result(report, name, "ns/obs", samples, config->samples);
+    free(samples);
+    free(packed);
+    free(obs);
+    game_free(&state);
+}
+
+static void bench_batch(BenchReport* report, const BenchConfig* config, const BenchMap* map) {
+    BatchEngine* engine = batch_engine_create(map->map, BENCH_BATCH_ENVS);
+    PlayerAction* actions = malloc(sizeof(PlayerAction) * 2 * BENCH_BATCH_ENVS);
+    StepInfo* infos = malloc(sizeof(StepInfo) * BENCH_BATCH_ENVS);
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+    int rounds = config->step_ops / BENCH_BATCH_ENVS > 0 ? config->step_ops / BENCH_BATCH_ENVS : 1;
+    int cursor = 0;
+
+    perf_begin();
+    for (int s = 0; s < config->samples; s++) {
+        double start = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            for (int e = 0; e < BENCH_BATCH_ENVS; e++) {
+                actions[e * 2] = random_actions[cursor][0];
+                actions[e * 2 + 1] = random_actions[cursor][1];
+                cursor = (cursor + 1) & (BENCH_ACTIONS - 1);
+            }
+            batch_engine_step(engine, actions, infos);
+            for (int e = 0; e < BENCH_BATCH_ENVS; e++) {
+                if (engine->game_over[e]) {
+                    batch_engine_reset(engine, e);
+                }
+            }
+        }
+        samples[s] = (now_ns() - start) / ((double)rounds * BENCH_BATCH_ENVS);
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "batch_step/%s", map->name);
+    add_result(report, name, "ns/step", samples, config->samples);
+    perf_end(report, name, (double)config->samples * rounds * BENCH_BATCH_ENVS);
+    free(samples);
+    free(infos);
+    free(actions);
+    batch_engine_free(engine);
+}
+
+// Bytes each extra env costs: its GameState plus its occupancy grid. The
+// map data is shared and reported separately.
+static void bench_memory(BenchReport* report, const BenchMap* map) {
+    char name[BENCH_NAME_MAX];
+    double env_bytes = (double)sizeof(GameState) +
+                       (double)map->map->height * (double)map->map->stride;
+    snprintf(name, sizeof(name), "memory_per_env/%s", map->name);
+    add_result(report, name, "bytes", &env_bytes, 1);
+
+    double map_bytes = (double)map_data_size(map->map);
+    snprintf(name, sizeof(name), "map_data/%s", map->name);
+    add_result(report, name, "bytes", &map_bytes, 1);
+}
+
+// =============================================================================
+// Thread scaling: each thread steps its own env, all starting together
+// =============================================================================
+
+typedef struct {
+    const MapData* map;
+    int steps;
+    pthread_barrier_t* barrier;
+    double start, end;
+} ThreadJob;
+
+static void* thread_main(void* arg) {
+    ThreadJob* job = arg;
+    GameState state;
+    game_init_map(&state, job->map);
+    int cursor = 0;
+
+    pthread_barrier_wait(job->barrier);
+    job->start = now_ns();
+    for (int i = 0; i < job->steps; i++) {
+        game_step(&state, random_actions[cursor]);
+        cursor = (cursor + 1) & (BENCH_ACTIONS - 1);
+        if (state.game_over) {
+            game_reset(&state);
+        }
+    }
+    job->end = now_ns();
+    game_free(&state);
+    return NULL;
+}
+
+// Wall time from the first thread starting to the last one finishing, per
+// step summed over threads, so perfect scaling divides the single-thread
+// figure by the thread count
+static void bench_threads(BenchReport* report, const BenchConfig* config, const BenchMap* map,
+                          int num_threads) {
+    pthread_t threads[256];
+    ThreadJob jobs[256];
+    pthread_barrier_t barrier;
+    double* samples = malloc(sizeof(double) * (size_t)config->samples);
+
+    for (int s = 0; s < config->samples; s++) {
+        pthread_barrier_init(&barrier, NULL, (unsigned)num_threads);
+        for (int t = 0; t < num_threads; t++) {
+            jobs[t] = (ThreadJob){map->map, config->thread_steps, &barrier, 0, 0};
+            pthread_create(&threads[t], NULL, thread_main, &jobs[t]);
+        }
+        double start = 0, end = 0;
+        for (int t = 0; t < num_threads; t++) {
+            pthread_join(threads[t], NULL);
+            start = t == 0 || jobs[t].start < start ? jobs[t].start : start;
+            end = jobs[t].end > end ? jobs[t].end : end;
+        }
+        samples[s] = (end - start) / ((double)config->thread_steps * num_threads);
+        pthread_barrier_destroy(&barrier);
+    }
+
+    char name[BENCH_NAME_MAX];
+    snprintf(name, sizeof(name), "threads_%d/%s", num_threads, map->name);
+    add_result(report, name, "ns/step", samples, config->samples);
+    free(samples);
+}
+
+// =============================================================================
+// JSON results
+// =============================================================================
+
+static bool write_report(const BenchReport* report, const char* path) {
+    FILE* f = path ? fopen(path, "w") : stdout;
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "{\n  \"version\": 1,\n  \"results\": [\n");
+    for (int i = 0; i < report->count; i++) {
+        const BenchResult* r = &report->results[i];
+        fprintf(f, "    {\"name\": \"%s\", \"unit\": \"%s\", \"samples\": %d, "
+                   "\"median\": %.3f, \"p99\": %.3f}%s\n",
+                r->name, r->unit, r->samples, r->median, r->p99,
+                i + 1 < report->count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    bool ok = !ferror(f);
+    if (path) {
+        ok = fclose(f) == 0 && ok;
+    }
+    return ok;
+}
+
+// Copy the JSON string value of key on line into out
+static bool read_string_field(const char* line, const char* key, char* out, size_t size) {
+    const char* p = strstr(line, key);
+    if (!p || !(p = strchr(p + strlen(key), '"'))) {
+        return false;
+    }
+    const char* end = strchr(++p, '"');
+    if (!end || (size_t)(end - p) >= size) {
+        return false;
+    }
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return true;
+}
+
+static bool read_number_field(const char* line, const char* key, double* out) {
+    const char* p = strstr(line, key);
+    return p && sscanf(p + strlen(key), " %lf", out) == 1;
+}
+
+// Reads files written by write_report (one result per line)
+static bool read_report(BenchReport* report, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    report->count = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), f) && report->count < BENCH_MAX_RESULTS) {
+        BenchResult* r = &report->results[report->count];
+        double samples = 0;
+        r->unit[0] = '\0';
+        if (read_string_field(line, "\"name\":", r->name, sizeof(r->name)) &&
+            read_number_field(line, "\"median\":", &r->median) &&
+            read_number_field(line, "\"p99\":", &r->p99)) {
+            read_number_field(line, "\"samples\":", &samples);
+            r->samples = (int)samples;
+            read_string_field(line, "\"unit\":", r->unit, sizeof(r->unit));
+            report->count++;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+// Every metric but IPC is lower-is-better. Returns the number of
+// regressions.
+static int compare_reports(const BenchReport* baseline, const BenchReport* current,
+                           double threshold_pct) {
+    int regressions = 0;
+    printf("%-36s %12s %12s %9s\n", "benchmark", "baseline", "current", "change");
+    for (int i = 0; i < current->count; i++) {
+        const BenchResult* cur = &current->results[i];
+        const BenchResult* base = NULL;
+        for (int j = 0; j < baseline->count && !base; j++) {
+            if (strcmp(baseline->results[j].name, cur->name) == 0) {
+                base = &baseline->results[j];
+            }
+        }
+        if (!base) {
+            printf("%-36s %12s %12.1f %9s\n", cur->name, "-", cur->median, "new");
+            continue;
+        }
+        double change = base->median > 0 ? (cur->median / base->median - 1.0) * 100.0 : 0.0;
+        bool higher_is_better = strcmp(cur->unit, "instr/cycle") == 0;
+        bool regressed = higher_is_better ? -change > threshold_pct : change > threshold_pct;
+        regressions += regressed;
+        printf("%-36s %12.1f %12.1f %+8.1f%%%s\n", cur->name, base->median, cur->median, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+static const MapData* generated_map(int size, int num_crystals) {
+    MapGenParams params;
+    mapgen_default_params(&params, 1);
+    params.width = size;
+    params.height = size;
+    params.num_crystals = num_crystals;
+    return mapgen_generate(&params);
+}
+
+static int load_maps(BenchMap* maps) {
+    int count = 0;
+    char* text = read_file("maps/arena_01.txt");
+    const MapData* map = text ? map_data_parse(text) : NULL;
+    free(text);
+    if (map) {
+        maps[count++] = (BenchMap){"arena_01", map};
+    }
+    if ((map = generated_map(15, 2))) maps[count++] = (BenchMap){"gen15", map};
+    if ((map = generated_map(32, 4))) maps[count++] = (BenchMap){"gen32", map};
+    if ((map = generated_map(64, 8))) maps[count++] = (BenchMap){"gen64", map};
+    return count;
+}
+
+static void run_benchmarks(BenchReport* report, const BenchConfig* config) {
+    BenchMap maps[BENCH_MAX_MAPS];
+    int num_maps = load_maps(maps);
+
+    unsigned int rng = 2024;
+    for (int i = 0; i < BENCH_ACTIONS; i++) {
+        for (int p = 0; p < 2; p++) {
+            rng = rng * 1103515245 + 12345;
+            random_actions[i][p].move = (ActionType)((rng >> 16) % 5);
+            random_actions[i][p].shoot = (ActionType)((rng >> 20) % 5);
+        }
+    }
+
+    report->count = 0;
+    perf_init(config);
+    for (int m = 0; m < num_maps; m++) {
+        fprintf(stderr, "%s (%dx%d):\n", maps[m].name, maps[m].map->width, maps[m].map->height);
+        bench_step(report, config, &maps[m], false);
+        bench_step(report, config, &maps[m], true);
+        bench_reset(report, config, &maps[m]);
+        bench_observe(report, config, &maps[m], false);
+        bench_observe(report, config, &maps[m], true);
+        bench_observe_incremental(report, config, &maps[m]);
+        bench_unpack(report, config, &maps[m]);
+        bench_batch(report, config, &maps[m]);
+        bench_memory(report, &maps[m]);
+    }
+
+    // Scaling on the 32x32 map (or whatever loaded last)
+    if (num_maps > 0) {
+        const BenchMap* map = &maps[num_maps > 2 ? 2 : num_maps - 1];
+        fprintf(stderr, "threads (%s):\n", map->name);
+        // 1, 2, 4, ... and the maximum itself
+        for (int t = 1; t <= config->max_threads; t *= 2) {
+            bench_threads(report, config, map, t);
+            if (t < config->max_threads && t * 2 > config->max_threads) {
+                bench_threads(report, config, map, config->max_threads);
+            }
+        }
+    }
+
+    for (int m = 0; m < num_maps; m++) {
+        map_data_release(maps[m].map);
+    }
+    if (perf_available) {
+        perf_close(&perf_counters);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    BenchConfig config = {
+        .samples = 31,
+        .step_ops = 20000,
+        .reset_ops = 20000,
+        .observe_ops = 2000,
+        .thread_steps = 50000,
+        .max_threads = cpus > 0 ? (int)cpus : 1,
+        .perf = true,
+    };
+    const char* out_path = NULL;
+    const char* baseline_path = NULL;
+    const char* current_path = NULL;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            config.samples = 7;
+            config.step_ops /= 10;
+            config.reset_ops /= 10;
+            config.observe_ops /= 10;
+            config.thread_steps /= 10;
+        } else if (strcmp(argv[i], "--no-perf") == 0) {
+            config.perf = false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            config.max_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                current_path = argv[++i];
+            }
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--quick] [--no-perf] [--threads <n>] [--out <results.json>]\n"
+                    "       %s --compare <baseline.json> [<current.json>] [--threshold <pct>]\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (config.max_threads < 1 || config.max_threads > 256) {
+        fprintf(stderr, "--threads must be between 1 and 256\n");
+        return 1;
+    }
+
+    static BenchReport current, baseline;
+    if (baseline_path && !read_report(&baseline, baseline_path)) {
+        fprintf(stderr, "Failed to read %s\n", baseline_path);
+        return 1;
+    }
+    if (current_path) {
+        if (!read_report(&current, current_path)) {
+            fprintf(stderr, "Failed to read %s\n", current_path);
+            return 1;
+        }
+    } else {
+        run_benchmarks(&current, &config);
+        if ((out_path || !baseline_path) && !write_report(&current, out_path)) {
+            fprintf(stderr, "Failed to write %s\n", out_path);
+            return 1;
+        }
+        if (out_path) {
+            fprintf(stderr, "Wrote %d results to %s\n", current.count, out_path);
+        }
+    }
+
+    if (baseline_path) {
+        int regressions = compare_reports(&baseline, &current, threshold);
+        printf("%d regression(s) over %.1f%%\n", regressions, threshold);
+        return regressions > 0;
+    }
+    return 0;
+}
@@ -2,6 +2,14 @@
 #include "game.h"
 #include "arena.h"
 #include "player.h"
+#include "map.h"
+#include "mapgen.h"
+#include "distance.h"
+#include "observation.h"
+#include "trace.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 // External declaration from game.c
 extern void game_set_seed(unsigned int seed);
@@ -14,14 +22,79 @@ void api_game_reset(GameState* state) {
     game_reset(state);
 }
 
+void api_game_free(GameState* state) {
+    game_free(state);
+}
+
+bool api_game_copy(GameState* dst, const GameState* src) {
+    return game_copy(dst, src);
+}
+
 void api_game_set_seed(unsigned int seed) {
     game_set_seed(seed);
 }
 
+bool api_game_set_num_players(GameState* state, int num_players) {
+    return game_set_num_players(state, num_players);
+}
+
+int api_get_num_players(const GameState* state) {
+    return state->num_players;
+}
+
+MapPack* api_map_pack_open(const char* path) {
+    MapPack* pack = malloc(sizeof(MapPack));
+    if (!pack) return NULL;
+    if (!map_pack_open(pack, path)) {
+        free(pack);
+        return NULL;
+    }
+    return pack;
+}
+
+void api_map_pack_close(MapPack* pack) {
+    if (!pack) return;
+    map_pack_close(pack);
+    free(pack);
+}
+
+int api_map_pack_num_maps(const MapPack* pack) {
+    return pack->num_maps;
+}
+
+int api_map_pack_find(const MapPack* pack, const char* name) {
+    return map_pack_find(pack, name);
+}
+
+bool api_game_init_from_pack(GameState* state, const MapPack* pack, int map_idx) {
+    const MapData* map = map_pack_get(pack, map_idx);
+    if (!map) return false;
+    game_init_map(state, map);
+    return true;
+}
+
+bool api_game_reset_generated(GameState* state, unsigned int seed, int width, int height,
+                              float wall_density, float void_density) {
+    MapGenParams params;
+    mapgen_default_params(&params, seed);
+    params.width = width;
+    params.height = height;
+    params.wall_density = wall_density;
+    params.void_density = void_density;
+
+    MapData* map = mapgen_generate(&params);
+    if (!map) return false;
+    game_free(state);
+    arena_init(&state->arena, map);  // keeps num_players
+    map_data_release(map);
+    game_reset(state);
+    return true;
+}
+
 StepInfo api_game_step(GameState* state, const int* actions) {
     PlayerAction player_actions[MAX_PLAYERS];
 
-    for (int i = 0; i < MAX_PLAYERS; i++) {
+    for (int i = 0; i < state->num_players; i++) {
         player_actions[i].move = (ActionType)actions[i * 2];
         player_actions[i].shoot = (ActionType)actions[i * 2 + 1];
     }
@@ -29,12 +102,231 @@ StepInfo api_game_step(GameState* state, const int* actions) {
     return game_step(state, player_actions);
 }
 
+BatchEngine* api_batch_create(const GameState* state, int num_envs) {
+    return batch_engine_create(state->arena.map, num_envs);
+}
+
+void api_batch_free(BatchEngine* engine) {
+    batch_engine_free(engine);
+}
+
+void api_batch_reset(BatchEngine* engine, int env) {
+    batch_engine_reset(engine, env);
+}
+
+void api_batch_step(BatchEngine* engine, const int* actions, StepInfo* infos) {
+    batch_engine_step(engine, (const PlayerAction*)actions, infos);
+}
+
+void api_batch_get_state(const BatchEngine* engine, int env, GameState* out) {
+    batch_engine_get_state(engine, env, out);
+}
+
+// Per-thread action and info scratch for api_batch_step_agents, grown as
+// needed and kept between calls
+static _Thread_local PlayerAction* agent_actions;
+static _Thread_local StepInfo* agent_infos;
+static _Thread_local int agent_scratch_envs;
+
+static bool reserve_agent_scratch(int num_envs) {
+    if (num_envs <= agent_scratch_envs) {
+        return true;
+    }
+    PlayerAction* actions = realloc(agent_actions, sizeof(PlayerAction) * BATCH_NUM_PLAYERS *
+                                                       (size_t)num_envs);
+    if (actions) {
+        agent_actions = actions;
+    }
+    StepInfo* infos = realloc(agent_infos, sizeof(StepInfo) * (size_t)num_envs);
+    if (infos) {
+        agent_infos = infos;
+    }
+    if (!actions || !infos) {
+        return false;
+    }
+    agent_scratch_envs = num_envs;
+    return true;
+}
+
+bool api_batch_step_agents(BatchEngine* engine, const int* actions, unsigned flags,
+                           float* rewards, uint8_t* dones, StepInfo* infos) {
+    int n = engine->num_envs;
+    if (!reserve_agent_scratch(n)) {
+        return false;
+    }
+    for (int a = 0; a < n * BATCH_NUM_PLAYERS; a++) {
+        int seat = a % BATCH_NUM_PLAYERS;
+        agent_actions[a].move = observation_world_action(seat, flags, (ActionType)actions[a * 2]);
+        agent_actions[a].shoot =
+            observation_world_action(seat, flags, (ActionType)actions[a * 2 + 1]);
+    }
+    if (!infos) {
+        infos = agent_infos;
+    }
+    batch_engine_step(engine, agent_actions, infos);
+
+    for (int e = 0; e < n; e++) {
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            int a = e * BATCH_NUM_PLAYERS + p;
+            rewards[a] = (float)infos[e].frags[p] - (infos[e].player_fragged[p] ? 1.0f : 0.0f);
+            dones[a] = engine->game_over[e] != 0;
+        }
+    }
+    return true;
+}
+
+// Reorder one agent's world-frame mask into its observation frame
+static void mask_to_agent_frame(int seat, unsigned flags, uint8_t* mask) {
+    uint8_t world[5];
+    memcpy(world, mask, sizeof(world));
+    for (int a = 0; a < 5; a++) {
+        mask[a] = world[observation_world_action(seat, flags, (ActionType)a)];
+    }
+}
+
+void api_write_action_masks(const BatchEngine* engine, unsigned flags, uint8_t* move_mask,
+                            uint8_t* shoot_mask) {
+    batch_engine_write_action_masks(engine, move_mask, shoot_mask);
+    for (int a = 0; a < engine->num_envs * BATCH_NUM_PLAYERS; a++) {
+        int seat = a % BATCH_NUM_PLAYERS;
+        if (!observation_is_mirrored(seat, flags)) {
+            continue;
+        }
+        mask_to_agent_frame(seat, flags, move_mask + (size_t)a * 5);
+        if (shoot_mask) {
+            mask_to_agent_frame(seat, flags, shoot_mask + (size_t)a * 5);
+        }
+    }
+}
+
+void api_batch_write_agent_observations(const BatchEngine* engine, int k, unsigned flags,
+                                        float* out) {
+    const MapData* map = engine->map;
+    size_t stride = (size_t)(k ? observation_crop_size(k, flags)
+                               : observation_num_channels(flags) * map->width * map->height +
+                                     OBS_NUM_SCALARS);
+    GameState snapshot;
+    for (int e = 0; e < engine->num_envs; e++) {
+        batch_engine_get_state(engine, e, &snapshot);
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            float* agent_out = out + stride * (size_t)(e * BATCH_NUM_PLAYERS + p);
+            if (k) {
+                observation_write_crop(&snapshot, p, k, flags, agent_out);
+            } else {
+                observation_write(&snapshot, p, flags, agent_out);
+            }
+        }
+    }
+}
+
+void api_batch_update_agent_observations(const BatchEngine* engine, ObsCache* caches,
+                                         unsigned flags, float* out) {
+    const MapData* map = engine->map;
+    size_t stride = (size_t)(observation_num_channels(flags) * map->width * map->height +
+                             OBS_NUM_SCALARS);
+    GameState snapshot;
+    for (int e = 0; e < engine->num_envs; e++) {
+        batch_engine_get_state(engine, e, &snapshot);
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            int a = e * BATCH_NUM_PLAYERS + p;
+            observation_update(&caches[a], &snapshot, p, flags, out + stride * (size_t)a);
+        }
+    }
+}
+
+int api_get_obs_cache_size(void) {
+    return sizeof(ObsCache);
+}
+
+void api_release_obs_caches(ObsCache* caches, int count) {
+    for (int i = 0; i < count; i++) {
+        observation_cache_release(&caches[i]);
+    }
+}
+
+bool api_batch_write_dihedral_observations(const BatchEngine* engine, int k, unsigned flags,
+                                           unsigned transforms, float* out) {
+    const MapData* map = engine->map;
+    int width = k ? k : map->width;
+    int height = k ? k : map->height;
+    size_t size = (size_t)(k ? observation_crop_size(k, flags)
+                             : observation_num_channels(flags) * width * height + OBS_NUM_SCALARS);
+    int count = __builtin_popcount(transforms & ((1u << OBS_NUM_DIHEDRAL) - 1));
+    float* upright = malloc(sizeof(float) * size);
+    if (!upright) {
+        return false;
+    }
+
+    GameState snapshot;
+    for (int e = 0; e < engine->num_envs; e++) {
+        batch_engine_get_state(engine, e, &snapshot);
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            if (k) {
+                observation_write_crop(&snapshot, p, k, flags, upright);
+            } else {
+                observation_write(&snapshot, p, flags, upright);
+            }
+            float* agent_out = out + size * (size_t)count * (size_t)(e * BATCH_NUM_PLAYERS + p);
+            for (int t = 0; t < OBS_NUM_DIHEDRAL; t++) {
+                if (transforms & (1u << t)) {
+                    observation_transform(upright, width, height, flags, t, agent_out);
+                    agent_out += size;
+                }
+            }
+        }
+    }
+    free(upright);
+    return true;
+}
+
+const uint8_t* api_get_dihedral_actions(void) {
+    return &observation_dihedral_actions[0][0];
+}
+
+int api_get_packed_observation_size(int width, int height, unsigned flags, int packing) {
+    return observation_packed_size(width, height, flags, (ObsPacking)packing);
+}
+
+bool api_batch_write_packed_observations(const BatchEngine* engine, int k, unsigned flags,
+                                         int packing, uint8_t* out) {
+    const MapData* map = engine->map;
+    int width = k ? k : map->width;
+    int height = k ? k : map->height;
+    size_t packed_size = (size_t)observation_packed_size(width, height, flags, (ObsPacking)packing);
+    float* obs = malloc(sizeof(float) * (size_t)(observation_num_channels(flags) * width * height +
+                                                 OBS_NUM_SCALARS));
+    if (!obs) {
+        return false;
+    }
+
+    GameState snapshot;
+    for (int e = 0; e < engine->num_envs; e++) {
+        batch_engine_get_state(engine, e, &snapshot);
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            if (k) {
+                observation_write_crop(&snapshot, p, k, flags, obs);
+            } else {
+                observation_write(&snapshot, p, flags, obs);
+            }
+            observation_pack(obs, width, height, flags, (ObsPacking)packing,
+                             out + packed_size * (size_t)(e * BATCH_NUM_PLAYERS + p));
+        }
+    }
+    free(obs);
+    return true;
+}
+
+void api_unpack_observations(const uint8_t* packed, int count, int width, int height,
+                             unsigned flags, int packing, float* out) {
+    observation_unpack(packed, count, width, height, flags, (ObsPacking)packing, out);
+}
+
 int api_get_arena_width(const GameState* state) {
-    return state->arena.width;
+    return state->arena.map->width;
 }
 
 int api_get_arena_height(const GameState* state) {
-    return state->arena.height;
+    return state->arena.map->height;
 }
 
 TileType api_get_tile(const GameState* state, int x, int y) {
@@ -42,22 +334,22 @@ TileType api_get_tile(const GameState* state, int x, int y) {
 }
 
 int api_get_num_crystals(const GameState* state) {
-    return state->arena.num_crystals;
+    return state->arena.map->num_crystals;
 }
 
 int api_get_crystal_x(const GameState* state, int idx) {
-    if (idx < 0 || idx >= state->arena.num_crystals) return -1;
-    return state->arena.crystals[idx].pos.x;
+    if (idx < 0 || idx >= state->arena.map->num_crystals) return -1;
+    return state->arena.map->crystals[idx].x;
 }
 
 int api_get_crystal_y(const GameState* state, int idx) {
-    if (idx < 0 || idx >= state->arena.num_crystals) return -1;
-    return state->arena.crystals[idx].pos.y;
+    if (idx < 0 || idx >= state->arena.map->num_crystals) return -1;
+    return state->arena.map->crystals[idx].y;
 }
 
 int api_get_crystal_cooldown(const GameState* state, int idx) {
-    if (idx < 0 || idx >= state->arena.num_crystals) return -1;
-    return state->arena.crystals[idx].cooldown_ticks;
+    if (idx < 0 || idx >= state->arena.map->num_crystals) return -1;
+    return state->arena.crystal_cooldowns[idx];
 }
 
 bool api_is_crystal_available(const GameState* state, int idx) {
@@ -65,42 +357,42 @@ bool api_is_crystal_available(const GameState* state, int idx) {
 }
 
 int api_get_player_x(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].pos.x;
 }
 
 int api_get_player_y(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].pos.y;
 }
 
 int api_get_player_health(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].health;
 }
 
 int api_get_player_energy(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].energy;
 }
 
 int api_get_player_move_cooldown(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].move_cooldown_ticks;
 }
 
 int api_get_player_laser_cooldown(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].laser_cooldown_ticks;
 }
 
 int api_get_player_score(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return -1;
+    if (player_idx < 0 || player_idx >= state->num_players) return -1;
     return state->players[player_idx].score;
 }
 
 bool api_is_player_alive(const GameState* state, int player_idx) {
-    if (player_idx < 0 || player_idx >= MAX_PLAYERS) return false;
+    if (player_idx < 0 || player_idx >= state->num_players) return false;
     return state->players[player_idx].alive;
 }
 
@@ -116,6 +408,210 @@ bool api_is_game_over(const GameState* state) {
     return state->game_over;
 }
 
+int api_get_distance(const GameState* state, int from_x, int from_y, int to_x, int to_y) {
+    Position from = {from_x, from_y};
+    Position to = {to_x, to_y};
+    return distance_between(state->arena.map, from, to);
+}
+
+int api_get_observation_size(const GameState* state, unsigned flags) {
+    return observation_size(state, flags);
+}
+
+void api_write_observation(const GameState* state, int player_idx, unsigned flags, float* out) {
+    observation_write(state, player_idx, flags, out);
+}
+
+int api_get_crop_observation_size(int k, unsigned flags) {
+    return observation_crop_size(k, flags);
+}
+
+void api_write_crop_observation(const GameState* state, int player_idx, int k, unsigned flags,
+                                float* out) {
+    observation_write_crop(state, player_idx, k, flags, out);
+}
+
+void api_write_crop_observation_batch(const GameState* states, int num_envs, int player_idx,
+                                      int k, unsigned flags, float* out) {
+    observation_write_crop_batch(states, num_envs, player_idx, k, flags, out);
+}
+
+FrameStack* api_framestack_create(int num_agents, int obs_size, int k) {
+    return framestack_create(num_agents, obs_size, k, true);
+}
+
+void api_framestack_free(FrameStack* stack) {
+    framestack_free(stack);
+}
+
+float* api_framestack_next(FrameStack* stack) {
+    return framestack_next(stack);
+}
+
+void api_framestack_push(FrameStack* stack) {
+    framestack_push(stack);
+}
+
+const float* api_framestack_window(const FrameStack* stack) {
+    return framestack_window(stack);
+}
+
+const float* api_framestack_frame(const FrameStack* stack, int i) {
+    return framestack_frame(stack, i);
+}
+
+void api_framestack_window_offsets(const FrameStack* stack, size_t* offsets) {
+    framestack_window_offsets(stack, offsets);
+}
+
+void api_framestack_reset_row(FrameStack* stack, int agent) {
+    framestack_reset_row(stack, agent);
+}
+
+bool api_get_profile_stats(ProfileStats* out) {
+    return profile_get_stats(out);
+}
+
+void api_reset_profile_stats(void) {
+    profile_reset_stats();
+}
+
+void api_trace_start(int capacity) {
+    trace_start(capacity);
+}
+
+void api_trace_stop(void) {
+    trace_stop();
+}
+
+bool api_trace_dump(const char* path) {
+    return trace_dump(path);
+}
+
 int api_get_state_size(void) {
     return sizeof(GameState);
 }
+
+// Type strings below assume these sizes
+_Static_assert(sizeof(int) == 4 && sizeof(Direction) == 4, "int fields are described as i4");
+_Static_assert(sizeof(bool) == 1, "bool fields are described as ?");
+
+#if UINTPTR_MAX == 0xFFFFFFFFu
+#define POINTER_TYPE "V4"
+#else
+#define POINTER_TYPE "V8"
+#endif
+
+#define SCALAR(s, field, type) \
+    {#field, type, (int)offsetof(s, field), (int)sizeof(((s*)0)->field), 1}
+#define ARRAY(s, field, type, n) \
+    {#field, type, (int)offsetof(s, field), (int)sizeof(((s*)0)->field[0]), n}
+
+static const ApiFieldLayout position_fields[] = {
+    SCALAR(Position, x, "i4"),
+    SCALAR(Position, y, "i4"),
+};
+
+static const ApiFieldLayout player_fields[] = {
+    SCALAR(Player, pos, "Position"),
+    SCALAR(Player, facing, "i4"),
+    SCALAR(Player, health, "i4"),
+    SCALAR(Player, energy, "i4"),
+    SCALAR(Player, move_cooldown_ticks, "i4"),
+    SCALAR(Player, laser_cooldown_ticks, "i4"),
+    SCALAR(Player, energy_regen_ticks, "i4"),
+    SCALAR(Player, score, "i4"),
+    SCALAR(Player, last_hit_by, "i4"),
+    SCALAR(Player, alive, "?"),
+};
+
+static const ApiFieldLayout laser_fields[] = {
+    SCALAR(LaserBeam, start, "Position"),
+    SCALAR(LaserBeam, end, "Position"),
+    SCALAR(LaserBeam, player_idx, "i4"),
+    SCALAR(LaserBeam, ticks_remaining, "i4"),
+    SCALAR(LaserBeam, active, "?"),
+};
+
+static const ApiFieldLayout arena_fields[] = {
+    SCALAR(Arena, map, POINTER_TYPE),
+    ARRAY(Arena, crystal_cooldowns, "i4", MAX_CRYSTALS),
+    SCALAR(Arena, occupancy, POINTER_TYPE),
+};
+
+static const ApiFieldLayout state_fields[] = {
+    SCALAR(GameState, arena, "Arena"),
+    ARRAY(GameState, players, "Player", MAX_PLAYERS),
+    ARRAY(GameState, lasers, "LaserBeam", MAX_LASERS),
+    SCALAR(GameState, num_players, "i4"),
+    SCALAR(GameState, current_tick, "i4"),
+    SCALAR(GameState, winner, "i4"),
+    SCALAR(GameState, game_over, "?"),
+    SCALAR(GameState, step_kernel, "u1"),
+};
+
+static const ApiFieldLayout step_info_fields[] = {
+    ARRAY(StepInfo, player_hit, "?", MAX_PLAYERS),
+    ARRAY(StepInfo, player_fragged, "?", MAX_PLAYERS),
+    ARRAY(StepInfo, crystal_collected, "?", MAX_PLAYERS),
+    ARRAY(StepInfo, damage_dealt, "i4", MAX_PLAYERS),
+    ARRAY(StepInfo, damage_taken, "i4", MAX_PLAYERS),
+    ARRAY(StepInfo, frags, "i4", MAX_PLAYERS),
+};
+
+#define STRUCT(s, fields) {#s, (int)sizeof(s), (int)(sizeof(fields) / sizeof(fields[0])), fields}
+
+// Dependencies before the structs that embed them
+static const ApiStructLayout struct_layouts[] = {
+    STRUCT(Position, position_fields),
+    STRUCT(Player, player_fields),
+    STRUCT(LaserBeam, laser_fields),
+    STRUCT(Arena, arena_fields),
+    STRUCT(GameState, state_fields),
+    STRUCT(StepInfo, step_info_fields),
+};
+
+#define NUM_STRUCT_LAYOUTS (int)(sizeof(struct_layouts) / sizeof(struct_layouts[0]))
+
+int api_get_num_struct_layouts(void) {
+    return NUM_STRUCT_LAYOUTS;
+}
+
+const ApiStructLayout* api_get_struct_layout_at(int idx) {
+    return idx >= 0 && idx < NUM_STRUCT_LAYOUTS ? &struct_layouts[idx] : NULL;
+}
+
+const ApiStructLayout* api_get_struct_layout(const char* name) {
+    for (int i = 0; i < NUM_STRUCT_LAYOUTS; i++) {
+        if (strcmp(struct_layouts[i].name, name) == 0) {
+            return &struct_layouts[i];
+        }
+    }
+    return NULL;
+}
+
+DatasetWriter* api_dataset_open(const char* dir, int obs_size, int num_players, int chunk_rows) {
+    return trajectory_writer_open(dir, obs_size, num_players, chunk_rows);
+}
+
+bool api_dataset_append(
+    DatasetWriter* writer,
+    const float* obs,
+    const int* actions,
+    const float* rewards,
+    bool done,
+    const StepInfo* info
+) {
+    PlayerAction player_actions[MAX_PLAYERS];
+
+    for (int i = 0; i < trajectory_writer_num_players(writer); i++) {
+        player_actions[i].move = (ActionType)actions[i * 2];
+        player_actions[i].shoot = (ActionType)actions[i * 2 + 1];
+    }
+
+    return trajectory_writer_append(writer, obs, player_actions, rewards, done, info);
+}
+
+bool api_dataset_close(DatasetWriter* writer) {
+    return dataset_writer_close(writer);
+}
@@ -2,6 +2,12 @@
 #define ARENA_API_H
 
 #include "types.h"
+#include "dataset.h"
+#include "mappack.h"
+#include "batch.h"
+#include "profile.h"
+#include "observation.h"
+#include "framestack.h"
 
 // =============================================================================
 // External API for Python bindings
@@ -15,13 +21,97 @@ extern "C" {
 // Game lifecycle
 void api_game_init(GameState* state, const char* map_str);
 void api_game_reset(GameState* state);
-void api_game_set_seed(unsigned int seed);
+void api_game_free(GameState* state);  // release map data and occupancy grid
+bool api_game_copy(GameState* dst, const GameState* src);  // independent copy, see game_copy
+void api_game_set_seed(unsigned int seed);  // respawn RNG of the calling thread
+
+// Player count (1..MAX_PLAYERS, default 2). Changing it resets the game.
+bool api_game_set_num_players(GameState* state, int num_players);
+int api_get_num_players(const GameState* state);
+
+// Precompiled map packs (see mappack.h). The pack must stay open while
+// states initialized from it are in use.
+MapPack* api_map_pack_open(const char* path);  // NULL on error
+void api_map_pack_close(MapPack* pack);
+int api_map_pack_num_maps(const MapPack* pack);
+int api_map_pack_find(const MapPack* pack, const char* name);
+bool api_game_init_from_pack(GameState* state, const MapPack* pack, int map_idx);
+
+// Switch an initialized state to a freshly generated map (see mapgen.h)
+// and reset it. Cheap enough to call on every episode reset. On failure
+// the state keeps its old map and is not reset.
+bool api_game_reset_generated(GameState* state, unsigned int seed, int width, int height,
+                              float wall_density, float void_density);
 
 // Main step function
 // actions: array of 2 integers per player [move, shoot] for each player
 // So for 2 players: [p0_move, p0_shoot, p1_move, p1_shoot]
+// (num_players pairs are read)
 StepInfo api_game_step(GameState* state, const int* actions);
 
+// Batched duels on the map of state (see batch.h), reset as by
+// api_game_reset. actions holds [move, shoot] for both players of every
+// env, env by env; infos receives one StepInfo per env.
+BatchEngine* api_batch_create(const GameState* state, int num_envs);  // NULL on error
+void api_batch_free(BatchEngine* engine);
+void api_batch_reset(BatchEngine* engine, int env);
+void api_batch_step(BatchEngine* engine, const int* actions, StepInfo* infos);
+// Snapshot of one env; borrows the engine's map, so never api_game_free
+// it (see batch_engine_get_state)
+void api_batch_get_state(const BatchEngine* engine, int env, GameState* out);
+
+// Self-play over a batch: both seats of every env are agents, agent
+// env * 2 + seat, so buffers are [num_envs * 2, ...] and one policy pass
+// serves both seats. actions is [move, shoot] per agent in the agent's
+// observation frame (see OBS_FLAG_MIRROR_SEAT1 in observation.h).
+// rewards[agent] is the frags it was credited this step minus 1 if it
+// was fragged; dones[agent] is 1 once its env is over. infos may be NULL.
+// Returns false if scratch memory could not be allocated.
+bool api_batch_step_agents(BatchEngine* engine, const int* actions, unsigned flags,
+                           float* rewards, uint8_t* dones, StepInfo* infos);
+
+// Legal-action masks of every agent, [num_envs * 2][5] uint8 indexed by
+// action (see batch_engine_write_action_masks), in each agent's
+// observation frame under flags. shoot_mask may be NULL.
+void api_write_action_masks(const BatchEngine* engine, unsigned flags, uint8_t* move_mask,
+                            uint8_t* shoot_mask);
+
+// Observations of every agent, observation size floats apart: full-map
+// observations when k is 0, else k x k crops
+void api_batch_write_agent_observations(const BatchEngine* engine, int k, unsigned flags,
+                                        float* out);
+
+// Incremental form of the full-map agent observations (see ObsCache in
+// observation.h): caches holds one zeroed ObsCache per agent, kept with
+// out between calls, and only cells that changed since the last call
+// are rewritten. Release the caches with api_release_obs_caches before
+// freeing them.
+void api_batch_update_agent_observations(const BatchEngine* engine, ObsCache* caches,
+                                         unsigned flags, float* out);
+int api_get_obs_cache_size(void);  // bytes per ObsCache, for allocation
+void api_release_obs_caches(ObsCache* caches, int count);
+
+// Dihedral augmentation (see observation.h): for every agent, one
+// observation per transform set in the transforms bitmask (bit t for
+// transform t), in increasing t, so out is [num_envs * 2][count][size].
+// Map actions into each frame with api_get_dihedral_actions. Returns
+// false if scratch memory could not be allocated.
+bool api_batch_write_dihedral_observations(const BatchEngine* engine, int k, unsigned flags,
+                                           unsigned transforms, float* out);
+
+// observation_dihedral_actions: [8][5], world action to action in frame t
+const uint8_t* api_get_dihedral_actions(void);
+
+// Packed observations (see observation.h), packing 0 for uint8 cells or
+// 1 for bit planes. width and height are the map's, or k for crops. The
+// batch form writes every agent, packed size bytes apart, and returns
+// false if scratch memory could not be allocated.
+int api_get_packed_observation_size(int width, int height, unsigned flags, int packing);
+bool api_batch_write_packed_observations(const BatchEngine* engine, int k, unsigned flags,
+                                         int packing, uint8_t* out);
+void api_unpack_observations(const uint8_t* packed, int count, int width, int height,
+                             unsigned flags, int packing, float* out);
+
 // State queries for observations
 int api_get_arena_width(const GameState* state);
 int api_get_arena_height(const GameState* state);
@@ -49,9 +139,91 @@ int api_get_current_tick(const GameState* state);
 int api_get_winner(const GameState* state);
 bool api_is_game_over(const GameState* state);
 
+// Shortest-path steps between two floor tiles, or -1 if unreachable
+// (a table lookup when either end is a crystal or spawn point)
+int api_get_distance(const GameState* state, int from_x, int from_y, int to_x, int to_y);
+
+// Observations (see observation.h for layout and OBS_FLAG_* options)
+int api_get_observation_size(const GameState* state, unsigned flags);
+void api_write_observation(const GameState* state, int player_idx, unsigned flags, float* out);
+
+// Egocentric k x k crops; the batch form writes one crop per state
+int api_get_crop_observation_size(int k, unsigned flags);
+void api_write_crop_observation(const GameState* state, int player_idx, int k, unsigned flags,
+                                float* out);
+void api_write_crop_observation_batch(const GameState* states, int num_envs, int player_idx,
+                                      int k, unsigned flags, float* out);
+
+// Frame stacking of agent observations (see framestack.h): write each
+// step's [num_agents][obs_size] frame at api_framestack_next, then push;
+// window is the contiguous [k][num_agents][obs_size] history, oldest
+// first, or NULL on the plain-ring fallback, where frame(i) or offsets
+// locate each frame
+FrameStack* api_framestack_create(int num_agents, int obs_size, int k);  // NULL on error
+void api_framestack_free(FrameStack* stack);
+float* api_framestack_next(FrameStack* stack);
+void api_framestack_push(FrameStack* stack);
+const float* api_framestack_window(const FrameStack* stack);
+const float* api_framestack_frame(const FrameStack* stack, int i);
+void api_framestack_window_offsets(const FrameStack* stack, size_t* offsets);
+void api_framestack_reset_row(FrameStack* stack, int agent);
+
+// Per-phase game_step timings of the calling thread (see profile.h).
+// Returns false when the library was built without ARENA_PROFILE.
+bool api_get_profile_stats(ProfileStats* out);
+void api_reset_profile_stats(void);
+
+// Timeline tracing of game_step (see trace.h). capacity is in events per
+// thread (<= 0 for the default); dump returns false on I/O error.
+void api_trace_start(int capacity);
+void api_trace_stop(void);
+bool api_trace_dump(const char* path);
+
 // Size query for allocation
 int api_get_state_size(void);
 
+// Struct layouts, so arrays of these structs can be read in place (e.g.
+// as numpy structured dtypes) instead of through the getters above.
+// Described: Position, Player, LaserBeam, Arena, GameState, StepInfo.
+// Crystals have no struct of their own: positions live in the shared map
+// and cooldowns in Arena.crystal_cooldowns.
+//
+// A field's type is either a numpy type string ("i4", "u1", "?", "V8"
+// for an opaque pointer) or the name of another described struct. Fields
+// are listed in offset order; padding is not described.
+typedef struct {
+    const char* name;
+    const char* type;
+    int offset;  // bytes from the start of the struct
+    int size;    // bytes per element
+    int count;   // array length, 1 for scalars
+} ApiFieldLayout;
+
+typedef struct {
+    const char* name;
+    int size;  // sizeof the struct, including padding
+    int num_fields;
+    const ApiFieldLayout* fields;
+} ApiStructLayout;
+
+int api_get_num_struct_layouts(void);
+const ApiStructLayout* api_get_struct_layout_at(int idx);  // NULL if out of range
+const ApiStructLayout* api_get_struct_layout(const char* name);  // NULL if not described
+
+// Trajectory recording (see dataset.h for the on-disk layout)
+// actions uses the same [move, shoot] per player layout as api_game_step;
+// actions and rewards hold num_players entries
+DatasetWriter* api_dataset_open(const char* dir, int obs_size, int num_players, int chunk_rows);
+bool api_dataset_append(
+    DatasetWriter* writer,
+    const float* obs,
+    const int* actions,
+    const float* rewards,
+    bool done,
+    const StepInfo* info
+);
+bool api_dataset_close(DatasetWriter* writer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,196 +1,88 @@
 #include "arena.h"
-#include <string.h>
+#include "map.h"
+#include "occupancy.h"
 #include <stdlib.h>
+#include <string.h>
 
-void arena_init(Arena* arena, int width, int height) {
-    arena->width = width;
-    arena->height = height;
-    arena->num_crystals = 0;
-    arena->num_spawn_points = 0;
-
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            arena->tiles[y][x] = TILE_FLOOR;
-        }
-    }
+// Bytes in the occupancy grid for map (at least 1, so malloc never sees 0)
+static size_t occupancy_bytes(const MapData* map) {
+    size_t tiles = (size_t)map->height * (size_t)map->stride;
+    return tiles > 0 ? tiles : 1;
+}
 
-    for (int i = 0; i < MAX_CRYSTALS; i++) {
-        arena->crystals[i].pos.x = -1;
-        arena->crystals[i].pos.y = -1;
-        arena->crystals[i].cooldown_ticks = 0;
+// Takes over a reference to map. The occupancy grid is sized for the map;
+// if it can't be allocated the arena falls back to the empty map.
+static bool arena_attach(Arena* arena, const MapData* map) {
+    arena->occupancy = malloc(occupancy_bytes(map));
+    if (!arena->occupancy) {
+        map_data_release(map);
+        map = map_data_empty();
+        arena->occupancy = malloc(occupancy_bytes(map));
     }
-
-    for (int i = 0; i < MAX_SPAWN_POINTS; i++) {
-        arena->spawn_points[i].pos.x = -1;
-        arena->spawn_points[i].pos.y = -1;
+    if (arena->occupancy) {
+        memset(arena->occupancy, OCCUPANCY_EMPTY, occupancy_bytes(map));
     }
+    arena->map = map;
+    arena_reset_crystals(arena);
+    return map != map_data_empty();
 }
 
-bool arena_load_from_string(Arena* arena, const char* map_str) {
-    // First pass: determine dimensions
-    // Must properly count UTF-8 characters, not bytes
-    int width = 0;
-    int height = 0;
-    int current_width = 0;
+void arena_init(Arena* arena, const MapData* map) {
+    map_data_retain(map);
+    arena_attach(arena, map);
+}
 
-    for (const char* p = map_str; *p; p++) {
-        unsigned char c = (unsigned char)*p;
-        if (c == '\n') {
-            if (current_width > width) {
-                width = current_width;
-            }
-            if (current_width > 0) {
-                height++;
-            }
-            current_width = 0;
-        } else if (c == ' ') {
-            // Skip spaces (used for formatting)
-            continue;
-        } else if ((c & 0xC0) == 0x80) {
-            // UTF-8 continuation byte (10xxxxxx) - skip, don't count
-            continue;
-        } else {
-            // Either ASCII (0xxxxxxx) or start of multi-byte sequence
-            // (110xxxxx, 1110xxxx, 11110xxx) - count as one character
-            current_width++;
-        }
+bool arena_copy(Arena* dst, const Arena* src) {
+    *dst = *src;
+    map_data_retain(src->map);
+    dst->occupancy = malloc(occupancy_bytes(src->map));
+    if (!dst->occupancy) {
+        map_data_release(src->map);
+        arena_attach(dst, map_data_empty());
+        return false;
     }
-    // Handle last line without newline
-    if (current_width > 0) {
-        if (current_width > width) {
-            width = current_width;
-        }
-        height++;
+    if (src->occupancy) {
+        memcpy(dst->occupancy, src->occupancy, occupancy_bytes(src->map));
+    } else {
+        memset(dst->occupancy, OCCUPANCY_EMPTY, occupancy_bytes(src->map));
     }
+    return true;
+}
 
-    if (width > MAX_ARENA_WIDTH || height > MAX_ARENA_HEIGHT) {
+void arena_release(Arena* arena) {
+    map_data_release(arena->map);
+    free(arena->occupancy);
+    arena->occupancy = NULL;
+    arena->map = map_data_empty();
+}
+
+bool arena_load_from_string(Arena* arena, const char* map_str) {
+    const MapData* map = map_data_load(map_str);
+    if (!map) {
+        arena_attach(arena, map_data_empty());
         return false;
     }
 
-    arena_init(arena, width, height);
-
-    // Second pass: parse tiles
-    int x = 0;
-    int y = 0;
-
-    for (const char* p = map_str; *p; p++) {
-        if (*p == '\n') {
-            x = 0;
-            if (y < height - 1) {
-                y++;
-            }
-            continue;
-        }
-
-        if (*p == ' ') {
-            continue;  // Skip spaces (used for formatting)
-        }
-
-        if (x >= width || y >= height) {
-            continue;
-        }
-
-        // Parse character
-        // × = void, ■ = wall, □ = floor, ◆ = crystal, ▷◁△▽ = spawn points
-        // Also support ASCII: x = void, # = wall, . = floor, * = crystal, 1/2 = spawn
-
-        // Check for multi-byte UTF-8 characters
-        unsigned char c = (unsigned char)*p;
-
-        if (c == 'x' || c == 'X') {
-            arena->tiles[y][x] = TILE_VOID;
-        } else if (c == '#') {
-            arena->tiles[y][x] = TILE_WALL;
-        } else if (c == '.' || c == '_') {
-            arena->tiles[y][x] = TILE_FLOOR;
-        } else if (c == '*' || c == 'C' || c == 'c') {
-            arena->tiles[y][x] = TILE_FLOOR;
-            if (arena->num_crystals < MAX_CRYSTALS) {
-                arena->crystals[arena->num_crystals].pos.x = x;
-                arena->crystals[arena->num_crystals].pos.y = y;
-                arena->crystals[arena->num_crystals].cooldown_ticks = 0;
-                arena->num_crystals++;
-            }
-        } else if (c == '1' || c == '2' || c == 'S' || c == 's') {
-            arena->tiles[y][x] = TILE_FLOOR;
-            if (arena->num_spawn_points < MAX_SPAWN_POINTS) {
-                arena->spawn_points[arena->num_spawn_points].pos.x = x;
-                arena->spawn_points[arena->num_spawn_points].pos.y = y;
-                arena->num_spawn_points++;
-            }
-        } else if (c >= 0xC0) {
-            // Multi-byte UTF-8 character
-            // ×(U+00D7): C3 97
-            // ■(U+25A0): E2 96 A0
-            // □(U+25A1): E2 96 A1
-            // ◆(U+25C6): E2 97 86
-            // ▷(U+25B7): E2 96 B7
-            // ◁(U+25C1): E2 97 81
-
-            if (c == 0xC3 && (unsigned char)*(p+1) == 0x97) {
-                // × (multiplication sign) = void
-                arena->tiles[y][x] = TILE_VOID;
-                p++;
-            } else if (c == 0xE2) {
-                unsigned char c2 = (unsigned char)*(p+1);
-                unsigned char c3 = (unsigned char)*(p+2);
-
-                if (c2 == 0x96 && c3 == 0xA0) {
-                    // ■ = wall
-                    arena->tiles[y][x] = TILE_WALL;
-                    p += 2;
-                } else if (c2 == 0x96 && c3 == 0xA1) {
-                    // □ = floor
-                    arena->tiles[y][x] = TILE_FLOOR;
-                    p += 2;
-                } else if (c2 == 0x97 && c3 == 0x86) {
-                    // ◆ = crystal
-                    arena->tiles[y][x] = TILE_FLOOR;
-                    if (arena->num_crystals < MAX_CRYSTALS) {
-                        arena->crystals[arena->num_crystals].pos.x = x;
-                        arena->crystals[arena->num_crystals].pos.y = y;
-                        arena->crystals[arena->num_crystals].cooldown_ticks = 0;
-                        arena->num_crystals++;
-                    }
-                    p += 2;
-                } else if ((c2 == 0x96 && c3 == 0xB7) ||  // ▷
-                           (c2 == 0x97 && c3 == 0x81) ||  // ◁
-                           (c2 == 0x96 && c3 == 0xB3) ||  // △
-                           (c2 == 0x96 && c3 == 0xBD)) {  // ▽
-                    // Spawn point
-                    arena->tiles[y][x] = TILE_FLOOR;
-                    if (arena->num_spawn_points < MAX_SPAWN_POINTS) {
-                        arena->spawn_points[arena->num_spawn_points].pos.x = x;
-                        arena->spawn_points[arena->num_spawn_points].pos.y = y;
-                        arena->num_spawn_points++;
-                    }
-                    p += 2;
-                } else {
-                    // Unknown UTF-8, treat as floor
-                    arena->tiles[y][x] = TILE_FLOOR;
-                    p += 2;
-                }
-            } else {
-                // Other multi-byte, skip appropriately
-                if (c >= 0xE0) p += 2;
-                else p++;
-            }
-        } else {
-            // Unknown single-byte, treat as floor
-            arena->tiles[y][x] = TILE_FLOOR;
-        }
+    // map_data_load already returned a reference for us
+    return arena_attach(arena, map);
+}
 
-        x++;
+void arena_reset_crystals(Arena* arena) {
+    for (int i = 0; i < MAX_CRYSTALS; i++) {
+        arena->crystal_cooldowns[i] = 0;
     }
+}
 
-    return true;
+int arena_width(const Arena* arena) {
+    return arena->map->width;
+}
+
+int arena_height(const Arena* arena) {
+    return arena->map->height;
 }
 
 TileType arena_get_tile(const Arena* arena, int x, int y) {
-    if (x < 0 || x >= arena->width || y < 0 || y >= arena->height) {
-        return TILE_VOID;  // Out of bounds is void
-    }
-    return arena->tiles[y][x];
+    return map_get_tile(arena->map, x, y);  // Out of bounds is void
 }
 
 bool arena_is_passable(const Arena* arena, int x, int y) {
@@ -199,7 +91,7 @@ bool arena_is_passable(const Arena* arena, int x, int y) {
 }
 
 bool arena_is_valid_position(const Arena* arena, int x, int y) {
-    return x >= 0 && x < arena->width && y >= 0 && y < arena->height;
+    return x >= 0 && x < arena->map->width && y >= 0 && y < arena->map->height;
 }
 
 bool arena_is_void(const Arena* arena, int x, int y) {
@@ -211,31 +103,29 @@ bool arena_is_wall(const Arena* arena, int x, int y) {
 }
 
 int arena_get_crystal_at(const Arena* arena, int x, int y) {
-    for (int i = 0; i < arena->num_crystals; i++) {
-        if (arena->crystals[i].pos.x == x && arena->crystals[i].pos.y == y) {
-            return i;
-        }
+    if (!arena_is_valid_position(arena, x, y)) {
+        return -1;
     }
-    return -1;
+    return map_crystal_at(arena->map)[map_index(arena->map, x, y)];
 }
 
 bool arena_crystal_available(const Arena* arena, int crystal_idx) {
-    if (crystal_idx < 0 || crystal_idx >= arena->num_crystals) {
+    if (crystal_idx < 0 || crystal_idx >= arena->map->num_crystals) {
         return false;
     }
-    return arena->crystals[crystal_idx].cooldown_ticks == 0;
+    return arena->crystal_cooldowns[crystal_idx] == 0;
 }
 
 void arena_collect_crystal(Arena* arena, int crystal_idx) {
-    if (crystal_idx >= 0 && crystal_idx < arena->num_crystals) {
-        arena->crystals[crystal_idx].cooldown_ticks = CRYSTAL_RESPAWN_TICKS;
+    if (crystal_idx >= 0 && crystal_idx < arena->map->num_crystals) {
+        arena->crystal_cooldowns[crystal_idx] = CRYSTAL_RESPAWN_TICKS;
     }
 }
 
 void arena_tick_crystals(Arena* arena) {
-    for (int i = 0; i < arena->num_crystals; i++) {
-        if (arena->crystals[i].cooldown_ticks > 0) {
-            arena->crystals[i].cooldown_ticks--;
+    for (int i = 0; i < arena->map->num_crystals; i++) {
+        if (arena->crystal_cooldowns[i] > 0) {
+            arena->crystal_cooldowns[i]--;
         }
     }
 }
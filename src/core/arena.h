@@ -3,13 +3,30 @@
 
 #include "types.h"
 
-// Initialize an empty arena
-void arena_init(Arena* arena, int width, int height);
+// Attach shared map data to an arena (takes a new reference), allocate
+// its occupancy grid and make all crystals available
+void arena_init(Arena* arena, const MapData* map);
 
-// Load arena from string (ASCII art format)
-// Returns true on success, false on error
+// Make dst an independent copy of src: a new map reference, its own
+// occupancy grid (empty if src has none) and the same crystal state. dst
+// must not hold a grid. Returns false on allocation failure, leaving dst
+// on the empty map.
+bool arena_copy(Arena* dst, const Arena* src);
+
+// Drop the arena's map reference and free its occupancy grid
+void arena_release(Arena* arena);
+
+// Load arena from string (ASCII art format), sharing the interned map data
+// Returns true on success; on error the arena gets the empty map
 bool arena_load_from_string(Arena* arena, const char* map_str);
 
+// Make all crystals available again (keeps the map)
+void arena_reset_crystals(Arena* arena);
+
+// Map dimensions
+int arena_width(const Arena* arena);
+int arena_height(const Arena* arena);
+
 // Tile queries
 TileType arena_get_tile(const Arena* arena, int x, int y);
 bool arena_is_passable(const Arena* arena, int x, int y);
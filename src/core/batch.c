@@ -0,0 +1,700 @@
+#include "batch.h"
+#include "arena.h"
+#include "game.h"
+#include "map.h"
+#include "occupancy.h"
+#include "player.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+// The lane kernels use move actions as directions directly
+_Static_assert(ACTION_UP == (int)DIR_UP && ACTION_DOWN == (int)DIR_DOWN &&
+               ACTION_LEFT == (int)DIR_LEFT && ACTION_RIGHT == (int)DIR_RIGHT,
+               "actions and directions must share values");
+_Static_assert(sizeof(PlayerAction) == 2 * sizeof(int32_t), "PlayerAction must be two int32s");
+
+// Per-step env flags
+#define FLAG_DONE     1  // game over at step start: untouched
+#define FLAG_FRAGGED  2  // someone is dead after shooting: finish the step per env
+
+#define PLAYER_FIELDS 11
+#define LASER_FIELDS  7
+#define ENV_FIELDS    4
+
+// =============================================================================
+// Lifetime and conversion
+// =============================================================================
+
+bool batch_engine_uses_avx2(void) {
+#ifdef BATCH_HAVE_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+BatchEngine* batch_engine_create(const MapData* map, int num_envs) {
+    if (num_envs < 1) {
+        return NULL;
+    }
+    BatchEngine* engine = calloc(1, sizeof(BatchEngine));
+    if (!engine) {
+        return NULL;
+    }
+
+    int capacity = (num_envs + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+    size_t rows = (size_t)PLAYER_FIELDS * BATCH_NUM_PLAYERS + MAX_CRYSTALS +
+                  (size_t)LASER_FIELDS * MAX_LASERS + ENV_FIELDS;
+    size_t bytes = rows * (size_t)capacity * sizeof(int32_t);
+    engine->storage = aligned_alloc(64, (bytes + 63) / 64 * 64);
+    if (!engine->storage) {
+        free(engine);
+        return NULL;
+    }
+    memset(engine->storage, 0, bytes);
+
+    int32_t* next = engine->storage;
+    int32_t** player_fields[PLAYER_FIELDS] = {
+        &engine->pos_x, &engine->pos_y, &engine->facing, &engine->health, &engine->energy,
+        &engine->move_cooldown, &engine->laser_cooldown, &engine->energy_regen, &engine->score,
+        &engine->last_hit_by, &engine->alive,
+    };
+    for (int i = 0; i < PLAYER_FIELDS; i++) {
+        *player_fields[i] = next;
+        next += BATCH_NUM_PLAYERS * capacity;
+    }
+    engine->crystal_cooldowns = next;
+    next += MAX_CRYSTALS * capacity;
+    int32_t** laser_fields[LASER_FIELDS] = {
+        &engine->laser_start_x, &engine->laser_start_y, &engine->laser_end_x,
+        &engine->laser_end_y, &engine->laser_owner, &engine->laser_ticks, &engine->laser_active,
+    };
+    for (int i = 0; i < LASER_FIELDS; i++) {
+        *laser_fields[i] = next;
+        next += MAX_LASERS * capacity;
+    }
+    int32_t** env_fields[ENV_FIELDS] = {
+        &engine->tick, &engine->winner, &engine->game_over, &engine->flags,
+    };
+    for (int i = 0; i < ENV_FIELDS; i++) {
+        *env_fields[i] = next;
+        next += capacity;
+    }
+
+    engine->map = map;
+    engine->num_envs = num_envs;
+    engine->capacity = capacity;
+    engine->use_avx2 = batch_engine_uses_avx2();
+    map_data_retain(map);
+
+    arena_init(&engine->scratch.arena, map);
+    engine->scratch.num_players = BATCH_NUM_PLAYERS;
+
+    for (int env = 0; env < num_envs; env++) {
+        batch_engine_reset(engine, env);
+    }
+    for (int env = num_envs; env < capacity; env++) {
+        engine->game_over[env] = 1;
+        engine->winner[env] = -1;
+    }
+    return engine;
+}
+
+void batch_engine_free(BatchEngine* engine) {
+    if (!engine) {
+        return;
+    }
+    game_free(&engine->scratch);
+    map_data_release(engine->map);
+    free(engine->storage);
+    free(engine);
+}
+
+// Players of env into state, stamping the live ones on its occupancy grid
+// when it has one
+static void load_players(const BatchEngine* engine, int env, GameState* state) {
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        int i = p * engine->capacity + env;
+        Player* player = &state->players[p];
+        player->pos.x = engine->pos_x[i];
+        player->pos.y = engine->pos_y[i];
+        player->facing = (Direction)engine->facing[i];
+        player->health = engine->health[i];
+        player->energy = engine->energy[i];
+        player->move_cooldown_ticks = engine->move_cooldown[i];
+        player->laser_cooldown_ticks = engine->laser_cooldown[i];
+        player->energy_regen_ticks = engine->energy_regen[i];
+        player->score = engine->score[i];
+        player->last_hit_by = engine->last_hit_by[i];
+        player->alive = engine->alive[i] != 0;
+        if (player->alive && state->arena.occupancy) {
+            occupancy_set(state, player->pos, p);
+        }
+    }
+}
+
+// Inverse of load_players, taking the players off the occupancy grid again
+// (players sharing a tile leave its entry behind, which the next load
+// re-stamps or reads ignore)
+static void store_players(BatchEngine* engine, int env, GameState* state) {
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        int i = p * engine->capacity + env;
+        const Player* player = &state->players[p];
+        engine->pos_x[i] = player->pos.x;
+        engine->pos_y[i] = player->pos.y;
+        engine->facing[i] = player->facing;
+        engine->health[i] = player->health;
+        engine->energy[i] = player->energy;
+        engine->move_cooldown[i] = player->move_cooldown_ticks;
+        engine->laser_cooldown[i] = player->laser_cooldown_ticks;
+        engine->energy_regen[i] = player->energy_regen_ticks;
+        engine->score[i] = player->score;
+        engine->last_hit_by[i] = player->last_hit_by;
+        engine->alive[i] = player->alive;
+        if (player->alive && state->arena.occupancy) {
+            occupancy_clear(state, player->pos, p);
+        }
+    }
+}
+
+static void load_laser(const BatchEngine* engine, int env, int slot, LaserBeam* laser) {
+    int i = slot * engine->capacity + env;
+    laser->start.x = engine->laser_start_x[i];
+    laser->start.y = engine->laser_start_y[i];
+    laser->end.x = engine->laser_end_x[i];
+    laser->end.y = engine->laser_end_y[i];
+    laser->player_idx = engine->laser_owner[i];
+    laser->ticks_remaining = engine->laser_ticks[i];
+    laser->active = engine->laser_active[i] != 0;
+}
+
+static void store_laser(BatchEngine* engine, int env, int slot, const LaserBeam* laser) {
+    int i = slot * engine->capacity + env;
+    engine->laser_start_x[i] = laser->start.x;
+    engine->laser_start_y[i] = laser->start.y;
+    engine->laser_end_x[i] = laser->end.x;
+    engine->laser_end_y[i] = laser->end.y;
+    engine->laser_owner[i] = laser->player_idx;
+    engine->laser_ticks[i] = laser->ticks_remaining;
+    engine->laser_active[i] = laser->active;
+}
+
+static void load_crystals(const BatchEngine* engine, int env, GameState* state) {
+    for (int c = 0; c < MAX_CRYSTALS; c++) {
+        state->arena.crystal_cooldowns[c] = engine->crystal_cooldowns[c * engine->capacity + env];
+    }
+}
+
+static void store_crystals(BatchEngine* engine, int env, const GameState* state) {
+    for (int c = 0; c < MAX_CRYSTALS; c++) {
+        engine->crystal_cooldowns[c * engine->capacity + env] = state->arena.crystal_cooldowns[c];
+    }
+}
+
+void batch_engine_write_action_masks(const BatchEngine* engine, uint8_t* move, uint8_t* shoot) {
+    const MapData* map = engine->map;
+    int capacity = engine->capacity;
+    for (int env = 0; env < engine->num_envs; env++) {
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            int i = p * capacity + env;
+            bool alive = engine->alive[i] && !engine->game_over[env];
+            bool can_move = player_ready_to_move(alive, engine->move_cooldown[i]);
+            bool can_shoot =
+                player_ready_to_shoot(alive, engine->laser_cooldown[i], engine->energy[i]);
+            uint8_t* m = move + (size_t)(env * BATCH_NUM_PLAYERS + p) * 5;
+            m[ACTION_NOOP] = 1;
+            for (int a = ACTION_UP; a <= ACTION_RIGHT; a++) {
+                Position target = position_add_direction(
+                    (Position){engine->pos_x[i], engine->pos_y[i]}, action_to_direction(a));
+                m[a] = can_move && map_get_tile(map, target.x, target.y) != TILE_WALL;
+            }
+            if (shoot) {
+                uint8_t* s = shoot + (size_t)(env * BATCH_NUM_PLAYERS + p) * 5;
+                s[ACTION_NOOP] = 1;
+                for (int a = ACTION_UP; a <= ACTION_RIGHT; a++) {
+                    s[a] = can_shoot;
+                }
+            }
+        }
+    }
+}
+
+void batch_engine_get_state(const BatchEngine* engine, int env, GameState* out) {
+    memset(out, 0, sizeof(*out));
+    out->arena.map = engine->map;
+    out->arena.occupancy = NULL;
+    out->num_players = BATCH_NUM_PLAYERS;
+    load_players(engine, env, out);
+    load_crystals(engine, env, out);
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        load_laser(engine, env, slot, &out->lasers[slot]);
+    }
+    out->current_tick = engine->tick[env];
+    out->winner = engine->winner[env];
+    out->game_over = engine->game_over[env] != 0;
+    for (int p = BATCH_NUM_PLAYERS; p < MAX_PLAYERS; p++) {
+        out->players[p].alive = false;
+    }
+}
+
+bool batch_engine_set_state(BatchEngine* engine, int env, const GameState* state) {
+    if (env < 0 || env >= engine->num_envs || state->arena.map != engine->map ||
+        state->num_players != BATCH_NUM_PLAYERS) {
+        return false;
+    }
+    GameState copy = *state;
+    copy.arena.occupancy = NULL;
+    store_players(engine, env, &copy);
+    store_crystals(engine, env, &copy);
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        store_laser(engine, env, slot, &copy.lasers[slot]);
+    }
+    engine->tick[env] = state->current_tick;
+    engine->winner[env] = state->winner;
+    engine->game_over[env] = state->game_over;
+    return true;
+}
+
+void batch_engine_reset(BatchEngine* engine, int env) {
+    GameState* scratch = &engine->scratch;
+    game_reset(scratch);
+    store_players(engine, env, scratch);
+    store_crystals(engine, env, scratch);
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        store_laser(engine, env, slot, &scratch->lasers[slot]);
+    }
+    engine->tick[env] = scratch->current_tick;
+    engine->winner[env] = scratch->winner;
+    engine->game_over[env] = scratch->game_over;
+}
+
+// =============================================================================
+// Scalar lane kernels
+//
+// Each works on one env and mirrors the matching part of game_step; the
+// AVX2 kernels below compute the same thing eight envs at a time.
+// =============================================================================
+
+// Crystal pickup for the live players of env (before and after movement)
+static void collect_env(BatchEngine* engine, int env, StepInfo* info) {
+    const MapData* map = engine->map;
+    const int8_t* crystal_at = map_crystal_at(map);
+    int capacity = engine->capacity;
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        int i = p * capacity + env;
+        int x = engine->pos_x[i], y = engine->pos_y[i];
+        if (!engine->alive[i] || x < 0 || x >= map->width || y < 0 || y >= map->height) {
+            continue;
+        }
+        int c = crystal_at[map_index(map, x, y)];
+        if (c >= 0 && engine->crystal_cooldowns[c * capacity + env] == 0) {
+            int energy = engine->energy[i] + MAX_ENERGY;
+            engine->energy[i] = energy > MAX_ENERGY ? MAX_ENERGY : energy;
+            engine->energy_regen[i] = ENERGY_REGEN_TICKS;
+            engine->crystal_cooldowns[c * capacity + env] = CRYSTAL_RESPAWN_TICKS;
+            info->crystal_collected[p] = true;
+        }
+    }
+}
+
+// Simultaneous movement for a duel. With two players the chain rules of
+// resolve_moves reduce to: a mover blocked by the other player follows it
+// if that player moves freely, and a swap blocks both.
+static void move_env(BatchEngine* engine, const PlayerAction* actions, int env) {
+    const MapData* map = engine->map;
+    int capacity = engine->capacity;
+    int dir[2], tx[2], ty[2], tile[2], want[2], can[2];
+    for (int p = 0; p < 2; p++) {
+        int i = p * capacity + env;
+        dir[p] = action_to_direction(actions[env * 2 + p].move);
+        can[p] = player_ready_to_move(engine->alive[i], engine->move_cooldown[i]);
+        Position target = position_add_direction(
+            (Position){engine->pos_x[i], engine->pos_y[i]}, (Direction)dir[p]);
+        tx[p] = target.x;
+        ty[p] = target.y;
+        tile[p] = map_get_tile(map, tx[p], ty[p]);
+        want[p] = dir[p] != DIR_NONE && can[p] && tile[p] != TILE_WALL;
+    }
+
+    bool contested = want[0] && want[1] && tx[0] == tx[1] && ty[0] == ty[1];
+    bool free_move[2], blocked[2];
+    for (int p = 0; p < 2; p++) {
+        int o = (1 - p) * capacity + env;
+        blocked[p] = engine->alive[o] && tx[p] == engine->pos_x[o] && ty[p] == engine->pos_y[o];
+        free_move[p] = want[p] && !contested && !blocked[p];
+    }
+
+    for (int p = 0; p < 2; p++) {
+        int i = p * capacity + env;
+        bool moves = want[p] && !contested && (!blocked[p] || free_move[1 - p]);
+        if (moves) {
+            engine->facing[i] = dir[p];
+            if (tile[p] == TILE_VOID) {
+                engine->alive[i] = 0;
+            } else {
+                engine->pos_x[i] = tx[p];
+                engine->pos_y[i] = ty[p];
+            }
+            engine->move_cooldown[i] = MOVEMENT_COOLDOWN_TICKS;
+        } else if (dir[p] != DIR_NONE && can[p]) {
+            // Blocked or walked into a wall
+            engine->facing[i] = dir[p];
+            engine->move_cooldown[i] = MOVEMENT_COOLDOWN_TICKS;
+        }
+    }
+}
+
+// Timers, tick counter and win check for one env
+static void finish_env(BatchEngine* engine, int env) {
+    int capacity = engine->capacity;
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        int i = p * capacity + env;
+        if (engine->move_cooldown[i] > 0) engine->move_cooldown[i]--;
+        if (engine->laser_cooldown[i] > 0) engine->laser_cooldown[i]--;
+        if (engine->energy[i] < MAX_ENERGY) {
+            if (--engine->energy_regen[i] <= 0) {
+                engine->energy[i]++;
+                engine->energy_regen[i] = ENERGY_REGEN_TICKS;
+            }
+        } else {
+            engine->energy_regen[i] = ENERGY_REGEN_TICKS;
+        }
+    }
+    for (int c = 0; c < engine->map->num_crystals; c++) {
+        if (engine->crystal_cooldowns[c * capacity + env] > 0) {
+            engine->crystal_cooldowns[c * capacity + env]--;
+        }
+    }
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        int i = slot * capacity + env;
+        if (engine->laser_active[i] && --engine->laser_ticks[i] <= 0) {
+            engine->laser_active[i] = 0;
+        }
+    }
+
+    int tick = ++engine->tick[env];
+    int s0 = engine->score[env], s1 = engine->score[capacity + env];
+    if (s0 >= WIN_SCORE || s1 >= WIN_SCORE) {
+        engine->winner[env] = s0 >= WIN_SCORE ? 0 : 1;
+        engine->game_over[env] = 1;
+    } else if (tick >= EPISODE_LENGTH_TICKS) {
+        engine->winner[env] = s0 > s1 ? 0 : s1 > s0 ? 1 : -1;
+        engine->game_over[env] = 1;
+    }
+}
+
+// =============================================================================
+// AVX2 lane kernels
+// =============================================================================
+
+#ifdef BATCH_HAVE_AVX2
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i load8(const int32_t* p) {
+    return _mm256_load_si256((const __m256i*)p);
+}
+
+// Write v to the lanes set in mask, keep the rest
+AVX2 static inline void store8_masked(int32_t* p, __m256i v, __m256i mask) {
+    _mm256_store_si256((__m256i*)p, _mm256_blendv_epi8(load8(p), v, mask));
+}
+
+AVX2 static inline __m256i not8(__m256i v) {
+    return _mm256_xor_si256(v, _mm256_set1_epi32(-1));
+}
+
+// Lane mask (all ones) where v != 0
+AVX2 static inline __m256i nonzero8(__m256i v) {
+    return not8(_mm256_cmpeq_epi32(v, _mm256_setzero_si256()));
+}
+
+AVX2 static void move_avx2(BatchEngine* engine, const PlayerAction* actions) {
+    const MapData* map = engine->map;
+    int capacity = engine->capacity;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i width = _mm256_set1_epi32(map->width);
+    const __m256i height = _mm256_set1_epi32(map->height);
+    const __m256i stride = _mm256_set1_epi32(map->stride);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int env = 0; env < capacity; env += BATCH_LANES) {
+        __m256i active = _mm256_cmpeq_epi32(load8(engine->flags + env), zero);
+        if (_mm256_testz_si256(active, active)) {
+            continue;
+        }
+
+        __m256i dir[2], tx[2], ty[2], tile[2], want[2], can[2], px[2], py[2], alive[2];
+        for (int p = 0; p < 2; p++) {
+            int i = p * capacity + env;
+            px[p] = load8(engine->pos_x + i);
+            py[p] = load8(engine->pos_y + i);
+            alive[p] = nonzero8(load8(engine->alive + i));
+
+            // actions[(env + lane) * 2 + p].move, only for active lanes
+            __m256i index = _mm256_slli_epi32(_mm256_add_epi32(_mm256_set1_epi32(env), lane), 2);
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(p * 2));
+            __m256i move = _mm256_mask_i32gather_epi32(zero, (const int*)actions, index, active, 4);
+            __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(move, zero),
+                                             _mm256_cmpgt_epi32(_mm256_set1_epi32(5), move));
+            dir[p] = _mm256_and_si256(move, valid);
+
+            __m256i up = _mm256_cmpeq_epi32(dir[p], _mm256_set1_epi32(DIR_UP));
+            __m256i down = _mm256_cmpeq_epi32(dir[p], _mm256_set1_epi32(DIR_DOWN));
+            __m256i left = _mm256_cmpeq_epi32(dir[p], _mm256_set1_epi32(DIR_LEFT));
+            __m256i right = _mm256_cmpeq_epi32(dir[p], _mm256_set1_epi32(DIR_RIGHT));
+            tx[p] = _mm256_add_epi32(px[p], _mm256_sub_epi32(left, right));
+            ty[p] = _mm256_add_epi32(py[p], _mm256_sub_epi32(up, down));
+
+            // Tile under the target; off the map is void. The gather reads
+            // 4 bytes per tile, which stays inside the map blob because the
+            // derived tables follow the tiles.
+            __m256i inside = _mm256_and_si256(
+                _mm256_and_si256(_mm256_cmpgt_epi32(tx[p], minus_one), _mm256_cmpgt_epi32(width, tx[p])),
+                _mm256_and_si256(_mm256_cmpgt_epi32(ty[p], minus_one), _mm256_cmpgt_epi32(height, ty[p])));
+            __m256i gather_mask = _mm256_and_si256(_mm256_and_si256(inside, active), valid);
+            __m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(ty[p], stride), tx[p]);
+            __m256i raw = _mm256_mask_i32gather_epi32(zero, (const int*)map->tiles, offset,
+                                                      gather_mask, 1);
+            raw = _mm256_and_si256(raw, _mm256_set1_epi32(0xFF));
+            tile[p] = _mm256_blendv_epi8(_mm256_set1_epi32(TILE_VOID), raw, inside);
+
+            __m256i ready = _mm256_cmpeq_epi32(load8(engine->move_cooldown + i), zero);
+            can[p] = _mm256_and_si256(alive[p], ready);
+            want[p] = _mm256_andnot_si256(_mm256_cmpeq_epi32(tile[p], _mm256_set1_epi32(TILE_WALL)),
+                                          _mm256_and_si256(valid, can[p]));
+        }
+
+        __m256i same_target = _mm256_and_si256(_mm256_cmpeq_epi32(tx[0], tx[1]),
+                                               _mm256_cmpeq_epi32(ty[0], ty[1]));
+        __m256i contested = _mm256_and_si256(_mm256_and_si256(want[0], want[1]), same_target);
+        __m256i blocked[2], free_move[2];
+        for (int p = 0; p < 2; p++) {
+            int o = 1 - p;
+            blocked[p] = _mm256_and_si256(alive[o], _mm256_and_si256(
+                _mm256_cmpeq_epi32(tx[p], px[o]), _mm256_cmpeq_epi32(ty[p], py[o])));
+            free_move[p] = _mm256_andnot_si256(_mm256_or_si256(contested, blocked[p]), want[p]);
+        }
+
+        for (int p = 0; p < 2; p++) {
+            int i = p * capacity + env;
+            __m256i follows = _mm256_or_si256(not8(blocked[p]), free_move[1 - p]);
+            __m256i moves = _mm256_and_si256(_mm256_andnot_si256(contested, want[p]), follows);
+            moves = _mm256_and_si256(moves, active);
+            __m256i bumps = _mm256_andnot_si256(moves, _mm256_and_si256(
+                _mm256_and_si256(nonzero8(dir[p]), can[p]), active));
+            __m256i turns = _mm256_or_si256(moves, bumps);
+            __m256i dies = _mm256_and_si256(moves,
+                _mm256_cmpeq_epi32(tile[p], _mm256_set1_epi32(TILE_VOID)));
+            __m256i steps = _mm256_andnot_si256(dies, moves);
+
+            store8_masked(engine->facing + i, dir[p], turns);
+            store8_masked(engine->move_cooldown + i,
+                          _mm256_set1_epi32(MOVEMENT_COOLDOWN_TICKS), turns);
+            store8_masked(engine->alive + i, zero, dies);
+            store8_masked(engine->pos_x + i, tx[p], steps);
+            store8_masked(engine->pos_y + i, ty[p], steps);
+        }
+    }
+}
+
+AVX2 static void finish_avx2(BatchEngine* engine) {
+    int capacity = engine->capacity;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i regen_ticks = _mm256_set1_epi32(ENERGY_REGEN_TICKS);
+    const __m256i max_energy = _mm256_set1_epi32(MAX_ENERGY);
+    const __m256i win_score = _mm256_set1_epi32(WIN_SCORE - 1);
+
+    for (int env = 0; env < capacity; env += BATCH_LANES) {
+        __m256i done = _mm256_and_si256(load8(engine->flags + env), _mm256_set1_epi32(FLAG_DONE));
+        __m256i live = _mm256_cmpeq_epi32(done, zero);
+        if (_mm256_testz_si256(live, live)) {
+            continue;
+        }
+
+        for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+            int i = p * capacity + env;
+            // cooldown - (cooldown > 0): the compare is -1 where positive
+            __m256i move_cd = load8(engine->move_cooldown + i);
+            __m256i laser_cd = load8(engine->laser_cooldown + i);
+            store8_masked(engine->move_cooldown + i,
+                          _mm256_add_epi32(move_cd, _mm256_cmpgt_epi32(move_cd, zero)), live);
+            store8_masked(engine->laser_cooldown + i,
+                          _mm256_add_epi32(laser_cd, _mm256_cmpgt_epi32(laser_cd, zero)), live);
+
+            __m256i energy = load8(engine->energy + i);
+            __m256i regen = _mm256_sub_epi32(load8(engine->energy_regen + i), one);
+            __m256i below_max = _mm256_cmpgt_epi32(max_energy, energy);
+            __m256i regen_due = _mm256_and_si256(below_max, _mm256_cmpgt_epi32(one, regen));
+            regen = _mm256_blendv_epi8(regen_ticks, regen, _mm256_andnot_si256(regen_due, below_max));
+            store8_masked(engine->energy + i, _mm256_sub_epi32(energy, regen_due), live);
+            store8_masked(engine->energy_regen + i, regen, live);
+        }
+
+        for (int c = 0; c < engine->map->num_crystals; c++) {
+            int32_t* cooldowns = engine->crystal_cooldowns + c * capacity + env;
+            __m256i cd = load8(cooldowns);
+            store8_masked(cooldowns, _mm256_add_epi32(cd, _mm256_cmpgt_epi32(cd, zero)), live);
+        }
+
+        for (int slot = 0; slot < MAX_LASERS; slot++) {
+            int i = slot * capacity + env;
+            __m256i active = _mm256_and_si256(nonzero8(load8(engine->laser_active + i)), live);
+            __m256i ticks = _mm256_sub_epi32(load8(engine->laser_ticks + i), one);
+            store8_masked(engine->laser_ticks + i, ticks, active);
+            store8_masked(engine->laser_active + i,
+                          _mm256_and_si256(_mm256_cmpgt_epi32(ticks, zero), one), active);
+        }
+
+        __m256i tick = _mm256_add_epi32(load8(engine->tick + env), one);
+        store8_masked(engine->tick + env, tick, live);
+
+        __m256i s0 = load8(engine->score + env);
+        __m256i s1 = load8(engine->score + capacity + env);
+        __m256i won0 = _mm256_cmpgt_epi32(s0, win_score);
+        __m256i won1 = _mm256_cmpgt_epi32(s1, win_score);
+        __m256i by_score = _mm256_or_si256(won0, won1);
+        __m256i timeout = _mm256_andnot_si256(by_score,
+            _mm256_cmpgt_epi32(tick, _mm256_set1_epi32(EPISODE_LENGTH_TICKS - 1)));
+
+        // By score: 0 if player 0 won, else 1. On timeout: the higher
+        // score, or -1 for a draw
+        __m256i score_winner = _mm256_andnot_si256(won0, one);
+        __m256i lead0 = _mm256_cmpgt_epi32(s0, s1);
+        __m256i lead1 = _mm256_cmpgt_epi32(s1, s0);
+        __m256i timeout_winner = _mm256_blendv_epi8(
+            _mm256_blendv_epi8(_mm256_set1_epi32(-1), one, lead1), zero, lead0);
+        __m256i winner = _mm256_blendv_epi8(timeout_winner, score_winner, by_score);
+        __m256i ends = _mm256_and_si256(_mm256_or_si256(by_score, timeout), live);
+        store8_masked(engine->winner + env, winner, ends);
+        store8_masked(engine->game_over + env, one, ends);
+    }
+}
+
+#endif // BATCH_HAVE_AVX2
+
+// =============================================================================
+// Step
+// =============================================================================
+
+// Run the shooting phase for env on the scratch state if anyone fires
+static void shoot_env(BatchEngine* engine, const PlayerAction* actions, int env, StepInfo* info) {
+    int capacity = engine->capacity;
+    bool fires = false;
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        int i = p * capacity + env;
+        fires |= action_to_direction(actions[env * 2 + p].shoot) != DIR_NONE &&
+                 player_ready_to_shoot(engine->alive[i], engine->laser_cooldown[i],
+                                       engine->energy[i]);
+    }
+    if (!fires) {
+        return;
+    }
+
+    // Beams only need the free slots; copy back the ones that get used
+    GameState* scratch = &engine->scratch;
+    load_players(engine, env, scratch);
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        scratch->lasers[slot].active = engine->laser_active[slot * capacity + env] != 0;
+    }
+    game_phase_shooting(scratch, &actions[env * 2], info);
+    for (int slot = 0; slot < MAX_LASERS; slot++) {
+        if (scratch->lasers[slot].active && !engine->laser_active[slot * capacity + env]) {
+            store_laser(engine, env, slot, &scratch->lasers[slot]);
+        }
+    }
+    store_players(engine, env, scratch);
+}
+
+// Respawns (and, for envs with a frag while shooting, the movement in
+// between) on the scratch state, in env order like game_step
+static void respawn_env(BatchEngine* engine, const PlayerAction* actions, int env, StepInfo* info) {
+    int capacity = engine->capacity;
+    bool fragged = engine->flags[env] & FLAG_FRAGGED;
+    bool any_dead = false;
+    for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+        any_dead |= !engine->alive[p * capacity + env];
+    }
+    if (!fragged && !any_dead) {
+        return;
+    }
+
+    GameState* scratch = &engine->scratch;
+    load_players(engine, env, scratch);
+    load_crystals(engine, env, scratch);
+    game_phase_respawn(scratch, info);
+    if (fragged) {
+        game_phase_movement(scratch, &actions[env * 2], info);
+        game_phase_respawn(scratch, info);
+    }
+    store_players(engine, env, scratch);
+    store_crystals(engine, env, scratch);
+}
+
+void batch_engine_step(BatchEngine* engine, const PlayerAction* actions, StepInfo* infos) {
+    int num_envs = engine->num_envs;
+    memset(infos, 0, sizeof(StepInfo) * (size_t)num_envs);
+
+    for (int env = 0; env < engine->capacity; env++) {
+        engine->flags[env] = engine->game_over[env] ? FLAG_DONE : 0;
+    }
+
+    // Crystals under the players, then shooting
+    for (int env = 0; env < num_envs; env++) {
+        if (!engine->flags[env]) {
+            collect_env(engine, env, &infos[env]);
+            shoot_env(engine, actions, env, &infos[env]);
+            // Fragged by this shot, or by one last step (game_step leaves
+            // those dead for a step): either way they respawn before moving
+            for (int p = 0; p < BATCH_NUM_PLAYERS; p++) {
+                if (!engine->alive[p * engine->capacity + env]) {
+                    engine->flags[env] |= FLAG_FRAGGED;
+                }
+            }
+        }
+    }
+
+    // Movement for every env without a frag so far, then crystals again
+#ifdef BATCH_HAVE_AVX2
+    if (engine->use_avx2) {
+        move_avx2(engine, actions);
+    } else
+#endif
+    {
+        for (int env = 0; env < num_envs; env++) {
+            if (!engine->flags[env]) {
+                move_env(engine, actions, env);
+            }
+        }
+    }
+    for (int env = 0; env < num_envs; env++) {
+        if (!engine->flags[env]) {
+            collect_env(engine, env, &infos[env]);
+        }
+    }
+
+    for (int env = 0; env < num_envs; env++) {
+        if (!(engine->flags[env] & FLAG_DONE)) {
+            respawn_env(engine, actions, env, &infos[env]);
+        }
+    }
+
+#ifdef BATCH_HAVE_AVX2
+    if (engine->use_avx2) {
+        finish_avx2(engine);
+        return;
+    }
+#endif
+    for (int env = 0; env < num_envs; env++) {
+        if (!(engine->flags[env] & FLAG_DONE)) {
+            finish_env(engine, env);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef ARENA_BATCH_H
+#define ARENA_BATCH_H
+
+#include <stdint.h>
+#include "types.h"
+
+// =============================================================================
+// Struct-of-arrays batched engine
+//
+// Steps num_envs duels on one shared map together. Every field is stored
+// as one contiguous int32 array across envs (env e of player p at
+// p * capacity + e), so the per-env arithmetic (crystal pickup, movement
+// and its conflict resolution, cooldowns, energy regen, win checks) runs
+// across envs in SIMD lanes. AVX2 is used when the CPU has it, with a
+// scalar path otherwise. Envs that are game over are masked out and left
+// untouched, as game_step does.
+//
+// Laser traces, hits and respawns are rare next to the rest, so they run
+// per env on a scratch GameState through the regular game phases. Envs are
+// visited in order, so the respawn RNG is consumed exactly as by calling
+// game_step on each env in turn, and the results (states and StepInfo)
+// are bit-identical to that.
+// =============================================================================
+
+#define BATCH_NUM_PLAYERS 2
+#define BATCH_LANES 8  // capacity is num_envs rounded up to this
+
+typedef struct {
+    const MapData* map;
+    int num_envs;
+    int capacity;
+
+    // [BATCH_NUM_PLAYERS * capacity]
+    int32_t* pos_x;
+    int32_t* pos_y;
+    int32_t* facing;
+    int32_t* health;
+    int32_t* energy;
+    int32_t* move_cooldown;
+    int32_t* laser_cooldown;
+    int32_t* energy_regen;
+    int32_t* score;
+    int32_t* last_hit_by;
+    int32_t* alive;
+
+    // [MAX_CRYSTALS * capacity]
+    int32_t* crystal_cooldowns;
+
+    // [MAX_LASERS * capacity]
+    int32_t* laser_start_x;
+    int32_t* laser_start_y;
+    int32_t* laser_end_x;
+    int32_t* laser_end_y;
+    int32_t* laser_owner;
+    int32_t* laser_ticks;
+    int32_t* laser_active;
+
+    // [capacity]; padding envs past num_envs are kept game over
+    int32_t* tick;
+    int32_t* winner;
+    int32_t* game_over;
+    int32_t* flags;  // per-step scratch
+
+    GameState scratch;  // one env at a time, for the scalar phases
+    bool use_avx2;      // set at creation; clear to force the scalar path
+    void* storage;
+} BatchEngine;
+
+// Create num_envs duels on map (takes a reference), each reset as by
+// game_reset. Returns NULL on allocation failure or num_envs < 1.
+BatchEngine* batch_engine_create(const MapData* map, int num_envs);
+void batch_engine_free(BatchEngine* engine);
+
+// Reset one env, as game_reset would
+void batch_engine_reset(BatchEngine* engine, int env);
+
+// Step every env. actions holds BATCH_NUM_PLAYERS entries per env, env
+// by env; infos receives one StepInfo per env.
+void batch_engine_step(BatchEngine* engine, const PlayerAction* actions, StepInfo* infos);
+
+// Copy one env out to a GameState. The copy borrows the engine's map
+// (no reference is taken) and has no occupancy grid: a snapshot for
+// observations and comparisons, not for stepping. Never pass it to
+// game_free, and don't use it after batch_engine_free.
+void batch_engine_get_state(const BatchEngine* engine, int env, GameState* out);
+
+// Load one env from a duel on the same map. Returns false otherwise.
+bool batch_engine_set_state(BatchEngine* engine, int env, const GameState* state);
+
+// Legal-action masks, [num_envs][BATCH_NUM_PLAYERS][5] indexed by
+// ActionType, 1 where the action can have an effect this step. NOOP is
+// always 1. A move is legal when the player can move and the tile that
+// way is not a wall (void is legal, if fatal); a shot when the player can
+// shoot. Dead players get NOOP only. shoot may be NULL.
+void batch_engine_write_action_masks(const BatchEngine* engine, uint8_t* move, uint8_t* shoot);
+
+// Whether steps use the AVX2 kernels on this machine
+bool batch_engine_uses_avx2(void);
+
+#endif // ARENA_BATCH_H
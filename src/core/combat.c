@@ -1,6 +1,8 @@
 #include "combat.h"
 #include "arena.h"
 #include "player.h"
+#include "occupancy.h"
+#include "map.h"
 
 // Get direction vector
 static void get_direction_delta(Direction dir, int* dx, int* dy) {
@@ -43,55 +45,49 @@ LaserResult combat_fire_laser(
         return result;
     }
 
-    Position current = state->players[shooter_idx].pos;
+    const MapData* map = state->arena.map;
+    Position origin = state->players[shooter_idx].pos;
     int dx, dy;
     get_direction_delta(dir, &dx, &dy);
 
-    // Trace the laser path
-    while (true) {
-        current.x += dx;
-        current.y += dy;
-
-        // Check bounds
-        if (!arena_is_valid_position(&state->arena, current.x, current.y)) {
-            result.hit_type = LASER_HIT_EDGE;
-            result.hit_position = current;
-            break;
-        }
+    // The map's ray table gives the distance to the first wall or edge, so
+    // only players inside that segment can be hit; walk it through the
+    // occupancy grid. Void tiles don't stop the laser.
+    int range = 1;
+    if (arena_is_valid_position(&state->arena, origin.x, origin.y)) {
+        range = map_ray_length(map, dir)[map_index(map, origin.x, origin.y)];
+    }
 
-        // Check for wall
-        if (arena_is_wall(&state->arena, current.x, current.y)) {
-            result.hit_type = LASER_HIT_WALL;
-            result.hit_position = current;
+    int target = -1;
+    for (int along = 1; along < range; along++) {
+        int p = occupancy_player_at(state, origin.x + dx * along, origin.y + dy * along);
+        if (p >= 0 && p != shooter_idx) {
+            target = p;
             break;
         }
+    }
 
-        // Check for player hit
-        for (int i = 0; i < MAX_PLAYERS; i++) {
-            if (i != shooter_idx &&
-                state->players[i].alive &&
-                state->players[i].pos.x == current.x &&
-                state->players[i].pos.y == current.y) {
-                result.hit_type = LASER_HIT_PLAYER;
-                result.target_player = i;
-                result.hit_position = current;
-
-                // Calculate pushback position
-                Direction push_dir = dir;  // Same direction as laser
-                bool fragged = false;
-                result.pushback_to = combat_apply_pushback(
-                    state, i, push_dir, PUSHBACK_DISTANCE, &fragged
-                );
-                result.target_fragged = fragged;
-
-                return result;
-            }
-        }
-
-        // Void tiles don't stop the laser, but we need a termination condition
-        // The laser continues through void until it hits something or goes out of bounds
+    if (target >= 0) {
+        result.hit_type = LASER_HIT_PLAYER;
+        result.target_player = target;
+        result.hit_position = state->players[target].pos;
+
+        // Calculate pushback position
+        Direction push_dir = dir;  // Same direction as laser
+        bool fragged = false;
+        result.pushback_to = combat_apply_pushback(
+            state, target, push_dir, PUSHBACK_DISTANCE, &fragged
+        );
+        result.target_fragged = fragged;
+        return result;
     }
 
+    Position end = {origin.x + dx * range, origin.y + dy * range};
+    result.hit_position = end;
+    result.hit_type = arena_is_valid_position(&state->arena, end.x, end.y)
+        ? LASER_HIT_WALL
+        : LASER_HIT_EDGE;
+
     return result;
 }
 
@@ -106,14 +102,17 @@ void combat_apply_laser_result(
         return;
     }
 
-    Player* target = &state->players[result->target_player];
+    int target_idx = result->target_player;
+    Player* target = &state->players[target_idx];
 
     // Apply damage
     player_take_damage(target, LASER_DAMAGE);
 
     // Apply pushback position (even if they died, for consistency)
     if (!result->target_fragged) {
+        occupancy_clear(state, target->pos, target_idx);
         target->pos = result->pushback_to;
+        occupancy_set(state, target->pos, target_idx);
     }
     // If fragged by pushback into void, the player is marked as not alive
     // and will be respawned in the main game loop
@@ -146,15 +145,10 @@ Position combat_apply_pushback(
             return current;
         }
 
-        // Check if next position is occupied by another player
-        for (int j = 0; j < MAX_PLAYERS; j++) {
-            if (j != player_idx &&
-                state->players[j].alive &&
-                state->players[j].pos.x == next.x &&
-                state->players[j].pos.y == next.y) {
-                // Blocked by another player, stop at current
-                return current;
-            }
+        // Blocked by another player, stop at current
+        int occupant = occupancy_player_at(state, next.x, next.y);
+        if (occupant >= 0 && occupant != player_idx) {
+            return current;
         }
 
         // Valid move, update current
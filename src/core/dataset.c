@@ -0,0 +1,513 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dataset.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATASET_DIR_MAX  960
+#define DATASET_PATH_MAX (DATASET_DIR_MAX + DATASET_MAX_NAME + 32)
+#define DATASET_META_FILE "meta.json"
+#define DATASET_VERSION 1
+
+struct DatasetWriter {
+    char dir[DATASET_DIR_MAX];
+    int num_columns;
+    char names[DATASET_MAX_COLUMNS][DATASET_MAX_NAME];
+    DatasetDType dtypes[DATASET_MAX_COLUMNS];
+    int widths[DATASET_MAX_COLUMNS];
+    size_t row_bytes[DATASET_MAX_COLUMNS];
+    int fds[DATASET_MAX_COLUMNS];
+
+    // Double-buffered chunks: one is filled by append, the other is
+    // being written by the background thread
+    int chunk_rows;
+    unsigned char* blocks[2];
+    unsigned char* buffers[2][DATASET_MAX_COLUMNS];
+    int active;
+    int fill_rows;
+    long rows;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int pending;         // buffer queued for writing, -1 = none
+    int pending_rows;
+    bool stop;
+    atomic_bool failed;  // set by the writer thread, polled by append
+};
+
+static const char* dtype_descr(DatasetDType dtype) {
+    switch (dtype) {
+        case DATASET_U8:  return "|u1";
+        case DATASET_I32: return "<i4";
+        case DATASET_F32: return "<f4";
+        default:          return "";
+    }
+}
+
+static bool dtype_from_descr(const char* descr, DatasetDType* dtype) {
+    if (strcmp(descr, "|u1") == 0) { *dtype = DATASET_U8;  return true; }
+    if (strcmp(descr, "<i4") == 0) { *dtype = DATASET_I32; return true; }
+    if (strcmp(descr, "<f4") == 0) { *dtype = DATASET_F32; return true; }
+    return false;
+}
+
+size_t dataset_dtype_size(DatasetDType dtype) {
+    switch (dtype) {
+        case DATASET_U8:  return 1;
+        case DATASET_I32: return 4;
+        case DATASET_F32: return 4;
+        default:          return 0;
+    }
+}
+
+static void column_path(char* out, size_t size, const char* dir, const char* name) {
+    snprintf(out, size, "%s/%s.bin", dir, name);
+}
+
+static bool write_all(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// Background writer: one sequential write per column per chunk
+static void* writer_thread_main(void* arg) {
+    DatasetWriter* w = (DatasetWriter*)arg;
+
+    pthread_mutex_lock(&w->mutex);
+    while (true) {
+        while (w->pending < 0 && !w->stop) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->pending < 0 && w->stop) {
+            break;
+        }
+
+        int buf = w->pending;
+        int rows = w->pending_rows;
+        pthread_mutex_unlock(&w->mutex);
+
+        bool ok = true;
+        for (int c = 0; c < w->num_columns && ok; c++) {
+            ok = write_all(w->fds[c], w->buffers[buf][c], w->row_bytes[c] * (size_t)rows);
+        }
+
+        pthread_mutex_lock(&w->mutex);
+        if (!ok) {
+            atomic_store_explicit(&w->failed, true, memory_order_relaxed);
+        }
+        w->pending = -1;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    return NULL;
+}
+
+// Queue the active buffer for writing and switch to the other one
+static void writer_submit_chunk(DatasetWriter* w) {
+    if (w->fill_rows == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    while (w->pending >= 0) {
+        pthread_cond_wait(&w->cond, &w->mutex);
+    }
+    w->pending = w->active;
+    w->pending_rows = w->fill_rows;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    w->active ^= 1;
+    w->fill_rows = 0;
+}
+
+static bool writer_write_meta(const DatasetWriter* w) {
+    char path[DATASET_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", w->dir, DATASET_META_FILE);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"version\": %d,\n", DATASET_VERSION);
+    fprintf(f, "  \"rows\": %ld,\n", w->rows);
+    fprintf(f, "  \"chunk_rows\": %d,\n", w->chunk_rows);
+    fprintf(f, "  \"columns\": [\n");
+    for (int c = 0; c < w->num_columns; c++) {
+        fprintf(f, "    {\"name\": \"%s\", \"dtype\": \"%s\", \"width\": %d, \"file\": \"%s.bin\"}%s\n",
+                w->names[c], dtype_descr(w->dtypes[c]), w->widths[c], w->names[c],
+                c + 1 < w->num_columns ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+
+    return fclose(f) == 0;
+}
+
+static void writer_free(DatasetWriter* w) {
+    for (int c = 0; c < w->num_columns; c++) {
+        if (w->fds[c] >= 0) {
+            close(w->fds[c]);
+        }
+    }
+    free(w->blocks[0]);
+    free(w->blocks[1]);
+    free(w);
+}
+
+DatasetWriter* dataset_writer_open(
+    const char* dir,
+    const DatasetColumn* columns,
+    int num_columns,
+    int chunk_rows
+) {
+    if (num_columns <= 0 || num_columns > DATASET_MAX_COLUMNS) {
+        return NULL;
+    }
+    if (chunk_rows <= 0) {
+        chunk_rows = DATASET_DEFAULT_CHUNK;
+    }
+
+    if (strlen(dir) >= DATASET_DIR_MAX) {
+        return NULL;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    DatasetWriter* w = calloc(1, sizeof(DatasetWriter));
+    if (!w) {
+        return NULL;
+    }
+
+    snprintf(w->dir, sizeof(w->dir), "%s", dir);
+    w->num_columns = num_columns;
+    w->chunk_rows = chunk_rows;
+    w->pending = -1;
+    atomic_init(&w->failed, false);
+
+    size_t total_row_bytes = 0;
+    for (int c = 0; c < num_columns; c++) {
+        w->fds[c] = -1;
+    }
+    for (int c = 0; c < num_columns; c++) {
+        size_t elem = dataset_dtype_size(columns[c].dtype);
+        if (elem == 0 || columns[c].width <= 0 ||
+            strlen(columns[c].name) >= DATASET_MAX_NAME) {
+            writer_free(w);
+            return NULL;
+        }
+        snprintf(w->names[c], DATASET_MAX_NAME, "%s", columns[c].name);
+        w->dtypes[c] = columns[c].dtype;
+        w->widths[c] = columns[c].width;
+        w->row_bytes[c] = elem * (size_t)columns[c].width;
+        total_row_bytes += w->row_bytes[c];
+
+        char path[DATASET_PATH_MAX];
+        column_path(path, sizeof(path), dir, columns[c].name);
+        w->fds[c] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (w->fds[c] < 0) {
+            writer_free(w);
+            return NULL;
+        }
+    }
+
+    // Each chunk buffer is one block holding every column's slice back to back
+    for (int b = 0; b < 2; b++) {
+        w->blocks[b] = malloc(total_row_bytes * (size_t)chunk_rows);
+        if (!w->blocks[b]) {
+            writer_free(w);
+            return NULL;
+        }
+        unsigned char* p = w->blocks[b];
+        for (int c = 0; c < num_columns; c++) {
+            w->buffers[b][c] = p;
+            p += w->row_bytes[c] * (size_t)chunk_rows;
+        }
+    }
+
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, writer_thread_main, w) != 0) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+        writer_free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+bool dataset_writer_append(DatasetWriter* writer, const void* const* fields) {
+    DatasetWriter* w = writer;
+
+    for (int c = 0; c < w->num_columns; c++) {
+        memcpy(w->buffers[w->active][c] + w->row_bytes[c] * (size_t)w->fill_rows,
+               fields[c], w->row_bytes[c]);
+    }
+    w->fill_rows++;
+    w->rows++;
+
+    if (w->fill_rows == w->chunk_rows) {
+        writer_submit_chunk(w);
+    }
+
+    // Only ever goes false -> true, so a relaxed read without the lock is enough
+    return !atomic_load_explicit(&w->failed, memory_order_relaxed);
+}
+
+long dataset_writer_rows(const DatasetWriter* writer) {
+    return writer->rows;
+}
+
+bool dataset_writer_close(DatasetWriter* writer) {
+    DatasetWriter* w = writer;
+
+    writer_submit_chunk(w);
+
+    pthread_mutex_lock(&w->mutex);
+    w->stop = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->thread, NULL);
+
+    bool ok = !atomic_load(&w->failed);
+    for (int c = 0; c < w->num_columns; c++) {
+        if (close(w->fds[c]) != 0) {
+            ok = false;
+        }
+        w->fds[c] = -1;
+    }
+    if (ok) {
+        ok = writer_write_meta(w);
+    }
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    writer_free(w);
+
+    return ok;
+}
+
+// =============================================================================
+// Reader
+// =============================================================================
+
+static char* read_text_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char* text = malloc((size_t)size + 1);
+    if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+bool dataset_reader_open(DatasetReader* reader, const char* dir) {
+    memset(reader, 0, sizeof(*reader));
+
+    char path[DATASET_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, DATASET_META_FILE);
+    char* meta = read_text_file(path);
+    if (!meta) {
+        return false;
+    }
+
+    const char* rows_key = strstr(meta, "\"rows\":");
+    if (!rows_key || sscanf(rows_key, "\"rows\": %ld", &reader->rows) != 1 ||
+        reader->rows < 0) {
+        free(meta);
+        return false;
+    }
+
+    // meta.json is written by dataset_writer_close with one column per line
+    const char* p = meta;
+    while ((p = strstr(p, "{\"name\":")) != NULL &&
+           reader->num_columns < DATASET_MAX_COLUMNS) {
+        DatasetReaderColumn* col = &reader->columns[reader->num_columns];
+        char descr[8];
+        if (sscanf(p, "{\"name\": \"%31[^\"]\", \"dtype\": \"%7[^\"]\", \"width\": %d",
+                   col->name, descr, &col->width) != 3 ||
+            col->width <= 0 || !dtype_from_descr(descr, &col->dtype)) {
+            free(meta);
+            dataset_reader_close(reader);
+            return false;
+        }
+        reader->num_columns++;
+        p++;
+    }
+    free(meta);
+
+    for (int c = 0; c < reader->num_columns; c++) {
+        DatasetReaderColumn* col = &reader->columns[c];
+        size_t row_bytes = dataset_dtype_size(col->dtype) * (size_t)col->width;
+        if ((unsigned long)reader->rows > SIZE_MAX / row_bytes) {
+            dataset_reader_close(reader);
+            return false;
+        }
+        size_t size = row_bytes * (size_t)reader->rows;
+        if (size == 0) {
+            continue;
+        }
+
+        // A file shorter than meta.json says would SIGBUS on access
+        column_path(path, sizeof(path), dir, col->name);
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && (fstat(fd, &st) != 0 || (uint64_t)st.st_size < size)) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            dataset_reader_close(reader);
+            return false;
+        }
+        void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            dataset_reader_close(reader);
+            return false;
+        }
+        col->data = data;
+        col->mapped_size = size;
+    }
+
+    return true;
+}
+
+void dataset_reader_close(DatasetReader* reader) {
+    for (int c = 0; c < reader->num_columns; c++) {
+        DatasetReaderColumn* col = &reader->columns[c];
+        if (col->data) {
+            munmap((void*)col->data, col->mapped_size);
+            col->data = NULL;
+        }
+    }
+    reader->num_columns = 0;
+    reader->rows = 0;
+}
+
+const DatasetReaderColumn* dataset_reader_column(const DatasetReader* reader, const char* name) {
+    for (int c = 0; c < reader->num_columns; c++) {
+        if (strcmp(reader->columns[c].name, name) == 0) {
+            return &reader->columns[c];
+        }
+    }
+    return NULL;
+}
+
+// =============================================================================
+// Trajectory layout
+// =============================================================================
+
+enum {
+    TRAJ_COL_OBS = 0,
+    TRAJ_COL_ACTION,
+    TRAJ_COL_REWARD,
+    TRAJ_COL_DONE,
+    TRAJ_COL_PLAYER_HIT,
+    TRAJ_COL_PLAYER_FRAGGED,
+    TRAJ_COL_CRYSTAL_COLLECTED,
+    TRAJ_COL_DAMAGE_DEALT,
+    TRAJ_COL_DAMAGE_TAKEN,
+    TRAJ_COL_FRAGS,
+    TRAJ_COL_COUNT
+};
+
+DatasetWriter* trajectory_writer_open(const char* dir, int obs_size, int num_players,
+                                      int chunk_rows) {
+    if (num_players < 1 || num_players > MAX_PLAYERS) {
+        return NULL;
+    }
+    DatasetColumn columns[TRAJ_COL_COUNT] = {
+        [TRAJ_COL_OBS]               = {"obs",                    DATASET_F32, obs_size},
+        [TRAJ_COL_ACTION]            = {"action",                 DATASET_I32, num_players * 2},
+        [TRAJ_COL_REWARD]            = {"reward",                 DATASET_F32, num_players},
+        [TRAJ_COL_DONE]              = {"done",                   DATASET_U8,  1},
+        [TRAJ_COL_PLAYER_HIT]        = {"info_player_hit",        DATASET_U8,  num_players},
+        [TRAJ_COL_PLAYER_FRAGGED]    = {"info_player_fragged",    DATASET_U8,  num_players},
+        [TRAJ_COL_CRYSTAL_COLLECTED] = {"info_crystal_collected", DATASET_U8,  num_players},
+        [TRAJ_COL_DAMAGE_DEALT]      = {"info_damage_dealt",      DATASET_I32, num_players},
+        [TRAJ_COL_DAMAGE_TAKEN]      = {"info_damage_taken",      DATASET_I32, num_players},
+        [TRAJ_COL_FRAGS]             = {"info_frags",             DATASET_I32, num_players},
+    };
+    return dataset_writer_open(dir, columns, TRAJ_COL_COUNT, chunk_rows);
+}
+
+int trajectory_writer_num_players(const DatasetWriter* writer) {
+    return writer->widths[TRAJ_COL_REWARD];
+}
+
+bool trajectory_writer_append(
+    DatasetWriter* writer,
+    const float* obs,
+    const PlayerAction* actions,
+    const float* rewards,
+    bool done,
+    const StepInfo* info
+) {
+    int32_t action_row[MAX_PLAYERS * 2];
+    uint8_t hit[MAX_PLAYERS], fragged[MAX_PLAYERS], collected[MAX_PLAYERS];
+    int32_t dealt[MAX_PLAYERS], taken[MAX_PLAYERS], frags[MAX_PLAYERS];
+    uint8_t done_byte = done ? 1 : 0;
+
+    for (int i = 0; i < trajectory_writer_num_players(writer); i++) {
+        action_row[i * 2] = actions[i].move;
+        action_row[i * 2 + 1] = actions[i].shoot;
+        hit[i] = info->player_hit[i];
+        fragged[i] = info->player_fragged[i];
+        collected[i] = info->crystal_collected[i];
+        dealt[i] = info->damage_dealt[i];
+        taken[i] = info->damage_taken[i];
+        frags[i] = info->frags[i];
+    }
+
+    const void* fields[TRAJ_COL_COUNT] = {
+        [TRAJ_COL_OBS]               = obs,
+        [TRAJ_COL_ACTION]            = action_row,
+        [TRAJ_COL_REWARD]            = rewards,
+        [TRAJ_COL_DONE]              = &done_byte,
+        [TRAJ_COL_PLAYER_HIT]        = hit,
+        [TRAJ_COL_PLAYER_FRAGGED]    = fragged,
+        [TRAJ_COL_CRYSTAL_COLLECTED] = collected,
+        [TRAJ_COL_DAMAGE_DEALT]      = dealt,
+        [TRAJ_COL_DAMAGE_TAKEN]      = taken,
+        [TRAJ_COL_FRAGS]             = frags,
+    };
+    return dataset_writer_append(writer, fields);
+}
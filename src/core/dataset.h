@@ -0,0 +1,104 @@
+#ifndef ARENA_DATASET_H
+#define ARENA_DATASET_H
+
+#include <stddef.h>
+#include "types.h"
+
+// =============================================================================
+// Columnar trajectory datasets (offline RL / behavior cloning)
+//
+// A dataset is a directory with one raw little-endian file per column
+// (<name>.bin, rows stored back to back) plus a meta.json describing dtype,
+// row shape and row count. Each column file can be opened directly with
+// numpy.memmap(path, dtype, mode="r", shape=(rows, width)).
+//
+// The writer fills fixed-size chunks in memory; full chunks are handed to a
+// background thread that appends each column with one large sequential write.
+// =============================================================================
+
+#define DATASET_MAX_COLUMNS     16
+#define DATASET_MAX_NAME        32
+#define DATASET_DEFAULT_CHUNK   4096  // rows per chunk
+
+typedef enum {
+    DATASET_U8  = 0,
+    DATASET_I32 = 1,
+    DATASET_F32 = 2
+} DatasetDType;
+
+typedef struct {
+    const char* name;    // column / file name (no extension)
+    DatasetDType dtype;
+    int width;           // elements per row
+} DatasetColumn;
+
+typedef struct DatasetWriter DatasetWriter;
+
+typedef struct {
+    char name[DATASET_MAX_NAME];
+    DatasetDType dtype;
+    int width;
+    const void* data;    // mmapped rows, NULL if the column is empty
+    size_t mapped_size;
+} DatasetReaderColumn;
+
+typedef struct {
+    int num_columns;
+    long rows;
+    DatasetReaderColumn columns[DATASET_MAX_COLUMNS];
+} DatasetReader;
+
+// Size in bytes of one element of dtype
+size_t dataset_dtype_size(DatasetDType dtype);
+
+// Create (or truncate) a dataset in dir. Returns NULL on error.
+DatasetWriter* dataset_writer_open(
+    const char* dir,
+    const DatasetColumn* columns,
+    int num_columns,
+    int chunk_rows
+);
+
+// Append one row. fields[i] points to columns[i].width elements.
+// Returns false if a previous background write failed.
+bool dataset_writer_append(DatasetWriter* writer, const void* const* fields);
+
+// Flush the partial chunk, stop the writer thread and write meta.json.
+// Frees the writer. Returns false if any write failed.
+bool dataset_writer_close(DatasetWriter* writer);
+
+// Rows appended so far (including rows still buffered)
+long dataset_writer_rows(const DatasetWriter* writer);
+
+// Map a dataset written by dataset_writer_close. Returns false on error,
+// including a meta.json with bad sizes or a column file too short for it.
+bool dataset_reader_open(DatasetReader* reader, const char* dir);
+void dataset_reader_close(DatasetReader* reader);
+
+// Find a column by name, NULL if missing
+const DatasetReaderColumn* dataset_reader_column(const DatasetReader* reader, const char* name);
+
+// =============================================================================
+// Trajectory layout: (obs, action, reward, done, StepInfo) per env step
+// Columns: obs[f32 x obs_size], action[i32 x 2*num_players],
+//          reward[f32 x num_players], done[u8], and one column per StepInfo
+//          field (info_player_hit, info_player_fragged, ...)
+// =============================================================================
+
+DatasetWriter* trajectory_writer_open(const char* dir, int obs_size, int num_players,
+                                      int chunk_rows);
+
+// Players per row the writer was opened with
+int trajectory_writer_num_players(const DatasetWriter* writer);
+
+// actions and rewards hold one entry per player
+bool trajectory_writer_append(
+    DatasetWriter* writer,
+    const float* obs,
+    const PlayerAction* actions,
+    const float* rewards,
+    bool done,
+    const StepInfo* info
+);
+
+#endif // ARENA_DATASET_H
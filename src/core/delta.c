@@ -0,0 +1,393 @@
+#include "delta.h"
+#include "map.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DELTA_MAGIC   0x544c4441u  // "ADLT"
+#define DELTA_VERSION 4
+
+// Varints are at most 5 bytes for 32-bit lengths, so a frame never
+// encodes to more than this
+#define DELTA_MAX_FRAME_BYTES(size) ((size_t)(size) + 10 * ((size_t)(size) / 2 + 1))
+
+static bool reserve_data(DeltaSequence* seq, size_t extra) {
+    if (extra > SIZE_MAX - seq->data_size) {
+        return false;
+    }
+    size_t needed = seq->data_size + extra;
+    if (needed <= seq->data_capacity) {
+        return true;
+    }
+
+    size_t capacity = seq->data_capacity ? seq->data_capacity : 4096;
+    while (capacity < needed) {
+        capacity = capacity <= SIZE_MAX / 2 ? capacity * 2 : needed;
+    }
+    unsigned char* data = realloc(seq->data, capacity);
+    if (!data) {
+        return false;
+    }
+    seq->data = data;
+    seq->data_capacity = capacity;
+    return true;
+}
+
+static unsigned char* put_varint(unsigned char* p, size_t value) {
+    while (value >= 0x80) {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+// NULL if the varint runs past end or is longer than put_varint writes
+static const unsigned char* get_varint(const unsigned char* p, const unsigned char* end,
+                                       size_t* value) {
+    size_t result = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        result |= (size_t)(*p & 0x7F) << shift;
+        if (!(*p++ & 0x80)) {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Length of the run of equal bytes starting at i (compares 8 bytes at a time)
+static size_t equal_run(const unsigned char* a, const unsigned char* b, size_t i, size_t n) {
+    size_t start = i;
+    while (i + 8 <= n) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb) break;
+        i += 8;
+    }
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i - start;
+}
+
+// Encode cur XOR ref as (zero run, literal run) pairs. Short equal gaps
+// inside a literal are kept in the literal, since a new pair costs 2 bytes.
+static unsigned char* encode_frame(unsigned char* out, const unsigned char* cur,
+                                   const unsigned char* ref, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t zeros = equal_run(cur, ref, i, n);
+        i += zeros;
+
+        size_t lit_start = i;
+        while (i < n) {
+            if (cur[i] != ref[i]) {
+                i++;
+                continue;
+            }
+            size_t gap = equal_run(cur, ref, i, n);
+            if (gap > 2 || i + gap == n) break;
+            i += gap;
+        }
+        size_t literal = i - lit_start;
+
+        out = put_varint(out, zeros);
+        out = put_varint(out, literal);
+        for (size_t k = 0; k < literal; k++) {
+            *out++ = cur[lit_start + k] ^ ref[lit_start + k];
+        }
+    }
+    return out;
+}
+
+// Apply one encoded frame in place on top of its reference. Returns the
+// next frame, or NULL if the runs overrun the record or the data ends
+// before the frame does.
+static const unsigned char* decode_frame(const unsigned char* in, const unsigned char* end,
+                                         unsigned char* out, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        size_t zeros, literal;
+        in = get_varint(in, end, &zeros);
+        in = in ? get_varint(in, end, &literal) : NULL;
+        if (!in || zeros > n - i || literal > n - i - zeros ||
+            literal > (size_t)(end - in)) {
+            return NULL;
+        }
+        i += zeros;
+        for (size_t k = 0; k < literal; k++) {
+            out[i + k] ^= in[k];
+        }
+        in += literal;
+        i += literal;
+    }
+    return in;
+}
+
+bool delta_seq_init(DeltaSequence* seq, int record_size, int keyframe_interval) {
+    memset(seq, 0, sizeof(*seq));
+    if (record_size <= 0) {
+        return false;
+    }
+    if (keyframe_interval <= 0) {
+        keyframe_interval = DELTA_DEFAULT_KEYFRAME_INTERVAL;
+    }
+
+    seq->record_size = record_size;
+    seq->keyframe_interval = keyframe_interval;
+    seq->dictionary = calloc(1, (size_t)record_size);
+    seq->prev = calloc(1, (size_t)record_size);
+    if (!seq->dictionary || !seq->prev) {
+        delta_seq_free(seq);
+        return false;
+    }
+    return true;
+}
+
+void delta_seq_free(DeltaSequence* seq) {
+    free(seq->dictionary);
+    free(seq->prev);
+    free(seq->data);
+    free(seq->keyframe_offsets);
+    free(seq->map);
+    if (seq->source_map) {
+        map_data_release(seq->source_map);
+    }
+    memset(seq, 0, sizeof(*seq));
+}
+
+bool delta_seq_push(DeltaSequence* seq, const void* record) {
+    size_t n = (size_t)seq->record_size;
+    const unsigned char* cur = (const unsigned char*)record;
+
+    if (seq->num_frames == 0) {
+        memcpy(seq->dictionary, cur, n);
+    }
+
+    bool keyframe = (seq->num_frames % seq->keyframe_interval) == 0;
+    if (keyframe && seq->num_keyframes == seq->keyframe_capacity) {
+        int capacity = seq->keyframe_capacity ? seq->keyframe_capacity * 2 : 16;
+        size_t* offsets = realloc(seq->keyframe_offsets, sizeof(size_t) * (size_t)capacity);
+        if (!offsets) {
+            return false;
+        }
+        seq->keyframe_offsets = offsets;
+        seq->keyframe_capacity = capacity;
+    }
+
+    if (!reserve_data(seq, DELTA_MAX_FRAME_BYTES(n))) {
+        return false;
+    }
+
+    if (keyframe) {
+        seq->keyframe_offsets[seq->num_keyframes++] = seq->data_size;
+    }
+
+    const unsigned char* ref = keyframe ? seq->dictionary : seq->prev;
+    unsigned char* end = encode_frame(seq->data + seq->data_size, cur, ref, n);
+    seq->data_size = (size_t)(end - seq->data);
+
+    memcpy(seq->prev, cur, n);
+    seq->num_frames++;
+    return true;
+}
+
+bool delta_seq_get(const DeltaSequence* seq, int index, void* out) {
+    if (index < 0 || index >= seq->num_frames) {
+        return false;
+    }
+
+    size_t n = (size_t)seq->record_size;
+    int keyframe = index / seq->keyframe_interval;
+    if (keyframe >= seq->num_keyframes) {
+        return false;
+    }
+    const unsigned char* in = seq->data + seq->keyframe_offsets[keyframe];
+    const unsigned char* end = seq->data + seq->data_size;
+
+    memcpy(out, seq->dictionary, n);
+    int first = keyframe * seq->keyframe_interval;
+    for (int i = first; in && i <= index; i++) {
+        in = decode_frame(in, end, (unsigned char*)out, n);
+    }
+    return in != NULL;
+}
+
+size_t delta_seq_encoded_size(const DeltaSequence* seq) {
+    return (size_t)seq->record_size +
+           (seq->map ? map_data_size(seq->map) : 0) +
+           seq->data_size +
+           sizeof(uint64_t) * (size_t)seq->num_keyframes;
+}
+
+// =============================================================================
+// Serialization
+// Header (u32): magic, version, record_size, keyframe_interval, num_frames,
+//               num_keyframes; then u64 data_size, u64 map_size, the map
+//               blob (if any), the dictionary, u64 keyframe offsets and
+//               the frame data
+// =============================================================================
+
+bool delta_seq_write(const DeltaSequence* seq, FILE* f) {
+    uint32_t header[6] = {
+        DELTA_MAGIC, DELTA_VERSION,
+        (uint32_t)seq->record_size, (uint32_t)seq->keyframe_interval,
+        (uint32_t)seq->num_frames, (uint32_t)seq->num_keyframes
+    };
+    uint64_t data_size = seq->data_size;
+    uint64_t map_size = seq->map ? map_data_size(seq->map) : 0;
+
+    if (fwrite(header, sizeof(header), 1, f) != 1) return false;
+    if (fwrite(&data_size, sizeof(data_size), 1, f) != 1) return false;
+    if (fwrite(&map_size, sizeof(map_size), 1, f) != 1) return false;
+    if (map_size > 0 && fwrite(seq->map, (size_t)map_size, 1, f) != 1) return false;
+    if (fwrite(seq->dictionary, (size_t)seq->record_size, 1, f) != 1) return false;
+    for (int i = 0; i < seq->num_keyframes; i++) {
+        uint64_t offset = seq->keyframe_offsets[i];
+        if (fwrite(&offset, sizeof(offset), 1, f) != 1) return false;
+    }
+    if (seq->data_size > 0 && fwrite(seq->data, seq->data_size, 1, f) != 1) return false;
+    return true;
+}
+
+// Bytes from the current position to the end of f, which must be seekable
+static bool bytes_left(FILE* f, uint64_t* remaining) {
+    long pos = ftell(f);
+    if (pos < 0 || fseek(f, 0, SEEK_END) != 0) {
+        return false;
+    }
+    long end = ftell(f);
+    if (end < pos || fseek(f, pos, SEEK_SET) != 0) {
+        return false;
+    }
+    *remaining = (uint64_t)(end - pos);
+    return true;
+}
+
+bool delta_seq_read(DeltaSequence* seq, FILE* f) {
+    uint32_t header[6];
+    uint64_t data_size, map_size;
+
+    if (fread(header, sizeof(header), 1, f) != 1) return false;
+    if (header[0] != DELTA_MAGIC || header[1] != DELTA_VERSION) return false;
+
+    // Sizes must be positive and the keyframe index must cover every frame
+    uint32_t record_size = header[2], interval = header[3];
+    uint32_t num_frames = header[4], num_keyframes = header[5];
+    if (record_size == 0 || record_size > INT32_MAX || interval == 0 ||
+        interval > INT32_MAX || num_frames > INT32_MAX ||
+        num_keyframes != (uint32_t)(((uint64_t)num_frames + interval - 1) / interval)) {
+        return false;
+    }
+    if (fread(&data_size, sizeof(data_size), 1, f) != 1) return false;
+    if (fread(&map_size, sizeof(map_size), 1, f) != 1) return false;
+
+    // Every section the header sizes must fit in the rest of the file, so
+    // a corrupt size fails here instead of driving a huge allocation
+    uint64_t remaining;
+    if (!bytes_left(f, &remaining)) return false;
+    uint64_t sections[4] = {map_size, record_size, (uint64_t)num_keyframes * sizeof(uint64_t),
+                            data_size};
+    for (int i = 0; i < 4; i++) {
+        if (sections[i] > remaining) return false;
+        remaining -= sections[i];
+    }
+
+    if (!delta_seq_init(seq, (int)record_size, (int)interval)) {
+        return false;
+    }
+    seq->num_frames = (int)num_frames;
+    seq->num_keyframes = (int)num_keyframes;
+    seq->keyframe_capacity = seq->num_keyframes;
+
+    bool ok = true;
+    if (map_size > 0) {
+        seq->map = map_size >= sizeof(MapData) ? map_data_alloc_blob((size_t)map_size) : NULL;
+        ok = seq->map != NULL && fread(seq->map, (size_t)map_size, 1, f) == 1 &&
+             map_data_validate_blob(seq->map, (size_t)map_size);
+        if (ok) {
+            seq->map->refcount = MAP_DATA_STATIC;
+        }
+    }
+
+    ok = ok && fread(seq->dictionary, (size_t)seq->record_size, 1, f) == 1;
+
+    if (ok && seq->num_keyframes > 0) {
+        seq->keyframe_offsets = malloc(sizeof(size_t) * (size_t)seq->num_keyframes);
+        ok = seq->keyframe_offsets != NULL;
+        for (int i = 0; ok && i < seq->num_keyframes; i++) {
+            uint64_t offset;
+            ok = fread(&offset, sizeof(offset), 1, f) == 1 && offset < data_size;
+            if (ok) {
+                seq->keyframe_offsets[i] = (size_t)offset;
+            }
+        }
+    }
+
+    if (ok && data_size > 0) {
+        ok = reserve_data(seq, (size_t)data_size) &&
+             fread(seq->data, (size_t)data_size, 1, f) == 1;
+        seq->data_size = (size_t)data_size;
+    }
+
+    // The encoder continues from the last frame if more records are pushed
+    if (ok && seq->num_frames > 0) {
+        ok = delta_seq_get(seq, seq->num_frames - 1, seq->prev);
+    }
+
+    if (!ok) {
+        delta_seq_free(seq);
+    }
+    return ok;
+}
+
+// =============================================================================
+// GameState helpers
+// =============================================================================
+
+bool delta_seq_init_states(DeltaSequence* seq, int keyframe_interval) {
+    return delta_seq_init(seq, (int)sizeof(GameState), keyframe_interval);
+}
+
+// Same map contents (the refcount aside)
+static bool same_map(const MapData* a, const MapData* b) {
+    size_t skip = offsetof(MapData, width);
+    return map_data_size(a) == map_data_size(b) &&
+           memcmp((const char*)a + skip, (const char*)b + skip, map_data_size(a) - skip) == 0;
+}
+
+bool delta_seq_push_state(DeltaSequence* seq, const GameState* state) {
+    // The map is stored once; records carry a NULL map pointer so archives
+    // don't depend on addresses from the recording process
+    if (!seq->map) {
+        size_t size = map_data_size(state->arena.map);
+        seq->map = map_data_alloc_blob(size);
+        if (!seq->map) {
+            return false;
+        }
+        memcpy(seq->map, state->arena.map, size);
+        seq->map->refcount = MAP_DATA_STATIC;
+        map_data_retain(state->arena.map);
+        seq->source_map = state->arena.map;
+    } else if (state->arena.map != seq->source_map && !same_map(seq->map, state->arena.map)) {
+        return false;
+    }
+
+    GameState record = *state;
+    record.arena.map = NULL;
+    record.arena.occupancy = NULL;
+    return delta_seq_push(seq, &record);
+}
+
+bool delta_seq_get_state(const DeltaSequence* seq, int index, GameState* out) {
+    if (seq->record_size != (int)sizeof(GameState) || !seq->map) {
+        return false;
+    }
+    if (!delta_seq_get(seq, index, out)) {
+        return false;
+    }
+    out->arena.map = seq->map;
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef ARENA_DELTA_H
+#define ARENA_DELTA_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "types.h"
+
+// =============================================================================
+// Delta-compressed state sequences
+//
+// Consecutive GameStates differ in a handful of bytes, so each frame is
+// stored as the XOR against a reference state, packed as runs:
+//   varint(zero_bytes) varint(literal_bytes) literal XOR bytes ...
+// Keyframes are XORed against the episode dictionary (the first state,
+// which carries the static map data) and every other frame against the
+// previous frame. Any frame is decoded from the nearest keyframe, so random
+// access costs at most keyframe_interval frame decodes.
+//
+// The codec is byte-oriented: it works for any fixed-size record. GameState
+// sequences additionally store the shared MapData once per episode; the
+// map pointer is zeroed in the encoded records and decoded states point at
+// the sequence's copy of the map.
+// =============================================================================
+
+#define DELTA_DEFAULT_KEYFRAME_INTERVAL 64
+
+typedef struct {
+    int record_size;
+    int keyframe_interval;
+    int num_frames;
+
+    unsigned char* dictionary;   // first record of the episode
+    unsigned char* prev;         // last pushed record (encoder side)
+
+    unsigned char* data;         // encoded frames, back to back
+    size_t data_size;
+    size_t data_capacity;
+
+    size_t* keyframe_offsets;    // offset into data of every keyframe
+    int num_keyframes;
+    int keyframe_capacity;
+
+    MapData* map;                // static map of a GameState episode (or NULL)
+    const MapData* source_map;   // map of the first pushed state, held (or NULL)
+} DeltaSequence;
+
+// Initialize an empty sequence. Returns false on allocation failure.
+bool delta_seq_init(DeltaSequence* seq, int record_size, int keyframe_interval);
+void delta_seq_free(DeltaSequence* seq);
+
+// Append a record. The first record becomes the dictionary.
+bool delta_seq_push(DeltaSequence* seq, const void* record);
+
+// Decode frame index into out (record_size bytes). Returns false if out of range.
+bool delta_seq_get(const DeltaSequence* seq, int index, void* out);
+
+// Encoded size in bytes, including the dictionaries and keyframe index
+size_t delta_seq_encoded_size(const DeltaSequence* seq);
+
+// Serialize / deserialize one episode. read initializes seq and fails on
+// an inconsistent header, sizes past the end of f (which must be
+// seekable) or a map blob that fails map_data_validate_blob; get fails
+// on frames that don't decode cleanly.
+bool delta_seq_write(const DeltaSequence* seq, FILE* f);
+bool delta_seq_read(DeltaSequence* seq, FILE* f);
+
+// GameState helpers. Decoded states borrow seq->map, which stays valid
+// until delta_seq_free; never pass them to game_free. They are snapshots for inspection: the
+// occupancy grid is not recorded, so don't step them. push_state fails
+// for a state on a different map than the episode's.
+bool delta_seq_init_states(DeltaSequence* seq, int keyframe_interval);
+bool delta_seq_push_state(DeltaSequence* seq, const GameState* state);
+bool delta_seq_get_state(const DeltaSequence* seq, int index, GameState* out);
+
+#endif // ARENA_DELTA_H
@@ -0,0 +1,153 @@
+#include "distance.h"
+#include "map.h"
+#include <stdlib.h>
+
+// Bit-parallel BFS from target, one bit per column and words_per_row
+// 64-bit words per row. Writes layer numbers into field (a [height][stride]
+// plane) when it is non-NULL and stops early once stop (if valid) is
+// reached. Returns the distance to stop, or -1 (also when out of memory).
+static int bfs(const MapData* map, Position target, Position stop, uint16_t* field) {
+    int h = map->height;
+    int words = (map->width + 63) / 64;
+    size_t plane = (size_t)h * (size_t)map->stride;
+
+    if (field) {
+        for (size_t i = 0; i < plane; i++) {
+            field[i] = MAP_DISTANCE_UNREACHABLE;
+        }
+    }
+    if (map_get_tile(map, target.x, target.y) != TILE_FLOOR) {
+        return -1;
+    }
+    if (target.x == stop.x && target.y == stop.y) {
+        return 0;
+    }
+
+    // passable, visited, frontier and next masks, each [h][words]
+    size_t mask_words = (size_t)h * (size_t)words;
+    uint64_t* masks = calloc(4 * mask_words, sizeof(uint64_t));
+    if (!masks) {
+        return -1;
+    }
+    uint64_t* passable = masks;
+    uint64_t* visited = masks + mask_words;
+    uint64_t* frontier = masks + 2 * mask_words;
+    uint64_t* next = masks + 3 * mask_words;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = &map->tiles[map_index(map, 0, y)];
+        for (int x = 0; x < map->width; x++) {
+            if (row[x] == TILE_FLOOR) {
+                passable[y * words + x / 64] |= 1ull << (x % 64);
+            }
+        }
+    }
+
+    frontier[target.y * words + target.x / 64] = 1ull << (target.x % 64);
+    visited[target.y * words + target.x / 64] = frontier[target.y * words + target.x / 64];
+    if (field) {
+        field[map_index(map, target.x, target.y)] = 0;
+    }
+
+    bool has_stop = map_get_tile(map, stop.x, stop.y) == TILE_FLOOR;
+    int y_min = target.y, y_max = target.y;  // rows the frontier spans
+    int result = -1;
+
+    for (int dist = 1; y_min <= y_max; dist++) {
+        int lo = y_min > 0 ? y_min - 1 : 0;
+        int hi = y_max < h - 1 ? y_max + 1 : h - 1;
+        y_min = h;
+        y_max = -1;
+
+        for (int y = lo; y <= hi; y++) {
+            const uint64_t* f = &frontier[y * words];
+            bool any = false;
+            for (int k = 0; k < words; k++) {
+                uint64_t grow = f[k] | (f[k] << 1) | (f[k] >> 1);
+                if (k > 0) grow |= f[k - 1] >> 63;
+                if (k < words - 1) grow |= f[k + 1] << 63;
+                if (y > 0) grow |= f[k - words];
+                if (y < h - 1) grow |= f[k + words];
+                int i = y * words + k;
+                next[i] = grow & passable[i] & ~visited[i];
+                any = any || next[i] != 0;
+            }
+            if (any) {
+                if (y < y_min) y_min = y;
+                if (y > y_max) y_max = y;
+            }
+        }
+
+        // The scanned span covers every old frontier row, so this also
+        // clears the previous layer. Paths too long for uint16_t saturate.
+        uint16_t value = dist < MAP_DISTANCE_UNREACHABLE ? (uint16_t)dist
+                                                         : MAP_DISTANCE_UNREACHABLE - 1;
+        for (int y = lo; y <= hi; y++) {
+            for (int k = 0; k < words; k++) {
+                int i = y * words + k;
+                uint64_t bits = next[i];
+                frontier[i] = bits;
+                visited[i] |= bits;
+                while (field && bits) {
+                    int x = k * 64 + __builtin_ctzll(bits);
+                    field[map_index(map, x, y)] = value;
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        if (has_stop && (visited[stop.y * words + stop.x / 64] >> (stop.x % 64)) & 1) {
+            result = dist;
+            break;
+        }
+    }
+
+    free(masks);
+    return result;
+}
+
+void distance_field_build(const MapData* map, Position target, uint16_t* field) {
+    Position none = {-1, -1};
+    bfs(map, target, none, field);
+}
+
+// Stored field for a crystal or spawn at pos, or NULL
+static const uint16_t* stored_field(const MapData* map, Position pos) {
+    int crystal = map_crystal_at(map)[map_index(map, pos.x, pos.y)];
+    if (crystal >= 0) {
+        return map_crystal_distance(map, crystal);
+    }
+    for (int i = 0; i < map->num_spawn_points; i++) {
+        if (map->spawn_points[i].pos.x == pos.x && map->spawn_points[i].pos.y == pos.y) {
+            return map_spawn_distance(map, i);
+        }
+    }
+    return NULL;
+}
+
+int distance_between(const MapData* map, Position from, Position to) {
+    if (map_get_tile(map, from.x, from.y) != TILE_FLOOR ||
+        map_get_tile(map, to.x, to.y) != TILE_FLOOR) {
+        return -1;
+    }
+
+    // Distances are symmetric, so a field at either end answers the query
+    const uint16_t* field = stored_field(map, to);
+    Position other = from;
+    if (!field) {
+        field = stored_field(map, from);
+        other = to;
+    }
+    if (field) {
+        uint16_t d = field[map_index(map, other.x, other.y)];
+        if (d == MAP_DISTANCE_UNREACHABLE) {
+            return -1;
+        }
+        // Saturated: the path is at least this long, so search for it
+        if (d < MAP_DISTANCE_UNREACHABLE - 1) {
+            return d;
+        }
+    }
+
+    return bfs(map, to, from, NULL);
+}
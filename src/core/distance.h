@@ -0,0 +1,27 @@
+#ifndef ARENA_DISTANCE_H
+#define ARENA_DISTANCE_H
+
+#include "types.h"
+
+// =============================================================================
+// Shortest-path distances over floor tiles (4-connected; walls and void
+// are impassable)
+//
+// Fields are computed with a bit-parallel BFS: every row of the passable
+// mask is a bitset, and one BFS layer is a handful of shifts, ORs and ANDs
+// per row instead of a queue operation per tile. map_data_build_tables
+// stores a field for every crystal and spawn point, so the common queries
+// are table lookups.
+// =============================================================================
+
+// Distance from every tile to target into a [height][stride] plane
+// (MAP_DISTANCE_UNREACHABLE where there is no path, including non-floor
+// tiles; longer paths saturate at MAP_DISTANCE_UNREACHABLE - 1)
+void distance_field_build(const MapData* map, Position target, uint16_t* field);
+
+// Distance between two tiles, or -1 if there is no path. A lookup when
+// either end is a crystal or spawn point, otherwise (or when the stored
+// value is saturated) an early-exit BFS, so the result is always exact.
+int distance_between(const MapData* map, Position from, Position to);
+
+#endif // ARENA_DISTANCE_H
@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+
+#include "framestack.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+// Map a memfd of ring_bytes twice, back to back. NULL on failure.
+static unsigned char* map_twice(size_t ring_bytes) {
+    int fd = memfd_create("arena_framestack", MFD_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    unsigned char* base = NULL;
+    if (ftruncate(fd, (off_t)ring_bytes) == 0) {
+        // Reserve both halves, then put the file over each
+        void* area = mmap(NULL, ring_bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area != MAP_FAILED) {
+            base = area;
+            if (mmap(base, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) ==
+                    MAP_FAILED ||
+                mmap(base + ring_bytes, ring_bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(area, ring_bytes * 2);
+                base = NULL;
+            }
+        }
+    }
+    close(fd);
+    return base;
+}
+#endif
+
+FrameStack* framestack_create(int num_rows, int frame_size, int k, bool double_map) {
+    if (num_rows < 1 || frame_size < 1 || k < 1) {
+        return NULL;
+    }
+    FrameStack* stack = calloc(1, sizeof(FrameStack));
+    if (!stack) {
+        return NULL;
+    }
+    stack->num_rows = num_rows;
+    stack->frame_size = frame_size;
+    stack->k = k;
+    stack->frame_bytes = sizeof(float) * (size_t)num_rows * (size_t)frame_size;
+
+#ifdef __linux__
+    if (double_map) {
+        // Any whole number of pages holding k frames: frames may straddle
+        // the end, which the second mapping makes contiguous
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        stack->ring_bytes = (stack->frame_bytes * (size_t)k + page - 1) / page * page;
+        stack->base = map_twice(stack->ring_bytes);
+        stack->double_mapped = stack->base != NULL;
+    }
+#else
+    (void)double_map;
+#endif
+    if (!stack->base) {
+        stack->ring_bytes = stack->frame_bytes * (size_t)k;
+        stack->base = calloc(1, stack->ring_bytes);
+        if (!stack->base) {
+            free(stack);
+            return NULL;
+        }
+    }
+    return stack;
+}
+
+void framestack_free(FrameStack* stack) {
+    if (!stack) {
+        return;
+    }
+#ifdef __linux__
+    if (stack->double_mapped) {
+        munmap(stack->base, stack->ring_bytes * 2);
+        free(stack);
+        return;
+    }
+#endif
+    free(stack->base);
+    free(stack);
+}
+
+float* framestack_next(FrameStack* stack) {
+    return (float*)(stack->base + stack->next);
+}
+
+void framestack_push(FrameStack* stack) {
+    stack->next = (stack->next + stack->frame_bytes) % stack->ring_bytes;
+}
+
+static size_t frame_offset(const FrameStack* stack, int i) {
+    size_t back = stack->frame_bytes * (size_t)(stack->k - i);
+    return (stack->next + stack->ring_bytes - back) % stack->ring_bytes;
+}
+
+const float* framestack_frame(const FrameStack* stack, int i) {
+    return (const float*)(stack->base + frame_offset(stack, i));
+}
+
+const float* framestack_window(const FrameStack* stack) {
+    size_t start = frame_offset(stack, 0);
+    if (!stack->double_mapped && start + stack->frame_bytes * (size_t)stack->k > stack->ring_bytes) {
+        return NULL;
+    }
+    return (const float*)(stack->base + start);
+}
+
+void framestack_window_offsets(const FrameStack* stack, size_t* offsets) {
+    for (int i = 0; i < stack->k; i++) {
+        offsets[i] = frame_offset(stack, i) / sizeof(float);
+    }
+}
+
+void framestack_reset_row(FrameStack* stack, int row) {
+    size_t row_offset = sizeof(float) * (size_t)row * (size_t)stack->frame_size;
+    const unsigned char* newest = stack->base + frame_offset(stack, stack->k - 1) + row_offset;
+    for (int i = 0; i < stack->k - 1; i++) {
+        memcpy(stack->base + frame_offset(stack, i) + row_offset, newest,
+               sizeof(float) * (size_t)stack->frame_size);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef ARENA_FRAMESTACK_H
+#define ARENA_FRAMESTACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// =============================================================================
+// Frame stacking
+//
+// A ring of the last k frames of a batch, where a frame is num_rows rows
+// (agents) of frame_size floats. Each step's frame is written once, in
+// place, and the stacked history is read without copying.
+//
+// Where possible the ring is one memfd mapped twice back to back, so the
+// bytes past its end are its start again: the k newest frames are then
+// always one contiguous [k][num_rows][frame_size] block, oldest first
+// (framestack_window). Otherwise (no memfd, or double_map false) the ring
+// is k plain slots and frames are located with framestack_frame, in the
+// order framestack_window_offsets lists them.
+//
+// Rows start zeroed. After an env resets, framestack_reset_row fills its
+// history with its newest frame so the stack never spans two episodes.
+// =============================================================================
+
+typedef struct {
+    int num_rows;
+    int frame_size;  // floats per row
+    int k;
+    size_t frame_bytes;  // num_rows * frame_size floats
+    size_t ring_bytes;   // >= k * frame_bytes
+    size_t next;         // byte offset of the next frame in the ring
+    bool double_mapped;
+    unsigned char* base;
+} FrameStack;
+
+// NULL on allocation failure or bad sizes. double_map false forces the
+// plain ring.
+FrameStack* framestack_create(int num_rows, int frame_size, int k, bool double_map);
+void framestack_free(FrameStack* stack);
+
+// Where the next frame goes ([num_rows][frame_size] floats, contiguous);
+// it becomes the newest frame on framestack_push
+float* framestack_next(FrameStack* stack);
+void framestack_push(FrameStack* stack);
+
+// Frame i of the stack, 0 = oldest, k - 1 = newest
+const float* framestack_frame(const FrameStack* stack, int i);
+
+// The k frames as one contiguous block, oldest first, or NULL when the
+// ring is not double-mapped and the window wraps. Valid until the next
+// push.
+const float* framestack_window(const FrameStack* stack);
+
+// Float offsets from the ring start of each frame, oldest first: the
+// strided index table for reading the plain ring
+void framestack_window_offsets(const FrameStack* stack, size_t* offsets);
+
+// Copy row's newest frame over its k - 1 older ones
+void framestack_reset_row(FrameStack* stack, int row);
+
+#endif // ARENA_FRAMESTACK_H
@@ -2,11 +2,16 @@
 #include "arena.h"
 #include "player.h"
 #include "combat.h"
+#include "map.h"
+#include "occupancy.h"
+#include "profile.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <time.h>
 
-// Simple random number generator state (for reproducibility in training)
-static unsigned int rng_state = 12345;
+// Simple random number generator state (for reproducibility in training).
+// One per thread, so envs can be stepped from several threads at once.
+static _Thread_local unsigned int rng_state = 12345;
 
 static unsigned int game_rand(void) {
     rng_state = rng_state * 1103515245 + 12345;
@@ -18,41 +23,64 @@ void game_set_seed(unsigned int seed) {
 }
 
 void game_init(GameState* state, const char* map_str) {
-    // Load arena
+    // Load arena (shares the interned map data)
     arena_load_from_string(&state->arena, map_str);
+    state->num_players = DEFAULT_NUM_PLAYERS;
+    game_reset(state);
+}
 
-    // Initialize players at spawn points
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        Position spawn = {0, 0};
-        if (i < state->arena.num_spawn_points) {
-            spawn = state->arena.spawn_points[i].pos;
-        }
-        player_init(&state->players[i], spawn);
-    }
+void game_init_map(GameState* state, const MapData* map) {
+    arena_init(&state->arena, map);
+    state->num_players = DEFAULT_NUM_PLAYERS;
+    game_reset(state);
+}
 
-    // Clear laser beams
-    for (int i = 0; i < MAX_LASERS; i++) {
-        state->lasers[i].active = false;
-    }
+bool game_copy(GameState* dst, const GameState* src) {
+    *dst = *src;
+    return arena_copy(&dst->arena, &src->arena);
+}
 
-    state->current_tick = 0;
-    state->winner = -1;
-    state->game_over = false;
+bool game_set_num_players(GameState* state, int num_players) {
+    if (num_players < 1 || num_players > MAX_PLAYERS) {
+        return false;
+    }
+    state->num_players = num_players;
+    game_reset(state);
+    return true;
 }
 
 void game_reset(GameState* state) {
+    const MapData* map = state->arena.map;
+
     // Reset crystal cooldowns
-    for (int i = 0; i < state->arena.num_crystals; i++) {
-        state->arena.crystals[i].cooldown_ticks = 0;
-    }
+    arena_reset_crystals(&state->arena);
 
-    // Reset players to spawn points
+    // Reset players to spawn points. Seats past num_players stay empty.
     for (int i = 0; i < MAX_PLAYERS; i++) {
         Position spawn = {0, 0};
-        if (i < state->arena.num_spawn_points) {
-            spawn = state->arena.spawn_points[i].pos;
+        if (i < map->num_spawn_points) {
+            spawn = map->spawn_points[i].pos;
         }
         player_init(&state->players[i], spawn);
+        if (i >= state->num_players) {
+            state->players[i].alive = false;
+        }
+    }
+
+    // Extra seats beyond the map's spawn points start like a respawn. The
+    // two duel seats keep the origin fallback above.
+    int first_extra = map->num_spawn_points > DEFAULT_NUM_PLAYERS ?
+        map->num_spawn_points : DEFAULT_NUM_PLAYERS;
+    for (int i = first_extra; i < state->num_players; i++) {
+        state->players[i].pos.x = -1;  // not placed yet
+        state->players[i].pos.y = -1;
+        state->players[i].alive = false;
+    }
+    occupancy_rebuild(state);
+    for (int i = first_extra; i < state->num_players; i++) {
+        state->players[i].pos = game_find_respawn_position(state, i);
+        state->players[i].alive = true;
+        occupancy_set(state, state->players[i].pos, i);
     }
 
     // Clear laser beams
@@ -63,394 +91,268 @@ void game_reset(GameState* state) {
     state->current_tick = 0;
     state->winner = -1;
     state->game_over = false;
+    game_select_step_kernel(state, true);
 }
 
-StepInfo game_step(GameState* state, const PlayerAction actions[MAX_PLAYERS]) {
-    StepInfo info = {0};
-
-    if (state->game_over) {
-        return info;
-    }
-
-    // Resolution order per spec:
-    // 1. Entity collection (crystals) - happens when player is on crystal tile
-    // 2. Shooting (both players simultaneously)
-    // 3. Pushback (applied as part of shooting)
-    // 4. Movement (both players simultaneously)
-
-    // Phase 1: Collect crystals (based on current positions before any moves)
-    game_phase_collect_crystals(state, &info);
-
-    // Phase 2 & 3: Shooting and pushback
-    game_phase_shooting(state, actions, &info);
-
-    // Handle respawns for players fragged by shooting
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!state->players[i].alive) {
-            int opponent = 1 - i;
-            state->players[opponent].score++;
-            info.player_fragged[i] = true;
+void game_free(GameState* state) {
+    arena_release(&state->arena);
+}
 
-            Position respawn = game_find_respawn_position(state, i);
-            player_respawn(&state->players[i], respawn);
-        }
+// Credit a frag to whoever last hit the victim. In a duel, deaths nobody
+// caused (walking into void) still go to the opponent.
+static void credit_frag(GameState* state, int victim, StepInfo* info) {
+    int killer = state->players[victim].last_hit_by;
+    if (killer < 0 && state->num_players == 2) {
+        killer = 1 - victim;
     }
-
-    // Phase 4: Movement
-    game_phase_movement(state, actions, &info);
-
-    // Handle respawns for players fragged by movement (pushed/moved into void)
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!state->players[i].alive && !info.player_fragged[i]) {
-            int opponent = 1 - i;
-            state->players[opponent].score++;
-            info.player_fragged[i] = true;
-
-            Position respawn = game_find_respawn_position(state, i);
-            player_respawn(&state->players[i], respawn);
-        }
+    if (killer >= 0 && killer != victim) {
+        state->players[killer].score++;
+        info->frags[killer]++;
     }
-
-    // Tick timers
-    game_tick_timers(state);
-
-    // Increment tick counter
-    state->current_tick++;
-
-    // Check win conditions
-    game_check_win_conditions(state);
-
-    return info;
+    info->player_fragged[victim] = true;
 }
 
-void game_phase_collect_crystals(GameState* state, StepInfo* info) {
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!state->players[i].alive) continue;
-
-        int crystal_idx = arena_get_crystal_at(
-            &state->arena,
-            state->players[i].pos.x,
-            state->players[i].pos.y
-        );
-
-        if (crystal_idx >= 0 && arena_crystal_available(&state->arena, crystal_idx)) {
-            // Collect crystal - restore full energy
-            player_restore_energy(&state->players[i], MAX_ENERGY);
-            arena_collect_crystal(&state->arena, crystal_idx);
-            info->crystal_collected[i] = true;
+// Whether player_idx may respawn at pos: no living player there and, if
+// check_distance, at least RESPAWN_MIN_DISTANCE from every other placed
+// player
+typedef struct {
+    Position others[MAX_PLAYERS];  // other placed players, dead ones included
+    int num_others;
+    int player_idx;
+    bool check_distance;
+} RespawnFilter;
+
+static bool respawn_tile_ok(const GameState* state, const RespawnFilter* filter, Position pos) {
+    int occupant = occupancy_player_at(state, pos.x, pos.y);
+    if (occupant >= 0 && occupant != filter->player_idx) {
+        return false;
+    }
+    for (int i = 0; filter->check_distance && i < filter->num_others; i++) {
+        if (manhattan_distance(pos, filter->others[i]) < RESPAWN_MIN_DISTANCE) {
+            return false;
         }
     }
+    return true;
 }
 
-void game_phase_shooting(GameState* state, const PlayerAction actions[MAX_PLAYERS], StepInfo* info) {
-    LaserResult results[MAX_PLAYERS];
-    bool will_shoot[MAX_PLAYERS] = {false};
-
-    // First, determine who will shoot and calculate results
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        Direction shoot_dir = action_to_direction(actions[i].shoot);
-
-        if (shoot_dir != DIR_NONE &&
-            player_can_shoot(&state->players[i])) {
+// Pick uniformly among the floor tiles that pass the filter: count them,
+// then walk to the chosen one. Returns false if none pass.
+static bool pick_respawn_tile(const GameState* state, const RespawnFilter* filter, Position* out) {
+    const MapData* map = state->arena.map;
+    const uint32_t* floor_tiles = map_floor_tiles(map);
 
-            // Consume energy and start cooldown
-            if (player_use_energy(&state->players[i], 1)) {
-                player_start_laser_cooldown(&state->players[i]);
-                will_shoot[i] = true;
-
-                // Calculate where the shot would land
-                results[i] = combat_fire_laser(state, i, shoot_dir);
-            }
-        }
+    int count = 0;
+    for (int i = 0; i < map->num_floor_tiles; i++) {
+        Position pos = {(int)floor_tiles[i] % map->stride, (int)floor_tiles[i] / map->stride};
+        count += respawn_tile_ok(state, filter, pos);
     }
-
-    // Create visual laser beams for rendering
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (will_shoot[i]) {
-            for (int j = 0; j < MAX_LASERS; j++) {
-                if (!state->lasers[j].active) {
-                    state->lasers[j].start = state->players[i].pos;
-                    state->lasers[j].end = results[i].hit_position;
-                    state->lasers[j].player_idx = i;
-                    state->lasers[j].ticks_remaining = LASER_COOLDOWN_TICKS;
-                    state->lasers[j].active = true;
-                    break;
-                }
-            }
-        }
+    if (count == 0) {
+        return false;
     }
 
-    // Apply all hits simultaneously
-    // This means if both players shoot each other, both take damage
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (will_shoot[i] && results[i].hit_type == LASER_HIT_PLAYER) {
-            int target = results[i].target_player;
-
-            // Apply damage
-            player_take_damage(&state->players[target], LASER_DAMAGE);
-            info->player_hit[target] = true;
-            info->damage_dealt[i] += LASER_DAMAGE;
-            info->damage_taken[target] += LASER_DAMAGE;
+    int chosen = game_rand() % count;
+    for (int i = 0; i < map->num_floor_tiles; i++) {
+        Position pos = {(int)floor_tiles[i] % map->stride, (int)floor_tiles[i] / map->stride};
+        if (respawn_tile_ok(state, filter, pos) && chosen-- == 0) {
+            *out = pos;
+            break;
         }
     }
+    return true;
+}
 
-    // Apply pushback after all damage (so simultaneous shots don't interfere)
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (will_shoot[i] && results[i].hit_type == LASER_HIT_PLAYER) {
-            int target = results[i].target_player;
-
-            // Only apply pushback if target is still alive
-            // (they might have died from damage)
-            if (state->players[target].alive) {
-                if (results[i].target_fragged) {
-                    // Pushed into void
-                    state->players[target].alive = false;
-                } else {
-                    // Apply pushback position
-                    state->players[target].pos = results[i].pushback_to;
-                }
-            }
+Position game_find_respawn_position(const GameState* state, int player_idx) {
+    RespawnFilter filter = {.num_others = 0, .player_idx = player_idx, .check_distance = true};
+    for (int i = 0; i < state->num_players; i++) {
+        if (i != player_idx && state->players[i].pos.x >= 0) {
+            filter.others[filter.num_others++] = state->players[i].pos;
         }
     }
-}
 
-void game_phase_movement(GameState* state, const PlayerAction actions[MAX_PLAYERS], StepInfo* info) {
-    (void)info;  // Currently unused in movement phase
-
-    Position intended[MAX_PLAYERS];
-    bool wants_move[MAX_PLAYERS] = {false};
+    // Floor tiles (row-major) at least RESPAWN_MIN_DISTANCE from everyone
+    Position pos = {0, 0};
+    if (pick_respawn_tile(state, &filter, &pos)) {
+        return pos;
+    }
 
-    // Calculate intended positions
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        intended[i] = state->players[i].pos;
+    // If no valid candidates (shouldn't happen with proper map design),
+    // fall back to any free floor tile
+    filter.check_distance = false;
+    if (pick_respawn_tile(state, &filter, &pos)) {
+        return pos;
+    }
 
-        if (!state->players[i].alive) continue;
+    // Last resort - spawn at origin
+    Position fallback = {0, 0};
+    return fallback;
+}
 
-        Direction move_dir = action_to_direction(actions[i].move);
+// =============================================================================
+// Simultaneous move resolution
+// =============================================================================
 
-        if (move_dir != DIR_NONE && player_can_move(&state->players[i])) {
-            Position target = position_add_direction(state->players[i].pos, move_dir);
+// Small open-addressing map counting the movers that claim each target
+// tile, so conflict checks cost O(players) instead of O(players^2). Keys
+// cover one tile past the arena edge, since moves into out-of-bounds void
+// are legal targets.
+#define TILE_TABLE_SIZE 32  // power of two, at least 2 * MAX_PLAYERS
 
-            // Check if target is passable
-            if (arena_is_passable(&state->arena, target.x, target.y)) {
-                intended[i] = target;
-                wants_move[i] = true;
-            } else if (arena_is_void(&state->arena, target.x, target.y)) {
-                // Moving into void = death
-                intended[i] = target;
-                wants_move[i] = true;
-            }
-            // Wall = stay in place, but still trigger cooldown if tried to move
-        }
-    }
+typedef struct {
+    int keys[TILE_TABLE_SIZE];    // -1 = empty slot
+    int count[TILE_TABLE_SIZE];
+} TileTable;
 
-    // Resolve conflicts
-    // Check for swap attempts (A->B and B->A)
-    bool swap_attempted = false;
-    if (MAX_PLAYERS == 2) {
-        if (wants_move[0] && wants_move[1]) {
-            // Check if they're trying to swap positions
-            if (intended[0].x == state->players[1].pos.x &&
-                intended[0].y == state->players[1].pos.y &&
-                intended[1].x == state->players[0].pos.x &&
-                intended[1].y == state->players[0].pos.y) {
-                // Swap blocked - both stay in place
-                swap_attempted = true;
-                wants_move[0] = false;
-                wants_move[1] = false;
-            }
-        }
-    }
+static int tile_key(Position pos) {
+    return (pos.y + 1) * (MAX_ARENA_WIDTH + 2) + (pos.x + 1);
+}
 
-    // Check for same-tile collision
-    if (!swap_attempted && MAX_PLAYERS == 2) {
-        if (wants_move[0] && wants_move[1]) {
-            if (intended[0].x == intended[1].x &&
-                intended[0].y == intended[1].y) {
-                // Both trying to move to same tile - both cancelled
-                wants_move[0] = false;
-                wants_move[1] = false;
-            }
-        }
+static void tile_table_clear(TileTable* table) {
+    for (int i = 0; i < TILE_TABLE_SIZE; i++) {
+        table->keys[i] = -1;
     }
+}
 
-    // Check for moving into opponent's current position (if opponent isn't moving)
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!wants_move[i]) continue;
-
-        for (int j = 0; j < MAX_PLAYERS; j++) {
-            if (i == j) continue;
-            if (!state->players[j].alive) continue;
-
-            // If moving to opponent's position and opponent isn't moving away
-            if (intended[i].x == state->players[j].pos.x &&
-                intended[i].y == state->players[j].pos.y) {
-                // Check if opponent is moving away
-                if (!wants_move[j] ||
-                    (intended[j].x == state->players[j].pos.x &&
-                     intended[j].y == state->players[j].pos.y)) {
-                    // Opponent isn't moving or staying in place - block our move
-                    wants_move[i] = false;
-                }
-            }
-        }
+static int tile_table_slot(const TileTable* table, Position pos) {
+    int key = tile_key(pos);
+    unsigned int slot = ((unsigned int)key * 2654435761u) >> 27;
+    while (table->keys[slot] != -1 && table->keys[slot] != key) {
+        slot = (slot + 1) & (TILE_TABLE_SIZE - 1);
     }
+    return (int)slot;
+}
 
-    // Apply movements
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (wants_move[i]) {
-            // Update facing direction based on movement
-            Direction move_dir = action_to_direction(actions[i].move);
-            if (move_dir != DIR_NONE) {
-                state->players[i].facing = move_dir;
-            }
-            // Check for void death
-            if (arena_is_void(&state->arena, intended[i].x, intended[i].y)) {
-                state->players[i].alive = false;
-                // Position doesn't matter, they'll respawn
-            } else {
-                state->players[i].pos = intended[i];
-            }
-            player_start_move_cooldown(&state->players[i]);
-        } else if (actions[i].move != ACTION_NOOP && state->players[i].alive) {
-            // Tried to move but was blocked - still start cooldown and update facing
-            Direction move_dir = action_to_direction(actions[i].move);
-            if (move_dir != DIR_NONE && player_can_move(&state->players[i])) {
-                state->players[i].facing = move_dir;
-                player_start_move_cooldown(&state->players[i]);
-            }
-        }
+static void tile_table_add(TileTable* table, Position pos) {
+    int slot = tile_table_slot(table, pos);
+    if (table->keys[slot] == -1) {
+        table->keys[slot] = tile_key(pos);
+        table->count[slot] = 0;
     }
+    table->count[slot]++;
+}
 
-    // Collect crystals at new positions (after movement)
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (!state->players[i].alive) continue;
-
-        int crystal_idx = arena_get_crystal_at(
-            &state->arena,
-            state->players[i].pos.x,
-            state->players[i].pos.y
-        );
-
-        if (crystal_idx >= 0 && arena_crystal_available(&state->arena, crystal_idx)) {
-            player_restore_energy(&state->players[i], MAX_ENERGY);
-            arena_collect_crystal(&state->arena, crystal_idx);
-            info->crystal_collected[i] = true;
-        }
-    }
+static int tile_table_count(const TileTable* table, Position pos) {
+    int slot = tile_table_slot(table, pos);
+    return table->keys[slot] == -1 ? 0 : table->count[slot];
 }
 
-void game_check_win_conditions(GameState* state) {
-    // Check score win condition
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        if (state->players[i].score >= WIN_SCORE) {
-            state->winner = i;
-            state->game_over = true;
+// =============================================================================
+// Step kernels
+//
+// game_step runs one of several copies of the step pipeline generated from
+// game_kernel.h: fixed player counts of 2, 4 and 8, each for maps narrow
+// enough to have the minimum row stride ("small", width <= MAP_ROW_ALIGN)
+// or any width, plus the generic kernel for everything else. game_reset
+// picks one per state, so the step itself never re-checks the shape.
+// =============================================================================
+
+#define KERNEL_NAME(fn) fn##_generic
+#define KERNEL_NUM_PLAYERS(s) ((s)->num_players)
+#define KERNEL_MAX_PLAYERS MAX_PLAYERS
+#define KERNEL_STRIDE(map) ((map)->stride)
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p2_small
+#define KERNEL_NUM_PLAYERS(s) 2
+#define KERNEL_MAX_PLAYERS 2
+#define KERNEL_STRIDE(map) MAP_ROW_ALIGN
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p2_large
+#define KERNEL_NUM_PLAYERS(s) 2
+#define KERNEL_MAX_PLAYERS 2
+#define KERNEL_STRIDE(map) ((map)->stride)
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p4_small
+#define KERNEL_NUM_PLAYERS(s) 4
+#define KERNEL_MAX_PLAYERS 4
+#define KERNEL_STRIDE(map) MAP_ROW_ALIGN
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p4_large
+#define KERNEL_NUM_PLAYERS(s) 4
+#define KERNEL_MAX_PLAYERS 4
+#define KERNEL_STRIDE(map) ((map)->stride)
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p8_small
+#define KERNEL_NUM_PLAYERS(s) 8
+#define KERNEL_MAX_PLAYERS 8
+#define KERNEL_STRIDE(map) MAP_ROW_ALIGN
+#include "game_kernel.h"
+
+#define KERNEL_NAME(fn) fn##_p8_large
+#define KERNEL_NUM_PLAYERS(s) 8
+#define KERNEL_MAX_PLAYERS 8
+#define KERNEL_STRIDE(map) ((map)->stride)
+#include "game_kernel.h"
+
+typedef struct {
+    const char* name;
+    int num_players;  // 0 = any
+    bool small;       // needs stride == MAP_ROW_ALIGN
+    StepInfo (*step)(GameState* state, const PlayerAction* actions);
+} StepKernel;
+
+// Index 0 is the generic kernel; the rest are tried in order
+static const StepKernel step_kernels[] = {
+    {"generic",  0, false, step_generic},
+    {"p2_small", 2, true,  step_p2_small},
+    {"p2_large", 2, false, step_p2_large},
+    {"p4_small", 4, true,  step_p4_small},
+    {"p4_large", 4, false, step_p4_large},
+    {"p8_small", 8, true,  step_p8_small},
+    {"p8_large", 8, false, step_p8_large},
+};
+
+#define NUM_STEP_KERNELS ((int)(sizeof(step_kernels) / sizeof(step_kernels[0])))
+
+void game_select_step_kernel(GameState* state, bool specialized) {
+    state->step_kernel = 0;
+    if (!specialized) {
+        return;
+    }
+    for (int i = 1; i < NUM_STEP_KERNELS; i++) {
+        const StepKernel* kernel = &step_kernels[i];
+        if (kernel->num_players == state->num_players &&
+            (!kernel->small || state->arena.map->stride == MAP_ROW_ALIGN)) {
+            state->step_kernel = (uint8_t)i;
             return;
         }
     }
+}
 
-    // Check timeout
-    if (state->current_tick >= EPISODE_LENGTH_TICKS) {
-        state->game_over = true;
-        // Determine winner by score
-        if (state->players[0].score > state->players[1].score) {
-            state->winner = 0;
-        } else if (state->players[1].score > state->players[0].score) {
-            state->winner = 1;
-        } else {
-            state->winner = -1;  // Draw
-        }
-    }
+const char* game_step_kernel_name(const GameState* state) {
+    return step_kernels[state->step_kernel].name;
 }
 
-Position game_find_respawn_position(const GameState* state, int player_idx) {
-    // Collect all valid floor tiles
-    Position candidates[MAX_ARENA_WIDTH * MAX_ARENA_HEIGHT];
-    int num_candidates = 0;
-
-    int opponent_idx = 1 - player_idx;
-    Position opponent_pos = state->players[opponent_idx].pos;
-
-    for (int y = 0; y < state->arena.height; y++) {
-        for (int x = 0; x < state->arena.width; x++) {
-            if (arena_is_passable(&state->arena, x, y)) {
-                Position pos = {x, y};
-
-                // Check minimum distance from opponent
-                if (manhattan_distance(pos, opponent_pos) >= RESPAWN_MIN_DISTANCE) {
-                    // Check not occupied by other player
-                    bool occupied = false;
-                    for (int i = 0; i < MAX_PLAYERS; i++) {
-                        if (i != player_idx &&
-                            state->players[i].alive &&
-                            state->players[i].pos.x == x &&
-                            state->players[i].pos.y == y) {
-                            occupied = true;
-                            break;
-                        }
-                    }
-
-                    if (!occupied) {
-                        candidates[num_candidates++] = pos;
-                    }
-                }
-            }
-        }
-    }
+StepInfo game_step(GameState* state, const PlayerAction* actions) {
+    TRACE_BEGIN("game_step");
+    StepInfo info = step_kernels[state->step_kernel].step(state, actions);
+    TRACE_END("game_step");
+    return info;
+}
 
-    // If no valid candidates (shouldn't happen with proper map design),
-    // fall back to any floor tile
-    if (num_candidates == 0) {
-        for (int y = 0; y < state->arena.height; y++) {
-            for (int x = 0; x < state->arena.width; x++) {
-                if (arena_is_passable(&state->arena, x, y)) {
-                    Position pos = {x, y};
-                    bool occupied = false;
-                    for (int i = 0; i < MAX_PLAYERS; i++) {
-                        if (i != player_idx &&
-                            state->players[i].alive &&
-                            state->players[i].pos.x == x &&
-                            state->players[i].pos.y == y) {
-                            occupied = true;
-                            break;
-                        }
-                    }
-                    if (!occupied) {
-                        candidates[num_candidates++] = pos;
-                    }
-                }
-            }
-        }
-    }
+void game_phase_collect_crystals(GameState* state, StepInfo* info) {
+    collect_crystals_generic(state, info);
+}
 
-    // Random selection
-    if (num_candidates > 0) {
-        int idx = game_rand() % num_candidates;
-        return candidates[idx];
-    }
+void game_phase_shooting(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    shooting_generic(state, actions, info);
+}
 
-    // Last resort - spawn at origin
-    Position fallback = {0, 0};
-    return fallback;
+void game_phase_movement(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    movement_generic(state, actions, info);
 }
 
-void game_tick_timers(GameState* state) {
-    // Tick player cooldowns
-    for (int i = 0; i < MAX_PLAYERS; i++) {
-        player_tick_cooldowns(&state->players[i]);
-    }
+void game_phase_respawn(GameState* state, StepInfo* info) {
+    respawn_dead_generic(state, info);
+}
 
-    // Tick crystal respawn timers
-    arena_tick_crystals(&state->arena);
+void game_check_win_conditions(GameState* state) {
+    check_win_conditions_generic(state);
+}
 
-    // Tick laser beam timers
-    for (int i = 0; i < MAX_LASERS; i++) {
-        if (state->lasers[i].active) {
-            state->lasers[i].ticks_remaining--;
-            if (state->lasers[i].ticks_remaining <= 0) {
-                state->lasers[i].active = false;
-            }
-        }
-    }
+void game_tick_timers(GameState* state) {
+    tick_timers_generic(state);
 }
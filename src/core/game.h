@@ -3,20 +3,50 @@
 
 #include "types.h"
 
-// Initialize game state with an arena
+// Initialize game state with an arena. state must be new or released
+// with game_free: a live state's map reference and grid would leak.
 void game_init(GameState* state, const char* map_str);
 
+// Initialize game state from already built map data (e.g. a map pack
+// entry). Takes a reference; no parsing or table building. Same rule for
+// state as game_init.
+void game_init_map(GameState* state, const MapData* map);
+
+// Make dst an independent copy of src, to be released with its own
+// game_free. Use this instead of a struct copy, which would share the
+// occupancy grid and map reference (see GameState). dst must be new or
+// released. Returns false on allocation failure; dst is then a valid
+// state on the empty map.
+bool game_copy(GameState* dst, const GameState* src);
+
+// Change the number of players (1..MAX_PLAYERS) and reset. Games start
+// with DEFAULT_NUM_PLAYERS. Returns false if num_players is out of range.
+bool game_set_num_players(GameState* state, int num_players);
+
 // Reset the game to initial state (keeps same arena)
 void game_reset(GameState* state);
 
-// Execute one game step with player actions
+// Release the state's map reference and free its occupancy grid
+void game_free(GameState* state);
+
+// Execute one game step with one action per player (num_players entries)
 // Resolution order:
 //   1. Entity collection (crystals)
-//   2. Shooting (both players simultaneously)
+//   2. Shooting (all players simultaneously)
 //   3. Pushback (from hits)
-//   4. Movement (both players simultaneously)
+//   4. Movement (all players simultaneously; chains of players following
+//      each other move together, swaps and other cycles are blocked)
 // Returns step info for reward calculation
-StepInfo game_step(GameState* state, const PlayerAction actions[MAX_PLAYERS]);
+StepInfo game_step(GameState* state, const PlayerAction* actions);
+
+// Choose the game_step variant for the state's player count and map:
+// a specialized kernel when one matches, else (or if !specialized) the
+// generic one. game_reset calls this with specialized = true; call it
+// again after changing num_players or the map without a reset.
+void game_select_step_kernel(GameState* state, bool specialized);
+
+// Name of the selected variant, e.g. "p2_small" or "generic"
+const char* game_step_kernel_name(const GameState* state);
 
 // Check win conditions and update game_over/winner
 void game_check_win_conditions(GameState* state);
@@ -29,7 +59,10 @@ void game_tick_timers(GameState* state);
 
 // Internal step phases (exposed for testing)
 void game_phase_collect_crystals(GameState* state, StepInfo* info);
-void game_phase_shooting(GameState* state, const PlayerAction actions[MAX_PLAYERS], StepInfo* info);
-void game_phase_movement(GameState* state, const PlayerAction actions[MAX_PLAYERS], StepInfo* info);
+void game_phase_shooting(GameState* state, const PlayerAction* actions, StepInfo* info);
+void game_phase_movement(GameState* state, const PlayerAction* actions, StepInfo* info);
+
+// Respawn dead players not already marked fragged in info, crediting frags
+void game_phase_respawn(GameState* state, StepInfo* info);
 
 #endif // ARENA_GAME_H
@@ -0,0 +1,444 @@
+// =============================================================================
+// Step kernel template
+//
+// game.c includes this file once per kernel variant (hence no include
+// guard). Each inclusion generates a full game_step pipeline whose player
+// count and map row stride are either compile-time constants, so the
+// compiler can unroll the per-player loops and fold the tile indexing, or
+// read from the state for the generic kernel. Every variant computes
+// exactly what the generic one does.
+//
+// Define before including (all are undefined again at the end):
+//   KERNEL_NAME(fn)          fn with the variant's suffix appended
+//   KERNEL_NUM_PLAYERS(s)    players in game s
+//   KERNEL_MAX_PLAYERS       compile-time bound on KERNEL_NUM_PLAYERS
+//   KERNEL_STRIDE(map)       row stride of map
+//
+// The including file provides credit_frag, the TileTable helpers, profile.h
+// and the usual core headers. Laser tracing (combat_fire_laser) and respawn
+// placement stay shared: both are rare next to the per-player loops.
+// =============================================================================
+
+static inline bool KERNEL_NAME(in_bounds)(const MapData* map, int x, int y) {
+    return x >= 0 && x < map->width && y >= 0 && y < map->height;
+}
+
+static inline int KERNEL_NAME(index)(const MapData* map, int x, int y) {
+    (void)map;  // unused when the stride is a constant
+    return y * KERNEL_STRIDE(map) + x;
+}
+
+// Out of bounds is void
+static inline TileType KERNEL_NAME(tile_at)(const MapData* map, Position pos) {
+    if (!KERNEL_NAME(in_bounds)(map, pos.x, pos.y)) {
+        return TILE_VOID;
+    }
+    return (TileType)map->tiles[KERNEL_NAME(index)(map, pos.x, pos.y)];
+}
+
+// Same checks as occupancy_player_at
+static inline int KERNEL_NAME(player_at)(const GameState* state, Position pos) {
+    const MapData* map = state->arena.map;
+    if (!KERNEL_NAME(in_bounds)(map, pos.x, pos.y)) {
+        return -1;
+    }
+    int idx = state->arena.occupancy[KERNEL_NAME(index)(map, pos.x, pos.y)];
+    if (idx == OCCUPANCY_EMPTY) {
+        return -1;
+    }
+    const Player* p = &state->players[idx];
+    if (!p->alive || p->pos.x != pos.x || p->pos.y != pos.y) {
+        return -1;
+    }
+    return idx;
+}
+
+// Same rules as occupancy_set and occupancy_clear: a shared tile names
+// its lowest-index player
+static inline void KERNEL_NAME(occupy)(GameState* state, Position pos, int player_idx) {
+    const MapData* map = state->arena.map;
+    if (KERNEL_NAME(in_bounds)(map, pos.x, pos.y)) {
+        uint8_t* cell = &state->arena.occupancy[KERNEL_NAME(index)(map, pos.x, pos.y)];
+        if (*cell < player_idx) {  // OCCUPANCY_EMPTY never is
+            const Player* p = &state->players[*cell];
+            if (p->alive && p->pos.x == pos.x && p->pos.y == pos.y) {
+                return;
+            }
+        }
+        *cell = (uint8_t)player_idx;
+    }
+}
+
+static inline void KERNEL_NAME(vacate)(GameState* state, Position pos, int player_idx) {
+    const MapData* map = state->arena.map;
+    if (KERNEL_NAME(in_bounds)(map, pos.x, pos.y)) {
+        uint8_t* cell = &state->arena.occupancy[KERNEL_NAME(index)(map, pos.x, pos.y)];
+        if (*cell == player_idx) {
+            *cell = OCCUPANCY_EMPTY;
+            for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+                const Player* p = &state->players[i];
+                if (i != player_idx && p->alive && p->pos.x == pos.x && p->pos.y == pos.y) {
+                    *cell = (uint8_t)i;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Give player i the crystal under them, if there is an available one
+static inline void KERNEL_NAME(collect_at)(GameState* state, int i, StepInfo* info) {
+    const MapData* map = state->arena.map;
+    Position pos = state->players[i].pos;
+    if (!KERNEL_NAME(in_bounds)(map, pos.x, pos.y)) {
+        return;
+    }
+    int crystal_idx = map_crystal_at(map)[KERNEL_NAME(index)(map, pos.x, pos.y)];
+    if (crystal_idx >= 0 && state->arena.crystal_cooldowns[crystal_idx] == 0) {
+        player_restore_energy(&state->players[i], MAX_ENERGY);
+        arena_collect_crystal(&state->arena, crystal_idx);
+        info->crystal_collected[i] = true;
+    }
+}
+
+static void KERNEL_NAME(collect_crystals)(GameState* state, StepInfo* info) {
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (state->players[i].alive) {
+            KERNEL_NAME(collect_at)(state, i, info);
+        }
+    }
+}
+
+static void KERNEL_NAME(shooting)(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    LaserResult results[KERNEL_MAX_PLAYERS];
+    bool will_shoot[KERNEL_MAX_PLAYERS] = {false};
+
+    // First, determine who will shoot and calculate results
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        Direction shoot_dir = action_to_direction(actions[i].shoot);
+
+        if (shoot_dir != DIR_NONE &&
+            player_can_shoot(&state->players[i])) {
+
+            // Consume energy and start cooldown
+            if (player_use_energy(&state->players[i], 1)) {
+                player_start_laser_cooldown(&state->players[i]);
+                will_shoot[i] = true;
+
+                // Calculate where the shot would land
+                results[i] = combat_fire_laser(state, i, shoot_dir);
+            }
+        }
+    }
+
+    // Create visual laser beams for rendering
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (will_shoot[i]) {
+            for (int j = 0; j < MAX_LASERS; j++) {
+                if (!state->lasers[j].active) {
+                    state->lasers[j].start = state->players[i].pos;
+                    state->lasers[j].end = results[i].hit_position;
+                    state->lasers[j].player_idx = i;
+                    state->lasers[j].ticks_remaining = LASER_COOLDOWN_TICKS;
+                    state->lasers[j].active = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Apply all hits simultaneously
+    // This means if two players shoot each other, both take damage. When
+    // several shots hit one target, the highest-index shooter gets the
+    // credit for a frag.
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (will_shoot[i] && results[i].hit_type == LASER_HIT_PLAYER) {
+            int target = results[i].target_player;
+
+            // Apply damage
+            player_take_damage(&state->players[target], LASER_DAMAGE);
+            state->players[target].last_hit_by = i;
+            info->player_hit[target] = true;
+            info->damage_dealt[i] += LASER_DAMAGE;
+            info->damage_taken[target] += LASER_DAMAGE;
+        }
+    }
+
+    // Apply pushback after all damage (so simultaneous shots don't interfere)
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (will_shoot[i] && results[i].hit_type == LASER_HIT_PLAYER) {
+            int target = results[i].target_player;
+
+            // Only apply pushback if target is still alive
+            // (they might have died from damage)
+            if (state->players[target].alive) {
+                KERNEL_NAME(vacate)(state, state->players[target].pos, target);
+                if (results[i].target_fragged) {
+                    // Pushed into void
+                    state->players[target].alive = false;
+                } else {
+                    // Apply pushback position
+                    state->players[target].pos = results[i].pushback_to;
+                    KERNEL_NAME(occupy)(state, results[i].pushback_to, target);
+                }
+            }
+        }
+    }
+}
+
+// Decide which of the wanted moves happen:
+//   - movers targeting the same tile are all cancelled
+//   - a move onto an occupied tile succeeds only if the occupant moves
+//     away. Following these links gives chains, which succeed or fail
+//     together, and cycles (a swap is a 2-cycle), which are blocked.
+// Every player has at most one outgoing link, so each one is visited once.
+// With few players, comparing every pair of targets is cheaper than the
+// claims table.
+static void KERNEL_NAME(resolve_moves)(const GameState* state, const Position* intended,
+                                       bool* wants_move) {
+    int num_players = KERNEL_NUM_PLAYERS(state);
+
+    // -1 = unresolved, 0 = stays, 1 = moves, 2 = on the chain being walked
+    int8_t outcome[KERNEL_MAX_PLAYERS];
+#if KERNEL_MAX_PLAYERS <= 4
+    for (int i = 0; i < num_players; i++) {
+        bool contested = false;
+        for (int j = 0; j < num_players; j++) {
+            contested |= j != i && wants_move[j] &&
+                         intended[j].x == intended[i].x && intended[j].y == intended[i].y;
+        }
+        outcome[i] = wants_move[i] && !contested ? -1 : 0;
+    }
+#else
+    TileTable claims;
+    tile_table_clear(&claims);
+    for (int i = 0; i < num_players; i++) {
+        if (wants_move[i]) {
+            tile_table_add(&claims, intended[i]);
+        }
+    }
+    for (int i = 0; i < num_players; i++) {
+        bool contested = wants_move[i] && tile_table_count(&claims, intended[i]) > 1;
+        outcome[i] = wants_move[i] && !contested ? -1 : 0;
+    }
+#endif
+
+    for (int i = 0; i < num_players; i++) {
+        int chain[KERNEL_MAX_PLAYERS];
+        int length = 0;
+        int result;
+        int current = i;
+
+        for (;;) {
+            if (outcome[current] == 2) {
+                result = 0;  // back on this chain: a cycle
+                break;
+            }
+            if (outcome[current] != -1) {
+                result = outcome[current];
+                break;
+            }
+            outcome[current] = 2;
+            chain[length++] = current;
+            int blocker = KERNEL_NAME(player_at)(state, intended[current]);
+            if (blocker < 0) {
+                result = 1;  // target is free
+                break;
+            }
+            current = blocker;
+        }
+        for (int k = 0; k < length; k++) {
+            outcome[chain[k]] = (int8_t)result;
+        }
+    }
+
+    for (int i = 0; i < num_players; i++) {
+        wants_move[i] = outcome[i] == 1;
+    }
+}
+
+static void KERNEL_NAME(movement)(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    const MapData* map = state->arena.map;
+    Position intended[KERNEL_MAX_PLAYERS] = {{0}};
+    bool wants_move[KERNEL_MAX_PLAYERS] = {false};
+
+    // Calculate intended positions
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        intended[i] = state->players[i].pos;
+
+        if (!state->players[i].alive) continue;
+
+        Direction move_dir = action_to_direction(actions[i].move);
+
+        if (move_dir != DIR_NONE && player_can_move(&state->players[i])) {
+            Position target = position_add_direction(state->players[i].pos, move_dir);
+
+            // Floor is passable and void is a legal (fatal) move; walls
+            // keep the player in place, but still trigger the cooldown
+            if (KERNEL_NAME(tile_at)(map, target) != TILE_WALL) {
+                intended[i] = target;
+                wants_move[i] = true;
+            }
+        }
+    }
+
+    KERNEL_NAME(resolve_moves)(state, intended, wants_move);
+
+    // Apply movements
+    Position from[KERNEL_MAX_PLAYERS];
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        from[i] = state->players[i].pos;
+        if (wants_move[i]) {
+            // Update facing direction based on movement
+            Direction move_dir = action_to_direction(actions[i].move);
+            if (move_dir != DIR_NONE) {
+                state->players[i].facing = move_dir;
+            }
+            // Check for void death
+            if (KERNEL_NAME(tile_at)(map, intended[i]) == TILE_VOID) {
+                state->players[i].alive = false;
+                // Position doesn't matter, they'll respawn
+            } else {
+                state->players[i].pos = intended[i];
+            }
+            player_start_move_cooldown(&state->players[i]);
+        } else if (actions[i].move != ACTION_NOOP && state->players[i].alive) {
+            // Tried to move but was blocked - still start cooldown and update facing
+            Direction move_dir = action_to_direction(actions[i].move);
+            if (move_dir != DIR_NONE && player_can_move(&state->players[i])) {
+                state->players[i].facing = move_dir;
+                player_start_move_cooldown(&state->players[i]);
+            }
+        }
+    }
+
+    // Update the grid once every mover has landed, so a chain can step
+    // into the tiles its members left and those tiles pass to whoever is
+    // still on them
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (wants_move[i]) {
+            KERNEL_NAME(vacate)(state, from[i], i);
+        }
+    }
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (wants_move[i] && state->players[i].alive) {
+            KERNEL_NAME(occupy)(state, intended[i], i);
+        }
+    }
+
+    // Collect crystals at new positions (after movement)
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (state->players[i].alive) {
+            KERNEL_NAME(collect_at)(state, i, info);
+        }
+    }
+}
+
+// Respawn dead players, skipping those already handled this step. All of
+// them leave the grid first: one killed on a shared tile may still name it.
+static void KERNEL_NAME(respawn_dead)(GameState* state, StepInfo* info) {
+    bool any = false;
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (!state->players[i].alive && !info->player_fragged[i]) {
+            KERNEL_NAME(vacate)(state, state->players[i].pos, i);
+            any = true;
+        }
+    }
+    if (!any) {
+        return;
+    }
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (!state->players[i].alive && !info->player_fragged[i]) {
+            credit_frag(state, i, info);
+
+            Position respawn = game_find_respawn_position(state, i);
+            player_respawn(&state->players[i], respawn);
+            KERNEL_NAME(occupy)(state, respawn, i);
+        }
+    }
+}
+
+static void KERNEL_NAME(tick_timers)(GameState* state) {
+    // Tick player cooldowns
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        player_tick_cooldowns(&state->players[i]);
+    }
+
+    // Tick crystal respawn timers
+    arena_tick_crystals(&state->arena);
+
+    // Tick laser beam timers
+    for (int i = 0; i < MAX_LASERS; i++) {
+        if (state->lasers[i].active) {
+            state->lasers[i].ticks_remaining--;
+            if (state->lasers[i].ticks_remaining <= 0) {
+                state->lasers[i].active = false;
+            }
+        }
+    }
+}
+
+static void KERNEL_NAME(check_win_conditions)(GameState* state) {
+    // Check score win condition
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (state->players[i].score >= WIN_SCORE) {
+            state->winner = i;
+            state->game_over = true;
+            return;
+        }
+    }
+
+    // Check timeout
+    if (state->current_tick >= EPISODE_LENGTH_TICKS) {
+        state->game_over = true;
+        // Determine winner by score; a shared top score is a draw
+        int best = -1;
+        bool tied = false;
+        for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+            if (best < 0 || state->players[i].score > state->players[best].score) {
+                best = i;
+                tied = false;
+            } else if (state->players[i].score == state->players[best].score) {
+                tied = true;
+            }
+        }
+        state->winner = tied ? -1 : best;
+    }
+}
+
+static StepInfo KERNEL_NAME(step)(GameState* state, const PlayerAction* actions) {
+    StepInfo info = {0};
+
+    if (state->game_over) {
+        return info;
+    }
+
+    // Pick up players moved outside game_step
+    for (int i = 0; i < KERNEL_NUM_PLAYERS(state); i++) {
+        if (state->players[i].alive) {
+            KERNEL_NAME(occupy)(state, state->players[i].pos, i);
+        }
+    }
+
+    // Phase 1: Collect crystals (based on current positions before any moves)
+    PROFILE_PHASE(PROFILE_COLLECT, KERNEL_NAME(collect_crystals)(state, &info));
+
+    // Phase 2 & 3: Shooting and pushback, then respawn the fragged
+    PROFILE_PHASE(PROFILE_SHOOTING, KERNEL_NAME(shooting)(state, actions, &info));
+    PROFILE_PHASE(PROFILE_RESPAWN, KERNEL_NAME(respawn_dead)(state, &info));
+
+    // Phase 4: Movement, then respawn players pushed or moved into void
+    PROFILE_PHASE(PROFILE_MOVEMENT, KERNEL_NAME(movement)(state, actions, &info));
+    PROFILE_PHASE(PROFILE_RESPAWN, KERNEL_NAME(respawn_dead)(state, &info));
+
+    PROFILE_PHASE(PROFILE_TIMERS, KERNEL_NAME(tick_timers)(state));
+    state->current_tick++;
+    PROFILE_PHASE(PROFILE_WIN_CHECK, KERNEL_NAME(check_win_conditions)(state));
+
+    return info;
+}
+
+#undef KERNEL_NAME
+#undef KERNEL_NUM_PLAYERS
+#undef KERNEL_MAX_PLAYERS
+#undef KERNEL_STRIDE
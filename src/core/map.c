@@ -0,0 +1,495 @@
+#include "map.h"
+#include "distance.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interned maps, keyed by source text. Retain/release only happen on env
+// init/free, so a single mutex-protected list is plenty.
+typedef struct MapCacheEntry {
+    uint64_t hash;
+    char* source;
+    MapData* map;
+    struct MapCacheEntry* next;
+} MapCacheEntry;
+
+static MapCacheEntry* map_cache = NULL;
+static pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static MapData empty_map = {
+    .refcount = MAP_DATA_STATIC,
+    .width = 0,
+    .height = 0,
+    .size = sizeof(MapData),
+};
+
+// FNV-1a
+static uint64_t hash_string(const char* s) {
+    uint64_t h = 14695981039346656037ull;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static size_t align_up(size_t value) {
+    return (value + MAP_ROW_ALIGN - 1) & ~(size_t)(MAP_ROW_ALIGN - 1);
+}
+
+// Table placement for a width x height map: every table starts on an
+// aligned boundary, as sizeof(MapData) and the plane sizes are multiples
+// of MAP_ROW_ALIGN
+typedef struct {
+    int stride;
+    size_t plane;
+    size_t crystal_at_offset;
+    size_t ray_length_offset;
+    size_t floor_tiles_offset;
+    size_t distance_offset;
+} MapLayout;
+
+static MapLayout map_layout(int width, int height) {
+    MapLayout layout;
+    layout.stride = (int)align_up((size_t)width);
+    layout.plane = (size_t)height * (size_t)layout.stride;
+    layout.crystal_at_offset = sizeof(MapData) + layout.plane;
+    layout.ray_length_offset = layout.crystal_at_offset + layout.plane;
+    layout.floor_tiles_offset = layout.ray_length_offset + 4 * layout.plane * sizeof(uint16_t);
+    layout.distance_offset = layout.floor_tiles_offset +
+        align_up((size_t)width * (size_t)height * sizeof(uint32_t));
+    return layout;
+}
+
+MapData* map_data_alloc_blob(size_t size) {
+    // aligned_alloc wants a multiple of the alignment
+    return aligned_alloc(MAP_ROW_ALIGN, align_up(size));
+}
+
+MapData* map_data_create(int width, int height) {
+    if (width < 0 || width > MAX_ARENA_WIDTH || height < 0 || height > MAX_ARENA_HEIGHT) {
+        return NULL;
+    }
+
+    MapLayout layout = map_layout(width, height);
+    size_t capacity = layout.distance_offset +
+        (size_t)(MAX_CRYSTALS + MAX_SPAWN_POINTS) * layout.plane * sizeof(uint16_t);
+
+    MapData* map = map_data_alloc_blob(capacity);
+    if (!map) {
+        return NULL;
+    }
+    memset(map, 0, align_up(capacity));
+
+    map->refcount = 1;
+    map->width = width;
+    map->height = height;
+    map->stride = layout.stride;
+    map->size = (uint32_t)layout.distance_offset;
+    map->crystal_at_offset = (uint32_t)layout.crystal_at_offset;
+    map->ray_length_offset = (uint32_t)layout.ray_length_offset;
+    map->floor_tiles_offset = (uint32_t)layout.floor_tiles_offset;
+    map->distance_offset = (uint32_t)layout.distance_offset;
+
+    for (int i = 0; i < MAX_CRYSTALS; i++) {
+        map->crystals[i].x = -1;
+        map->crystals[i].y = -1;
+    }
+    for (int i = 0; i < MAX_SPAWN_POINTS; i++) {
+        map->spawn_points[i].pos.x = -1;
+        map->spawn_points[i].pos.y = -1;
+    }
+
+    return map;
+}
+
+static void add_crystal(MapData* map, int x, int y) {
+    if (map->num_crystals < MAX_CRYSTALS) {
+        map->crystals[map->num_crystals].x = x;
+        map->crystals[map->num_crystals].y = y;
+        map->num_crystals++;
+    }
+}
+
+static void add_spawn_point(MapData* map, int x, int y) {
+    if (map->num_spawn_points < MAX_SPAWN_POINTS) {
+        map->spawn_points[map->num_spawn_points].pos.x = x;
+        map->spawn_points[map->num_spawn_points].pos.y = y;
+        map->num_spawn_points++;
+    }
+}
+
+MapData* map_data_parse(const char* map_str) {
+    // First pass: determine dimensions
+    // Must properly count UTF-8 characters, not bytes
+    int width = 0;
+    int height = 0;
+    int current_width = 0;
+
+    for (const char* p = map_str; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '\n') {
+            if (current_width > width) {
+                width = current_width;
+            }
+            if (current_width > 0) {
+                height++;
+            }
+            current_width = 0;
+        } else if (c == ' ') {
+            // Skip spaces (used for formatting)
+            continue;
+        } else if ((c & 0xC0) == 0x80) {
+            // UTF-8 continuation byte (10xxxxxx) - skip, don't count
+            continue;
+        } else {
+            // Either ASCII (0xxxxxxx) or start of multi-byte sequence
+            // (110xxxxx, 1110xxxx, 11110xxx) - count as one character
+            current_width++;
+        }
+    }
+    // Handle last line without newline
+    if (current_width > 0) {
+        if (current_width > width) {
+            width = current_width;
+        }
+        height++;
+    }
+
+    if (width > MAX_ARENA_WIDTH || height > MAX_ARENA_HEIGHT) {
+        return NULL;
+    }
+
+    MapData* map = map_data_create(width, height);
+    if (!map) {
+        return NULL;
+    }
+
+    // Second pass: parse tiles
+    int x = 0;
+    int y = 0;
+
+    for (const char* p = map_str; *p; p++) {
+        if (*p == '\n') {
+            x = 0;
+            if (y < height - 1) {
+                y++;
+            }
+            continue;
+        }
+
+        if (*p == ' ') {
+            continue;  // Skip spaces (used for formatting)
+        }
+
+        if (x >= width || y >= height) {
+            continue;
+        }
+
+        // Parse character
+        // × = void, ■ = wall, □ = floor, ◆ = crystal, ▷◁△▽ = spawn points
+        // Also support ASCII: x = void, # = wall, . = floor, * = crystal, 1/2 = spawn
+
+        // Check for multi-byte UTF-8 characters
+        unsigned char c = (unsigned char)*p;
+
+        if (c == 'x' || c == 'X') {
+            map_set_tile(map, x, y, TILE_VOID);
+        } else if (c == '#') {
+            map_set_tile(map, x, y, TILE_WALL);
+        } else if (c == '.' || c == '_') {
+            map_set_tile(map, x, y, TILE_FLOOR);
+        } else if (c == '*' || c == 'C' || c == 'c') {
+            map_set_tile(map, x, y, TILE_FLOOR);
+            add_crystal(map, x, y);
+        } else if (c == '1' || c == '2' || c == 'S' || c == 's') {
+            map_set_tile(map, x, y, TILE_FLOOR);
+            add_spawn_point(map, x, y);
+        } else if (c >= 0xC0) {
+            // Multi-byte UTF-8 character
+            // ×(U+00D7): C3 97
+            // ■(U+25A0): E2 96 A0
+            // □(U+25A1): E2 96 A1
+            // ◆(U+25C6): E2 97 86
+            // ▷(U+25B7): E2 96 B7
+            // ◁(U+25C1): E2 97 81
+
+            if (c == 0xC3 && (unsigned char)*(p+1) == 0x97) {
+                // × (multiplication sign) = void
+                map_set_tile(map, x, y, TILE_VOID);
+                p++;
+            } else if (c == 0xE2) {
+                unsigned char c2 = (unsigned char)*(p+1);
+                unsigned char c3 = (unsigned char)*(p+2);
+
+                if (c2 == 0x96 && c3 == 0xA0) {
+                    // ■ = wall
+                    map_set_tile(map, x, y, TILE_WALL);
+                    p += 2;
+                } else if (c2 == 0x96 && c3 == 0xA1) {
+                    // □ = floor
+                    map_set_tile(map, x, y, TILE_FLOOR);
+                    p += 2;
+                } else if (c2 == 0x97 && c3 == 0x86) {
+                    // ◆ = crystal
+                    map_set_tile(map, x, y, TILE_FLOOR);
+                    add_crystal(map, x, y);
+                    p += 2;
+                } else if ((c2 == 0x96 && c3 == 0xB7) ||  // ▷
+                           (c2 == 0x97 && c3 == 0x81) ||  // ◁
+                           (c2 == 0x96 && c3 == 0xB3) ||  // △
+                           (c2 == 0x96 && c3 == 0xBD)) {  // ▽
+                    // Spawn point
+                    map_set_tile(map, x, y, TILE_FLOOR);
+                    add_spawn_point(map, x, y);
+                    p += 2;
+                } else {
+                    // Unknown UTF-8, treat as floor
+                    map_set_tile(map, x, y, TILE_FLOOR);
+                    p += 2;
+                }
+            } else {
+                // Other multi-byte, skip appropriately
+                if (c >= 0xE0) p += 2;
+                else p++;
+            }
+        } else {
+            // Unknown single-byte, treat as floor
+            map_set_tile(map, x, y, TILE_FLOOR);
+        }
+
+        x++;
+    }
+
+    map_data_build_tables(map);
+    return map;
+}
+
+static void build_ray_table(MapData* map, Direction dir) {
+    uint16_t* ray = (uint16_t*)map_ray_length(map, dir);
+    int dx = 0, dy = 0;
+    switch (dir) {
+        case DIR_UP:    dy = -1; break;
+        case DIR_DOWN:  dy = 1;  break;
+        case DIR_LEFT:  dx = -1; break;
+        case DIR_RIGHT: dx = 1;  break;
+        default: return;
+    }
+
+    // Walk against the ray direction so the neighbour's length is known
+    int x_start = dx > 0 ? map->width - 1 : 0;
+    int x_step = dx > 0 ? -1 : 1;
+    int y_start = dy > 0 ? map->height - 1 : 0;
+    int y_step = dy > 0 ? -1 : 1;
+
+    for (int y = y_start; y >= 0 && y < map->height; y += y_step) {
+        for (int x = x_start; x >= 0 && x < map->width; x += x_step) {
+            int nx = x + dx;
+            int ny = y + dy;
+            bool blocked = nx < 0 || nx >= map->width || ny < 0 || ny >= map->height ||
+                           map_get_tile(map, nx, ny) == TILE_WALL;
+            ray[map_index(map, x, y)] =
+                blocked ? 1 : (uint16_t)(1 + ray[map_index(map, nx, ny)]);
+        }
+    }
+}
+
+void map_data_build_tables(MapData* map) {
+    size_t plane = (size_t)map->height * (size_t)map->stride;
+
+    int8_t* crystal_at = (int8_t*)map_crystal_at(map);
+    memset(crystal_at, -1, plane);
+    for (int i = 0; i < map->num_crystals; i++) {
+        Position pos = map->crystals[i];
+        if (pos.x >= 0 && pos.x < map->width && pos.y >= 0 && pos.y < map->height &&
+            crystal_at[map_index(map, pos.x, pos.y)] < 0) {
+            crystal_at[map_index(map, pos.x, pos.y)] = (int8_t)i;
+        }
+    }
+
+    // Floor tiles in row-major order: respawn candidate scans walk this
+    // list instead of the whole grid
+    uint32_t* floor_tiles = (uint32_t*)map_floor_tiles(map);
+    map->num_floor_tiles = 0;
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            if (map_get_tile(map, x, y) == TILE_FLOOR) {
+                floor_tiles[map->num_floor_tiles++] = (uint32_t)map_index(map, x, y);
+            }
+        }
+    }
+
+    build_ray_table(map, DIR_UP);
+    build_ray_table(map, DIR_DOWN);
+    build_ray_table(map, DIR_LEFT);
+    build_ray_table(map, DIR_RIGHT);
+
+    // Distance planes are packed for the actual counts, so the blob ends
+    // after the last one in use
+    for (int i = 0; i < map->num_crystals; i++) {
+        distance_field_build(map, map->crystals[i], (uint16_t*)map_crystal_distance(map, i));
+    }
+    for (int i = 0; i < map->num_spawn_points; i++) {
+        distance_field_build(map, map->spawn_points[i].pos, (uint16_t*)map_spawn_distance(map, i));
+    }
+    map->size = map->distance_offset +
+        (uint32_t)((size_t)(map->num_crystals + map->num_spawn_points) * plane * sizeof(uint16_t));
+}
+
+size_t map_data_size(const MapData* map) {
+    return map->size;
+}
+
+static bool position_in_map(const MapData* map, Position pos) {
+    return pos.x >= 0 && pos.x < map->width && pos.y >= 0 && pos.y < map->height;
+}
+
+bool map_data_validate_blob(const MapData* map, size_t size) {
+    if (size < sizeof(MapData) || map->size != size ||
+        map->width < 0 || map->width > MAX_ARENA_WIDTH ||
+        map->height < 0 || map->height > MAX_ARENA_HEIGHT ||
+        map->num_crystals < 0 || map->num_crystals > MAX_CRYSTALS ||
+        map->num_spawn_points < 0 || map->num_spawn_points > MAX_SPAWN_POINTS ||
+        map->num_floor_tiles < 0 || map->num_floor_tiles > map->width * map->height) {
+        return false;
+    }
+    for (int i = 0; i < map->num_crystals; i++) {
+        if (!position_in_map(map, map->crystals[i])) return false;
+    }
+    for (int i = 0; i < map->num_spawn_points; i++) {
+        if (!position_in_map(map, map->spawn_points[i].pos)) return false;
+    }
+
+    // Tables are only read through width and height, so a map with no
+    // tiles (like the empty map) needs no layout
+    MapLayout layout = map_layout(map->width, map->height);
+    if (layout.plane == 0) {
+        return map->num_crystals == 0 && map->num_spawn_points == 0 &&
+               map->num_floor_tiles == 0;
+    }
+    size_t planes = (size_t)(map->num_crystals + map->num_spawn_points);
+    if (map->stride != layout.stride ||
+        map->crystal_at_offset != layout.crystal_at_offset ||
+        map->ray_length_offset != layout.ray_length_offset ||
+        map->floor_tiles_offset != layout.floor_tiles_offset ||
+        map->distance_offset != layout.distance_offset ||
+        size != layout.distance_offset + planes * layout.plane * sizeof(uint16_t)) {
+        return false;
+    }
+
+    // Table contents that are used as indices or step counts
+    const int8_t* crystal_at = map_crystal_at(map);
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            int i = map_index(map, x, y);
+            if (map->tiles[i] > TILE_VOID ||
+                crystal_at[i] < -1 || crystal_at[i] >= map->num_crystals) {
+                return false;
+            }
+            for (int dir = DIR_UP; dir <= DIR_RIGHT; dir++) {
+                int limit = dir == DIR_UP || dir == DIR_DOWN ? map->height : map->width;
+                uint16_t ray = map_ray_length(map, (Direction)dir)[i];
+                if (ray < 1 || ray > limit) return false;
+            }
+        }
+    }
+    const uint32_t* floor_tiles = map_floor_tiles(map);
+    for (int i = 0; i < map->num_floor_tiles; i++) {
+        uint32_t index = floor_tiles[i];
+        if (index >= layout.plane || (int)(index % (uint32_t)map->stride) >= map->width ||
+            map->tiles[index] != TILE_FLOOR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const MapData* map_data_empty(void) {
+    return &empty_map;
+}
+
+const MapData* map_data_load(const char* map_str) {
+    uint64_t hash = hash_string(map_str);
+
+    pthread_mutex_lock(&map_mutex);
+    for (MapCacheEntry* e = map_cache; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->source, map_str) == 0) {
+            e->map->refcount++;
+            pthread_mutex_unlock(&map_mutex);
+            return e->map;
+        }
+    }
+    pthread_mutex_unlock(&map_mutex);
+
+    // Parse outside the lock; if another thread interned the same map in
+    // the meantime, use theirs
+    MapData* map = map_data_parse(map_str);
+    if (!map) {
+        return NULL;
+    }
+
+    MapCacheEntry* entry = malloc(sizeof(MapCacheEntry));
+    char* source = malloc(strlen(map_str) + 1);
+    if (!entry || !source) {
+        free(entry);
+        free(source);
+        return map;  // still usable, just not shared
+    }
+    strcpy(source, map_str);
+
+    pthread_mutex_lock(&map_mutex);
+    for (MapCacheEntry* e = map_cache; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->source, map_str) == 0) {
+            e->map->refcount++;
+            pthread_mutex_unlock(&map_mutex);
+            free(entry);
+            free(source);
+            free(map);
+            return e->map;
+        }
+    }
+    entry->hash = hash;
+    entry->source = source;
+    entry->map = map;
+    entry->next = map_cache;
+    map_cache = entry;
+    pthread_mutex_unlock(&map_mutex);
+
+    return map;
+}
+
+void map_data_retain(const MapData* map) {
+    if (!map || map->refcount == MAP_DATA_STATIC) {
+        return;
+    }
+
+    pthread_mutex_lock(&map_mutex);
+    ((MapData*)map)->refcount++;
+    pthread_mutex_unlock(&map_mutex);
+}
+
+void map_data_release(const MapData* map) {
+    if (!map || map->refcount == MAP_DATA_STATIC) {
+        return;
+    }
+
+    MapData* owned = (MapData*)map;
+    pthread_mutex_lock(&map_mutex);
+    if (--owned->refcount > 0) {
+        pthread_mutex_unlock(&map_mutex);
+        return;
+    }
+
+    for (MapCacheEntry** link = &map_cache; *link; link = &(*link)->next) {
+        if ((*link)->map == owned) {
+            MapCacheEntry* entry = *link;
+            *link = entry->next;
+            free(entry->source);
+            free(entry);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&map_mutex);
+
+    free(owned);
+}
@@ -0,0 +1,95 @@
+#ifndef ARENA_MAP_H
+#define ARENA_MAP_H
+
+#include <stddef.h>
+#include "types.h"
+
+// =============================================================================
+// Shared, immutable map data
+//
+// A MapData is built once per map and referenced by every GameState playing
+// it. Maps loaded through map_data_load are interned by source text, so
+// 100k envs initialized from the same string share a single copy.
+// Refcounting is only touched on init/free, never inside game_step.
+// =============================================================================
+
+// Parse a map from string (ASCII art format) into a new, non-interned
+// MapData with refcount 1. Returns NULL on error (e.g. map too large).
+MapData* map_data_parse(const char* map_str);
+
+// New all-floor map with no crystals or spawns and refcount 1, for
+// building maps in code. Call map_data_build_tables when done. Storage
+// for the derived tables is reserved up front, sized for MAX_CRYSTALS and
+// MAX_SPAWN_POINTS.
+MapData* map_data_create(int width, int height);
+
+// Uninitialized, MAP_ROW_ALIGN-aligned storage for a size-byte map blob,
+// for code that copies or loads one. Free with free().
+MapData* map_data_alloc_blob(size_t size);
+
+// Get the interned MapData for map_str, parsing it on first use.
+// Returns a new reference, or NULL on error.
+const MapData* map_data_load(const char* map_str);
+
+// Shared empty (0x0) map, used when a load fails. Never freed.
+const MapData* map_data_empty(void);
+
+// Reference counting. No-ops for MAP_DATA_STATIC maps and NULL.
+void map_data_retain(const MapData* map);
+void map_data_release(const MapData* map);
+
+// Rebuild the derived lookup tables after editing tiles/crystals/spawns
+void map_data_build_tables(MapData* map);
+
+// Size in bytes of the map data blob: header plus the tables in use
+// (only as many distance planes as the map has crystals and spawns)
+size_t map_data_size(const MapData* map);
+
+// Check a map blob of size bytes read from outside the process (a map
+// pack record, an archived episode) before using it: dimensions and
+// counts in range, tables where map_data_build_tables puts them, and
+// every table entry used as an index or step count in bounds. Distance
+// values are not checked; any value is safe to read.
+bool map_data_validate_blob(const MapData* map, size_t size);
+
+// Index of (x, y) into any per-tile table
+static inline int map_index(const MapData* map, int x, int y) {
+    return y * map->stride + x;
+}
+
+// Tile query (out of bounds is void)
+static inline TileType map_get_tile(const MapData* map, int x, int y) {
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) {
+        return TILE_VOID;
+    }
+    return (TileType)map->tiles[map_index(map, x, y)];
+}
+
+static inline void map_set_tile(MapData* map, int x, int y, TileType tile) {
+    map->tiles[map_index(map, x, y)] = (uint8_t)tile;
+}
+
+// Derived tables (see MapData)
+static inline const int8_t* map_crystal_at(const MapData* map) {
+    return (const int8_t*)((const unsigned char*)map + map->crystal_at_offset);
+}
+
+static inline const uint16_t* map_ray_length(const MapData* map, Direction dir) {
+    return (const uint16_t*)((const unsigned char*)map + map->ray_length_offset) +
+           (size_t)(dir - 1) * (size_t)(map->height * map->stride);
+}
+
+static inline const uint32_t* map_floor_tiles(const MapData* map) {
+    return (const uint32_t*)((const unsigned char*)map + map->floor_tiles_offset);
+}
+
+static inline const uint16_t* map_crystal_distance(const MapData* map, int crystal) {
+    return (const uint16_t*)((const unsigned char*)map + map->distance_offset) +
+           (size_t)crystal * (size_t)(map->height * map->stride);
+}
+
+static inline const uint16_t* map_spawn_distance(const MapData* map, int spawn) {
+    return map_crystal_distance(map, map->num_crystals + spawn);
+}
+
+#endif // ARENA_MAP_H
@@ -0,0 +1,326 @@
+#include "mapgen.h"
+#include "map.h"
+#include <stdlib.h>
+
+// Tiles are indexed by map_index (as in MapData.floor_tiles)
+#define TILE_X(map, i) ((i) % (map)->stride)
+#define TILE_Y(map, i) ((i) / (map)->stride)
+
+// Per-tile work arrays, allocated once per mapgen_generate call
+typedef struct {
+    int* comp;        // component label per tile, -1 for non-floor
+    int* queue;
+    int* candidates;
+} MapGenScratch;
+
+// Private xorshift32 stream so generation never perturbs game_rand
+static uint32_t mapgen_next(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static float mapgen_unit(uint32_t* state) {
+    return (float)(mapgen_next(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+void mapgen_default_params(MapGenParams* params, unsigned int seed) {
+    params->seed = seed;
+    params->width = 15;
+    params->height = 15;
+    params->wall_density = 0.15f;
+    params->void_density = 0.10f;
+    params->num_crystals = 2;
+    params->num_spawns = 2;
+}
+
+static int mirror_index(const MapData* map, int i) {
+    return map_index(map, map->width - 1 - TILE_X(map, i), map->height - 1 - TILE_Y(map, i));
+}
+
+// Whether a laser fired from a could reach b: same row or column with no
+// wall in between (lasers pass over void)
+static bool in_line_of_fire(const MapData* map, Position a, Position b) {
+    if (a.x != b.x && a.y != b.y) {
+        return false;
+    }
+    int dx = (b.x > a.x) - (b.x < a.x);
+    int dy = (b.y > a.y) - (b.y < a.y);
+    for (int x = a.x + dx, y = a.y + dy; x != b.x || y != b.y; x += dx, y += dy) {
+        if (map_get_tile(map, x, y) == TILE_WALL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Label 4-connected floor components into comp (-1 for non-floor) and
+// return the label of the largest one that maps onto itself under the
+// symmetry, or -1 if there is none. (The mirror of a component is always
+// a component of the same size, but it can be a different one.) The
+// largest component overall goes to *largest.
+static int label_components(const MapData* map, int* comp, int* queue, int* largest) {
+    int best = -1, best_size = 0, largest_size = 0, label = 0;
+    *largest = -1;
+
+    for (int i = 0; i < map->height * map->stride; i++) {
+        comp[i] = -1;
+    }
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            int start = map_index(map, x, y);
+            if (comp[start] >= 0 || map->tiles[start] != TILE_FLOOR) {
+                continue;
+            }
+            int head = 0, tail = 0;
+            comp[start] = label;
+            queue[tail++] = start;
+            while (head < tail) {
+                int i = queue[head++];
+                int cx = TILE_X(map, i);
+                int cy = TILE_Y(map, i);
+                int neighbors[4] = {
+                    cy > 0 ? i - map->stride : -1,
+                    cy < map->height - 1 ? i + map->stride : -1,
+                    cx > 0 ? i - 1 : -1,
+                    cx < map->width - 1 ? i + 1 : -1
+                };
+                for (int d = 0; d < 4; d++) {
+                    int j = neighbors[d];
+                    if (j >= 0 && comp[j] < 0 && map->tiles[j] == TILE_FLOOR) {
+                        comp[j] = label;
+                        queue[tail++] = j;
+                    }
+                }
+            }
+            if (tail > largest_size) {
+                *largest = label;
+                largest_size = tail;
+            }
+            bool symmetric = comp[mirror_index(map, start)] == label;
+            if (symmetric && tail > best_size) {
+                best = label;
+                best_size = tail;
+            }
+            label++;
+        }
+    }
+    return best;
+}
+
+// Join a component to its mirror image: carve an L-shaped floor corridor
+// (mirrored, so symmetry holds) from the component's tile nearest the
+// center to that tile's mirror
+static void carve_to_mirror(MapData* map, const int* comp, int label) {
+    int w = map->width;
+    int h = map->height;
+    int start = -1, best_dist = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int dist = abs(2 * x - (w - 1)) + abs(2 * y - (h - 1));
+            if (comp[map_index(map, x, y)] == label && (start < 0 || dist < best_dist)) {
+                start = map_index(map, x, y);
+                best_dist = dist;
+            }
+        }
+    }
+
+    int x = TILE_X(map, start), y = TILE_Y(map, start);
+    int end_x = w - 1 - x, end_y = h - 1 - y;
+    for (;;) {
+        map_set_tile(map, x, y, TILE_FLOOR);
+        map_set_tile(map, w - 1 - x, h - 1 - y, TILE_FLOOR);
+        if (x != end_x) {
+            x += x < end_x ? 1 : -1;
+        } else if (y != end_y) {
+            y += y < end_y ? 1 : -1;
+        } else {
+            break;
+        }
+    }
+}
+
+// Remove and return a random entry of the candidate list, or -1 if empty
+static int take_candidate(int* candidates, int* count, uint32_t* rng) {
+    if (*count == 0) {
+        return -1;
+    }
+    int k = (int)(mapgen_next(rng) % (uint32_t)*count);
+    int i = candidates[k];
+    candidates[k] = candidates[--*count];
+    return i;
+}
+
+static bool generate_once(MapData* map, const MapGenParams* params, uint32_t* rng,
+                          MapGenScratch* scratch) {
+    int w = map->width;
+    int h = map->height;
+
+    // Tiles: roll the first half in row-major order and mirror it. The
+    // center tile of an odd-sized map mirrors onto itself.
+    int half = (w * h + 1) / 2;
+    for (int k = 0, x = 0, y = 0; k < half; k++) {
+        float r = mapgen_unit(rng);
+        uint8_t tile = TILE_FLOOR;
+        if (r < params->void_density) {
+            tile = TILE_VOID;
+        } else if (r < params->void_density + params->wall_density) {
+            tile = TILE_WALL;
+        }
+        map_set_tile(map, x, y, (TileType)tile);
+        map_set_tile(map, w - 1 - x, h - 1 - y, (TileType)tile);
+        if (++x == w) {
+            x = 0;
+            y++;
+        }
+    }
+
+    // Keep only the main floor region and wall off the rest, so
+    // reachability holds by construction and nobody respawns in a sealed
+    // pocket. Near the percolation threshold the biggest region is often
+    // split from its mirror image; those two get joined first.
+    int* comp = scratch->comp;
+    int largest;
+    int main_comp = label_components(map, comp, scratch->queue, &largest);
+    if (largest >= 0 && largest != main_comp) {
+        carve_to_mirror(map, comp, largest);
+        main_comp = label_components(map, comp, scratch->queue, &largest);
+    }
+    int* candidates = scratch->candidates;
+    int num_candidates = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int i = map_index(map, x, y);
+            if (comp[i] >= 0 && comp[i] != main_comp) {
+                map->tiles[i] = TILE_WALL;
+            }
+            // Spawns and crystals come in mirrored pairs, so candidates
+            // are first-half tiles (excluding the center)
+            int linear = y * w + x;
+            if (comp[i] == main_comp && main_comp >= 0 && linear < w * h - 1 - linear) {
+                candidates[num_candidates++] = i;
+            }
+        }
+    }
+
+    // Spawn pairs: a candidate that has line of fire to its mirror or to
+    // an earlier spawn is dropped, since those spawns stay
+    map->num_spawn_points = 0;
+    while (map->num_spawn_points + 1 < params->num_spawns) {
+        int i = take_candidate(candidates, &num_candidates, rng);
+        if (i < 0) {
+            return false;
+        }
+        int mirror = mirror_index(map, i);
+        Position a = {TILE_X(map, i), TILE_Y(map, i)};
+        Position b = {TILE_X(map, mirror), TILE_Y(map, mirror)};
+        bool exposed = in_line_of_fire(map, a, b);
+        for (int k = 0; k < map->num_spawn_points && !exposed; k++) {
+            Position other = map->spawn_points[k].pos;
+            exposed = in_line_of_fire(map, a, other) || in_line_of_fire(map, b, other);
+        }
+        if (!exposed) {
+            map->spawn_points[map->num_spawn_points++].pos = a;
+            map->spawn_points[map->num_spawn_points++].pos = b;
+        }
+    }
+
+    map->num_crystals = 0;
+    while (map->num_crystals + 1 < params->num_crystals) {
+        int i = take_candidate(candidates, &num_candidates, rng);
+        if (i < 0) {
+            return false;
+        }
+        int mirror = mirror_index(map, i);
+        map->crystals[map->num_crystals++] = (Position){TILE_X(map, i), TILE_Y(map, i)};
+        map->crystals[map->num_crystals++] = (Position){TILE_X(map, mirror), TILE_Y(map, mirror)};
+    }
+
+    map_data_build_tables(map);
+    return true;
+}
+
+MapData* mapgen_generate(const MapGenParams* params) {
+    if (params->width < 2 || params->width > MAX_ARENA_WIDTH ||
+        params->height < 1 || params->height > MAX_ARENA_HEIGHT ||
+        params->wall_density < 0.0f || params->void_density < 0.0f ||
+        params->wall_density + params->void_density >= 1.0f ||
+        params->num_spawns < 2 || params->num_spawns > MAX_SPAWN_POINTS ||
+        params->num_crystals < 0 || params->num_crystals > MAX_CRYSTALS) {
+        return NULL;
+    }
+
+    MapData* map = map_data_create(params->width, params->height);
+    if (!map) {
+        return NULL;
+    }
+
+    size_t tiles = (size_t)map->height * (size_t)map->stride;
+    MapGenScratch scratch = {
+        .comp = malloc(tiles * sizeof(int)),
+        .queue = malloc(tiles * sizeof(int)),
+        .candidates = malloc(tiles * sizeof(int)),
+    };
+    bool ok = scratch.comp && scratch.queue && scratch.candidates;
+
+    // Mix the seed so nearby seeds give unrelated maps (xorshift needs a
+    // nonzero state)
+    uint32_t rng = params->seed * 2654435761u ^ 0x9E3779B9u;
+    if (rng == 0) {
+        rng = 1;
+    }
+
+    bool found = false;
+    for (int attempt = 0; ok && !found && attempt < MAPGEN_MAX_ATTEMPTS; attempt++) {
+        // Placement guarantees the rules; validating is a cheap backstop
+        found = generate_once(map, params, &rng, &scratch) && mapgen_validate(map);
+    }
+
+    free(scratch.comp);
+    free(scratch.queue);
+    free(scratch.candidates);
+    if (!found) {
+        map_data_release(map);
+        return NULL;
+    }
+    return map;
+}
+
+// =============================================================================
+// Validation
+// =============================================================================
+
+bool mapgen_validate(const MapData* map) {
+    if (map->num_spawn_points < 1) {
+        return false;
+    }
+
+    // The map's BFS distance fields answer reachability directly (tiles
+    // that are not floor are never reachable)
+    for (int i = 0; i < map->num_spawn_points; i++) {
+        for (int j = 0; j < map->num_crystals; j++) {
+            Position c = map->crystals[j];
+            if (map_spawn_distance(map, i)[map_index(map, c.x, c.y)] == MAP_DISTANCE_UNREACHABLE) {
+                return false;
+            }
+        }
+        Position p = map->spawn_points[i].pos;
+        if (map_spawn_distance(map, 0)[map_index(map, p.x, p.y)] == MAP_DISTANCE_UNREACHABLE) {
+            return false;
+        }
+    }
+
+    // No spawn may be able to shoot another on the first tick
+    for (int i = 0; i < map->num_spawn_points; i++) {
+        for (int j = i + 1; j < map->num_spawn_points; j++) {
+            if (in_line_of_fire(map, map->spawn_points[i].pos, map->spawn_points[j].pos)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_MAPGEN_H
+#define ARENA_MAPGEN_H
+
+#include "types.h"
+
+// =============================================================================
+// Procedural arena generation
+//
+// Maps are point-symmetric (rotated 180 degrees about the center), so both
+// seats get the same layout. Walls and void are scattered over one half
+// and mirrored, crystals and spawns are placed in mirrored pairs, and every
+// candidate is validated before it is accepted:
+//   - every spawn reaches every crystal (and the other spawns)
+//   - no two spawns have line of sight to each other
+// Generation is deterministic for a given seed and does not touch the
+// game's respawn RNG.
+// =============================================================================
+
+#define MAPGEN_MAX_ATTEMPTS 64
+
+typedef struct {
+    unsigned int seed;
+    int width;            // 1..MAX_ARENA_WIDTH
+    int height;           // 1..MAX_ARENA_HEIGHT
+    float wall_density;   // fraction of tiles that become walls
+    float void_density;   // fraction of tiles that become void
+    int num_crystals;     // rounded down to an even number, <= MAX_CRYSTALS
+    int num_spawns;       // rounded down to an even number, <= MAX_SPAWN_POINTS
+} MapGenParams;
+
+// Defaults: 15x15, 15% walls, 10% void, 2 crystals, 2 spawns
+void mapgen_default_params(MapGenParams* params, unsigned int seed);
+
+// Generate a validated map. Returns a new MapData (refcount 1), or NULL if
+// the parameters are invalid or no valid map was found in
+// MAPGEN_MAX_ATTEMPTS tries.
+MapData* mapgen_generate(const MapGenParams* params);
+
+// Check the connectivity and spawn line-of-sight rules on any map with
+// built tables
+bool mapgen_validate(const MapData* map);
+
+#endif // ARENA_MAPGEN_H
@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "mappack.h"
+#include "map.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t align_up(uint64_t value) {
+    return (value + MAP_PACK_ALIGN - 1) & ~(uint64_t)(MAP_PACK_ALIGN - 1);
+}
+
+bool map_pack_open(MapPack* pack, const char* path) {
+    memset(pack, 0, sizeof(*pack));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MapPackHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const MapPackHeader* header = (const MapPackHeader*)base;
+    size_t table_end = sizeof(MapPackHeader) + sizeof(MapPackEntry) * (size_t)header->num_maps;
+    bool ok = header->magic == MAP_PACK_MAGIC &&
+              header->version == MAP_PACK_VERSION &&
+              header->map_data_size == sizeof(MapData) &&
+              table_end <= size;
+
+    const MapPackEntry* entries = (const MapPackEntry*)(header + 1);
+    // Records are used in place, so check each one's layout up front
+    for (uint32_t i = 0; ok && i < header->num_maps; i++) {
+        ok = entries[i].size >= sizeof(MapData) &&
+             entries[i].offset % MAP_PACK_ALIGN == 0 &&
+             entries[i].offset <= size &&
+             entries[i].size <= size - entries[i].offset &&
+             map_data_validate_blob(
+                 (const MapData*)((const unsigned char*)base + entries[i].offset),
+                 (size_t)entries[i].size);
+    }
+
+    if (!ok) {
+        munmap(base, size);
+        return false;
+    }
+
+    pack->base = (const unsigned char*)base;
+    pack->size = size;
+    pack->num_maps = (int)header->num_maps;
+    pack->entries = entries;
+    return true;
+}
+
+void map_pack_close(MapPack* pack) {
+    if (pack->base) {
+        munmap((void*)pack->base, pack->size);
+    }
+    memset(pack, 0, sizeof(*pack));
+}
+
+const MapData* map_pack_get(const MapPack* pack, int index) {
+    if (index < 0 || index >= pack->num_maps) {
+        return NULL;
+    }
+    return (const MapData*)(pack->base + pack->entries[index].offset);
+}
+
+int map_pack_find(const MapPack* pack, const char* name) {
+    for (int i = 0; i < pack->num_maps; i++) {
+        if (strncmp(pack->entries[i].name, name, MAP_PACK_NAME_MAX) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool map_pack_write(const char* path, const MapData* const* maps,
+                    const char* const* names, int num_maps) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+
+    MapPackHeader header = {
+        .magic = MAP_PACK_MAGIC,
+        .version = MAP_PACK_VERSION,
+        .map_data_size = sizeof(MapData),
+        .num_maps = (uint32_t)num_maps
+    };
+
+    MapPackEntry* entries = calloc((size_t)num_maps + 1, sizeof(MapPackEntry));
+    if (!entries) {
+        fclose(f);
+        return false;
+    }
+
+    uint64_t offset = align_up(sizeof(MapPackHeader) + sizeof(MapPackEntry) * (uint64_t)num_maps);
+    for (int i = 0; i < num_maps; i++) {
+        entries[i].offset = offset;
+        entries[i].size = map_data_size(maps[i]);
+        snprintf(entries[i].name, MAP_PACK_NAME_MAX, "%s", names[i]);
+        offset = align_up(offset + entries[i].size);
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (num_maps == 0 ||
+               fwrite(entries, sizeof(MapPackEntry), (size_t)num_maps, f) == (size_t)num_maps);
+
+    static const unsigned char zeros[MAP_PACK_ALIGN] = {0};
+    for (int i = 0; ok && i < num_maps; i++) {
+        long pos = ftell(f);
+        ok = pos >= 0 && (uint64_t)pos <= entries[i].offset &&
+             fwrite(zeros, 1, entries[i].offset - (uint64_t)pos, f) == entries[i].offset - (uint64_t)pos;
+
+        // Pack maps live in read-only memory and are never refcounted
+        MapData* record = map_data_alloc_blob(entries[i].size);
+        ok = ok && record != NULL;
+        if (ok) {
+            memcpy(record, maps[i], entries[i].size);
+            record->refcount = MAP_DATA_STATIC;
+            ok = fwrite(record, entries[i].size, 1, f) == 1;
+        }
+        free(record);
+    }
+
+    free(entries);
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,63 @@
+#ifndef ARENA_MAPPACK_H
+#define ARENA_MAPPACK_H
+
+#include <stddef.h>
+#include "types.h"
+
+// =============================================================================
+// Precompiled map packs
+//
+// A pack is one versioned binary file holding fully built MapData records
+// (tiles, crystals, spawns and every derived table), produced offline by
+// tools/mapc.c. The library mmaps the pack read-only and hands out pointers
+// straight into the mapping, so initializing an env from a pack is O(1):
+// no parsing and no table building.
+//
+// Layout: MapPackHeader, num_maps MapPackEntry records, then the MapData
+// records at MAP_PACK_ALIGN-aligned offsets. Records are only valid for
+// the same MapData layout, which the header records and checks.
+// =============================================================================
+
+#define MAP_PACK_MAGIC    0x4b504d41u  // "AMPK"
+#define MAP_PACK_VERSION  3
+#define MAP_PACK_ALIGN    MAP_ROW_ALIGN
+#define MAP_PACK_NAME_MAX 48
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t map_data_size;   // sizeof(MapData) the pack was built with
+    uint32_t num_maps;
+} MapPackHeader;
+
+typedef struct {
+    uint64_t offset;          // from the start of the file
+    uint64_t size;
+    char name[MAP_PACK_NAME_MAX];
+} MapPackEntry;
+
+typedef struct {
+    const unsigned char* base;
+    size_t size;
+    int num_maps;
+    const MapPackEntry* entries;
+} MapPack;
+
+// Map a pack file. Returns false if it is missing, truncated, built for
+// a different version / MapData layout, or holds a record that fails
+// map_data_validate_blob.
+bool map_pack_open(MapPack* pack, const char* path);
+void map_pack_close(MapPack* pack);
+
+// Map by index (NULL if out of range). Pack maps are MAP_DATA_STATIC and
+// stay valid until map_pack_close.
+const MapData* map_pack_get(const MapPack* pack, int index);
+
+// Index of the map with the given name, or -1
+int map_pack_find(const MapPack* pack, const char* name);
+
+// Write maps into a new pack file. Returns false on I/O error.
+bool map_pack_write(const char* path, const MapData* const* maps,
+                    const char* const* names, int num_maps);
+
+#endif // ARENA_MAPPACK_H
@@ -0,0 +1,627 @@
+#include "observation.h"
+#include "arena.h"
+#include "map.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int observation_num_channels(unsigned flags) {
+    int channels = OBS_NUM_BASE_CHANNELS;
+    if (flags & OBS_FLAG_CRYSTAL_DISTANCE) {
+        channels++;
+    }
+    return channels;
+}
+
+bool observation_is_mirrored(int player_idx, unsigned flags) {
+    return (flags & OBS_FLAG_MIRROR_SEAT1) && player_idx == 1;
+}
+
+ActionType observation_world_action(int player_idx, unsigned flags, ActionType action) {
+    if (!observation_is_mirrored(player_idx, flags) || (unsigned)action > ACTION_RIGHT) {
+        return action;
+    }
+    // A half turn is its own inverse
+    return (ActionType)observation_dihedral_actions[OBS_DIHEDRAL_ROT180][action];
+}
+
+// =============================================================================
+// Dihedral transforms
+// =============================================================================
+
+// Indexed [t][NOOP, UP, DOWN, LEFT, RIGHT]; a clockwise quarter turn
+// takes up to right, and the flip swaps left and right
+const uint8_t observation_dihedral_actions[OBS_NUM_DIHEDRAL][5] = {
+    {ACTION_NOOP, ACTION_UP, ACTION_DOWN, ACTION_LEFT, ACTION_RIGHT},
+    {ACTION_NOOP, ACTION_RIGHT, ACTION_LEFT, ACTION_UP, ACTION_DOWN},
+    {ACTION_NOOP, ACTION_DOWN, ACTION_UP, ACTION_RIGHT, ACTION_LEFT},
+    {ACTION_NOOP, ACTION_LEFT, ACTION_RIGHT, ACTION_DOWN, ACTION_UP},
+    {ACTION_NOOP, ACTION_UP, ACTION_DOWN, ACTION_RIGHT, ACTION_LEFT},
+    {ACTION_NOOP, ACTION_RIGHT, ACTION_LEFT, ACTION_DOWN, ACTION_UP},
+    {ACTION_NOOP, ACTION_DOWN, ACTION_UP, ACTION_LEFT, ACTION_RIGHT},
+    {ACTION_NOOP, ACTION_LEFT, ACTION_RIGHT, ACTION_UP, ACTION_DOWN},
+};
+
+int observation_dihedral_inverse(int t) {
+    // Reflections and the half turn undo themselves
+    return t == 1 ? 3 : t == 3 ? 1 : t;
+}
+
+// Where (x, y) of a w x h grid lands under t, in a grid that is w x h
+// for even t and h x w for odd t
+static void dihedral_point(int t, int w, int h, int x, int y, int* out_x, int* out_y) {
+    if (t & 4) {
+        x = w - 1 - x;
+    }
+    for (int r = 0; r < (t & 3); r++) {
+        int turned_x = h - 1 - y;
+        y = x;
+        x = turned_x;
+        int swap = w;
+        w = h;
+        h = swap;
+    }
+    *out_x = x;
+    *out_y = y;
+}
+
+void observation_transform(const float* src, int width, int height, unsigned flags, int t,
+                           float* out) {
+    int plane_size = width * height;
+    int num_channels = observation_num_channels(flags);
+    if (t == OBS_DIHEDRAL_IDENTITY) {
+        memcpy(out, src, sizeof(float) * ((size_t)num_channels * (size_t)plane_size + OBS_NUM_SCALARS));
+        return;
+    }
+    int out_width = (t & 1) ? height : width;
+
+    // The map is affine: out index = base + x * step_x + y * step_y
+    int x0, y0, x1, y1, x2, y2;
+    dihedral_point(t, width, height, 0, 0, &x0, &y0);
+    dihedral_point(t, width, height, 1, 0, &x1, &y1);
+    dihedral_point(t, width, height, 0, 1, &x2, &y2);
+    int base = y0 * out_width + x0;
+    int step_x = (y1 * out_width + x1) - base;
+    int step_y = (y2 * out_width + x2) - base;
+
+    for (int c = 0; c < num_channels; c++) {
+        const float* plane = src + (size_t)c * (size_t)plane_size;
+        float* dst = out + (size_t)c * (size_t)plane_size + base;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                dst[x * step_x + y * step_y] = plane[y * width + x];
+            }
+        }
+    }
+    memcpy(out + (size_t)num_channels * (size_t)plane_size,
+           src + (size_t)num_channels * (size_t)plane_size, sizeof(float) * OBS_NUM_SCALARS);
+}
+
+// A 180 degree turn of a row-major plane is the plane reversed
+static void rotate_planes_180(float* planes, int num_planes, int plane_size) {
+    for (int c = 0; c < num_planes; c++) {
+        float* plane = planes + (size_t)c * (size_t)plane_size;
+        for (int i = 0, j = plane_size - 1; i < j; i++, j--) {
+            float t = plane[i];
+            plane[i] = plane[j];
+            plane[j] = t;
+        }
+    }
+}
+
+int observation_size(const GameState* state, unsigned flags) {
+    const MapData* map = state->arena.map;
+    return observation_num_channels(flags) * map->width * map->height + OBS_NUM_SCALARS;
+}
+
+static void write_player_scalars(const Player* p, float* out) {
+    out[0] = (float)p->health / MAX_HEALTH;
+    out[1] = (float)p->energy / MAX_ENERGY;
+    out[2] = (float)p->laser_cooldown_ticks / LASER_COOLDOWN_TICKS;
+    out[3] = (float)p->move_cooldown_ticks / MOVEMENT_COOLDOWN_TICKS;
+}
+
+// With more than two players the "opponent" scalars are the next seat's
+static void write_scalars(const GameState* state, int player_idx, float* scalars) {
+    write_player_scalars(&state->players[player_idx], scalars);
+    if (state->num_players > 1) {
+        write_player_scalars(&state->players[(player_idx + 1) % state->num_players], scalars + 4);
+    } else {
+        memset(scalars + 4, 0, sizeof(float) * 4);
+    }
+}
+
+// One-hot a row of n tiles into three float planes (0 or 1 each)
+static void write_tile_row(const uint8_t* tiles, int n, float* walls, float* voids,
+                           float* floors) {
+    int x = 0;
+#ifdef __SSE2__
+    // Widen 4 tiles to 32-bit lanes, compare, and keep 1.0f where equal
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wall = _mm_set1_epi32(TILE_WALL);
+    const __m128i vd = _mm_set1_epi32(TILE_VOID);
+    const __m128i flr = _mm_set1_epi32(TILE_FLOOR);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; x + 4 <= n; x += 4) {
+        int32_t packed;
+        memcpy(&packed, tiles + x, sizeof(packed));
+        __m128i t = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        _mm_storeu_ps(walls + x, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, wall)), one));
+        _mm_storeu_ps(voids + x, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, vd)), one));
+        _mm_storeu_ps(floors + x, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, flr)), one));
+    }
+#endif
+    for (; x < n; x++) {
+        walls[x] = tiles[x] == TILE_WALL ? 1.0f : 0.0f;
+        voids[x] = tiles[x] == TILE_VOID ? 1.0f : 0.0f;
+        floors[x] = tiles[x] == TILE_FLOOR ? 1.0f : 0.0f;
+    }
+}
+
+// Min over available crystals' distance fields
+static void write_crystal_distance(const GameState* state, float* plane) {
+    const MapData* map = state->arena.map;
+    int w = map->width;
+    int h = map->height;
+    float scale = 1.0f / (float)(w + h);
+
+    const uint16_t* available[MAX_CRYSTALS];
+    int num_available = 0;
+    for (int i = 0; i < map->num_crystals; i++) {
+        if (arena_crystal_available(&state->arena, i)) {
+            available[num_available++] = map_crystal_distance(map, i);
+        }
+    }
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int best = MAP_DISTANCE_UNREACHABLE;
+            for (int k = 0; k < num_available; k++) {
+                int d = available[k][map_index(map, x, y)];
+                if (d < best) best = d;
+            }
+            float v = (float)best * scale;
+            plane[y * w + x] = v < 1.0f ? v : 1.0f;
+        }
+    }
+}
+
+void observation_write(const GameState* state, int player_idx, unsigned flags, float* out) {
+    const MapData* map = state->arena.map;
+    int w = map->width;
+    int h = map->height;
+    int plane_size = w * h;
+    int num_channels = observation_num_channels(flags);
+
+    memset(out, 0, sizeof(float) * (size_t)(num_channels * plane_size));
+
+    float* walls = out + OBS_CHANNEL_WALL * plane_size;
+    float* voids = out + OBS_CHANNEL_VOID * plane_size;
+    float* floors = out + OBS_CHANNEL_FLOOR * plane_size;
+    for (int y = 0; y < h; y++) {
+        write_tile_row(&map->tiles[map_index(map, 0, y)], w,
+                       walls + y * w, voids + y * w, floors + y * w);
+    }
+
+    float* available = out + OBS_CHANNEL_CRYSTAL_AVAILABLE * plane_size;
+    float* cooldown = out + OBS_CHANNEL_CRYSTAL_COOLDOWN * plane_size;
+    for (int i = 0; i < map->num_crystals; i++) {
+        Position pos = map->crystals[i];
+        int remaining = state->arena.crystal_cooldowns[i];
+        if (remaining == 0) {
+            available[pos.y * w + pos.x] = 1.0f;
+        } else {
+            cooldown[pos.y * w + pos.x] = (float)remaining / CRYSTAL_RESPAWN_TICKS;
+        }
+    }
+
+    float* self = out + OBS_CHANNEL_SELF * plane_size;
+    float* opponents = out + OBS_CHANNEL_OPPONENT * plane_size;
+    for (int i = 0; i < state->num_players; i++) {
+        const Player* p = &state->players[i];
+        if (!p->alive || !arena_is_valid_position(&state->arena, p->pos.x, p->pos.y)) {
+            continue;
+        }
+        float* plane = i == player_idx ? self : opponents;
+        plane[p->pos.y * w + p->pos.x] = 1.0f;
+    }
+
+    int channel = OBS_NUM_BASE_CHANNELS;
+    if (flags & OBS_FLAG_CRYSTAL_DISTANCE) {
+        write_crystal_distance(state, out + channel * plane_size);
+        channel++;
+    }
+
+    if (observation_is_mirrored(player_idx, flags)) {
+        rotate_planes_180(out, num_channels, plane_size);
+    }
+
+    write_scalars(state, player_idx, out + num_channels * plane_size);
+}
+
+// =============================================================================
+// Incremental observations
+// =============================================================================
+
+// Plane index of a world cell in player_idx's observation
+static int observed_cell(const MapData* map, int player_idx, unsigned flags, int x, int y) {
+    int cell = y * map->width + x;
+    return observation_is_mirrored(player_idx, flags) ? map->width * map->height - 1 - cell : cell;
+}
+
+static int player_cell(const GameState* state, int i, int player_idx, unsigned flags) {
+    const Player* p = &state->players[i];
+    if (!p->alive || !arena_is_valid_position(&state->arena, p->pos.x, p->pos.y)) {
+        return -1;
+    }
+    return observed_cell(state->arena.map, player_idx, flags, p->pos.x, p->pos.y);
+}
+
+static void cache_record(ObsCache* cache, const GameState* state, int player_idx, unsigned flags) {
+    if (cache->map != state->arena.map) {
+        map_data_retain(state->arena.map);
+        map_data_release(cache->map);
+        cache->map = state->arena.map;
+    }
+    cache->player_idx = player_idx;
+    cache->flags = flags;
+    cache->num_players = state->num_players;
+    for (int i = 0; i < state->num_players; i++) {
+        cache->player_cells[i] = player_cell(state, i, player_idx, flags);
+    }
+    memcpy(cache->crystal_cooldowns, state->arena.crystal_cooldowns,
+           sizeof(cache->crystal_cooldowns));
+}
+
+void observation_cache_release(ObsCache* cache) {
+    map_data_release(cache->map);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void observation_update(ObsCache* cache, const GameState* state, int player_idx, unsigned flags,
+                        float* out) {
+    const MapData* map = state->arena.map;
+    if (cache->map != map || cache->player_idx != player_idx || cache->flags != flags ||
+        cache->num_players != state->num_players) {
+        observation_write(state, player_idx, flags, out);
+        cache_record(cache, state, player_idx, flags);
+        return;
+    }
+
+    int plane_size = map->width * map->height;
+    int num_channels = observation_num_channels(flags);
+
+    // Clear every moved player before drawing any, so one player stepping
+    // onto a cell another just left is drawn, not erased
+    float* self = out + OBS_CHANNEL_SELF * plane_size;
+    float* opponents = out + OBS_CHANNEL_OPPONENT * plane_size;
+    int cells[MAX_PLAYERS];
+    for (int i = 0; i < state->num_players; i++) {
+        cells[i] = player_cell(state, i, player_idx, flags);
+        if (cells[i] != cache->player_cells[i] && cache->player_cells[i] >= 0) {
+            (i == player_idx ? self : opponents)[cache->player_cells[i]] = 0.0f;
+        }
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        if (cells[i] != cache->player_cells[i] && cells[i] >= 0) {
+            (i == player_idx ? self : opponents)[cells[i]] = 1.0f;
+        }
+        cache->player_cells[i] = cells[i];
+    }
+
+    float* available = out + OBS_CHANNEL_CRYSTAL_AVAILABLE * plane_size;
+    float* cooldown = out + OBS_CHANNEL_CRYSTAL_COOLDOWN * plane_size;
+    bool availability_changed = false;
+    for (int i = 0; i < map->num_crystals; i++) {
+        int remaining = state->arena.crystal_cooldowns[i];
+        int before = cache->crystal_cooldowns[i];
+        if (remaining == before) {
+            continue;
+        }
+        availability_changed |= (remaining == 0) != (before == 0);
+        int cell = observed_cell(map, player_idx, flags, map->crystals[i].x, map->crystals[i].y);
+        available[cell] = remaining == 0 ? 1.0f : 0.0f;
+        cooldown[cell] = (float)remaining / CRYSTAL_RESPAWN_TICKS;
+        cache->crystal_cooldowns[i] = remaining;
+    }
+
+    if ((flags & OBS_FLAG_CRYSTAL_DISTANCE) && availability_changed) {
+        float* distance = out + OBS_CHANNEL_CRYSTAL_DISTANCE * plane_size;
+        write_crystal_distance(state, distance);
+        if (observation_is_mirrored(player_idx, flags)) {
+            rotate_planes_180(distance, 1, plane_size);
+        }
+    }
+
+    write_scalars(state, player_idx, out + num_channels * plane_size);
+}
+
+// =============================================================================
+// Packed observations
+// =============================================================================
+
+static bool channel_is_binary(int channel) {
+    return channel < OBS_NUM_BASE_CHANNELS && channel != OBS_CHANNEL_CRYSTAL_COOLDOWN;
+}
+
+static bool channel_is_bits(int channel, ObsPacking packing) {
+    return packing == OBS_PACK_BITS && channel_is_binary(channel);
+}
+
+static int packed_plane_bytes(int channel, int plane_size, ObsPacking packing) {
+    return channel_is_bits(channel, packing) ? (plane_size + 7) / 8 : plane_size;
+}
+
+int observation_packed_size(int width, int height, unsigned flags, ObsPacking packing) {
+    int size = 0;
+    for (int c = 0; c < observation_num_channels(flags); c++) {
+        size += packed_plane_bytes(c, width * height, packing);
+    }
+    return size + (int)sizeof(float) * OBS_NUM_SCALARS;
+}
+
+void observation_pack(const float* obs, int width, int height, unsigned flags,
+                      ObsPacking packing, uint8_t* out) {
+    int plane_size = width * height;
+    int num_channels = observation_num_channels(flags);
+    for (int c = 0; c < num_channels; c++) {
+        const float* plane = obs + (size_t)c * (size_t)plane_size;
+        int bytes = packed_plane_bytes(c, plane_size, packing);
+        if (!channel_is_bits(c, packing)) {
+            for (int i = 0; i < plane_size; i++) {
+                float v = plane[i] * 255.0f + 0.5f;
+                out[i] = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (uint8_t)v;
+            }
+        } else {
+            memset(out, 0, (size_t)bytes);
+            for (int i = 0; i < plane_size; i++) {
+                out[i >> 3] |= (uint8_t)((plane[i] != 0.0f) << (i & 7));
+            }
+        }
+        out += bytes;
+    }
+    memcpy(out, obs + (size_t)num_channels * (size_t)plane_size, sizeof(float) * OBS_NUM_SCALARS);
+}
+
+// Expand n bits into n floats of 0 or 1
+static void unpack_bits(const uint8_t* bits, int n, float* out) {
+    int i = 0;
+#ifdef __SSE2__
+    // Broadcast a byte, keep one bit per lane, and turn set lanes into 1.0f
+    const __m128i low_bits = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i high_bits = _mm_setr_epi32(16, 32, 64, 128);
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 8 <= n; i += 8) {
+        __m128i b = _mm_set1_epi32(bits[i >> 3]);
+        __m128i lo = _mm_cmpeq_epi32(_mm_and_si128(b, low_bits), low_bits);
+        __m128i hi = _mm_cmpeq_epi32(_mm_and_si128(b, high_bits), high_bits);
+        _mm_storeu_ps(out + i, _mm_and_ps(_mm_castsi128_ps(lo), one));
+        _mm_storeu_ps(out + i + 4, _mm_and_ps(_mm_castsi128_ps(hi), one));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (bits[i >> 3] >> (i & 7)) & 1 ? 1.0f : 0.0f;
+    }
+}
+
+static void unpack_bytes(const uint8_t* bytes, int n, float* out) {
+    const float scale = 1.0f / 255.0f;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(bytes + i));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), vscale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), vscale));
+        _mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), vscale));
+        _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), vscale));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (float)bytes[i] * scale;
+    }
+}
+
+void observation_unpack(const uint8_t* packed, int count, int width, int height, unsigned flags,
+                        ObsPacking packing, float* out) {
+    int plane_size = width * height;
+    int num_channels = observation_num_channels(flags);
+    for (int n = 0; n < count; n++) {
+        for (int c = 0; c < num_channels; c++) {
+            if (channel_is_bits(c, packing)) {
+                unpack_bits(packed, plane_size, out);
+            } else {
+                unpack_bytes(packed, plane_size, out);
+            }
+            packed += packed_plane_bytes(c, plane_size, packing);
+            out += plane_size;
+        }
+        memcpy(out, packed, sizeof(float) * OBS_NUM_SCALARS);
+        packed += sizeof(float) * OBS_NUM_SCALARS;
+        out += OBS_NUM_SCALARS;
+    }
+}
+
+// =============================================================================
+// Egocentric crops
+// =============================================================================
+
+int observation_crop_size(int k, unsigned flags) {
+    return observation_num_channels(flags) * k * k + OBS_NUM_SCALARS;
+}
+
+// Crop offset (u, v) from the center maps to world offset (dx, dy) by the
+// rotation that turns "up" into the player's facing. to_crop inverts it.
+static Direction crop_facing(const Player* p, unsigned flags) {
+    if (!(flags & OBS_FLAG_ROTATE_TO_FACING) || p->facing == DIR_NONE) {
+        return DIR_UP;
+    }
+    return p->facing;
+}
+
+static void to_world(Direction facing, int u, int v, int* dx, int* dy) {
+    switch (facing) {
+        case DIR_DOWN:  *dx = -u; *dy = -v; break;
+        case DIR_RIGHT: *dx = -v; *dy = u;  break;
+        case DIR_LEFT:  *dx = v;  *dy = -u; break;
+        default:        *dx = u;  *dy = v;  break;
+    }
+}
+
+static void to_crop(Direction facing, int dx, int dy, int* u, int* v) {
+    switch (facing) {
+        case DIR_DOWN:  *u = -dx; *v = -dy; break;
+        case DIR_RIGHT: *u = dy;  *v = -dx; break;
+        case DIR_LEFT:  *u = -dy; *v = dx;  break;
+        default:        *u = dx;  *v = dy;  break;
+    }
+}
+
+// Unrotated crops read whole map row segments; everything off the map is
+// void
+static void write_crop_tiles_upright(const MapData* map, Position center, int k,
+                                     float* walls, float* voids, float* floors) {
+    int half = k / 2;
+    int wx0 = center.x - half;
+    int lo = wx0 < 0 ? -wx0 : 0;  // first crop column on the map
+    int hi = map->width - wx0;    // one past the last
+    if (hi > k) hi = k;
+
+    for (int cy = 0; cy < k; cy++) {
+        int wy = center.y - half + cy;
+        float* row_voids = voids + cy * k;
+        if (wy < 0 || wy >= map->height || lo >= hi) {
+            for (int cx = 0; cx < k; cx++) row_voids[cx] = 1.0f;
+            continue;
+        }
+        for (int cx = 0; cx < lo; cx++) row_voids[cx] = 1.0f;
+        for (int cx = hi; cx < k; cx++) row_voids[cx] = 1.0f;
+        write_tile_row(&map->tiles[map_index(map, wx0 + lo, wy)], hi - lo,
+                       walls + cy * k + lo, row_voids + lo, floors + cy * k + lo);
+    }
+}
+
+static void write_crop_tiles_rotated(const MapData* map, Position center, Direction facing, int k,
+                                     float* walls, float* voids, float* floors) {
+    int half = k / 2;
+    for (int cy = 0; cy < k; cy++) {
+        for (int cx = 0; cx < k; cx++) {
+            int dx, dy;
+            to_world(facing, cx - half, cy - half, &dx, &dy);
+            int i = cy * k + cx;
+            switch (map_get_tile(map, center.x + dx, center.y + dy)) {
+                case TILE_WALL:  walls[i] = 1.0f; break;
+                case TILE_VOID:  voids[i] = 1.0f; break;
+                case TILE_FLOOR: floors[i] = 1.0f; break;
+            }
+        }
+    }
+}
+
+// Crop cell index for a world position, or -1 if it falls outside
+static int crop_cell(Position center, Direction facing, int k, Position pos) {
+    int u, v;
+    to_crop(facing, pos.x - center.x, pos.y - center.y, &u, &v);
+    int cx = u + k / 2;
+    int cy = v + k / 2;
+    if (cx < 0 || cx >= k || cy < 0 || cy >= k) {
+        return -1;
+    }
+    return cy * k + cx;
+}
+
+void observation_write_crop(const GameState* state, int player_idx, int k, unsigned flags,
+                            float* out) {
+    const MapData* map = state->arena.map;
+    const Player* self = &state->players[player_idx];
+    Position center = self->pos;
+    Direction facing = crop_facing(self, flags);
+    int plane_size = k * k;
+    int num_channels = observation_num_channels(flags);
+
+    memset(out, 0, sizeof(float) * (size_t)(num_channels * plane_size));
+
+    float* walls = out + OBS_CHANNEL_WALL * plane_size;
+    float* voids = out + OBS_CHANNEL_VOID * plane_size;
+    float* floors = out + OBS_CHANNEL_FLOOR * plane_size;
+    if (facing == DIR_UP) {
+        write_crop_tiles_upright(map, center, k, walls, voids, floors);
+    } else {
+        write_crop_tiles_rotated(map, center, facing, k, walls, voids, floors);
+    }
+
+    float* available = out + OBS_CHANNEL_CRYSTAL_AVAILABLE * plane_size;
+    float* cooldown = out + OBS_CHANNEL_CRYSTAL_COOLDOWN * plane_size;
+    for (int i = 0; i < map->num_crystals; i++) {
+        int cell = crop_cell(center, facing, k, map->crystals[i]);
+        if (cell < 0) continue;
+        int remaining = state->arena.crystal_cooldowns[i];
+        if (remaining == 0) {
+            available[cell] = 1.0f;
+        } else {
+            cooldown[cell] = (float)remaining / CRYSTAL_RESPAWN_TICKS;
+        }
+    }
+
+    float* self_plane = out + OBS_CHANNEL_SELF * plane_size;
+    float* opponents = out + OBS_CHANNEL_OPPONENT * plane_size;
+    for (int i = 0; i < state->num_players; i++) {
+        const Player* p = &state->players[i];
+        if (!p->alive || !arena_is_valid_position(&state->arena, p->pos.x, p->pos.y)) {
+            continue;
+        }
+        int cell = crop_cell(center, facing, k, p->pos);
+        if (cell >= 0) {
+            (i == player_idx ? self_plane : opponents)[cell] = 1.0f;
+        }
+    }
+
+    int channel = OBS_NUM_BASE_CHANNELS;
+    if (flags & OBS_FLAG_CRYSTAL_DISTANCE) {
+        float* plane = out + channel * plane_size;
+        float scale = 1.0f / (float)(map->width + map->height);
+        const uint16_t* fields[MAX_CRYSTALS];
+        int num_fields = 0;
+        for (int i = 0; i < map->num_crystals; i++) {
+            if (arena_crystal_available(&state->arena, i)) {
+                fields[num_fields++] = map_crystal_distance(map, i);
+            }
+        }
+        int half = k / 2;
+        for (int cy = 0; cy < k; cy++) {
+            for (int cx = 0; cx < k; cx++) {
+                int dx, dy;
+                to_world(facing, cx - half, cy - half, &dx, &dy);
+                int x = center.x + dx, y = center.y + dy;
+                int best = MAP_DISTANCE_UNREACHABLE;
+                if (arena_is_valid_position(&state->arena, x, y)) {
+                    for (int f = 0; f < num_fields; f++) {
+                        int d = fields[f][map_index(map, x, y)];
+                        if (d < best) best = d;
+                    }
+                }
+                float v = (float)best * scale;
+                plane[cy * k + cx] = v < 1.0f ? v : 1.0f;
+            }
+        }
+        channel++;
+    }
+
+    if (observation_is_mirrored(player_idx, flags)) {
+        rotate_planes_180(out, num_channels, plane_size);
+    }
+
+    write_scalars(state, player_idx, out + num_channels * plane_size);
+}
+
+void observation_write_crop_batch(const GameState* states, int num_envs, int player_idx, int k,
+                                  unsigned flags, float* out) {
+    size_t stride = (size_t)observation_crop_size(k, flags);
+    for (int i = 0; i < num_envs; i++) {
+        observation_write_crop(&states[i], player_idx, k, flags, out + stride * (size_t)i);
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef ARENA_OBSERVATION_H
+#define ARENA_OBSERVATION_H
+
+#include "types.h"
+
+// =============================================================================
+// Observations
+//
+// Layout (float32): grid channels [C][height][width] over the map, followed
+// by OBS_NUM_SCALARS scalars. All values are normalized to 0-1.
+// =============================================================================
+
+typedef enum {
+    OBS_CHANNEL_WALL = 0,
+    OBS_CHANNEL_VOID,
+    OBS_CHANNEL_FLOOR,
+    OBS_CHANNEL_CRYSTAL_AVAILABLE,
+    OBS_CHANNEL_CRYSTAL_COOLDOWN,   // remaining cooldown / CRYSTAL_RESPAWN_TICKS
+    OBS_CHANNEL_SELF,
+    OBS_CHANNEL_OPPONENT,           // every other player
+    OBS_NUM_BASE_CHANNELS,
+
+    // Optional channels, appended in this order when their flag is set
+    OBS_CHANNEL_CRYSTAL_DISTANCE = OBS_NUM_BASE_CHANNELS
+} ObsChannel;
+
+// Shortest-path distance to the nearest available crystal, divided by
+// width + height and clamped to 1 (1 when none is reachable). Read from the
+// map's precomputed distance fields, no per-step BFS.
+#define OBS_FLAG_CRYSTAL_DISTANCE (1u << 0)
+
+// self health, energy, laser cooldown, move cooldown, then the same for
+// the opponent (the next seat, zeros in single-player games)
+#define OBS_NUM_SCALARS 8
+
+// Self-play canonicalization: player 1's grid channels are rotated 180
+// degrees, so on point-symmetric maps (arena_01) both seats see the board
+// from the same side and one policy can play either. Scalars are not
+// affected. Actions chosen from such an observation are in the rotated
+// frame; map them back with observation_world_action.
+#define OBS_FLAG_MIRROR_SEAT1 (1u << 2)
+
+int observation_num_channels(unsigned flags);
+
+// =============================================================================
+// Dihedral transforms
+//
+// The rules are invariant under the 8 symmetries of the square once
+// directions are remapped, so any observation can be augmented into 8.
+// Transform t flips the grid left-right when t & 4, then turns it
+// (t & 3) quarter turns clockwise. Odd quarter turns swap the grid's
+// width and height: a [C][h][w] observation becomes [C][w][h]. Scalars
+// are unchanged.
+// =============================================================================
+
+#define OBS_NUM_DIHEDRAL 8
+#define OBS_DIHEDRAL_IDENTITY 0
+#define OBS_DIHEDRAL_ROT180 2
+
+// observation_dihedral_actions[t][a] is world action a as seen in frame t
+extern const uint8_t observation_dihedral_actions[OBS_NUM_DIHEDRAL][5];
+
+// The transform undoing t
+int observation_dihedral_inverse(int t);
+
+// Transform an observation of a width x height grid (as written by
+// observation_write, or a crop with width = height = k) into out, which
+// must not overlap src
+void observation_transform(const float* src, int width, int height, unsigned flags, int t,
+                           float* out);
+
+// =============================================================================
+// Packed observations
+//
+// A byte format for moving observations cheaply, converted from and back
+// to the float layout. Channels keep their order; each is a plane of
+// width x height cells:
+//   OBS_PACK_U8:   one byte per cell, round(value * 255)
+//   OBS_PACK_BITS: binary channels (tiles, available crystals, players)
+//                  one bit per cell, least significant bit first, padded
+//                  to a whole byte; other channels as in OBS_PACK_U8
+// followed by the OBS_NUM_SCALARS scalars as native float32, unquantized.
+// Binary channels round-trip exactly; the others to within 1/510.
+// =============================================================================
+
+typedef enum {
+    OBS_PACK_U8 = 0,
+    OBS_PACK_BITS = 1
+} ObsPacking;
+
+// Bytes written by observation_pack
+int observation_packed_size(int width, int height, unsigned flags, ObsPacking packing);
+
+void observation_pack(const float* obs, int width, int height, unsigned flags,
+                      ObsPacking packing, uint8_t* out);
+
+// count packed observations, back to back, into count float observations
+void observation_unpack(const uint8_t* packed, int count, int width, int height, unsigned flags,
+                        ObsPacking packing, float* out);
+
+// Whether player_idx's observation is rotated under flags
+bool observation_is_mirrored(int player_idx, unsigned flags);
+
+// The world action for an action chosen in player_idx's observation frame
+ActionType observation_world_action(int player_idx, unsigned flags, ActionType action);
+
+// Number of floats written by observation_write
+int observation_size(const GameState* state, unsigned flags);
+
+// Write the observation from player_idx's point of view
+void observation_write(const GameState* state, int player_idx, unsigned flags, float* out);
+
+// =============================================================================
+// Incremental observations
+//
+// Walls, void and floor never change within an episode, and a step moves
+// only a few cells of the other channels. An ObsCache remembers what the
+// full-map observation in its buffer shows (the map, player cells and
+// crystal timers); observation_update compares that with the state and
+// rewrites only the cells that differ, plus the scalars. The distance
+// channel is recomputed only when a crystal becomes available or taken.
+// Anything else (another map, player or flags) falls back to a full
+// observation_write.
+//
+// A zeroed cache is empty. The buffer must not be modified between
+// updates except through the same cache. The cache holds a reference to
+// the map it last wrote, so that map's address can't be reused by
+// another map while the cache still names it; release it with
+// observation_cache_release.
+// =============================================================================
+
+typedef struct {
+    const MapData* map;  // held reference, NULL = empty
+    int player_idx;
+    unsigned flags;
+    int num_players;
+    int player_cells[MAX_PLAYERS];  // cell shown per player, -1 = none
+    int crystal_cooldowns[MAX_CRYSTALS];
+} ObsCache;
+
+// Bring out, last written through cache, up to date with state
+void observation_update(ObsCache* cache, const GameState* state, int player_idx, unsigned flags,
+                        float* out);
+
+// Drop the cache's map reference and empty it
+void observation_cache_release(ObsCache* cache);
+
+// =============================================================================
+// Egocentric crops
+//
+// A k x k window centered on the player (cell (k/2, k/2)), with the same
+// channels and scalars as the full observation: [C][k][k] then
+// OBS_NUM_SCALARS. Cost and size depend only on k, not on the map. Cells
+// outside the map read as void.
+// =============================================================================
+
+// Rotate the crop so the player's facing points up (toward row 0); the
+// player's right is then to the right of the crop
+#define OBS_FLAG_ROTATE_TO_FACING (1u << 1)
+
+// Number of floats written by observation_write_crop
+int observation_crop_size(int k, unsigned flags);
+
+void observation_write_crop(const GameState* state, int player_idx, int k, unsigned flags,
+                            float* out);
+
+// One crop per env for num_envs consecutive states, written back to back
+// (observation_crop_size floats apart)
+void observation_write_crop_batch(const GameState* states, int num_envs, int player_idx, int k,
+                                  unsigned flags, float* out);
+
+#endif // ARENA_OBSERVATION_H
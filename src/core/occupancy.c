@@ -0,0 +1,26 @@
+#include "occupancy.h"
+#include <string.h>
+
+void occupancy_rebuild(GameState* state) {
+    const MapData* map = state->arena.map;
+    memset(state->arena.occupancy, OCCUPANCY_EMPTY, (size_t)map->height * (size_t)map->stride);
+    occupancy_refresh(state);
+}
+
+void occupancy_refresh(GameState* state) {
+    for (int i = 0; i < state->num_players; i++) {
+        if (state->players[i].alive) {
+            occupancy_set(state, state->players[i].pos, i);
+        }
+    }
+}
+
+int occupancy_scan(const GameState* state, Position pos, int skip) {
+    for (int i = 0; i < state->num_players; i++) {
+        const Player* p = &state->players[i];
+        if (i != skip && p->alive && p->pos.x == pos.x && p->pos.y == pos.y) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,77 @@
+#ifndef ARENA_OCCUPANCY_H
+#define ARENA_OCCUPANCY_H
+
+#include "types.h"
+#include "map.h"
+
+// =============================================================================
+// Occupancy grid
+//
+// Arena.occupancy holds the index of the player standing on each tile, or
+// OCCUPANCY_EMPTY, laid out like the map's tables (map_index). game_step
+// keeps it in sync, so "who is on this tile" is one load instead of a
+// loop over the players.
+//
+// Simultaneous pushbacks can leave several players on one tile. The entry
+// then names the lowest-index one, which is who the per-player scans this
+// replaces found first: occupancy_set never overwrites a lower index, and
+// occupancy_clear hands the tile to whoever is still standing on it.
+//
+// Reads check the entry against the player it names, so an entry left
+// behind by code that moves players directly (tests, tools) is ignored
+// rather than trusted. game_step re-stamps every live player on entry,
+// which picks such moves up.
+// =============================================================================
+
+#define OCCUPANCY_EMPTY 0xFF
+
+// Clear the grid and stamp every live player
+void occupancy_rebuild(GameState* state);
+
+// Stamp every live player without clearing first
+void occupancy_refresh(GameState* state);
+
+// Lowest-index live player other than skip on pos, or -1; a player scan,
+// for when the entry for pos is being handed on
+int occupancy_scan(const GameState* state, Position pos, int skip);
+
+// Player standing on (x, y), or -1. Out-of-bounds tiles are empty.
+static inline int occupancy_player_at(const GameState* state, int x, int y) {
+    const MapData* map = state->arena.map;
+    if (x < 0 || x >= map->width || y < 0 || y >= map->height) {
+        return -1;
+    }
+    int idx = state->arena.occupancy[map_index(map, x, y)];
+    if (idx == OCCUPANCY_EMPTY) {
+        return -1;
+    }
+    const Player* p = &state->players[idx];
+    if (!p->alive || p->pos.x != x || p->pos.y != y) {
+        return -1;
+    }
+    return idx;
+}
+
+// Record player_idx on pos unless a lower-index player already stands there
+static inline void occupancy_set(GameState* state, Position pos, int player_idx) {
+    const MapData* map = state->arena.map;
+    int current = occupancy_player_at(state, pos.x, pos.y);
+    if ((current < 0 || player_idx < current) &&
+        pos.x >= 0 && pos.x < map->width && pos.y >= 0 && pos.y < map->height) {
+        state->arena.occupancy[map_index(map, pos.x, pos.y)] = (uint8_t)player_idx;
+    }
+}
+
+// player_idx leaves pos: if the entry names it, pass the tile to the next
+// player still on it, else clear it
+static inline void occupancy_clear(GameState* state, Position pos, int player_idx) {
+    const MapData* map = state->arena.map;
+    if (pos.x >= 0 && pos.x < map->width && pos.y >= 0 && pos.y < map->height &&
+        state->arena.occupancy[map_index(map, pos.x, pos.y)] == player_idx) {
+        int next = occupancy_scan(state, pos, player_idx);
+        state->arena.occupancy[map_index(map, pos.x, pos.y)] =
+            next < 0 ? OCCUPANCY_EMPTY : (uint8_t)next;
+    }
+}
+
+#endif // ARENA_OCCUPANCY_H
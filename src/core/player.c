@@ -9,6 +9,7 @@ void player_init(Player* player, Position spawn_pos) {
     player->laser_cooldown_ticks = 0;
     player->energy_regen_ticks = ENERGY_REGEN_TICKS;
     player->score = 0;
+    player->last_hit_by = -1;
     player->alive = true;
 }
 
@@ -20,6 +21,7 @@ void player_respawn(Player* player, Position spawn_pos) {
     player->move_cooldown_ticks = 0;
     player->laser_cooldown_ticks = 0;
     player->energy_regen_ticks = ENERGY_REGEN_TICKS;
+    player->last_hit_by = -1;
     player->alive = true;
     // Note: score is NOT reset on respawn
 }
@@ -46,13 +48,11 @@ void player_tick_cooldowns(Player* player) {
 }
 
 bool player_can_move(const Player* player) {
-    return player->alive && player->move_cooldown_ticks == 0;
+    return player_ready_to_move(player->alive, player->move_cooldown_ticks);
 }
 
 bool player_can_shoot(const Player* player) {
-    return player->alive &&
-           player->laser_cooldown_ticks == 0 &&
-           player->energy > 0;
+    return player_ready_to_shoot(player->alive, player->laser_cooldown_ticks, player->energy);
 }
 
 void player_start_move_cooldown(Player* player) {
@@ -14,6 +14,16 @@ void player_tick_cooldowns(Player* player);
 bool player_can_move(const Player* player);
 bool player_can_shoot(const Player* player);
 
+// The rules behind player_can_move and player_can_shoot, on the bare
+// fields, for code that keeps players as separate arrays (the batch engine)
+static inline bool player_ready_to_move(bool alive, int move_cooldown_ticks) {
+    return alive && move_cooldown_ticks == 0;
+}
+
+static inline bool player_ready_to_shoot(bool alive, int laser_cooldown_ticks, int energy) {
+    return alive && laser_cooldown_ticks == 0 && energy > 0;
+}
+
 // Actions
 void player_start_move_cooldown(Player* player);
 void player_start_laser_cooldown(Player* player);
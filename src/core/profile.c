@@ -0,0 +1,86 @@
+#include "profile.h"
+#include <string.h>
+
+static const char* const phase_names[PROFILE_NUM_PHASES] = {
+    "collect", "shooting", "respawn", "movement", "timers", "win_check",
+};
+
+const char* profile_phase_name(ProfilePhase phase) {
+    return (unsigned)phase < PROFILE_NUM_PHASES ? phase_names[phase] : "unknown";
+}
+
+static void clear_stats(ProfileStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < PROFILE_NUM_PHASES; i++) {
+        stats->phases[i].min_ticks = UINT64_MAX;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    stats->cycles = true;
+#endif
+}
+
+void profile_stats_add(ProfileStats* dst, const ProfileStats* src) {
+    for (int i = 0; i < PROFILE_NUM_PHASES; i++) {
+        ProfilePhaseStats* d = &dst->phases[i];
+        const ProfilePhaseStats* s = &src->phases[i];
+        d->calls += s->calls;
+        d->total_ticks += s->total_ticks;
+        d->min_ticks = s->min_ticks < d->min_ticks ? s->min_ticks : d->min_ticks;
+        d->max_ticks = s->max_ticks > d->max_ticks ? s->max_ticks : d->max_ticks;
+        for (int b = 0; b < PROFILE_HIST_BUCKETS; b++) {
+            d->histogram[b] += s->histogram[b];
+        }
+    }
+}
+
+#ifdef ARENA_PROFILE
+
+static _Thread_local ProfileStats thread_stats;
+static _Thread_local bool thread_stats_ready;
+
+static ProfileStats* get_thread_stats(void) {
+    if (!thread_stats_ready) {
+        clear_stats(&thread_stats);
+        thread_stats_ready = true;
+    }
+    return &thread_stats;
+}
+
+void profile_record(ProfilePhase phase, uint64_t ticks) {
+    ProfilePhaseStats* s = &get_thread_stats()->phases[phase];
+    int bucket = ticks ? 63 - __builtin_clzll(ticks) : 0;
+    s->calls++;
+    s->total_ticks += ticks;
+    s->min_ticks = ticks < s->min_ticks ? ticks : s->min_ticks;
+    s->max_ticks = ticks > s->max_ticks ? ticks : s->max_ticks;
+    s->histogram[bucket < PROFILE_HIST_BUCKETS ? bucket : PROFILE_HIST_BUCKETS - 1]++;
+}
+
+bool profile_enabled(void) {
+    return true;
+}
+
+bool profile_get_stats(ProfileStats* out) {
+    *out = *get_thread_stats();
+    return true;
+}
+
+void profile_reset_stats(void) {
+    clear_stats(get_thread_stats());
+}
+
+#else
+
+bool profile_enabled(void) {
+    return false;
+}
+
+bool profile_get_stats(ProfileStats* out) {
+    clear_stats(out);
+    return false;
+}
+
+void profile_reset_stats(void) {
+}
+
+#endif // ARENA_PROFILE
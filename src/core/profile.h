@@ -0,0 +1,92 @@
+#ifndef ARENA_PROFILE_H
+#define ARENA_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// =============================================================================
+// Per-phase timing of game_step
+//
+// Built with -DARENA_PROFILE (make PROFILE=1), every phase of game_step is
+// wrapped in a timestamp pair and its duration added to counters owned by
+// the calling thread, so threads stepping their own envs never contend.
+// Without the flag PROFILE_PHASE expands to the bare statement and the
+// stats calls report that profiling is off.
+//
+// Durations are in ticks: TSC cycles on x86, nanoseconds elsewhere. The
+// histogram buckets them by magnitude, bucket b counting durations in
+// [2^b, 2^(b+1)) (bucket 0 also takes 0).
+// =============================================================================
+
+typedef enum {
+    PROFILE_COLLECT,
+    PROFILE_SHOOTING,
+    PROFILE_RESPAWN,   // both passes: after shooting and after movement
+    PROFILE_MOVEMENT,
+    PROFILE_TIMERS,
+    PROFILE_WIN_CHECK,
+    PROFILE_NUM_PHASES
+} ProfilePhase;
+
+#define PROFILE_HIST_BUCKETS 32
+
+typedef struct {
+    uint64_t calls;
+    uint64_t total_ticks;
+    uint64_t min_ticks;  // UINT64_MAX until the first call
+    uint64_t max_ticks;
+    uint64_t histogram[PROFILE_HIST_BUCKETS];
+} ProfilePhaseStats;
+
+typedef struct {
+    bool cycles;  // ticks are TSC cycles rather than nanoseconds
+    ProfilePhaseStats phases[PROFILE_NUM_PHASES];
+} ProfileStats;
+
+// Whether this build was compiled with ARENA_PROFILE
+bool profile_enabled(void);
+
+// Copy the calling thread's counters. Returns false (and clears out) when
+// profiling is compiled out.
+bool profile_get_stats(ProfileStats* out);
+
+// Zero the calling thread's counters
+void profile_reset_stats(void);
+
+// Add src into dst, e.g. to total the stats gathered by several threads
+void profile_stats_add(ProfileStats* dst, const ProfileStats* src);
+
+const char* profile_phase_name(ProfilePhase phase);
+
+#ifdef ARENA_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profile_now(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t profile_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+void profile_record(ProfilePhase phase, uint64_t ticks);
+
+#define PROFILE_PHASE(phase, stmt)                          \
+    do {                                                    \
+        uint64_t profile_start_ = profile_now();            \
+        stmt;                                               \
+        profile_record((phase), profile_now() - profile_start_); \
+    } while (0)
+
+#else
+
+#define PROFILE_PHASE(phase, stmt) stmt
+
+#endif // ARENA_PROFILE
+
+#endif // ARENA_PROFILE_H
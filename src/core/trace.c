@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    const char* name;
+    uint64_t ts_ns;
+    char phase;  // 'B' or 'E'
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    struct TraceBuffer* next;
+    int tid;
+    int capacity;
+    uint64_t count;  // events ever written; the last capacity are kept
+    TraceEvent events[];
+} TraceBuffer;
+
+atomic_bool trace_active;
+
+// Bumped by trace_start and trace_clear, which free every buffer; a thread
+// holding a buffer from an older generation registers a new one
+static atomic_uint generation;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer* buffers;
+static int buffer_capacity = TRACE_DEFAULT_CAPACITY;
+static int next_tid = 1;
+
+static _Thread_local TraceBuffer* local_buffer;
+static _Thread_local unsigned local_generation;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void free_buffers(void) {
+    while (buffers) {
+        TraceBuffer* next = buffers->next;
+        free(buffers);
+        buffers = next;
+    }
+}
+
+static TraceBuffer* register_thread(unsigned gen) {
+    pthread_mutex_lock(&lock);
+    TraceBuffer* buffer =
+        malloc(sizeof(TraceBuffer) + sizeof(TraceEvent) * (size_t)buffer_capacity);
+    if (buffer) {
+        buffer->tid = next_tid++;
+        buffer->capacity = buffer_capacity;
+        buffer->count = 0;
+        buffer->next = buffers;
+        buffers = buffer;
+    }
+    pthread_mutex_unlock(&lock);
+    local_buffer = buffer;
+    local_generation = gen;
+    return buffer;
+}
+
+void trace_event(const char* name, char phase) {
+    unsigned gen = atomic_load_explicit(&generation, memory_order_relaxed);
+    TraceBuffer* buffer = local_buffer;
+    if (!buffer || local_generation != gen) {
+        buffer = register_thread(gen);
+        if (!buffer) {
+            return;
+        }
+    }
+    TraceEvent* e = &buffer->events[buffer->count % (uint64_t)buffer->capacity];
+    e->name = name;
+    e->ts_ns = now_ns();
+    e->phase = phase;
+    buffer->count++;
+}
+
+void trace_start(int capacity) {
+    atomic_store(&trace_active, false);
+    pthread_mutex_lock(&lock);
+    free_buffers();
+    buffer_capacity = capacity > 0 ? capacity : TRACE_DEFAULT_CAPACITY;
+    atomic_fetch_add(&generation, 1);
+    pthread_mutex_unlock(&lock);
+    atomic_store(&trace_active, true);
+}
+
+void trace_stop(void) {
+    atomic_store(&trace_active, false);
+}
+
+void trace_clear(void) {
+    atomic_store(&trace_active, false);
+    pthread_mutex_lock(&lock);
+    free_buffers();
+    atomic_fetch_add(&generation, 1);
+    pthread_mutex_unlock(&lock);
+}
+
+bool trace_dump(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+
+    pthread_mutex_lock(&lock);
+    for (const TraceBuffer* b = buffers; b; b = b->next) {
+        uint64_t start = b->count > (uint64_t)b->capacity ? b->count - (uint64_t)b->capacity : 0;
+        int depth = 0;
+        for (uint64_t i = start; i < b->count; i++) {
+            const TraceEvent* e = &b->events[i % (uint64_t)b->capacity];
+            // An end whose begin was overwritten
+            if (e->phase == 'E' && depth == 0) {
+                continue;
+            }
+            depth += e->phase == 'B' ? 1 : -1;
+            fprintf(f, "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d}",
+                    first ? "" : ",\n", e->name, e->phase, (double)e->ts_ns / 1000.0, b->tid);
+            first = false;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    fprintf(f, "\n]}\n");
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
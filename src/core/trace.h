@@ -0,0 +1,62 @@
+#ifndef ARENA_TRACE_H
+#define ARENA_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// =============================================================================
+// Timeline trace recorder
+//
+// TRACE_BEGIN / TRACE_END mark a span on the calling thread. While
+// recording is off they cost one relaxed load and a branch; while on, each
+// appends a timestamped event to the thread's own ring buffer, so threads
+// never contend. Once a buffer fills, the oldest events are overwritten,
+// keeping the most recent window.
+//
+// trace_dump writes every thread's events in the Chrome trace JSON format,
+// which chrome://tracing and Perfetto open directly. Spans whose begin
+// was overwritten are dropped; spans still open are left open.
+//
+// Names must be string literals (only the pointer is stored). trace_start,
+// trace_dump and trace_clear must not run while other threads are inside
+// traced code; call them between steps or frames.
+// =============================================================================
+
+#define TRACE_DEFAULT_CAPACITY 65536  // events per thread
+
+extern atomic_bool trace_active;
+
+void trace_event(const char* name, char phase);
+
+static inline bool trace_is_on(void) {
+    return atomic_load_explicit(&trace_active, memory_order_relaxed);
+}
+
+#define TRACE_BEGIN(name)                \
+    do {                                 \
+        if (trace_is_on()) {             \
+            trace_event((name), 'B');    \
+        }                                \
+    } while (0)
+
+#define TRACE_END(name)                  \
+    do {                                 \
+        if (trace_is_on()) {             \
+            trace_event((name), 'E');    \
+        }                                \
+    } while (0)
+
+// Discard anything recorded and start recording, keeping the last
+// capacity events per thread (<= 0 for TRACE_DEFAULT_CAPACITY)
+void trace_start(int capacity);
+
+// Stop recording; what was recorded stays available to trace_dump
+void trace_stop(void);
+
+// Write the recorded events to path. Returns false on I/O error.
+bool trace_dump(const char* path);
+
+// Stop recording and free every thread's buffer
+void trace_clear(void);
+
+#endif // ARENA_TRACE_H
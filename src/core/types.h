@@ -36,16 +36,20 @@
 // Win condition
 #define WIN_SCORE           8
 
-// Arena limits
-#define MAX_ARENA_WIDTH     32
-#define MAX_ARENA_HEIGHT    32
-#define MAX_PLAYERS         2
+// Arena limits. Tile storage is sized per map (see MapData), so these only
+// bound what a map may declare.
+#define MAX_ARENA_WIDTH     1024
+#define MAX_ARENA_HEIGHT    1024
+#define MAX_PLAYERS         8
 #define MAX_CRYSTALS        8
-#define MAX_SPAWN_POINTS    4
-#define MAX_LASERS          4
+#define MAX_SPAWN_POINTS    8
+#define MAX_LASERS          (MAX_PLAYERS * 2)
+
+// Players per game unless changed with game_set_num_players
+#define DEFAULT_NUM_PLAYERS 2
 
 // Respawn
-#define RESPAWN_MIN_DISTANCE 3  // Manhattan distance from opponent
+#define RESPAWN_MIN_DISTANCE 3  // Manhattan distance from every other player
 
 // =============================================================================
 // Enums
@@ -89,25 +93,69 @@ typedef struct {
     int y;
 } Position;
 
-typedef struct {
-    Position pos;
-    int cooldown_ticks;  // 0 = available, >0 = on cooldown
-} Crystal;
-
 typedef struct {
     Position pos;
 } SpawnPoint;
 
+// Refcount value for map data that is never freed (static or mmapped)
+#define MAP_DATA_STATIC (-1)
+
+// Distance field value for tiles with no path to the target
+#define MAP_DISTANCE_UNREACHABLE 0xFFFF
+
+// Alignment of MapData, its tables and its rows (one cache line)
+#define MAP_ROW_ALIGN 64
+
+// Static map data: tiles, entity placements and derived lookup tables.
+// Immutable once built and shared by every env playing the same map;
+// only the refcount changes (see map.h).
+//
+// One allocation of `size` bytes: this header, then every per-tile table,
+// each starting on a MAP_ROW_ALIGN boundary. Per-tile tables are
+// [height][stride] with stride = width rounded up to MAP_ROW_ALIGN, so
+// rows are cache-line aligned; index them with map_index. Tables are
+// located by byte offsets rather than pointers so the blob can be copied,
+// written to disk and mmapped as is. Use the accessors in map.h.
 typedef struct {
+    int refcount;
     int width;
     int height;
-    TileType tiles[MAX_ARENA_HEIGHT][MAX_ARENA_WIDTH];
+    int stride;     // row pitch in tiles
+    uint32_t size;  // bytes in use, see map_data_size
 
     int num_crystals;
-    Crystal crystals[MAX_CRYSTALS];
+    Position crystals[MAX_CRYSTALS];
 
     int num_spawn_points;
     SpawnPoint spawn_points[MAX_SPAWN_POINTS];
+
+    // Derived tables (built once by map_data_build_tables). Byte offsets
+    // from the start of the MapData:
+    //   crystal_at:  int8_t, crystal index or -1
+    //   ray_length:  uint16_t [4] planes, steps from a tile to the first
+    //                wall or out-of-bounds tile per direction (indexed by
+    //                Direction - 1); lasers travel through void
+    //   floor_tiles: uint32_t [num_floor_tiles], map_index of every floor
+    //                tile in row-major order
+    //   distance:    uint16_t planes, one per crystal then one per spawn
+    //                point: shortest-path steps over floor tiles
+    //                (MAP_DISTANCE_UNREACHABLE if there is no path), see
+    //                distance.h
+    int num_floor_tiles;
+    uint32_t crystal_at_offset;
+    uint32_t ray_length_offset;
+    uint32_t floor_tiles_offset;
+    uint32_t distance_offset;
+
+    _Alignas(MAP_ROW_ALIGN) uint8_t tiles[];  // [height][stride] TileType values
+} MapData;
+
+// Per-env arena state: a reference to the shared map plus the only
+// map-related state that changes during an episode
+typedef struct {
+    const MapData* map;
+    int crystal_cooldowns[MAX_CRYSTALS];  // 0 = available, >0 = on cooldown
+    uint8_t* occupancy;  // [height][stride] player per tile, see occupancy.h
 } Arena;
 
 typedef struct {
@@ -119,6 +167,7 @@ typedef struct {
     int laser_cooldown_ticks;  // 0 = can shoot
     int energy_regen_ticks;    // countdown to next energy regen
     int score;
+    int last_hit_by;           // player who last hit us since respawn, -1 = none
     bool alive;
 } Player;
 
@@ -137,14 +186,29 @@ typedef struct {
     bool active;
 } LaserBeam;
 
-// Full game state
+// Full game state. It owns a map reference and the occupancy grid, so a
+// struct copy is only a view of the original: copy with game_copy, and
+// give each state exactly one game_free. Re-initializing a live state
+// without game_free leaks both. The exception is snapshots, which borrow
+// their map and have no grid: batch_engine_get_state and
+// delta_seq_get_state fill states that must never be passed to
+// game_free.
+//
+// players and lasers are sized for MAX_PLAYERS whatever num_players is:
+// about 860 bytes per state (plus the occupancy grid), against ~250 for a
+// duel-sized struct. Fixed inline arrays keep player access direct and
+// let snapshots, delta encoding and struct layouts treat the state as one
+// flat record. Code that holds many duel envs uses the batch engine,
+// whose per-env rows only cover BATCH_NUM_PLAYERS players.
 typedef struct {
     Arena arena;
     Player players[MAX_PLAYERS];
     LaserBeam lasers[MAX_LASERS];
+    int num_players;  // players[0..num_players) are in the game
     int current_tick;
-    int winner;  // -1 = no winner yet, 0 or 1 = player index who won
+    int winner;  // -1 = no winner yet, else index of the winning player
     bool game_over;
+    uint8_t step_kernel;  // game_step variant for this shape, set by game_reset
 } GameState;
 
 // Result of a laser shot (for debugging/rendering)
@@ -163,6 +227,7 @@ typedef struct {
     bool crystal_collected[MAX_PLAYERS];
     int damage_dealt[MAX_PLAYERS];
     int damage_taken[MAX_PLAYERS];
+    int frags[MAX_PLAYERS];  // frags credited to each player this step
 } StepInfo;
 
 #endif // ARENA_TYPES_H
@@ -0,0 +1,883 @@
+// CPython extension over the batch engine (module _arena)
+//
+// BatchEnv steps num_envs duels in one call. Inputs are read and outputs
+// exposed through the buffer protocol, so numpy arrays, array.array,
+// bytearray and memoryview all work without copies and without numpy
+// being required at build time:
+//
+//   env = _arena.BatchEnv(map_text, num_envs, obs_flags=0, crop=0, seed=None,
+//                         frame_stack=0)
+//   env.step(actions)    # int32 buffer [num_envs, 2, 2] of (move, shoot)
+//   env.observe()        # fill env.obs
+//   env.action_masks()   # fill env.move_mask and env.shoot_mask
+//   env.observe_dihedral(out, transforms)  # 8x augmented observations;
+//                        # _arena.DIHEDRAL_ACTIONS[t] remaps actions
+//   env.stacked          # with frame_stack=k: [num_envs * 2, k, obs_size]
+//                        # observe() then writes straight into the ring
+//                        # and obs is its newest frame
+//   env.observe_packed(out, bits=True)   # bit-packed, see observation.h
+//   env.unpack(packed, out, bits=True)   # back to float32, learner side
+//   env.reset_done()     # reset finished envs, returns how many
+//   np.asarray(env.obs)  # float32 [num_envs, 2, obs_size], zero-copy
+//
+// step and observe release the GIL while they run. The views returned by
+// obs, rewards, dones and field() point straight at memory the env owns
+// (engine fields are the batch engine's own struct-of-arrays storage)
+// and keep the env alive; they see every later step without re-fetching
+// (except obs with frame_stack, which follows the ring like stacked).
+// obs and engine field views are read-only: full-map observations are
+// patched in place each observe() (see ObsCache in observation.h).
+//
+// struct_dtype(name) turns the library's struct layouts (see api.h) into
+// a spec for np.dtype, so arrays of GameState or StepInfo read as
+// structured arrays:
+//
+//   np.frombuffer(states, dtype=np.dtype(_arena.struct_dtype("GameState")))
+//
+// Both seats are agents (see api_batch_step_agents): obs, rewards and
+// dones are [num_envs, 2, ...], i.e. [num_envs * 2, ...] agent rows, and
+// actions are in each agent's observation frame. Pass
+// OBS_FLAG_MIRROR_SEAT1 in obs_flags to canonicalize player 1.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdbool.h>
+#include <string.h>
+#include "api.h"
+#include "batch.h"
+#include "framestack.h"
+#include "game.h"
+#include "observation.h"
+
+// =============================================================================
+// BufferView: exports one strided region of a BatchEnv
+// =============================================================================
+
+#define VIEW_MAX_DIMS 3
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* owner;  // keeps the memory alive
+    void* buf;
+    int ndim;
+    Py_ssize_t shape[VIEW_MAX_DIMS];
+    Py_ssize_t strides[VIEW_MAX_DIMS];
+    Py_ssize_t itemsize;
+    char format[2];
+    bool readonly;
+} BufferView;
+
+static bool view_is_c_contiguous(const BufferView* v) {
+    Py_ssize_t expected = v->itemsize;
+    for (int d = v->ndim - 1; d >= 0; d--) {
+        if (v->shape[d] > 1 && v->strides[d] != expected) {
+            return false;
+        }
+        expected *= v->shape[d];
+    }
+    return true;
+}
+
+static int bufferview_getbuffer(PyObject* obj, Py_buffer* view, int flags) {
+    BufferView* self = (BufferView*)obj;
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && self->readonly) {
+        PyErr_SetString(PyExc_BufferError, "view is read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES && !view_is_c_contiguous(self)) {
+        PyErr_SetString(PyExc_BufferError, "view is strided");
+        view->obj = NULL;
+        return -1;
+    }
+    Py_ssize_t len = self->itemsize;
+    for (int d = 0; d < self->ndim; d++) {
+        len *= self->shape[d];
+    }
+    view->buf = self->buf;
+    view->obj = Py_NewRef(obj);
+    view->len = len;
+    view->itemsize = self->itemsize;
+    view->readonly = self->readonly;
+    view->ndim = self->ndim;
+    view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static void bufferview_dealloc(PyObject* obj) {
+    Py_XDECREF(((BufferView*)obj)->owner);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static PyBufferProcs bufferview_as_buffer = {
+    .bf_getbuffer = bufferview_getbuffer,
+};
+
+static PyTypeObject BufferViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_arena.BufferView",
+    .tp_basicsize = sizeof(BufferView),
+    .tp_dealloc = bufferview_dealloc,
+    .tp_as_buffer = &bufferview_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Region of a BatchEnv exported through the buffer protocol",
+};
+
+// memoryview over buf with the given shape; strides are in elements,
+// NULL for C order
+static PyObject* make_view(PyObject* owner, void* buf, char format, Py_ssize_t itemsize,
+                           int ndim, const Py_ssize_t* shape, const Py_ssize_t* strides,
+                           bool readonly) {
+    BufferView* v = PyObject_New(BufferView, &BufferViewType);
+    if (!v) {
+        return NULL;
+    }
+    v->owner = Py_NewRef(owner);
+    v->buf = buf;
+    v->ndim = ndim;
+    v->itemsize = itemsize;
+    v->format[0] = format;
+    v->format[1] = '\0';
+    v->readonly = readonly;
+    Py_ssize_t step = 1;
+    for (int d = ndim - 1; d >= 0; d--) {
+        v->shape[d] = shape[d];
+        v->strides[d] = (strides ? strides[d] : step) * itemsize;
+        step *= shape[d];
+    }
+    PyObject* mv = PyMemoryView_FromObject((PyObject*)v);
+    Py_DECREF(v);
+    return mv;
+}
+
+// =============================================================================
+// BatchEnv
+// =============================================================================
+
+typedef struct {
+    PyObject_HEAD
+    BatchEngine* engine;
+    int num_envs;
+    unsigned obs_flags;
+    int crop;      // 0 = full map observations
+    int obs_size;  // floats per player
+    float* obs;       // [num_envs][2][obs_size], NULL with frame_stack
+    float* rewards;   // [num_envs][2]
+    uint8_t* dones;   // [num_envs][2]
+    uint8_t* move_mask;   // [num_envs][2][5]
+    uint8_t* shoot_mask;  // [num_envs][2][5]
+    StepInfo* infos;  // [num_envs]
+    ObsCache* caches;  // [num_envs][2], full-map observations without frame_stack
+    FrameStack* stack;       // NULL without frame stacking
+    uint8_t* stack_pending;  // [num_envs], reset since the last observe
+    bool busy;        // a call is running with the GIL released
+} BatchEnv;
+
+static void batchenv_dealloc(PyObject* obj) {
+    BatchEnv* self = (BatchEnv*)obj;
+    batch_engine_free(self->engine);
+    PyMem_RawFree(self->obs);
+    PyMem_RawFree(self->rewards);
+    PyMem_RawFree(self->dones);
+    PyMem_RawFree(self->move_mask);
+    PyMem_RawFree(self->shoot_mask);
+    PyMem_RawFree(self->infos);
+    if (self->caches) {
+        api_release_obs_caches(self->caches, self->num_envs * 2);
+    }
+    PyMem_RawFree(self->caches);
+    framestack_free(self->stack);
+    PyMem_RawFree(self->stack_pending);
+    Py_TYPE(obj)->tp_free(obj);
+}
+
+static int batchenv_init(PyObject* obj, PyObject* args, PyObject* kwargs) {
+    BatchEnv* self = (BatchEnv*)obj;
+    static char* keywords[] = {"map", "num_envs", "obs_flags", "crop", "seed", "frame_stack",
+                               NULL};
+    const char* map_text;
+    int num_envs, crop = 0, frame_stack = 0;
+    unsigned int obs_flags = 0;
+    PyObject* seed = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "si|IiOi", keywords, &map_text, &num_envs,
+                                     &obs_flags, &crop, &seed, &frame_stack)) {
+        return -1;
+    }
+    if (frame_stack < 0) {
+        PyErr_SetString(PyExc_ValueError, "frame_stack must not be negative");
+        return -1;
+    }
+    if (self->engine) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is already initialized");
+        return -1;
+    }
+    if (num_envs < 1) {
+        PyErr_SetString(PyExc_ValueError, "num_envs must be positive");
+        return -1;
+    }
+    if (crop < 0 || (crop > 0 && crop % 2 == 0)) {
+        PyErr_SetString(PyExc_ValueError, "crop must be 0 or an odd size");
+        return -1;
+    }
+    if (seed != Py_None) {
+        unsigned long value = PyLong_AsUnsignedLongMask(seed);
+        if (PyErr_Occurred()) {
+            return -1;
+        }
+        api_game_set_seed((unsigned int)value);
+    }
+
+    GameState state;
+    api_game_init(&state, map_text);
+    if (api_get_arena_width(&state) == 0) {
+        api_game_free(&state);
+        PyErr_SetString(PyExc_ValueError, "map could not be parsed");
+        return -1;
+    }
+    self->num_envs = num_envs;
+    self->obs_flags = obs_flags;
+    self->crop = crop;
+    self->obs_size = crop ? observation_crop_size(crop, obs_flags)
+                          : observation_size(&state, obs_flags);
+    self->engine = api_batch_create(&state, num_envs);
+    api_game_free(&state);
+
+    size_t n = (size_t)num_envs;
+    self->rewards = PyMem_RawCalloc(n * 2, sizeof(float));
+    self->dones = PyMem_RawCalloc(n * 2, 1);
+    self->move_mask = PyMem_RawCalloc(n * 2 * 5, 1);
+    self->shoot_mask = PyMem_RawCalloc(n * 2 * 5, 1);
+    self->infos = PyMem_RawCalloc(n, sizeof(StepInfo));
+    if (frame_stack == 0) {
+        self->obs = PyMem_RawCalloc(n * 2 * (size_t)self->obs_size, sizeof(float));
+        self->caches = PyMem_RawCalloc(n * 2, sizeof(ObsCache));
+    } else {
+        // observe() writes into the ring, so there is no separate obs buffer
+        self->stack = framestack_create(num_envs * 2, self->obs_size, frame_stack, true);
+        self->stack_pending = PyMem_RawMalloc(n);
+        if (!self->stack || !self->stack_pending) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        memset(self->stack_pending, 1, n);
+    }
+    if (!self->engine || (frame_stack == 0 && (!self->obs || !self->caches)) || !self->rewards ||
+        !self->dones || !self->infos || !self->move_mask || !self->shoot_mask) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static bool claim(BatchEnv* self) {
+    if (!self->engine) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is not initialized");
+        return false;
+    }
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is in use by another thread");
+        return false;
+    }
+    self->busy = true;
+    return true;
+}
+
+static bool is_int32_format(const char* format) {
+    if (!format) {
+        return false;
+    }
+    if (*format == '<' || *format == '=' || *format == '@') {
+        format++;
+    }
+    return strcmp(format, "i") == 0 || (strcmp(format, "l") == 0 && sizeof(long) == 4);
+}
+
+static PyObject* batchenv_step(PyObject* obj, PyObject* arg) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_buffer actions;
+    if (PyObject_GetBuffer(arg, &actions, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return NULL;
+    }
+    Py_ssize_t expected = (Py_ssize_t)self->num_envs * 2 * 2 * 4;
+    if (actions.itemsize != 4 || !is_int32_format(actions.format) || actions.len != expected) {
+        PyErr_Format(PyExc_ValueError, "actions must be %d x 2 x 2 int32 (move, shoot)",
+                     self->num_envs);
+        PyBuffer_Release(&actions);
+        return NULL;
+    }
+    if (!claim(self)) {
+        PyBuffer_Release(&actions);
+        return NULL;
+    }
+
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = api_batch_step_agents(self->engine, (const int*)actions.buf, self->obs_flags,
+                               self->rewards, self->dones, self->infos);
+    Py_END_ALLOW_THREADS
+
+    self->busy = false;
+    PyBuffer_Release(&actions);
+    if (!ok) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* batchenv_observe(PyObject* obj, PyObject* Py_UNUSED(ignored)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    if (!claim(self)) {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (self->stack) {
+        // Straight into the ring. The slot holds the frame from k steps
+        // back (and ring slots shift when the ring isn't a whole number of
+        // frames), so it is written in full rather than patched.
+        api_batch_write_agent_observations(self->engine, self->crop, self->obs_flags,
+                                           framestack_next(self->stack));
+        framestack_push(self->stack);
+        for (int e = 0; e < self->num_envs; e++) {
+            if (self->stack_pending[e]) {
+                framestack_reset_row(self->stack, e * 2);
+                framestack_reset_row(self->stack, e * 2 + 1);
+                self->stack_pending[e] = 0;
+            }
+        }
+    } else if (self->crop) {
+        api_batch_write_agent_observations(self->engine, self->crop, self->obs_flags, self->obs);
+    } else {
+        api_batch_update_agent_observations(self->engine, self->caches, self->obs_flags,
+                                            self->obs);
+    }
+    Py_END_ALLOW_THREADS
+
+    self->busy = false;
+    Py_RETURN_NONE;
+}
+
+static PyObject* batchenv_observe_dihedral(PyObject* obj, PyObject* args) {
+    BatchEnv* self = (BatchEnv*)obj;
+    PyObject* target;
+    unsigned int transforms = (1u << OBS_NUM_DIHEDRAL) - 1;
+    if (!PyArg_ParseTuple(args, "O|I", &target, &transforms)) {
+        return NULL;
+    }
+    transforms &= (1u << OBS_NUM_DIHEDRAL) - 1;
+    Py_buffer out;
+    if (PyObject_GetBuffer(target, &out, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE | PyBUF_FORMAT) < 0) {
+        return NULL;
+    }
+    Py_ssize_t expected = (Py_ssize_t)self->num_envs * 2 * __builtin_popcount(transforms) *
+                          self->obs_size * (Py_ssize_t)sizeof(float);
+    if (out.itemsize != 4 || !out.format || out.format[strlen(out.format) - 1] != 'f' ||
+        out.len != expected) {
+        PyErr_Format(PyExc_ValueError, "out must be float32 [%d, 2, %d, %d]", self->num_envs,
+                     __builtin_popcount(transforms), self->obs_size);
+        PyBuffer_Release(&out);
+        return NULL;
+    }
+    if (!claim(self)) {
+        PyBuffer_Release(&out);
+        return NULL;
+    }
+
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = api_batch_write_dihedral_observations(self->engine, self->crop, self->obs_flags,
+                                               transforms, (float*)out.buf);
+    Py_END_ALLOW_THREADS
+
+    self->busy = false;
+    PyBuffer_Release(&out);
+    if (!ok) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+// Writable C-contiguous buffer of exactly len bytes and itemsize bytes
+// per item, or -1 with ValueError
+static int get_out_buffer(PyObject* target, Py_buffer* out, Py_ssize_t len, Py_ssize_t itemsize,
+                          const char* what) {
+    if (PyObject_GetBuffer(target, out, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE) < 0) {
+        return -1;
+    }
+    if (out->len != len || out->itemsize != itemsize) {
+        PyErr_Format(PyExc_ValueError, "%s must be %zd bytes of %zd-byte items", what, len,
+                     itemsize);
+        PyBuffer_Release(out);
+        return -1;
+    }
+    return 0;
+}
+
+static int obs_width(const BatchEnv* self) {
+    return self->crop ? self->crop : self->engine->map->width;
+}
+
+static int obs_height(const BatchEnv* self) {
+    return self->crop ? self->crop : self->engine->map->height;
+}
+
+static PyObject* batchenv_packed_size(PyObject* obj, PyObject* args) {
+    BatchEnv* self = (BatchEnv*)obj;
+    int bits = 1;
+    if (!PyArg_ParseTuple(args, "|p", &bits)) {
+        return NULL;
+    }
+    if (!self->engine) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is not initialized");
+        return NULL;
+    }
+    return PyLong_FromLong(observation_packed_size(obs_width(self), obs_height(self),
+                                                   self->obs_flags, (ObsPacking)bits));
+}
+
+static PyObject* batchenv_observe_packed(PyObject* obj, PyObject* args) {
+    BatchEnv* self = (BatchEnv*)obj;
+    PyObject* target;
+    int bits = 1;
+    if (!PyArg_ParseTuple(args, "O|p", &target, &bits) || !claim(self)) {
+        return NULL;
+    }
+    Py_ssize_t size = observation_packed_size(obs_width(self), obs_height(self), self->obs_flags,
+                                              (ObsPacking)bits);
+    Py_buffer out;
+    if (get_out_buffer(target, &out, (Py_ssize_t)self->num_envs * 2 * size, 1, "out") < 0) {
+        self->busy = false;
+        return NULL;
+    }
+
+    bool ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = api_batch_write_packed_observations(self->engine, self->crop, self->obs_flags, bits,
+                                             (uint8_t*)out.buf);
+    Py_END_ALLOW_THREADS
+
+    self->busy = false;
+    PyBuffer_Release(&out);
+    if (!ok) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* batchenv_unpack(PyObject* obj, PyObject* args) {
+    BatchEnv* self = (BatchEnv*)obj;
+    PyObject* source;
+    PyObject* target;
+    int bits = 1;
+    if (!PyArg_ParseTuple(args, "OO|p", &source, &target, &bits)) {
+        return NULL;
+    }
+    if (!self->engine) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is not initialized");
+        return NULL;
+    }
+    int w = obs_width(self), h = obs_height(self);
+    Py_ssize_t packed_size = observation_packed_size(w, h, self->obs_flags, (ObsPacking)bits);
+    Py_buffer packed, out;
+    if (PyObject_GetBuffer(source, &packed, PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    if (packed.len % packed_size != 0) {
+        PyErr_Format(PyExc_ValueError, "packed must be a multiple of %zd bytes", packed_size);
+        PyBuffer_Release(&packed);
+        return NULL;
+    }
+    int count = (int)(packed.len / packed_size);
+    if (get_out_buffer(target, &out, (Py_ssize_t)count * self->obs_size * 4, 4, "out") < 0) {
+        PyBuffer_Release(&packed);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    observation_unpack((const uint8_t*)packed.buf, count, w, h, self->obs_flags,
+                       (ObsPacking)bits, (float*)out.buf);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&packed);
+    PyBuffer_Release(&out);
+    return PyLong_FromLong(count);
+}
+
+static PyObject* batchenv_action_masks(PyObject* obj, PyObject* Py_UNUSED(ignored)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    if (!claim(self)) {
+        return NULL;
+    }
+    api_write_action_masks(self->engine, self->obs_flags, self->move_mask, self->shoot_mask);
+    self->busy = false;
+    Py_RETURN_NONE;
+}
+
+static PyObject* batchenv_reset(PyObject* obj, PyObject* args) {
+    BatchEnv* self = (BatchEnv*)obj;
+    int env = -1;
+    if (!PyArg_ParseTuple(args, "|i", &env)) {
+        return NULL;
+    }
+    if (env < -1 || env >= self->num_envs) {
+        PyErr_SetString(PyExc_IndexError, "env out of range");
+        return NULL;
+    }
+    if (!claim(self)) {
+        return NULL;
+    }
+    for (int e = env < 0 ? 0 : env; e < (env < 0 ? self->num_envs : env + 1); e++) {
+        api_batch_reset(self->engine, e);
+        if (self->stack) {
+            self->stack_pending[e] = 1;
+        }
+    }
+    self->busy = false;
+    Py_RETURN_NONE;
+}
+
+static PyObject* batchenv_reset_done(PyObject* obj, PyObject* Py_UNUSED(ignored)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    if (!claim(self)) {
+        return NULL;
+    }
+    int count = 0;
+    for (int e = 0; e < self->num_envs; e++) {
+        if (self->engine->game_over[e]) {
+            api_batch_reset(self->engine, e);
+            if (self->stack) {
+                self->stack_pending[e] = 1;
+            }
+            count++;
+        }
+    }
+    self->busy = false;
+    return PyLong_FromLong(count);
+}
+
+// Engine fields by name, with their leading dimension
+typedef struct {
+    const char* name;
+    size_t offset;  // of the int32_t* in BatchEngine
+    int rows;       // 0 = one value per env
+} EngineField;
+
+#define ENGINE_FIELD(field, rows) {#field, offsetof(BatchEngine, field), rows}
+
+static const EngineField engine_fields[] = {
+    ENGINE_FIELD(pos_x, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(pos_y, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(facing, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(health, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(energy, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(move_cooldown, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(laser_cooldown, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(energy_regen, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(score, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(last_hit_by, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(alive, BATCH_NUM_PLAYERS),
+    ENGINE_FIELD(crystal_cooldowns, MAX_CRYSTALS),
+    ENGINE_FIELD(laser_start_x, MAX_LASERS),
+    ENGINE_FIELD(laser_start_y, MAX_LASERS),
+    ENGINE_FIELD(laser_end_x, MAX_LASERS),
+    ENGINE_FIELD(laser_end_y, MAX_LASERS),
+    ENGINE_FIELD(laser_owner, MAX_LASERS),
+    ENGINE_FIELD(laser_ticks, MAX_LASERS),
+    ENGINE_FIELD(laser_active, MAX_LASERS),
+    ENGINE_FIELD(tick, 0),
+    ENGINE_FIELD(winner, 0),
+    ENGINE_FIELD(game_over, 0),
+};
+
+#define NUM_ENGINE_FIELDS (int)(sizeof(engine_fields) / sizeof(engine_fields[0]))
+
+static PyObject* batchenv_field(PyObject* obj, PyObject* arg) {
+    BatchEnv* self = (BatchEnv*)obj;
+    const char* name = PyUnicode_AsUTF8(arg);
+    if (!name) {
+        return NULL;
+    }
+    if (!self->engine) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is not initialized");
+        return NULL;
+    }
+    for (int i = 0; i < NUM_ENGINE_FIELDS; i++) {
+        const EngineField* f = &engine_fields[i];
+        if (strcmp(name, f->name) != 0) {
+            continue;
+        }
+        int32_t* data = *(int32_t**)((char*)self->engine + f->offset);
+        if (f->rows == 0) {
+            Py_ssize_t shape[1] = {self->num_envs};
+            return make_view(obj, data, 'i', 4, 1, shape, NULL, true);
+        }
+        // [rows][capacity] storage, viewed as [rows][num_envs]
+        Py_ssize_t shape[2] = {f->rows, self->num_envs};
+        Py_ssize_t strides[2] = {self->engine->capacity, 1};
+        return make_view(obj, data, 'i', 4, 2, shape, strides, true);
+    }
+    PyErr_Format(PyExc_KeyError, "no engine field %s", name);
+    return NULL;
+}
+
+static PyObject* batchenv_field_names(PyObject* Py_UNUSED(cls), PyObject* Py_UNUSED(ignored)) {
+    PyObject* names = PyTuple_New(NUM_ENGINE_FIELDS);
+    for (int i = 0; names && i < NUM_ENGINE_FIELDS; i++) {
+        PyObject* name = PyUnicode_FromString(engine_fields[i].name);
+        if (!name) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(names, i, name);
+    }
+    return names;
+}
+
+static PyObject* batchenv_get_obs(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_ssize_t shape[3] = {self->num_envs, 2, self->obs_size};
+    if (self->stack) {
+        // Newest frame in the ring; it moves on every observe()
+        const float* newest = framestack_frame(self->stack, self->stack->k - 1);
+        return make_view(obj, (void*)newest, 'f', 4, 3, shape, NULL, true);
+    }
+    return make_view(obj, self->obs, 'f', 4, 3, shape, NULL, true);
+}
+
+static PyObject* batchenv_get_rewards(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_ssize_t shape[2] = {self->num_envs, 2};
+    return make_view(obj, self->rewards, 'f', 4, 2, shape, NULL, false);
+}
+
+static PyObject* batchenv_get_dones(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_ssize_t shape[2] = {self->num_envs, 2};
+    return make_view(obj, self->dones, 'B', 1, 2, shape, NULL, false);
+}
+
+static PyObject* batchenv_get_move_mask(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_ssize_t shape[3] = {self->num_envs, 2, 5};
+    return make_view(obj, self->move_mask, 'B', 1, 3, shape, NULL, false);
+}
+
+static PyObject* batchenv_get_shoot_mask(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    Py_ssize_t shape[3] = {self->num_envs, 2, 5};
+    return make_view(obj, self->shoot_mask, 'B', 1, 3, shape, NULL, false);
+}
+
+static PyObject* batchenv_get_stacked(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    if (!self->stack) {
+        PyErr_SetString(PyExc_AttributeError, "BatchEnv was created without frame_stack");
+        return NULL;
+    }
+    int k = self->stack->k;
+    Py_ssize_t rows = (Py_ssize_t)self->num_envs * 2;
+    Py_ssize_t shape[VIEW_MAX_DIMS] = {rows, k, self->obs_size};
+    const float* window = framestack_window(self->stack);
+    if (window) {
+        // Frames are [k][agents][obs_size]; present them agent-major
+        Py_ssize_t strides[VIEW_MAX_DIMS] = {self->obs_size, rows * self->obs_size, 1};
+        return make_view(obj, (void*)window, 'f', 4, 3, shape, strides, true);
+    }
+
+    // Plain ring: gather a copy in the same layout
+    size_t row_bytes = sizeof(float) * (size_t)self->obs_size;
+    PyObject* copy = PyByteArray_FromStringAndSize(NULL, rows * k * (Py_ssize_t)row_bytes);
+    if (!copy) {
+        return NULL;
+    }
+    char* dst = PyByteArray_AS_STRING(copy);
+    for (Py_ssize_t r = 0; r < rows; r++) {
+        for (int i = 0; i < k; i++) {
+            memcpy(dst + ((size_t)r * (size_t)k + (size_t)i) * row_bytes,
+                   framestack_frame(self->stack, i) + r * self->obs_size, row_bytes);
+        }
+    }
+    PyObject* view = make_view(copy, dst, 'f', 4, 3, shape, NULL, true);
+    Py_DECREF(copy);
+    return view;
+}
+
+static PyObject* batchenv_get_stack_zero_copy(PyObject* obj, void* Py_UNUSED(closure)) {
+    BatchEnv* self = (BatchEnv*)obj;
+    return PyBool_FromLong(self->stack && self->stack->double_mapped);
+}
+
+static PyObject* batchenv_get_num_envs(PyObject* obj, void* Py_UNUSED(closure)) {
+    return PyLong_FromLong(((BatchEnv*)obj)->num_envs);
+}
+
+static PyObject* batchenv_get_obs_size(PyObject* obj, void* Py_UNUSED(closure)) {
+    return PyLong_FromLong(((BatchEnv*)obj)->obs_size);
+}
+
+static PyMethodDef batchenv_methods[] = {
+    {"step", batchenv_step, METH_O,
+     "step(actions): step every env; actions is an int32 buffer [num_envs, 2, 2]"},
+    {"observe", batchenv_observe, METH_NOARGS,
+     "observe(): write both players' observations of every env into obs"},
+    {"observe_dihedral", batchenv_observe_dihedral, METH_VARARGS,
+     "observe_dihedral(out, transforms=0xff): write each agent's observation under every "
+     "dihedral transform in the bitmask into a float32 buffer [num_envs, 2, count, obs_size]"},
+    {"packed_size", batchenv_packed_size, METH_VARARGS,
+     "packed_size(bits=True): bytes per packed observation"},
+    {"observe_packed", batchenv_observe_packed, METH_VARARGS,
+     "observe_packed(out, bits=True): write every agent's observation, packed, into a byte "
+     "buffer [num_envs, 2, packed_size]"},
+    {"unpack", batchenv_unpack, METH_VARARGS,
+     "unpack(packed, out, bits=True): expand packed observations into a float32 buffer; "
+     "returns how many"},
+    {"action_masks", batchenv_action_masks, METH_NOARGS,
+     "action_masks(): write legal-action masks into move_mask and shoot_mask"},
+    {"reset", batchenv_reset, METH_VARARGS, "reset(env=-1): reset one env, or all"},
+    {"reset_done", batchenv_reset_done, METH_NOARGS,
+     "reset_done(): reset every finished env; returns how many"},
+    {"field", batchenv_field, METH_O,
+     "field(name): read-only int32 view of an engine field, [rows, num_envs] or [num_envs]"},
+    {"field_names", batchenv_field_names, METH_NOARGS | METH_CLASS,
+     "field_names(): names accepted by field()"},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef batchenv_getset[] = {
+    {"obs", batchenv_get_obs, NULL,
+     "read-only float32 [num_envs, 2, obs_size], updated in place by observe(); with "
+     "frame_stack, the newest frame of the ring, valid until the next observe()", NULL},
+    {"rewards", batchenv_get_rewards, NULL, "float32 [num_envs, 2] from the last step", NULL},
+    {"dones", batchenv_get_dones, NULL, "uint8 [num_envs, 2] from the last step", NULL},
+    {"move_mask", batchenv_get_move_mask, NULL, "uint8 [num_envs, 2, 5], filled by action_masks()",
+     NULL},
+    {"shoot_mask", batchenv_get_shoot_mask, NULL,
+     "uint8 [num_envs, 2, 5], filled by action_masks()", NULL},
+    {"stacked", batchenv_get_stacked, NULL,
+     "read-only float32 [num_envs * 2, frame_stack, obs_size], oldest frame first; valid until "
+     "the next observe()", NULL},
+    {"stack_zero_copy", batchenv_get_stack_zero_copy, NULL,
+     "whether stacked is a view of the double-mapped ring rather than a copy", NULL},
+    {"num_envs", batchenv_get_num_envs, NULL, "number of envs", NULL},
+    {"obs_size", batchenv_get_obs_size, NULL, "floats per player observation", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject BatchEnvType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_arena.BatchEnv",
+    .tp_basicsize = sizeof(BatchEnv),
+    .tp_dealloc = batchenv_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "BatchEnv(map, num_envs, obs_flags=0, crop=0, seed=None, frame_stack=0): "
+              "batched duels",
+    .tp_methods = batchenv_methods,
+    .tp_getset = batchenv_getset,
+    .tp_init = batchenv_init,
+    .tp_new = PyType_GenericNew,
+};
+
+// =============================================================================
+// Module
+// =============================================================================
+
+// {"names", "formats", "offsets", "itemsize"} for np.dtype; struct-typed
+// fields nest the same dict, arrays become (format, (count,))
+static PyObject* layout_to_dtype(const ApiStructLayout* layout) {
+    PyObject* names = PyList_New(layout->num_fields);
+    PyObject* formats = PyList_New(layout->num_fields);
+    PyObject* offsets = PyList_New(layout->num_fields);
+    PyObject* spec = NULL;
+    if (!names || !formats || !offsets) {
+        goto done;
+    }
+    for (int i = 0; i < layout->num_fields; i++) {
+        const ApiFieldLayout* f = &layout->fields[i];
+        const ApiStructLayout* nested = api_get_struct_layout(f->type);
+        PyObject* format = nested ? layout_to_dtype(nested) : PyUnicode_FromString(f->type);
+        if (format && f->count != 1) {
+            PyObject* array = Py_BuildValue("(N(i))", format, f->count);
+            format = array;
+        }
+        if (!format) {
+            goto done;
+        }
+        PyList_SET_ITEM(names, i, PyUnicode_FromString(f->name));
+        PyList_SET_ITEM(formats, i, format);
+        PyList_SET_ITEM(offsets, i, PyLong_FromLong(f->offset));
+    }
+    spec = Py_BuildValue("{sOsOsOsi}", "names", names, "formats", formats, "offsets", offsets,
+                         "itemsize", layout->size);
+done:
+    Py_XDECREF(names);
+    Py_XDECREF(formats);
+    Py_XDECREF(offsets);
+    return spec;
+}
+
+static PyObject* module_struct_dtype(PyObject* Py_UNUSED(module), PyObject* arg) {
+    const char* name = PyUnicode_AsUTF8(arg);
+    if (!name) {
+        return NULL;
+    }
+    const ApiStructLayout* layout = api_get_struct_layout(name);
+    if (!layout) {
+        PyErr_Format(PyExc_KeyError, "no layout for struct %s", name);
+        return NULL;
+    }
+    return layout_to_dtype(layout);
+}
+
+static PyObject* module_set_seed(PyObject* Py_UNUSED(module), PyObject* arg) {
+    unsigned long seed = PyLong_AsUnsignedLongMask(arg);
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    api_game_set_seed((unsigned int)seed);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef module_methods[] = {
+    {"set_seed", module_set_seed, METH_O, "set_seed(seed): respawn RNG of the calling thread"},
+    {"struct_dtype", module_struct_dtype, METH_O,
+     "struct_dtype(name): np.dtype spec for GameState, Player, StepInfo, ..."},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef arena_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_arena",
+    .m_doc = "Batched arena duels with zero-copy buffer views",
+    .m_size = -1,
+    .m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit__arena(void) {
+    if (PyType_Ready(&BufferViewType) < 0 || PyType_Ready(&BatchEnvType) < 0) {
+        return NULL;
+    }
+    PyObject* module = PyModule_Create(&arena_module);
+    if (!module) {
+        return NULL;
+    }
+    PyObject* actions = PyTuple_New(OBS_NUM_DIHEDRAL);
+    for (int t = 0; actions && t < OBS_NUM_DIHEDRAL; t++) {
+        const uint8_t* a = observation_dihedral_actions[t];
+        PyTuple_SET_ITEM(actions, t, Py_BuildValue("(iiiii)", a[0], a[1], a[2], a[3], a[4]));
+    }
+    int added = actions ? PyModule_AddObjectRef(module, "DIHEDRAL_ACTIONS", actions) : -1;
+    Py_XDECREF(actions);
+    if (added < 0 ||
+        PyModule_AddObjectRef(module, "BatchEnv", (PyObject*)&BatchEnvType) < 0 ||
+        PyModule_AddIntConstant(module, "OBS_FLAG_CRYSTAL_DISTANCE", OBS_FLAG_CRYSTAL_DISTANCE) < 0 ||
+        PyModule_AddIntConstant(module, "OBS_FLAG_ROTATE_TO_FACING", OBS_FLAG_ROTATE_TO_FACING) < 0 ||
+        PyModule_AddIntConstant(module, "OBS_FLAG_MIRROR_SEAT1", OBS_FLAG_MIRROR_SEAT1) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
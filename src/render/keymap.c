@@ -66,6 +66,7 @@ static const ActionNameEntry ACTION_NAME_TABLE[] = {
     {"p2_shoot",      KEY_P2_SHOOT},
     {"screenshot",    KEY_SCREENSHOT},
     {"pause",         KEY_PAUSE},
+    {"trace",         KEY_TRACE},
     {"quit",          KEY_QUIT},
     {NULL, 0}
 };
@@ -111,6 +112,7 @@ void keymap_load_defaults(Keymap* km) {
     km->bindings[KEY_P2_SHOOT]      = SDL_SCANCODE_RSHIFT;
     km->bindings[KEY_SCREENSHOT]    = SDL_SCANCODE_T;
     km->bindings[KEY_PAUSE]         = SDL_SCANCODE_P;
+    km->bindings[KEY_TRACE]         = SDL_SCANCODE_Y;
     km->bindings[KEY_QUIT]          = SDL_SCANCODE_ESCAPE;
 }
 
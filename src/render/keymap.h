@@ -17,6 +17,7 @@ typedef enum {
     KEY_P2_SHOOT,
     KEY_SCREENSHOT,
     KEY_PAUSE,
+    KEY_TRACE,
     KEY_QUIT,
     KEY_ACTION_COUNT
 } KeyAction;
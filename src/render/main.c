@@ -7,10 +7,14 @@
 #include "screenshot.h"
 #include "keymap.h"
 #include "config.h"
+#include "../core/trace.h"
 
 // Tick rate in milliseconds (60 ticks per second)
 #define TICK_MS 16
 
+// Written when the trace key is pressed a second time
+#define TRACE_FILE "trace.json"
+
 // Simple test map
 static const char* TEST_MAP =
     "########\n"
@@ -29,11 +33,11 @@ int main(int argc, char* argv[]) {
     GameState state;
     game_init(&state, TEST_MAP);
 
-    printf("Arena: %dx%d\n", state.arena.width, state.arena.height);
+    printf("Arena: %dx%d\n", state.arena.map->width, state.arena.map->height);
     printf("Players: P1 at (%d,%d), P2 at (%d,%d)\n",
            state.players[0].pos.x, state.players[0].pos.y,
            state.players[1].pos.x, state.players[1].pos.y);
-    printf("Crystals: %d\n", state.arena.num_crystals);
+    printf("Crystals: %d\n", state.arena.map->num_crystals);
 
     // Load config
     GameConfig config;
@@ -46,7 +50,7 @@ int main(int argc, char* argv[]) {
 
     // Initialize renderer
     RenderContext ctx;
-    if (render_init(&ctx, state.arena.width, state.arena.height, config.scale) < 0) {
+    if (render_init(&ctx, state.arena.map->width, state.arena.map->height, config.scale) < 0) {
         fprintf(stderr, "Failed to initialize renderer\n");
         return 1;
     }
@@ -107,6 +111,19 @@ int main(int argc, char* argv[]) {
                 if (sc == keymap.bindings[KEY_SCREENSHOT]) {
                     screenshot_save(&ctx);
                 }
+                if (sc == keymap.bindings[KEY_TRACE]) {
+                    if (!trace_is_on()) {
+                        trace_start(0);
+                        printf("Tracing started\n");
+                    } else {
+                        trace_stop();
+                        if (trace_dump(TRACE_FILE)) {
+                            printf("Trace saved: %s\n", TRACE_FILE);
+                        } else {
+                            fprintf(stderr, "Failed to write %s\n", TRACE_FILE);
+                        }
+                    }
+                }
             }
         }
 
@@ -114,7 +131,7 @@ int main(int argc, char* argv[]) {
             Uint32 now = SDL_GetTicks();
             while (now - last_tick_time >= TICK_MS) {
                 const Uint8* kb_state = SDL_GetKeyboardState(NULL);
-                PlayerAction actions[2];
+                PlayerAction actions[MAX_PLAYERS] = {0};
                 keymap_get_actions(&keymap, kb_state, &state, actions);
                 game_step(&state, actions);
                 last_tick_time += TICK_MS;
@@ -124,7 +141,9 @@ int main(int argc, char* argv[]) {
         render_game(&ctx, &state);
     }
 
+    trace_clear();
     render_cleanup(&ctx);
+    game_free(&state);
     printf("Goodbye!\n");
 
     return 0;
@@ -1,4 +1,6 @@
 #include "render.h"
+#include "map.h"
+#include "trace.h"
 #include <SDL_image.h>
 #include <stdio.h>
 
@@ -10,6 +12,14 @@ static const Color COLOR_CRYSTAL = {0, 200, 255, 255};
 static const Color COLOR_CRYSTAL_COOLDOWN = {0, 80, 100, 255};
 static const Color COLOR_PLAYER1 = {255, 100, 100, 255};
 static const Color COLOR_PLAYER2 = {100, 100, 255, 255};
+static const Color COLOR_PLAYER_EXTRA[MAX_PLAYERS - 2] = {
+    {100, 220, 100, 255},
+    {240, 220, 80, 255},
+    {220, 120, 240, 255},
+    {80, 220, 220, 255},
+    {255, 160, 60, 255},
+    {200, 200, 200, 255},
+};
 static const Color COLOR_PLAYER_DEAD = {80, 80, 80, 255};
 static const Color COLOR_HUD_BG  = {20, 20, 20, 255};
 static const Color COLOR_HEALTH  = {255, 50, 50, 255};
@@ -114,19 +124,20 @@ void render_cleanup(RenderContext* ctx) {
 }
 
 void render_arena(RenderContext* ctx, const Arena* arena) {
-    for (int y = 0; y < arena->height; y++) {
-        for (int x = 0; x < arena->width; x++) {
+    const MapData* map = arena->map;
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
             int screen_x = x * TILE_SIZE;
             int screen_y = y * TILE_SIZE;
 
             if (ctx->sprites.loaded) {
-                SpriteIndex sprite = sprite_for_tile(arena->tiles[y][x]);
+                SpriteIndex sprite = sprite_for_tile(map_get_tile(map, x, y));
                 sprites_render(ctx->renderer, &ctx->sprites, sprite, screen_x, screen_y);
             } else {
                 // Fallback to primitive rendering
                 SDL_Rect tile_rect = {screen_x, screen_y, TILE_SIZE - 1, TILE_SIZE - 1};
 
-                switch (arena->tiles[y][x]) {
+                switch (map_get_tile(map, x, y)) {
                     case TILE_FLOOR:
                         set_draw_color(ctx->renderer, COLOR_FLOOR);
                         break;
@@ -145,13 +156,13 @@ void render_arena(RenderContext* ctx, const Arena* arena) {
 }
 
 void render_crystals(RenderContext* ctx, const Arena* arena) {
-    for (int i = 0; i < arena->num_crystals; i++) {
-        const Crystal* crystal = &arena->crystals[i];
-        int screen_x = crystal->pos.x * TILE_SIZE;
-        int screen_y = crystal->pos.y * TILE_SIZE;
+    for (int i = 0; i < arena->map->num_crystals; i++) {
+        Position pos = arena->map->crystals[i];
+        bool on_cooldown = (arena->crystal_cooldowns[i] > 0);
+        int screen_x = pos.x * TILE_SIZE;
+        int screen_y = pos.y * TILE_SIZE;
 
         if (ctx->sprites.loaded) {
-            bool on_cooldown = (crystal->cooldown_ticks > 0);
             SpriteIndex sprite = sprite_for_crystal(on_cooldown);
             sprites_render(ctx->renderer, &ctx->sprites, sprite, screen_x, screen_y);
         } else {
@@ -160,7 +171,7 @@ void render_crystals(RenderContext* ctx, const Arena* arena) {
             int cy = screen_y + TILE_SIZE / 2;
             int size = TILE_SIZE / 3;
 
-            if (crystal->cooldown_ticks > 0) {
+            if (on_cooldown) {
                 set_draw_color(ctx->renderer, COLOR_CRYSTAL_COOLDOWN);
             } else {
                 set_draw_color(ctx->renderer, COLOR_CRYSTAL);
@@ -187,8 +198,14 @@ void render_crystals(RenderContext* ctx, const Arena* arena) {
     }
 }
 
-void render_players(RenderContext* ctx, const Player players[MAX_PLAYERS]) {
-    for (int i = 0; i < MAX_PLAYERS; i++) {
+static Color player_color(int index) {
+    if (index == 0) return COLOR_PLAYER1;
+    if (index == 1) return COLOR_PLAYER2;
+    return COLOR_PLAYER_EXTRA[index - 2];
+}
+
+void render_players(RenderContext* ctx, const Player* players, int num_players) {
+    for (int i = 0; i < num_players; i++) {
         const Player* player = &players[i];
         int screen_x = player->pos.x * TILE_SIZE;
         int screen_y = player->pos.y * TILE_SIZE;
@@ -202,14 +219,7 @@ void render_players(RenderContext* ctx, const Player players[MAX_PLAYERS]) {
             int py = screen_y + TILE_SIZE / 2;
             int radius = TILE_SIZE / 3;
 
-            Color color;
-            if (!player->alive) {
-                color = COLOR_PLAYER_DEAD;
-            } else if (i == 0) {
-                color = COLOR_PLAYER1;
-            } else {
-                color = COLOR_PLAYER2;
-            }
+            Color color = player->alive ? player_color(i) : COLOR_PLAYER_DEAD;
 
             set_draw_color(ctx->renderer, color);
 
@@ -238,7 +248,7 @@ void render_players(RenderContext* ctx, const Player players[MAX_PLAYERS]) {
 }
 
 void render_hud(RenderContext* ctx, const GameState* state) {
-    int hud_y = state->arena.height * TILE_SIZE;
+    int hud_y = state->arena.map->height * TILE_SIZE;
 
     // HUD background
     SDL_Rect hud_rect = {0, hud_y, ctx->window_width, HUD_HEIGHT};
@@ -250,14 +260,13 @@ void render_hud(RenderContext* ctx, const GameState* state) {
     SDL_RenderDrawLine(ctx->renderer, 0, hud_y, ctx->window_width, hud_y);
 
     // Player stats
-    for (int i = 0; i < MAX_PLAYERS; i++) {
+    for (int i = 0; i < state->num_players; i++) {
         const Player* player = &state->players[i];
-        int base_x = i * (ctx->window_width / 2) + 10;
+        int base_x = i * (ctx->window_width / state->num_players) + 10;
         int bar_y = hud_y + 10;
 
         // Player indicator
-        Color player_color = (i == 0) ? COLOR_PLAYER1 : COLOR_PLAYER2;
-        set_draw_color(ctx->renderer, player_color);
+        set_draw_color(ctx->renderer, player_color(i));
         SDL_Rect indicator = {base_x, bar_y, 10, 40};
         SDL_RenderFillRect(ctx->renderer, &indicator);
 
@@ -342,16 +351,24 @@ void render_lasers(RenderContext* ctx, const GameState* state) {
 }
 
 void render_game(RenderContext* ctx, const GameState* state) {
+    TRACE_BEGIN("render_game");
+
     // Render to offscreen texture at native resolution
     SDL_SetRenderTarget(ctx->renderer, ctx->target);
     SDL_SetRenderDrawColor(ctx->renderer, 0, 0, 0, 255);
     SDL_RenderClear(ctx->renderer);
 
+    TRACE_BEGIN("render_arena");
     render_arena(ctx, &state->arena);
+    TRACE_END("render_arena");
     render_crystals(ctx, &state->arena);
+    TRACE_BEGIN("render_lasers");
     render_lasers(ctx, state);
-    render_players(ctx, state->players);
+    TRACE_END("render_lasers");
+    render_players(ctx, state->players, state->num_players);
+    TRACE_BEGIN("render_hud");
     render_hud(ctx, state);
+    TRACE_END("render_hud");
 
     // Switch to window and blit scaled texture
     SDL_SetRenderTarget(ctx->renderer, NULL);
@@ -380,5 +397,9 @@ void render_game(RenderContext* ctx, const GameState* state) {
     };
 
     SDL_RenderCopy(ctx->renderer, ctx->target, NULL, &dst);
+    TRACE_BEGIN("SDL_RenderPresent");
     SDL_RenderPresent(ctx->renderer);
+    TRACE_END("SDL_RenderPresent");
+
+    TRACE_END("render_game");
 }
@@ -38,7 +38,7 @@ void render_game(RenderContext* ctx, const GameState* state);
 // Individual render functions (for flexibility)
 void render_arena(RenderContext* ctx, const Arena* arena);
 void render_crystals(RenderContext* ctx, const Arena* arena);
-void render_players(RenderContext* ctx, const Player players[MAX_PLAYERS]);
+void render_players(RenderContext* ctx, const Player* players, int num_players);
 void render_hud(RenderContext* ctx, const GameState* state);
 void render_lasers(RenderContext* ctx, const GameState* state);
 
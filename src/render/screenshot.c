@@ -1,4 +1,5 @@
 #include "screenshot.h"
+#include "trace.h"
 #include <stdio.h>
 #include <time.h>
 #include <sys/stat.h>
@@ -30,7 +31,7 @@ static void generate_filename(char* buffer, size_t size) {
              t->tm_hour, t->tm_min, t->tm_sec);
 }
 
-int screenshot_save(RenderContext* ctx) {
+static int save_png(RenderContext* ctx) {
     if (ensure_screenshots_dir() != 0) {
         return -1;
     }
@@ -73,3 +74,10 @@ int screenshot_save(RenderContext* ctx) {
     printf("Screenshot saved: %s\n", filename);
     return 0;
 }
+
+int screenshot_save(RenderContext* ctx) {
+    TRACE_BEGIN("screenshot_save");
+    int result = save_png(ctx);
+    TRACE_END("screenshot_save");
+    return result;
+}
@@ -1,12 +1,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include "../src/core/types.h"
 #include "../src/core/arena.h"
 #include "../src/core/player.h"
 #include "../src/core/combat.h"
 #include "../src/core/game.h"
 #include "../src/core/api.h"
+#include "../src/core/dataset.h"
+#include "../src/core/delta.h"
+#include "../src/core/map.h"
+#include "../src/core/mappack.h"
+#include "../src/core/mapgen.h"
+#include "../src/core/distance.h"
+#include "../src/core/observation.h"
+#include "../src/core/occupancy.h"
+#include "../src/core/batch.h"
+#include "../src/core/trace.h"
+#include "../src/core/framestack.h"
 
 // Simple test framework
 static int tests_run = 0;
@@ -73,8 +86,8 @@ static const char* TEST_MAP_UTF8 =
 // =============================================================================
 
 void test_arena_load(Arena* arena) {
-    ASSERT_EQ(arena->width, 7);
-    ASSERT_EQ(arena->height, 7);
+    ASSERT_EQ(arena->map->width, 7);
+    ASSERT_EQ(arena->map->height, 7);
 
     // Check corners are void
     ASSERT_EQ(arena_get_tile(arena, 0, 0), TILE_VOID);
@@ -101,20 +114,20 @@ void test_arena_load(Arena* arena) {
     ASSERT_EQ(arena_get_tile(arena, 1, 5), TILE_FLOOR);
 
     // Check crystal positions
-    ASSERT_EQ(arena->crystals[0].pos.x, 5);
-    ASSERT_EQ(arena->crystals[0].pos.y, 1);
-    ASSERT_EQ(arena->crystals[1].pos.x, 1);
-    ASSERT_EQ(arena->crystals[1].pos.y, 5);
+    ASSERT_EQ(arena->map->crystals[0].x, 5);
+    ASSERT_EQ(arena->map->crystals[0].y, 1);
+    ASSERT_EQ(arena->map->crystals[1].x, 1);
+    ASSERT_EQ(arena->map->crystals[1].y, 5);
 
     // Check spawn points
-    ASSERT_EQ(arena->num_spawn_points, 2);
-    ASSERT_EQ(arena->spawn_points[0].pos.x, 1);
-    ASSERT_EQ(arena->spawn_points[0].pos.y, 2);
-    ASSERT_EQ(arena->spawn_points[1].pos.x, 5);
-    ASSERT_EQ(arena->spawn_points[1].pos.y, 4);
+    ASSERT_EQ(arena->map->num_spawn_points, 2);
+    ASSERT_EQ(arena->map->spawn_points[0].pos.x, 1);
+    ASSERT_EQ(arena->map->spawn_points[0].pos.y, 2);
+    ASSERT_EQ(arena->map->spawn_points[1].pos.x, 5);
+    ASSERT_EQ(arena->map->spawn_points[1].pos.y, 4);
 
     // Check crystal count
-    ASSERT_EQ(arena->num_crystals, 2);
+    ASSERT_EQ(arena->map->num_crystals, 2);
 }
 
 TEST(test_arena_load_ascii) {
@@ -149,6 +162,87 @@ TEST(test_arena_crystal) {
     ASSERT(arena_crystal_available(&arena, crystal_idx), "Crystal should respawn after cooldown");
 }
 
+TEST(test_arena_shared_map) {
+    GameState a, b;
+    game_init(&a, TEST_MAP_ASCII);
+    game_init(&b, TEST_MAP_ASCII);
+
+    // Same source text shares one interned map
+    ASSERT(a.arena.map == b.arena.map, "States should share map data");
+    int refs = a.arena.map->refcount;
+    ASSERT(refs >= 2, "Shared map should be refcounted");
+
+    // Crystal cooldowns stay per-env
+    arena_collect_crystal(&a.arena, 0);
+    ASSERT(!arena_crystal_available(&a.arena, 0), "Crystal should be collected in env a");
+    ASSERT(arena_crystal_available(&b.arena, 0), "Crystal should still be available in env b");
+
+    // Mutable per-env state no longer carries the tile grid
+    ASSERT(sizeof(GameState) < map_data_size(a.arena.map), "GameState should be smaller than the map");
+
+    game_free(&b);
+    ASSERT_EQ(a.arena.map->refcount, refs - 1);
+    game_free(&a);
+}
+
+TEST(test_arena_load_too_large) {
+    char big[(MAX_ARENA_WIDTH + 2) * 2 + 1];
+    memset(big, '.', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+
+    Arena arena;
+    ASSERT(!arena_load_from_string(&arena, big), "Oversized map should fail to load");
+    ASSERT_EQ(arena.map->width, 0);
+    ASSERT_EQ(arena_get_tile(&arena, 0, 0), TILE_VOID);
+}
+
+TEST(test_arena_runtime_sized_storage) {
+    // Small maps get small tables
+    MapData* small = map_data_parse(TEST_MAP_ASCII);
+    ASSERT(small != NULL, "Failed to parse map");
+    ASSERT_EQ(small->stride % MAP_ROW_ALIGN, 0);
+    ASSERT(map_data_size(small) < 16 * 1024, "7x7 map should stay small");
+    map_data_release(small);
+
+    // Large maps work end to end, with aligned rows
+    MapGenParams params;
+    mapgen_default_params(&params, 5);
+    params.width = 256;
+    params.height = 256;
+    params.num_spawns = 4;
+    MapData* map = mapgen_generate(&params);
+    ASSERT(map != NULL, "256x256 generation failed");
+    ASSERT_EQ(map->stride % MAP_ROW_ALIGN, 0);
+    ASSERT_EQ((uintptr_t)map->tiles % MAP_ROW_ALIGN, 0);
+    ASSERT_EQ((uintptr_t)map_ray_length(map, DIR_DOWN) % MAP_ROW_ALIGN, 0);
+    ASSERT_EQ((uintptr_t)map_crystal_distance(map, 0) % MAP_ROW_ALIGN, 0);
+
+    GameState state;
+    game_init_map(&state, map);
+    map_data_release(map);
+    game_set_num_players(&state, 4);
+    for (int i = 0; i < 4; i++) {
+        Position pos = state.players[i].pos;
+        ASSERT_EQ(pos.x, state.arena.map->spawn_points[i].pos.x);
+        ASSERT_EQ(pos.y, state.arena.map->spawn_points[i].pos.y);
+    }
+
+    // Play some steps with movement and shooting
+    PlayerAction actions[4] = {{ACTION_NOOP, ACTION_NOOP}};
+    for (int step = 0; step < 50; step++) {
+        for (int i = 0; i < 4; i++) {
+            actions[i].move = (ActionType)(1 + (step + i) % 4);
+            actions[i].shoot = (ActionType)(1 + (step * 3 + i) % 4);
+        }
+        game_step(&state, actions);
+    }
+    for (int i = 0; i < 4; i++) {
+        ASSERT(arena_is_passable(&state.arena, state.players[i].pos.x, state.players[i].pos.y),
+               "Players should stay on floor");
+    }
+    game_free(&state);
+}
+
 // =============================================================================
 // Player Tests
 // =============================================================================
@@ -461,6 +555,24 @@ TEST(test_game_frag_and_respawn) {
     ASSERT_EQ(state.players[1].pos.x, 4); // deterministic based on seed
 }
 
+TEST(test_game_copy) {
+    GameState state, copy;
+    game_init(&state, "1 . . 2");
+    ASSERT(game_copy(&copy, &state), "Copy should succeed");
+    ASSERT(copy.arena.map == state.arena.map, "Copy should share the map");
+    ASSERT(copy.arena.occupancy != state.arena.occupancy, "Copy should own its grid");
+
+    // Stepping the copy leaves the original's grid alone
+    PlayerAction actions[2] = {{ACTION_RIGHT, ACTION_NOOP}, {ACTION_NOOP, ACTION_NOOP}};
+    game_step(&copy, actions);
+    ASSERT_EQ(occupancy_player_at(&copy, 1, 0), 0);
+    ASSERT_EQ(occupancy_player_at(&state, 0, 0), 0);
+    ASSERT_EQ(state.arena.occupancy[map_index(state.arena.map, 1, 0)], OCCUPANCY_EMPTY);
+
+    game_free(&copy);
+    game_free(&state);
+}
+
 // =============================================================================
 // API Tests
 // =============================================================================
@@ -489,6 +601,1703 @@ TEST(test_api_step) {
     ASSERT_EQ(api_get_current_tick(&state), 1);
 }
 
+TEST(test_api_profile_stats) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    api_reset_profile_stats();
+    int actions[4] = {ACTION_RIGHT, ACTION_NOOP, ACTION_LEFT, ACTION_NOOP};
+    for (int i = 0; i < 10; i++) {
+        api_game_step(&state, actions);
+    }
+    api_game_free(&state);
+
+    ProfileStats stats;
+    if (!api_get_profile_stats(&stats)) {
+        // Compiled out: nothing recorded
+        ASSERT(!profile_enabled(), "Stats should only be missing without ARENA_PROFILE");
+        ASSERT_EQ((int)stats.phases[PROFILE_MOVEMENT].calls, 0);
+        return;
+    }
+    for (int p = 0; p < PROFILE_NUM_PHASES; p++) {
+        const ProfilePhaseStats* s = &stats.phases[p];
+        uint64_t counted = 0;
+        for (int b = 0; b < PROFILE_HIST_BUCKETS; b++) {
+            counted += s->histogram[b];
+        }
+        ASSERT_EQ((int)s->calls, p == PROFILE_RESPAWN ? 20 : 10);
+        ASSERT_EQ((int)counted, (int)s->calls);
+        ASSERT(s->min_ticks <= s->max_ticks, "Min should not exceed max");
+    }
+}
+
+TEST(test_api_struct_layout) {
+    const ApiStructLayout* state = api_get_struct_layout("GameState");
+    ASSERT(state != NULL, "GameState should be described");
+    ASSERT_EQ(state->size, api_get_state_size());
+    ASSERT(api_get_struct_layout("Crystal") == NULL, "Unknown structs should not be found");
+    ASSERT(api_get_struct_layout_at(api_get_num_struct_layouts()) == NULL, "Index past the end");
+
+    // Every field lies inside its struct, after the previous one, and
+    // struct-typed fields refer to a described struct of matching size
+    for (int i = 0; i < api_get_num_struct_layouts(); i++) {
+        const ApiStructLayout* s = api_get_struct_layout_at(i);
+        int end = 0;
+        for (int f = 0; f < s->num_fields; f++) {
+            const ApiFieldLayout* field = &s->fields[f];
+            const ApiStructLayout* nested = api_get_struct_layout(field->type);
+            if (nested) {
+                ASSERT_EQ(field->size, nested->size);
+            }
+            ASSERT(field->offset >= end, "Fields should be in offset order without overlap");
+            end = field->offset + field->size * field->count;
+            ASSERT(end <= s->size, "Field should fit in its struct");
+        }
+    }
+
+    // Reading a field through the layout matches the getter
+    GameState g;
+    api_game_init(&g, TEST_MAP_ASCII);
+    int actions[4] = {ACTION_RIGHT, ACTION_NOOP, ACTION_NOOP, ACTION_NOOP};
+    api_game_step(&g, actions);
+    int players = -1, pos = -1, x = -1;
+    for (int f = 0; f < state->num_fields; f++) {
+        if (strcmp(state->fields[f].name, "players") == 0) {
+            players = f;
+        }
+    }
+    ASSERT(players >= 0, "GameState should have players");
+    ASSERT_EQ(state->fields[players].count, MAX_PLAYERS);
+    const ApiStructLayout* player = api_get_struct_layout(state->fields[players].type);
+    const ApiStructLayout* position = api_get_struct_layout("Position");
+    ASSERT(player != NULL && position != NULL, "Player and Position should be described");
+    for (int f = 0; f < player->num_fields; f++) {
+        if (strcmp(player->fields[f].name, "pos") == 0) {
+            pos = player->fields[f].offset;
+        }
+    }
+    for (int f = 0; f < position->num_fields; f++) {
+        if (strcmp(position->fields[f].name, "x") == 0) {
+            x = position->fields[f].offset;
+        }
+    }
+    const char* base = (const char*)&g + state->fields[players].offset;
+    int value;
+    memcpy(&value, base + player->size + pos + x, sizeof(value));
+    ASSERT_EQ(value, api_get_player_x(&g, 1));
+    memcpy(&value, base + pos + x, sizeof(value));
+    ASSERT_EQ(value, api_get_player_x(&g, 0));
+    api_game_free(&g);
+}
+
+#define TEST_TRACE_FILE "build/test_trace.json"
+
+// Count occurrences of needle in the trace file
+static int count_in_trace(const char* needle) {
+    FILE* f = fopen(TEST_TRACE_FILE, "rb");
+    if (!f) {
+        return -1;
+    }
+    static char text[65536];
+    size_t n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = '\0';
+    int count = 0;
+    for (const char* p = text; (p = strstr(p, needle)); p++) {
+        count++;
+    }
+    return count;
+}
+
+TEST(test_api_trace_dump) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    int actions[4] = {ACTION_NOOP, ACTION_NOOP, ACTION_NOOP, ACTION_NOOP};
+
+    api_trace_start(0);
+    for (int i = 0; i < 5; i++) {
+        api_game_step(&state, actions);
+    }
+    api_trace_stop();
+    api_game_step(&state, actions);  // not recorded
+    ASSERT(api_trace_dump(TEST_TRACE_FILE), "Dump failed");
+    ASSERT_EQ(count_in_trace("\"name\": \"game_step\", \"ph\": \"B\""), 5);
+    ASSERT_EQ(count_in_trace("\"name\": \"game_step\", \"ph\": \"E\""), 5);
+
+    // A 5-event ring keeps the last two spans plus the end of the one
+    // before, which is dropped since its begin was overwritten
+    api_trace_start(5);
+    for (int i = 0; i < 5; i++) {
+        api_game_step(&state, actions);
+    }
+    api_trace_stop();
+    ASSERT(api_trace_dump(TEST_TRACE_FILE), "Dump failed");
+    ASSERT_EQ(count_in_trace("\"ph\": \"B\""), 2);
+    ASSERT_EQ(count_in_trace("\"ph\": \"E\""), 2);
+
+    trace_clear();
+    api_game_free(&state);
+}
+
+// =============================================================================
+// Dataset Tests
+// =============================================================================
+
+#define TEST_DATASET_DIR "build/test_dataset"
+
+TEST(test_dataset_roundtrip) {
+    // Small chunk size so rows span several background writes
+    DatasetColumn columns[2] = {
+        {"value", DATASET_I32, 2},
+        {"flag",  DATASET_U8,  1}
+    };
+    DatasetWriter* writer = dataset_writer_open(TEST_DATASET_DIR, columns, 2, 4);
+    ASSERT(writer != NULL, "Failed to open dataset writer");
+
+    for (int i = 0; i < 11; i++) {
+        int32_t value[2] = {i, i * 10};
+        uint8_t flag = (uint8_t)(i & 1);
+        const void* fields[2] = {value, &flag};
+        ASSERT(dataset_writer_append(writer, fields), "Append failed");
+    }
+    ASSERT_EQ(dataset_writer_rows(writer), 11);
+    ASSERT(dataset_writer_close(writer), "Close failed");
+
+    DatasetReader reader;
+    ASSERT(dataset_reader_open(&reader, TEST_DATASET_DIR), "Failed to open dataset reader");
+    ASSERT_EQ(reader.rows, 11);
+    ASSERT_EQ(reader.num_columns, 2);
+
+    const DatasetReaderColumn* value = dataset_reader_column(&reader, "value");
+    const DatasetReaderColumn* flag = dataset_reader_column(&reader, "flag");
+    ASSERT(value != NULL && flag != NULL, "Columns should exist");
+    ASSERT_EQ(value->width, 2);
+    ASSERT_EQ(value->dtype, DATASET_I32);
+
+    const int32_t* values = (const int32_t*)value->data;
+    const uint8_t* flags = (const uint8_t*)flag->data;
+    for (int i = 0; i < 11; i++) {
+        ASSERT_EQ(values[i * 2], i);
+        ASSERT_EQ(values[i * 2 + 1], i * 10);
+        ASSERT_EQ(flags[i], i & 1);
+    }
+    dataset_reader_close(&reader);
+}
+
+TEST(test_dataset_rejects_truncated_column) {
+    DatasetColumn columns[1] = {{"value", DATASET_I32, 2}};
+    DatasetWriter* writer = dataset_writer_open(TEST_DATASET_DIR, columns, 1, 0);
+    ASSERT(writer != NULL, "Failed to open dataset writer");
+    for (int i = 0; i < 5; i++) {
+        int32_t value[2] = {i, i};
+        const void* fields[1] = {value};
+        ASSERT(dataset_writer_append(writer, fields), "Append failed");
+    }
+    ASSERT(dataset_writer_close(writer), "Close failed");
+
+    // Cut the column file short of the 5 rows meta.json promises
+    FILE* f = fopen(TEST_DATASET_DIR "/value.bin", "wb");
+    ASSERT(f != NULL, "Failed to truncate column file");
+    int32_t partial[2] = {0, 0};
+    fwrite(partial, sizeof(partial), 1, f);
+    fclose(f);
+
+    DatasetReader reader;
+    ASSERT(!dataset_reader_open(&reader, TEST_DATASET_DIR), "Truncated column should be rejected");
+}
+
+TEST(test_dataset_trajectory) {
+    GameState state;
+    game_init(&state, "1 . . 2");
+
+    DatasetWriter* writer = trajectory_writer_open(TEST_DATASET_DIR, 3, 2, 0);
+    ASSERT(writer != NULL, "Failed to open trajectory writer");
+
+    PlayerAction actions[2] = {
+        {ACTION_NOOP, ACTION_RIGHT},
+        {ACTION_NOOP, ACTION_NOOP}
+    };
+    StepInfo info = game_step(&state, actions);
+    float obs[3] = {0.5f, 1.0f, 2.0f};
+    float rewards[MAX_PLAYERS] = {0.5f, -0.5f};
+    ASSERT(trajectory_writer_append(writer, obs, actions, rewards, false, &info), "Append failed");
+    ASSERT(dataset_writer_close(writer), "Close failed");
+
+    DatasetReader reader;
+    ASSERT(dataset_reader_open(&reader, TEST_DATASET_DIR), "Failed to open dataset reader");
+    ASSERT_EQ(reader.rows, 1);
+
+    const DatasetReaderColumn* action = dataset_reader_column(&reader, "action");
+    const DatasetReaderColumn* hit = dataset_reader_column(&reader, "info_player_hit");
+    const DatasetReaderColumn* reward = dataset_reader_column(&reader, "reward");
+    const DatasetReaderColumn* frags = dataset_reader_column(&reader, "info_frags");
+    ASSERT(action != NULL && hit != NULL && reward != NULL && frags != NULL,
+           "Columns should exist");
+    ASSERT_EQ(frags->width, 2);
+    ASSERT_EQ(((const int32_t*)action->data)[1], ACTION_RIGHT);
+    ASSERT_EQ(((const uint8_t*)hit->data)[1], 1);
+    ASSERT(((const float*)reward->data)[1] == -0.5f, "Reward should round-trip");
+    ASSERT_EQ(((const int32_t*)frags->data)[0], info.frags[0]);
+    dataset_reader_close(&reader);
+}
+
+// =============================================================================
+// Delta Tests
+// =============================================================================
+
+#define TEST_DELTA_FRAMES 300
+#define TEST_DELTA_FILE "build/test_delta.bin"
+
+// Decoded states point at the sequence's copy of the map
+static bool states_equal_except_map(const GameState* a, const GameState* b) {
+    GameState ca = *a;
+    GameState cb = *b;
+    ca.arena.map = NULL;
+    cb.arena.map = NULL;
+    ca.arena.occupancy = NULL;
+    cb.arena.occupancy = NULL;
+    return memcmp(&ca, &cb, sizeof(GameState)) == 0 &&
+           map_data_size(a->arena.map) == map_data_size(b->arena.map) &&
+           memcmp(&a->arena.map->width, &b->arena.map->width,
+                  map_data_size(a->arena.map) - sizeof(int)) == 0;
+}
+
+// Play a deterministic pseudo-random episode, recording every state
+static GameState* record_random_episode(DeltaSequence* seq) {
+    GameState* states = malloc(sizeof(GameState) * TEST_DELTA_FRAMES);
+    if (!states) return NULL;
+
+    GameState state;
+    memset(&state, 0, sizeof(state));
+    game_init(&state, TEST_MAP_ASCII);
+    api_game_set_seed(7);
+
+    unsigned int rng = 99;
+    for (int t = 0; t < TEST_DELTA_FRAMES; t++) {
+        states[t] = state;
+        delta_seq_push_state(seq, &state);
+
+        PlayerAction actions[MAX_PLAYERS];
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            rng = rng * 1103515245 + 12345;
+            actions[i].move = (ActionType)((rng >> 16) % 5);
+            rng = rng * 1103515245 + 12345;
+            actions[i].shoot = (ActionType)((rng >> 16) % 5);
+        }
+        game_step(&state, actions);
+    }
+    return states;
+}
+
+TEST(test_delta_roundtrip) {
+    DeltaSequence seq;
+    ASSERT(delta_seq_init_states(&seq, 16), "Failed to init sequence");
+
+    GameState* states = record_random_episode(&seq);
+    ASSERT(states != NULL, "Failed to record episode");
+    ASSERT_EQ(seq.num_frames, TEST_DELTA_FRAMES);
+
+    // Random access in reverse order exercises keyframe seeking
+    GameState decoded;
+    for (int t = TEST_DELTA_FRAMES - 1; t >= 0; t--) {
+        if (!delta_seq_get_state(&seq, t, &decoded) ||
+            !states_equal_except_map(&decoded, &states[t])) {
+            free(states);
+            delta_seq_free(&seq);
+            ASSERT(false, "Decoded state should match recorded state");
+        }
+    }
+
+    // Frame stream only; the map and dictionary are stored once per episode
+    size_t raw_size = sizeof(GameState) * TEST_DELTA_FRAMES;
+    size_t frames_size = seq.data_size;
+    free(states);
+    delta_seq_free(&seq);
+    ASSERT(frames_size * 5 < raw_size, "Frames should compress at least 5x");
+}
+
+TEST(test_delta_file_roundtrip) {
+    DeltaSequence seq;
+    ASSERT(delta_seq_init_states(&seq, 0), "Failed to init sequence");
+    GameState* states = record_random_episode(&seq);
+    ASSERT(states != NULL, "Failed to record episode");
+
+    FILE* f = fopen(TEST_DELTA_FILE, "wb");
+    ASSERT(f != NULL, "Failed to open archive for writing");
+    bool written = delta_seq_write(&seq, f);
+    fclose(f);
+    delta_seq_free(&seq);
+    ASSERT(written, "Failed to write archive");
+
+    DeltaSequence loaded;
+    f = fopen(TEST_DELTA_FILE, "rb");
+    ASSERT(f != NULL, "Failed to open archive for reading");
+    bool read = delta_seq_read(&loaded, f);
+    fclose(f);
+    ASSERT(read, "Failed to read archive");
+    ASSERT_EQ(loaded.num_frames, TEST_DELTA_FRAMES);
+
+    GameState decoded;
+    bool match = delta_seq_get_state(&loaded, 123, &decoded) &&
+                 states_equal_except_map(&decoded, &states[123]);
+    free(states);
+    delta_seq_free(&loaded);
+    ASSERT(match, "Loaded archive should decode the recorded state");
+}
+
+// Write bytes as the archive file and read it back
+static bool read_delta_bytes(const unsigned char* bytes, size_t size, DeltaSequence* out) {
+    FILE* f = fopen(TEST_DELTA_FILE, "wb");
+    if (!f) return false;
+    bool written = fwrite(bytes, size, 1, f) == 1;
+    fclose(f);
+    f = fopen(TEST_DELTA_FILE, "rb");
+    if (!f) return false;
+    bool read = written && delta_seq_read(out, f);
+    fclose(f);
+    return read;
+}
+
+TEST(test_delta_rejects_corrupt_archive) {
+    // Six 16-byte records, keyframes every 4
+    DeltaSequence seq;
+    ASSERT(delta_seq_init(&seq, 16, 4), "Failed to init sequence");
+    for (int t = 0; t < 6; t++) {
+        unsigned char record[16] = {0};
+        record[t] = (unsigned char)(t + 1);
+        ASSERT(delta_seq_push(&seq, record), "Failed to push record");
+    }
+    FILE* f = fopen(TEST_DELTA_FILE, "wb");
+    ASSERT(f != NULL, "Failed to open archive for writing");
+    bool written = delta_seq_write(&seq, f);
+    fclose(f);
+    delta_seq_free(&seq);
+    ASSERT(written, "Failed to write archive");
+
+    unsigned char bytes[256];
+    f = fopen(TEST_DELTA_FILE, "rb");
+    ASSERT(f != NULL, "Failed to open archive for reading");
+    size_t size = fread(bytes, 1, sizeof(bytes), f);
+    fclose(f);
+
+    // Header fields are u32 at 8 (record_size), 12 (interval) and 20
+    // (num_keyframes); frame data starts after the header, two u64
+    // sizes, the dictionary and two keyframe offsets
+    const size_t header_fields[3] = {8, 12, 20};
+    for (int i = 0; i < 3; i++) {
+        unsigned char bad[256];
+        memcpy(bad, bytes, size);
+        memset(bad + header_fields[i], 0, 4);
+        ASSERT(!read_delta_bytes(bad, size, &seq), "Inconsistent header should be rejected");
+    }
+
+    // u64 data_size at 24 and map_size at 32 past the end of the file
+    const size_t size_fields[2] = {24, 32};
+    for (int i = 0; i < 2; i++) {
+        unsigned char bad[256];
+        memcpy(bad, bytes, size);
+        memset(bad + size_fields[i], 0xFF, 8);
+        ASSERT(!read_delta_bytes(bad, size, &seq), "Sizes past the file should be rejected");
+    }
+
+    // A zero run longer than the record in frame 0
+    size_t data_start = 24 + 16 + 16 + 2 * 8;
+    bytes[data_start] = 0x7F;
+    ASSERT(read_delta_bytes(bytes, size, &seq), "Frames past the bad one still decode");
+    unsigned char out[16];
+    bool bad_frame = delta_seq_get(&seq, 0, out);
+    bool good_frame = delta_seq_get(&seq, 5, out);
+    delta_seq_free(&seq);
+    ASSERT(!bad_frame, "Overrunning frame should fail to decode");
+    ASSERT(good_frame, "Frame from the next keyframe should decode");
+}
+
+TEST(test_delta_rejects_bad_map) {
+    GameState state;
+    game_init(&state, TEST_MAP_ASCII);
+    DeltaSequence seq;
+    ASSERT(delta_seq_init_states(&seq, 0), "Failed to init sequence");
+    bool pushed = delta_seq_push_state(&seq, &state);
+    game_free(&state);
+    FILE* f = fopen(TEST_DELTA_FILE, "wb");
+    bool written = pushed && f && delta_seq_write(&seq, f);
+    if (f) fclose(f);
+    delta_seq_free(&seq);
+    ASSERT(written, "Failed to write archive");
+
+    f = fopen(TEST_DELTA_FILE, "rb");
+    ASSERT(f != NULL, "Failed to open archive for reading");
+    fseek(f, 0, SEEK_END);
+    size_t size = (size_t)ftell(f);
+    rewind(f);
+    unsigned char* bytes = malloc(size);
+    bool read = bytes && fread(bytes, size, 1, f) == 1;
+    fclose(f);
+    ASSERT(read, "Failed to read archive");
+
+    bool intact = read_delta_bytes(bytes, size, &seq);
+    if (intact) delta_seq_free(&seq);
+
+    // The map blob follows the 24-byte header and the two u64 sizes
+    int height = 1000;
+    memcpy(bytes + 24 + 16 + offsetof(MapData, height), &height, sizeof(height));
+    bool bad = read_delta_bytes(bytes, size, &seq);
+    free(bytes);
+    ASSERT(intact, "Unmodified archive should read");
+    ASSERT(!bad, "Map blob with a bad layout should be rejected");
+}
+
+TEST(test_delta_rejects_other_map) {
+    GameState a, b;
+    game_init(&a, TEST_MAP_ASCII);
+    game_init(&b, "1 . # . 2");
+
+    DeltaSequence seq;
+    ASSERT(delta_seq_init_states(&seq, 0), "Failed to init sequence");
+    bool first = delta_seq_push_state(&seq, &a);
+    bool other = delta_seq_push_state(&seq, &b);
+    bool same = delta_seq_push_state(&seq, &a);
+    int frames = seq.num_frames;
+    delta_seq_free(&seq);
+    game_free(&a);
+    game_free(&b);
+    ASSERT(first && same, "States on the episode's map should push");
+    ASSERT(!other, "A state on another map should be rejected");
+    ASSERT_EQ(frames, 2);
+}
+
+// =============================================================================
+// Map Pack Tests
+// =============================================================================
+
+#define TEST_PACK_FILE "build/test_maps.pack"
+
+TEST(test_map_pack_roundtrip) {
+    MapData* maps[2] = {
+        map_data_parse(TEST_MAP_ASCII),
+        map_data_parse("1 . # . 2")
+    };
+    ASSERT(maps[0] && maps[1], "Failed to parse maps");
+    const char* names[2] = {"test_a", "test_b"};
+    bool written = map_pack_write(TEST_PACK_FILE, (const MapData* const*)maps, names, 2);
+
+    MapPack pack;
+    bool opened = written && map_pack_open(&pack, TEST_PACK_FILE);
+    bool same = opened &&
+                map_data_size(map_pack_get(&pack, 0)) == map_data_size(maps[0]) &&
+                memcmp(&map_pack_get(&pack, 0)->width, &maps[0]->width,
+                       map_data_size(maps[0]) - sizeof(int)) == 0;
+    map_data_release(maps[0]);
+    map_data_release(maps[1]);
+    ASSERT(written, "Failed to write pack");
+    ASSERT(opened, "Failed to open pack");
+    ASSERT(same, "Pack map should match the parsed map and tables");
+
+    ASSERT_EQ(pack.num_maps, 2);
+    ASSERT_EQ(map_pack_find(&pack, "test_b"), 1);
+    ASSERT_EQ(map_pack_find(&pack, "missing"), -1);
+    ASSERT(map_pack_get(&pack, 2) == NULL, "Out of range index should return NULL");
+
+    const MapData* map = map_pack_get(&pack, 1);
+    ASSERT_EQ(map->refcount, MAP_DATA_STATIC);
+    ASSERT_EQ(map->width, 5);
+
+    // Envs initialize straight from the mapping
+    GameState state;
+    game_init_map(&state, map);
+    ASSERT(state.arena.map == map, "State should reference the mmapped map");
+    ASSERT_EQ(state.players[1].pos.x, 4);
+
+    PlayerAction actions[2] = {
+        {ACTION_NOOP, ACTION_RIGHT},
+        {ACTION_NOOP, ACTION_NOOP}
+    };
+    game_step(&state, actions);
+    ASSERT_EQ(state.lasers[0].end.x, 2);  // blocked by the wall
+    game_free(&state);
+
+    map_pack_close(&pack);
+}
+
+TEST(test_map_pack_rejects_bad_file) {
+    FILE* f = fopen(TEST_PACK_FILE, "wb");
+    ASSERT(f != NULL, "Failed to create file");
+    fputs("not a map pack", f);
+    fclose(f);
+
+    MapPack pack;
+    ASSERT(!map_pack_open(&pack, TEST_PACK_FILE), "Garbage file should be rejected");
+}
+
+// Rewrite the pack file with one field of the file patched
+static bool open_patched_pack(const unsigned char* bytes, size_t size, size_t at,
+                              const void* value, size_t value_size) {
+    unsigned char* patched = malloc(size);
+    if (!patched) return false;
+    memcpy(patched, bytes, size);
+    memcpy(patched + at, value, value_size);
+    FILE* f = fopen(TEST_PACK_FILE, "wb");
+    bool written = f && fwrite(patched, size, 1, f) == 1;
+    if (f) fclose(f);
+    free(patched);
+
+    MapPack pack;
+    bool opened = written && map_pack_open(&pack, TEST_PACK_FILE);
+    if (opened) map_pack_close(&pack);
+    return opened;
+}
+
+TEST(test_map_pack_rejects_bad_record) {
+    MapData* map = map_data_parse(TEST_MAP_ASCII);
+    ASSERT(map != NULL, "Failed to parse map");
+    const char* name = "test_a";
+    bool written = map_pack_write(TEST_PACK_FILE, (const MapData* const*)&map, &name, 1);
+    map_data_release(map);
+    ASSERT(written, "Failed to write pack");
+
+    FILE* f = fopen(TEST_PACK_FILE, "rb");
+    ASSERT(f != NULL, "Failed to open pack");
+    fseek(f, 0, SEEK_END);
+    size_t size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* bytes = malloc(size);
+    bool read = bytes && fread(bytes, size, 1, f) == 1;
+    fclose(f);
+    ASSERT(read, "Failed to read pack");
+
+    const MapPackEntry* entry = (const MapPackEntry*)(bytes + sizeof(MapPackHeader));
+    size_t record = (size_t)entry->offset;
+    size_t ray_table = record + ((const MapData*)(bytes + record))->ray_length_offset;
+    int wide = MAX_ARENA_WIDTH;
+    uint32_t bad_offset = 0;
+    uint64_t huge = UINT64_MAX - MAP_PACK_ALIGN + 1;
+    uint8_t bad_tile = 7;
+    uint16_t long_ray = 1000;
+
+    bool intact = open_patched_pack(bytes, size, 0, bytes, 1);
+    bool width = open_patched_pack(bytes, size, record + offsetof(MapData, width), &wide,
+                                   sizeof(wide));
+    bool offset = open_patched_pack(bytes, size, record + offsetof(MapData, ray_length_offset),
+                                    &bad_offset, sizeof(bad_offset));
+    bool wrap = open_patched_pack(bytes, size,
+                                  sizeof(MapPackHeader) + offsetof(MapPackEntry, offset),
+                                  &huge, sizeof(huge));
+    bool tile = open_patched_pack(bytes, size, record + offsetof(MapData, tiles), &bad_tile, 1);
+    bool ray = open_patched_pack(bytes, size, ray_table, &long_ray, sizeof(long_ray));
+    free(bytes);
+
+    ASSERT(intact, "Unmodified pack should open");
+    ASSERT(!width, "Width that doesn't match the layout should be rejected");
+    ASSERT(!offset, "Table offset outside the layout should be rejected");
+    ASSERT(!wrap, "Entry offset + size overflow should be rejected");
+    ASSERT(!tile, "Unknown tile value should be rejected");
+    ASSERT(!ray, "Ray longer than the map should be rejected");
+}
+
+// =============================================================================
+// Map Generator Tests
+// =============================================================================
+
+TEST(test_mapgen_symmetric_and_valid) {
+    for (unsigned int seed = 1; seed <= 200; seed++) {
+        MapGenParams params;
+        mapgen_default_params(&params, seed);
+        params.width = 8 + (int)(seed % 20);
+        params.height = 6 + (int)(seed % 17);
+        params.num_crystals = 4;
+        params.num_spawns = 4;
+
+        MapData* map = mapgen_generate(&params);
+        ASSERT(map != NULL, "Generator should find a valid map");
+        ASSERT_EQ(map->width, params.width);
+        ASSERT_EQ(map->height, params.height);
+        ASSERT_EQ(map->num_spawn_points, 4);
+        ASSERT_EQ(map->num_crystals, 4);
+        ASSERT(mapgen_validate(map), "Generated map should pass validation");
+
+        bool symmetric = true;
+        for (int y = 0; y < map->height; y++) {
+            for (int x = 0; x < map->width; x++) {
+                symmetric = symmetric &&
+                    map_get_tile(map, x, y) ==
+                    map_get_tile(map, map->width - 1 - x, map->height - 1 - y);
+            }
+        }
+        ASSERT(symmetric, "Generated map should be point symmetric");
+        ASSERT_EQ(map->spawn_points[1].pos.x, map->width - 1 - map->spawn_points[0].pos.x);
+        ASSERT_EQ(map->spawn_points[1].pos.y, map->height - 1 - map->spawn_points[0].pos.y);
+        map_data_release(map);
+    }
+}
+
+TEST(test_mapgen_deterministic) {
+    MapGenParams params;
+    mapgen_default_params(&params, 1234);
+    MapData* a = mapgen_generate(&params);
+    MapData* b = mapgen_generate(&params);
+    params.seed = 1235;
+    MapData* c = mapgen_generate(&params);
+    ASSERT(a && b && c, "Generation failed");
+    size_t tiles = (size_t)a->height * (size_t)a->stride;
+    bool same = memcmp(a->tiles, b->tiles, tiles) == 0;
+    bool differs = memcmp(a->tiles, c->tiles, tiles) != 0;
+    map_data_release(a);
+    map_data_release(b);
+    map_data_release(c);
+    ASSERT(same, "Same seed should give the same map");
+    ASSERT(differs, "Different seeds should give different maps");
+}
+
+TEST(test_mapgen_validate_rejects) {
+    // Spawns facing each other down an open row
+    MapData* open_row = map_data_parse("1 . . . 2");
+    // Crystal walled off from both spawns
+    MapData* sealed = map_data_parse(
+        "1 . # . .\n"
+        ". . # * .\n"
+        "# # # . 2\n"
+        ". . . . .\n");
+    ASSERT(open_row && sealed, "Failed to parse maps");
+    bool open_ok = mapgen_validate(open_row);
+    bool sealed_ok = mapgen_validate(sealed);
+    map_data_release(open_row);
+    map_data_release(sealed);
+    ASSERT(!open_ok, "Spawns in line of sight should be rejected");
+    ASSERT(!sealed_ok, "Unreachable crystal should be rejected");
+
+    MapGenParams params;
+    mapgen_default_params(&params, 7);
+    params.wall_density = 0.6f;
+    params.void_density = 0.5f;
+    ASSERT(mapgen_generate(&params) == NULL, "Densities over 1 should be rejected");
+}
+
+TEST(test_api_reset_generated) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    ASSERT(api_game_reset_generated(&state, 99, 20, 14, 0.2f, 0.1f), "Reset should succeed");
+    ASSERT_EQ(api_get_arena_width(&state), 20);
+    ASSERT_EQ(api_get_arena_height(&state), 14);
+    ASSERT_EQ(state.current_tick, 0);
+    Position spawn = state.arena.map->spawn_points[0].pos;
+    ASSERT_EQ(state.players[0].pos.x, spawn.x);
+    ASSERT_EQ(state.players[0].pos.y, spawn.y);
+
+    const MapData* before = state.arena.map;
+    ASSERT(!api_game_reset_generated(&state, 99, MAX_ARENA_WIDTH + 1, 14, 0.2f, 0.1f),
+           "Oversized map should fail");
+    ASSERT(state.arena.map == before, "Failed reset should keep the old map");
+    api_game_free(&state);
+}
+
+// =============================================================================
+// Distance Tests
+// =============================================================================
+
+// Plain queue BFS over floor tiles, for checking the bit-parallel version.
+// dist is dense [height][width], -1 where unreachable.
+static void reference_distances(const MapData* map, Position target, int* dist) {
+    int w = map->width;
+    Position* queue = malloc(sizeof(Position) * (size_t)(w * map->height));
+    int head = 0, tail = 0;
+    for (int i = 0; i < w * map->height; i++) {
+        dist[i] = -1;
+    }
+    dist[target.y * w + target.x] = 0;
+    queue[tail++] = target;
+    while (head < tail) {
+        Position p = queue[head++];
+        const int dx[4] = {0, 0, -1, 1};
+        const int dy[4] = {-1, 1, 0, 0};
+        for (int d = 0; d < 4; d++) {
+            Position n = {p.x + dx[d], p.y + dy[d]};
+            if (map_get_tile(map, n.x, n.y) == TILE_FLOOR && dist[n.y * w + n.x] < 0) {
+                dist[n.y * w + n.x] = dist[p.y * w + p.x] + 1;
+                queue[tail++] = n;
+            }
+        }
+    }
+    free(queue);
+}
+
+static Position floor_tile_position(const MapData* map, int i) {
+    Position p = {
+        (int)map_floor_tiles(map)[i] % map->stride,
+        (int)map_floor_tiles(map)[i] / map->stride
+    };
+    return p;
+}
+
+TEST(test_distance_fields_match_bfs) {
+    for (unsigned int seed = 1; seed <= 20; seed++) {
+        // Odd seeds are wider than one 64-column mask word
+        MapGenParams params;
+        mapgen_default_params(&params, seed);
+        params.width = seed % 2 ? 70 : 13;
+        params.height = 9 + (int)seed;
+        params.num_crystals = 4;
+        MapData* map = mapgen_generate(&params);
+        ASSERT(map != NULL, "Generation failed");
+        int* expected = malloc(sizeof(int) * (size_t)(map->width * map->height));
+
+        bool fields_ok = true;
+        for (int c = 0; c < map->num_crystals; c++) {
+            reference_distances(map, map->crystals[c], expected);
+            for (int y = 0; y < map->height; y++) {
+                for (int x = 0; x < map->width; x++) {
+                    int stored = map_crystal_distance(map, c)[map_index(map, x, y)];
+                    int want = expected[y * map->width + x];
+                    fields_ok = fields_ok && stored == (want < 0 ? MAP_DISTANCE_UNREACHABLE : want);
+                }
+            }
+        }
+
+        // Arbitrary pairs go through the early-exit BFS
+        Position from = {-1, -1};
+        for (int i = 0; i < map->num_floor_tiles && from.x < 0; i++) {
+            Position p = floor_tile_position(map, i);
+            if (map_crystal_at(map)[map_index(map, p.x, p.y)] < 0) from = p;
+        }
+        reference_distances(map, from, expected);
+        bool pairs_ok = true;
+        for (int i = 0; i < map->num_floor_tiles; i++) {
+            Position to = floor_tile_position(map, i);
+            pairs_ok = pairs_ok &&
+                distance_between(map, from, to) == expected[to.y * map->width + to.x];
+        }
+        free(expected);
+        map_data_release(map);
+        ASSERT(fields_ok, "Crystal distance field should match a queue BFS");
+        ASSERT(pairs_ok, "distance_between should match a queue BFS");
+    }
+}
+
+static bool nearly_equal(float a, float b) {
+    return a - b < 1e-6f && b - a < 1e-6f;
+}
+
+TEST(test_distance_api_and_observation) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    ASSERT_EQ(api_get_distance(&state, 1, 2, 1, 5), 3);   // spawn to crystal
+    ASSERT_EQ(api_get_distance(&state, 2, 3, 4, 4), 3);   // plain tiles
+    ASSERT_EQ(api_get_distance(&state, 1, 2, 0, 2), -1);  // void
+    ASSERT_EQ(api_get_distance(&state, 3, 3, 3, 3), 0);
+
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    int size = api_get_observation_size(&state, flags);
+    ASSERT_EQ(size, 8 * 7 * 7 + OBS_NUM_SCALARS);
+    float* obs = malloc(sizeof(float) * (size_t)size);
+    ASSERT(obs != NULL, "Allocation failed");
+
+    const float* distance = obs + OBS_CHANNEL_CRYSTAL_DISTANCE * 49;
+    api_write_observation(&state, 0, flags, obs);
+    bool near_ok = nearly_equal(distance[2 * 7 + 1], 3.0f / 14.0f);
+    bool self_ok = obs[OBS_CHANNEL_SELF * 49 + 2 * 7 + 1] == 1.0f;
+    bool wall_ok = distance[0 * 7 + 1] == 1.0f;
+
+    // Nearest crystal taken: the channel falls back to the other one
+    arena_collect_crystal(&state.arena, 1);
+    api_write_observation(&state, 0, flags, obs);
+    bool far_ok = nearly_equal(distance[2 * 7 + 1], 5.0f / 14.0f);
+    free(obs);
+    api_game_free(&state);
+
+    ASSERT(near_ok, "Distance channel should use the nearest crystal");
+    ASSERT(self_ok, "Self channel should mark the player");
+    ASSERT(wall_ok, "Unreachable tiles should read 1");
+    ASSERT(far_ok, "Collected crystals should be skipped");
+}
+
+TEST(test_distance_beyond_uint16) {
+    // Serpentine corridor: 200 full rows joined by one-tile gaps at
+    // alternating ends, 80198 steps from (0, 0) to (0, 398)
+    MapData* map = map_data_create(400, 399);
+    ASSERT(map != NULL, "Failed to create map");
+    for (int y = 1; y < 399; y += 2) {
+        int gap = (y / 2) % 2 == 0 ? 399 : 0;
+        for (int x = 0; x < 400; x++) {
+            if (x != gap) {
+                map->tiles[map_index(map, x, y)] = TILE_WALL;
+            }
+        }
+    }
+    map->num_spawn_points = 1;
+    map->spawn_points[0].pos = (Position){0, 0};
+    map_data_build_tables(map);
+
+    uint16_t stored = map_spawn_distance(map, 0)[map_index(map, 0, 398)];
+    int from_spawn = distance_between(map, (Position){0, 0}, (Position){0, 398});
+    int plain = distance_between(map, (Position){1, 0}, (Position){0, 398});
+    map_data_release(map);
+
+    ASSERT_EQ(stored, MAP_DISTANCE_UNREACHABLE - 1);
+    ASSERT_EQ(from_spawn, 80198);
+    ASSERT_EQ(plain, 80197);
+}
+
+// =============================================================================
+// Multiplayer Tests
+// =============================================================================
+
+TEST(test_multiplayer_set_num_players) {
+    GameState state;
+    game_init(&state, "1 . . 2 . . . .\n. . . . . . . .\n. . . . . . . .");
+
+    ASSERT_EQ(state.num_players, DEFAULT_NUM_PLAYERS);
+    ASSERT(!game_set_num_players(&state, 0), "Zero players should be rejected");
+    ASSERT(!game_set_num_players(&state, MAX_PLAYERS + 1), "Too many players should be rejected");
+    ASSERT(game_set_num_players(&state, MAX_PLAYERS), "Full table should be accepted");
+    ASSERT_EQ(state.num_players, MAX_PLAYERS);
+
+    // Seats without a spawn point still get distinct floor tiles
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        ASSERT(state.players[i].alive, "Every seat should be alive");
+        ASSERT(arena_is_passable(&state.arena, state.players[i].pos.x, state.players[i].pos.y),
+               "Players should start on floor");
+        for (int j = 0; j < i; j++) {
+            ASSERT(state.players[i].pos.x != state.players[j].pos.x ||
+                   state.players[i].pos.y != state.players[j].pos.y,
+                   "Players should not share a tile");
+        }
+    }
+    game_free(&state);
+}
+
+static void place_players(GameState* state, const int* xs, int n) {
+    game_set_num_players(state, n);
+    for (int i = 0; i < n; i++) {
+        state->players[i].pos.x = xs[i];
+        state->players[i].pos.y = 0;
+    }
+}
+
+TEST(test_multiplayer_chain_moves) {
+    GameState state;
+    game_init(&state, "1 . . . . . 2");
+
+    // 0 -> 1 -> 2 -> empty: the whole line moves
+    int xs[3] = {0, 1, 2};
+    place_players(&state, xs, 3);
+    PlayerAction actions[3] = {
+        {ACTION_RIGHT, ACTION_NOOP},
+        {ACTION_RIGHT, ACTION_NOOP},
+        {ACTION_RIGHT, ACTION_NOOP}
+    };
+    game_step(&state, actions);
+    ASSERT_EQ(state.players[0].pos.x, 1);
+    ASSERT_EQ(state.players[1].pos.x, 2);
+    ASSERT_EQ(state.players[2].pos.x, 3);
+
+    // A chain ending in a stationary player stays put
+    place_players(&state, xs, 3);
+    actions[2].move = ACTION_NOOP;
+    game_step(&state, actions);
+    ASSERT_EQ(state.players[0].pos.x, 0);
+    ASSERT_EQ(state.players[1].pos.x, 1);
+    ASSERT_EQ(state.players[2].pos.x, 2);
+    game_free(&state);
+}
+
+TEST(test_multiplayer_cycle_blocked) {
+    GameState state;
+    game_init(&state, "1 . .\n. . .\n. . 2");
+
+    // Four players rotating around a 2x2 square
+    game_set_num_players(&state, 4);
+    Position square[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    for (int i = 0; i < 4; i++) {
+        state.players[i].pos = square[i];
+    }
+    PlayerAction actions[4] = {
+        {ACTION_RIGHT, ACTION_NOOP},
+        {ACTION_DOWN, ACTION_NOOP},
+        {ACTION_LEFT, ACTION_NOOP},
+        {ACTION_UP, ACTION_NOOP}
+    };
+    game_step(&state, actions);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(state.players[i].pos.x, square[i].x);
+        ASSERT_EQ(state.players[i].pos.y, square[i].y);
+    }
+    game_free(&state);
+}
+
+TEST(test_multiplayer_frag_attribution) {
+    GameState state;
+    game_init(&state, "1 . . . x . 2");
+    api_game_set_seed(42);
+
+    // Player 2 knocks player 1 into the void; player 0 gets nothing
+    int xs[3] = {0, 3, 2};
+    place_players(&state, xs, 3);
+    PlayerAction actions[3] = {
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_RIGHT}
+    };
+    StepInfo info = game_step(&state, actions);
+
+    ASSERT(info.player_fragged[1], "Player 1 should be fragged");
+    ASSERT_EQ(info.frags[2], 1);
+    ASSERT_EQ(info.frags[0], 0);
+    ASSERT_EQ(state.players[2].score, 1);
+    ASSERT_EQ(state.players[0].score, 0);
+    game_free(&state);
+}
+
+TEST(test_occupancy_tracks_players) {
+    MapGenParams params;
+    mapgen_default_params(&params, 7);
+    MapData* map = mapgen_generate(&params);
+    ASSERT(map != NULL, "Map should generate");
+
+    GameState state;
+    game_init_map(&state, map);
+    map_data_release(map);
+    game_set_num_players(&state, MAX_PLAYERS);
+    api_game_set_seed(3);
+
+    unsigned int rng = 99;
+    for (int step = 0; step < 300; step++) {
+        PlayerAction actions[MAX_PLAYERS];
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            rng = rng * 1103515245 + 12345;
+            actions[i].move = (ActionType)((rng >> 16) % 5);
+            actions[i].shoot = (ActionType)((rng >> 20) % 5);
+        }
+        game_step(&state, actions);
+
+        // Every tile agrees with a scan of the players
+        for (int y = 0; y < state.arena.map->height; y++) {
+            for (int x = 0; x < state.arena.map->width; x++) {
+                int expected = -1;
+                for (int i = state.num_players - 1; i >= 0; i--) {
+                    if (state.players[i].alive &&
+                        state.players[i].pos.x == x && state.players[i].pos.y == y) {
+                        expected = i;
+                    }
+                }
+                ASSERT_EQ(occupancy_player_at(&state, x, y), expected);
+            }
+        }
+        if (state.game_over) {
+            game_reset(&state);
+        }
+    }
+    game_free(&state);
+}
+
+TEST(test_occupancy_shared_tile) {
+    GameState state;
+    game_init(&state, "1 . . . .\n. . . . .\n. . . . .\n. . . . .\n. . . . 2");
+
+    // Players 1 and 2 are pushed onto (2, 2) by simultaneous shots
+    game_set_num_players(&state, 4);
+    Position start[4] = {{2, 0}, {2, 1}, {1, 2}, {0, 2}};
+    for (int i = 0; i < 4; i++) {
+        state.players[i].pos = start[i];
+    }
+    PlayerAction shots[4] = {
+        {ACTION_NOOP, ACTION_DOWN},
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_RIGHT}
+    };
+    game_step(&state, shots);
+    ASSERT_EQ(state.players[1].pos.x, 2);
+    ASSERT_EQ(state.players[1].pos.y, 2);
+    ASSERT_EQ(state.players[2].pos.x, 2);
+    ASSERT_EQ(state.players[2].pos.y, 2);
+    ASSERT_EQ(occupancy_player_at(&state, 2, 2), 1);
+
+    // When player 1 walks off, the tile passes to player 2
+    PlayerAction moves[4] = {
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_RIGHT, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_NOOP},
+        {ACTION_NOOP, ACTION_NOOP}
+    };
+    game_step(&state, moves);
+    ASSERT_EQ(occupancy_player_at(&state, 3, 2), 1);
+    ASSERT_EQ(occupancy_player_at(&state, 2, 2), 2);
+    game_free(&state);
+}
+
+// Every field up to and including alive (no padding)
+static bool players_equal(const Player* a, const Player* b, int n) {
+    for (int i = 0; i < n; i++) {
+        if (memcmp(&a[i], &b[i], offsetof(Player, alive) + sizeof(bool)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(test_step_kernels_match_generic) {
+    int widths[] = {15, MAP_ROW_ALIGN + 9};
+    int counts[] = {2, 3, 4, 8};
+    enum { STEPS = 400 };
+    Player* trace = malloc(sizeof(Player) * MAX_PLAYERS * STEPS);
+    StepInfo* infos = malloc(sizeof(StepInfo) * STEPS);
+    ASSERT(trace != NULL && infos != NULL, "Allocation failed");
+
+    for (int w = 0; w < 2; w++) {
+        MapGenParams params;
+        mapgen_default_params(&params, 11);
+        params.width = widths[w];
+        params.num_spawns = 4;
+        MapData* map = mapgen_generate(&params);
+        ASSERT(map != NULL, "Map should generate");
+
+        for (int c = 0; c < 4; c++) {
+            GameState state;
+            game_init_map(&state, map);
+            game_set_num_players(&state, counts[c]);
+            const char* name = game_step_kernel_name(&state);
+            bool specialized = counts[c] != 3;
+            ASSERT(strcmp(name, "generic") != 0 || !specialized, "Kernel should be specialized");
+            ASSERT(strstr(name, w == 0 ? "small" : "large") != NULL || !specialized,
+                   "Kernel should match the map width");
+
+            // Record with the specialized kernel, replay with the generic one
+            for (int pass = 0; pass < 2; pass++) {
+                api_game_set_seed(5);
+                game_reset(&state);
+                game_select_step_kernel(&state, pass == 0);
+                unsigned int rng = 1234;
+                for (int step = 0; step < STEPS; step++) {
+                    PlayerAction actions[MAX_PLAYERS];
+                    for (int i = 0; i < counts[c]; i++) {
+                        rng = rng * 1103515245 + 12345;
+                        actions[i].move = (ActionType)((rng >> 16) % 5);
+                        actions[i].shoot = (ActionType)((rng >> 20) % 5);
+                    }
+                    StepInfo info = game_step(&state, actions);
+                    Player* players = &trace[step * MAX_PLAYERS];
+                    if (pass == 0) {
+                        memcpy(players, state.players, sizeof(Player) * MAX_PLAYERS);
+                        infos[step] = info;
+                    } else {
+                        ASSERT(players_equal(players, state.players, counts[c]),
+                               "Players should match the generic kernel");
+                        ASSERT(memcmp(&infos[step], &info, sizeof(info)) == 0,
+                               "Step info should match the generic kernel");
+                    }
+                }
+            }
+            game_free(&state);
+        }
+        map_data_release(map);
+    }
+    free(trace);
+    free(infos);
+}
+
+// =============================================================================
+// Batch Engine Tests
+// =============================================================================
+
+static bool lasers_equal(const LaserBeam* a, const LaserBeam* b) {
+    for (int i = 0; i < MAX_LASERS; i++) {
+        if (a[i].active != b[i].active) return false;
+        if (a[i].active && (a[i].start.x != b[i].start.x || a[i].start.y != b[i].start.y ||
+                            a[i].end.x != b[i].end.x || a[i].end.y != b[i].end.y ||
+                            a[i].player_idx != b[i].player_idx ||
+                            a[i].ticks_remaining != b[i].ticks_remaining)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Step num_envs duels with the batch engine and with game_step, env by
+// env, from the same seed; everything must match at every step
+static bool batch_matches_game_step(const MapData* map, bool use_avx2) {
+    enum { NUM_ENVS = 13, STEPS = 1500 };
+    GameState* refs = calloc(NUM_ENVS, sizeof(GameState));
+    StepInfo* ref_infos = malloc(sizeof(StepInfo) * NUM_ENVS * STEPS);
+    Player* ref_players = malloc(sizeof(Player) * 2 * NUM_ENVS * STEPS);
+    PlayerAction* actions = malloc(sizeof(PlayerAction) * 2 * NUM_ENVS * STEPS);
+    StepInfo infos[NUM_ENVS];
+    bool ok = refs && ref_infos && ref_players && actions;
+
+    unsigned int rng = 77;
+    for (int i = 0; ok && i < 2 * NUM_ENVS * STEPS; i++) {
+        rng = rng * 1103515245 + 12345;
+        actions[i].move = (ActionType)((rng >> 16) % 6);  // 5 = out of range
+        actions[i].shoot = (ActionType)((rng >> 20) % 5);
+    }
+
+    // Env 3 starts near the time limit so it finishes mid-run
+    api_game_set_seed(21);
+    for (int e = 0; ok && e < NUM_ENVS; e++) {
+        game_init_map(&refs[e], map);
+    }
+    if (ok) refs[3].current_tick = EPISODE_LENGTH_TICKS - 40;
+    for (int step = 0; ok && step < STEPS; step++) {
+        for (int e = 0; e < NUM_ENVS; e++) {
+            ref_infos[step * NUM_ENVS + e] = game_step(&refs[e], &actions[(step * NUM_ENVS + e) * 2]);
+            memcpy(&ref_players[(step * NUM_ENVS + e) * 2], refs[e].players, sizeof(Player) * 2);
+        }
+    }
+
+    api_game_set_seed(21);
+    BatchEngine* engine = ok ? batch_engine_create(map, NUM_ENVS) : NULL;
+    ok = ok && engine != NULL;
+    if (ok) {
+        engine->use_avx2 = use_avx2;
+        GameState start;
+        batch_engine_get_state(engine, 3, &start);
+        start.current_tick = EPISODE_LENGTH_TICKS - 40;
+        ok = batch_engine_set_state(engine, 3, &start);
+    }
+    for (int step = 0; ok && step < STEPS; step++) {
+        batch_engine_step(engine, &actions[step * NUM_ENVS * 2], infos);
+        for (int e = 0; ok && e < NUM_ENVS; e++) {
+            GameState got;
+            batch_engine_get_state(engine, e, &got);
+            ok = memcmp(&infos[e], &ref_infos[step * NUM_ENVS + e], sizeof(StepInfo)) == 0 &&
+                 players_equal(got.players, &ref_players[(step * NUM_ENVS + e) * 2], 2);
+        }
+    }
+    for (int e = 0; ok && e < NUM_ENVS; e++) {
+        GameState got;
+        batch_engine_get_state(engine, e, &got);
+        ok = lasers_equal(got.lasers, refs[e].lasers) &&
+             memcmp(got.arena.crystal_cooldowns, refs[e].arena.crystal_cooldowns,
+                    sizeof(got.arena.crystal_cooldowns)) == 0 &&
+             got.current_tick == refs[e].current_tick && got.winner == refs[e].winner &&
+             got.game_over == refs[e].game_over;
+    }
+    ok = ok && refs[3].game_over;
+
+    batch_engine_free(engine);
+    for (int e = 0; refs && e < NUM_ENVS; e++) {
+        game_free(&refs[e]);
+    }
+    free(refs);
+    free(ref_infos);
+    free(ref_players);
+    free(actions);
+    return ok;
+}
+
+TEST(test_batch_matches_game_step) {
+    MapGenParams params;
+    mapgen_default_params(&params, 5);
+    params.num_crystals = 4;
+    MapData* map = mapgen_generate(&params);
+    ASSERT(map != NULL, "Map should generate");
+
+    bool scalar_ok = batch_matches_game_step(map, false);
+    bool avx2_ok = !batch_engine_uses_avx2() || batch_matches_game_step(map, true);
+    map_data_release(map);
+
+    ASSERT(scalar_ok, "Scalar batch path should match game_step");
+    ASSERT(avx2_ok, "AVX2 batch path should match game_step");
+}
+
+TEST(test_batch_respawns_before_moving) {
+    // A player fragged last step is still dead when the next one starts;
+    // game_step respawns them before movement, so they move that step
+    GameState ref;
+    api_game_init(&ref, TEST_MAP_ASCII);
+    ref.players[1].alive = false;
+    ref.players[1].health = 0;
+
+    BatchEngine* engine = batch_engine_create(ref.arena.map, 1);
+    ASSERT(engine != NULL, "Failed to create engine");
+    ASSERT(batch_engine_set_state(engine, 0, &ref), "Failed to load state");
+
+    PlayerAction actions[2] = {{ACTION_NOOP, ACTION_NOOP}, {ACTION_LEFT, ACTION_NOOP}};
+    StepInfo info;
+    api_game_set_seed(3);
+    StepInfo ref_info = game_step(&ref, actions);
+    api_game_set_seed(3);
+    batch_engine_step(engine, actions, &info);
+
+    GameState got;
+    batch_engine_get_state(engine, 0, &got);
+    bool same = players_equal(got.players, ref.players, 2) &&
+                memcmp(&info, &ref_info, sizeof(StepInfo)) == 0;
+    int cooldown = ref.players[1].move_cooldown_ticks;
+    batch_engine_free(engine);
+    api_game_free(&ref);
+    ASSERT(cooldown > 0, "Respawned player should have moved");
+    ASSERT(same, "Batch should respawn before moving, like game_step");
+}
+
+TEST(test_batch_agents_mirror_seat1) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    BatchEngine* engine = api_batch_create(&state, 2);
+    ASSERT(engine != NULL, "Engine should be created");
+
+    // The test map is point-symmetric, so mirrored seats see the same board
+    unsigned flags = OBS_FLAG_MIRROR_SEAT1 | OBS_FLAG_CRYSTAL_DISTANCE;
+    size_t size = (size_t)api_get_observation_size(&state, flags);
+    float* obs = calloc(size * 4, sizeof(float));
+    api_batch_write_agent_observations(engine, 0, flags, obs);
+    bool same_start = memcmp(obs, obs + size, sizeof(float) * size) == 0;
+
+    // Both agents step "right" in their own frame: toward each other
+    int actions[8] = {ACTION_RIGHT, ACTION_NOOP, ACTION_RIGHT, ACTION_NOOP,
+                      ACTION_NOOP, ACTION_NOOP, ACTION_NOOP, ACTION_NOOP};
+    float rewards[4];
+    uint8_t dones[4];
+    ASSERT(api_batch_step_agents(engine, actions, flags, rewards, dones, NULL), "Step failed");
+    api_batch_write_agent_observations(engine, 0, flags, obs);
+    bool same_after = memcmp(obs, obs + size, sizeof(float) * size) == 0;
+    bool idle_same = memcmp(obs + 2 * size, obs + 3 * size, sizeof(float) * size) == 0;
+
+    GameState snapshot;
+    api_batch_get_state(engine, 0, &snapshot);
+    ASSERT_EQ(snapshot.players[0].pos.x, 2);
+    ASSERT_EQ(snapshot.players[1].pos.x, 4);
+    ASSERT(rewards[0] == 0.0f && rewards[3] == 0.0f && !dones[0] && !dones[3],
+           "Nothing should be scored or done");
+
+    // Unmirrored, the seats see the board differently
+    api_batch_write_agent_observations(engine, 0, OBS_FLAG_CRYSTAL_DISTANCE, obs);
+    bool differ = memcmp(obs, obs + size, sizeof(float) * size) != 0;
+
+    free(obs);
+    api_batch_free(engine);
+    api_game_free(&state);
+
+    ASSERT(same_start, "Mirrored seats should see the same start");
+    ASSERT(same_after, "Mirrored seats should see the same board after symmetric moves");
+    ASSERT(idle_same, "Idle env should stay symmetric");
+    ASSERT(differ, "Unmirrored seats should differ");
+}
+
+TEST(test_batch_action_masks) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    BatchEngine* engine = api_batch_create(&state, 2);
+    ASSERT(engine != NULL, "Engine should be created");
+
+    // Env 0: player 0 at (1, 2) has void to the left and floor elsewhere;
+    // player 1 at (5, 5) has a wall below and is on laser cooldown with
+    // no energy
+    state.players[1].pos = (Position){5, 5};
+    state.players[1].laser_cooldown_ticks = 3;
+    state.players[1].energy = 0;
+    state.players[0].move_cooldown_ticks = 0;
+    ASSERT(batch_engine_set_state(engine, 0, &state), "State should load");
+    // Env 1: player 0 on move cooldown, player 1 dead
+    state.players[0].move_cooldown_ticks = 5;
+    state.players[1].alive = false;
+    ASSERT(batch_engine_set_state(engine, 1, &state), "State should load");
+
+    uint8_t move[2][2][5], shoot[2][2][5];
+    api_write_action_masks(engine, 0, &move[0][0][0], &shoot[0][0][0]);
+    uint8_t p0_move[5] = {1, 1, 1, 1, 1};
+    uint8_t p1_move[5] = {1, 1, 0, 1, 1};
+    uint8_t shoot_all[5] = {1, 1, 1, 1, 1};
+    uint8_t noop_only[5] = {1, 0, 0, 0, 0};
+    ASSERT(memcmp(move[0][0], p0_move, 5) == 0, "Void is a legal move");
+    ASSERT(memcmp(move[0][1], p1_move, 5) == 0, "Walls should be masked");
+    ASSERT(memcmp(shoot[0][0], shoot_all, 5) == 0, "Ready player can shoot");
+    ASSERT(memcmp(shoot[0][1], noop_only, 5) == 0, "No energy or cooldown masks shots");
+    ASSERT(memcmp(move[1][0], noop_only, 5) == 0, "Move cooldown masks moves");
+    ASSERT(memcmp(move[1][1], noop_only, 5) == 0, "Dead player gets NOOP only");
+
+    // Mirrored seat 1 sees its mask in the rotated frame
+    uint8_t mirrored[2][2][5];
+    api_write_action_masks(engine, OBS_FLAG_MIRROR_SEAT1, &mirrored[0][0][0], NULL);
+    uint8_t p1_rotated[5] = {1, 0, 1, 1, 1};
+    ASSERT(memcmp(mirrored[0][0], p0_move, 5) == 0, "Seat 0 is not mirrored");
+    ASSERT(memcmp(mirrored[0][1], p1_rotated, 5) == 0, "Seat 1 mask should be rotated");
+
+    api_batch_free(engine);
+    api_game_free(&state);
+}
+
+TEST(test_batch_rejects_foreign_state) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    BatchEngine* engine = batch_engine_create(state.arena.map, 3);
+    ASSERT(engine != NULL, "Engine should be created");
+    ASSERT_EQ(engine->capacity, BATCH_LANES);
+    ASSERT(batch_engine_set_state(engine, 2, &state), "Same-map duel should load");
+    ASSERT(!batch_engine_set_state(engine, 3, &state), "Env out of range should be rejected");
+
+    GameState other;
+    api_game_init(&other, TEST_MAP_UTF8);
+    ASSERT(!batch_engine_set_state(engine, 0, &other), "Other map should be rejected");
+    game_set_num_players(&state, 3);
+    ASSERT(!batch_engine_set_state(engine, 0, &state), "Non-duel should be rejected");
+
+    batch_engine_free(engine);
+    api_game_free(&state);
+    api_game_free(&other);
+}
+
+// =============================================================================
+// Observation Crop Tests
+// =============================================================================
+
+TEST(test_crop_matches_full_observation) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    state.players[0].pos = (Position){3, 3};
+
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    int full_size = api_get_observation_size(&state, flags);
+    int crop_size = api_get_crop_observation_size(7, flags);
+    ASSERT_EQ(crop_size, full_size);
+
+    // Centered on a 7x7 map, a 7x7 crop is the whole map
+    float* full = calloc((size_t)full_size, sizeof(float));
+    float* crop = calloc((size_t)crop_size, sizeof(float));
+    api_write_observation(&state, 0, flags, full);
+    api_write_crop_observation(&state, 0, 7, flags, crop);
+    bool same = memcmp(full, crop, sizeof(float) * (size_t)full_size) == 0;
+
+    // Shifted to a corner, the cells past the edge read as void
+    state.players[0].pos = (Position){1, 2};
+    api_write_crop_observation(&state, 0, 7, flags, crop);
+    const float* voids = crop + OBS_CHANNEL_VOID * 49;
+    const float* self = crop + OBS_CHANNEL_SELF * 49;
+    const float* distance = crop + OBS_CHANNEL_CRYSTAL_DISTANCE * 49;
+    bool edge_void = voids[0] == 1.0f && voids[6 * 7 + 0] == 1.0f && voids[0 * 7 + 1] == 1.0f;
+    bool edge_far = distance[0] == 1.0f;
+    bool centered = self[3 * 7 + 3] == 1.0f;
+
+    free(full);
+    free(crop);
+    api_game_free(&state);
+
+    ASSERT(same, "Full-map crop should match the full observation");
+    ASSERT(edge_void, "Cells outside the map should be void");
+    ASSERT(edge_far, "Cells outside the map should read distance 1");
+    ASSERT(centered, "Player should sit at the crop center");
+}
+
+TEST(test_crop_rotates_to_facing) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    state.players[0].pos = (Position){3, 3};
+    state.players[1].pos = (Position){5, 3};
+
+    int k = 5;
+    int size = api_get_crop_observation_size(k, OBS_FLAG_ROTATE_TO_FACING);
+    float* crop = calloc((size_t)size, sizeof(float));
+    const float* opponent = crop + OBS_CHANNEL_OPPONENT * k * k;
+
+    // Opponent two tiles to the right: straight ahead when facing right,
+    // behind when facing left, and to the left/right when facing down/up
+    int expected[DIR_RIGHT + 1][2] = {
+        [DIR_RIGHT] = {2, 0}, [DIR_LEFT] = {2, 4}, [DIR_DOWN] = {0, 2}, [DIR_UP] = {4, 2},
+    };
+    bool ok = true;
+    for (int dir = DIR_UP; dir <= DIR_RIGHT; dir++) {
+        state.players[0].facing = (Direction)dir;
+        api_write_crop_observation(&state, 0, k, OBS_FLAG_ROTATE_TO_FACING, crop);
+        int x = expected[dir][0], y = expected[dir][1];
+        ok = ok && opponent[y * k + x] == 1.0f;
+    }
+
+    // Without the flag the crop stays world-aligned
+    state.players[0].facing = DIR_LEFT;
+    api_write_crop_observation(&state, 0, k, 0, crop);
+    bool upright = opponent[2 * k + 4] == 1.0f;
+
+    free(crop);
+    api_game_free(&state);
+
+    ASSERT(ok, "Rotated crop should put the opponent relative to facing");
+    ASSERT(upright, "Unrotated crop should stay world-aligned");
+}
+
+TEST(test_crop_batch_matches_single) {
+    GameState states[3];
+    for (int i = 0; i < 3; i++) {
+        api_game_init(&states[i], TEST_MAP_ASCII);
+        states[i].players[0].pos = (Position){1 + i, 3};
+    }
+
+    int k = 9;
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    int size = api_get_crop_observation_size(k, flags);
+    float* batch = calloc((size_t)size * 3, sizeof(float));
+    float* single = calloc((size_t)size, sizeof(float));
+    api_write_crop_observation_batch(states, 3, 0, k, flags, batch);
+
+    bool same = true;
+    for (int i = 0; i < 3; i++) {
+        api_write_crop_observation(&states[i], 0, k, flags, single);
+        same = same && memcmp(batch + (size_t)size * i, single, sizeof(float) * (size_t)size) == 0;
+        api_game_free(&states[i]);
+    }
+    free(batch);
+    free(single);
+
+    ASSERT(same, "Batched crops should match single writes");
+}
+
+// Cell set in a plane, or -1
+static int find_cell(const float* plane, int size) {
+    for (int i = 0; i < size; i++) {
+        if (plane[i] == 1.0f) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TEST(test_dihedral_transforms) {
+    // Not square, so odd quarter turns must swap width and height
+    const char* map =
+        "# # # # # #\n"
+        "# 1 . . . #\n"
+        "# . . . 2 #\n"
+        "# # # # # #\n";
+    GameState state;
+    api_game_init(&state, map);
+    int w = 6, h = 4, plane = w * h;
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    size_t size = (size_t)api_get_observation_size(&state, flags);
+    float* before = calloc(size, sizeof(float));
+    float* after = calloc(size, sizeof(float));
+    float* moved = calloc(size, sizeof(float));
+    float* back = calloc(size, sizeof(float));
+    const uint8_t* actions = api_get_dihedral_actions();
+    api_write_observation(&state, 0, flags, before);
+
+    // Player 0 steps right from (1, 1)
+    int step[4] = {ACTION_RIGHT, ACTION_NOOP, ACTION_NOOP, ACTION_NOOP};
+    api_game_step(&state, step);
+    api_write_observation(&state, 0, flags, moved);
+
+    bool round_trip = true, consistent = true;
+    for (int t = 0; t < OBS_NUM_DIHEDRAL; t++) {
+        int tw = (t & 1) ? h : w;
+        observation_transform(before, w, h, flags, t, after);
+        observation_transform(after, tw, (t & 1) ? w : h, flags, observation_dihedral_inverse(t),
+                              back);
+        round_trip = round_trip && memcmp(before, back, sizeof(float) * size) == 0;
+
+        // The move shows up in frame t as the remapped action
+        int from = find_cell(after + OBS_CHANNEL_SELF * plane, plane);
+        observation_transform(moved, w, h, flags, t, after);
+        int to = find_cell(after + OBS_CHANNEL_SELF * plane, plane);
+        int dx = to % tw - from % tw, dy = to / tw - from / tw;
+        int expected_dx[5] = {0, 0, 0, -1, 1}, expected_dy[5] = {0, -1, 1, 0, 0};
+        int a = actions[t * 5 + ACTION_RIGHT];
+        consistent = consistent && from >= 0 && to >= 0 && dx == expected_dx[a] &&
+                     dy == expected_dy[a];
+    }
+
+    // Batched, the identity slot matches the plain observation
+    BatchEngine* engine = api_batch_create(&state, 1);
+    float* batch = calloc(size * 4, sizeof(float));
+    ASSERT(api_batch_write_dihedral_observations(engine, 0, flags, 0x11, batch), "Write failed");
+    api_game_reset(&state);
+    api_write_observation(&state, 1, flags, before);
+    observation_transform(before, w, h, flags, 4, after);
+    bool batched = memcmp(batch + 2 * size, before, sizeof(float) * size) == 0 &&
+                   memcmp(batch + 3 * size, after, sizeof(float) * size) == 0;
+
+    free(batch);
+    free(before);
+    free(after);
+    free(moved);
+    free(back);
+    api_batch_free(engine);
+    api_game_free(&state);
+
+    ASSERT(round_trip, "Inverse transform should restore the observation");
+    ASSERT(consistent, "Action table should match the transformed move");
+    ASSERT(batched, "Batched transforms should match single writes");
+}
+
+TEST(test_incremental_observation_matches_full) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    BatchEngine* engine = api_batch_create(&state, 3);
+    ASSERT(engine != NULL, "Engine should be created");
+
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE | OBS_FLAG_MIRROR_SEAT1;
+    size_t size = (size_t)api_get_observation_size(&state, flags);
+    float* full = calloc(size * 6, sizeof(float));
+    float* patched = calloc(size * 6, sizeof(float));
+    ObsCache* caches = calloc(6, sizeof(ObsCache));
+    StepInfo infos[3];
+    int actions[12];
+    unsigned rng = 7;
+    api_game_set_seed(11);
+
+    // Random play with resets, through crystal pickups, frags and respawns
+    bool same = true;
+    for (int tick = 0; tick < 3000 && same; tick++) {
+        for (int i = 0; i < 12; i++) {
+            rng = rng * 1103515245 + 12345;
+            actions[i] = (int)((rng >> 16) % 5);
+        }
+        api_batch_step(engine, actions, infos);
+        for (int e = 0; e < 3; e++) {
+            if (engine->game_over[e]) {
+                api_batch_reset(engine, e);
+            }
+        }
+        api_batch_write_agent_observations(engine, 0, flags, full);
+        api_batch_update_agent_observations(engine, caches, flags, patched);
+        same = memcmp(full, patched, sizeof(float) * size * 6) == 0;
+    }
+
+    // A flag change falls back to a full write
+    api_batch_write_agent_observations(engine, 0, OBS_FLAG_CRYSTAL_DISTANCE, full);
+    api_batch_update_agent_observations(engine, caches, OBS_FLAG_CRYSTAL_DISTANCE, patched);
+    bool refreshed = memcmp(full, patched, sizeof(float) * size * 6) == 0;
+
+    free(full);
+    free(patched);
+    api_release_obs_caches(caches, 6);
+    free(caches);
+    api_batch_free(engine);
+    api_game_free(&state);
+
+    ASSERT(same, "Patched observations should match full writes");
+    ASSERT(refreshed, "Changed flags should rewrite the observation");
+}
+
+TEST(test_incremental_observation_new_map) {
+    // The cache holds its map, so a map generated after the old one is
+    // freed can't take its address and pass for it
+    MapGenParams params;
+    mapgen_default_params(&params, 1);
+    MapData* first = mapgen_generate(&params);
+    ASSERT(first != NULL, "Map should generate");
+    GameState state;
+    game_init_map(&state, first);
+    map_data_release(first);
+
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    size_t size = (size_t)observation_size(&state, flags);
+    float* full = calloc(size, sizeof(float));
+    float* patched = calloc(size, sizeof(float));
+    ObsCache cache = {0};
+    observation_update(&cache, &state, 0, flags, patched);
+    game_free(&state);
+    bool held = cache.map == first && first->refcount == 1;
+
+    mapgen_default_params(&params, 2);
+    MapData* second = mapgen_generate(&params);
+    ASSERT(second != NULL, "Map should generate");
+    game_init_map(&state, second);
+    map_data_release(second);
+    ASSERT_EQ((size_t)observation_size(&state, flags), size);  // default size for both
+    observation_update(&cache, &state, 0, flags, patched);
+    observation_write(&state, 0, flags, full);
+    bool same = second != first && memcmp(full, patched, sizeof(float) * size) == 0;
+
+    observation_cache_release(&cache);
+    free(full);
+    free(patched);
+    game_free(&state);
+    ASSERT(held, "Cache should keep its map alive");
+    ASSERT(same, "A new map should get a full rewrite");
+}
+
+TEST(test_packed_observation_round_trip) {
+    GameState state;
+    api_game_init(&state, TEST_MAP_ASCII);
+    state.arena.crystal_cooldowns[0] = 100;
+    BatchEngine* engine = api_batch_create(&state, 2);
+    ASSERT(batch_engine_set_state(engine, 1, &state), "State should load");
+
+    unsigned flags = OBS_FLAG_CRYSTAL_DISTANCE;
+    size_t size = (size_t)api_get_observation_size(&state, flags);
+    float* obs = calloc(size * 4, sizeof(float));
+    float* unpacked = calloc(size * 4, sizeof(float));
+    api_batch_write_agent_observations(engine, 0, flags, obs);
+
+    bool binary_exact = true, close = true;
+    for (int packing = OBS_PACK_U8; packing <= OBS_PACK_BITS; packing++) {
+        int packed_size = api_get_packed_observation_size(7, 7, flags, packing);
+        uint8_t* packed = calloc((size_t)packed_size * 4, 1);
+        ASSERT(api_batch_write_packed_observations(engine, 0, flags, packing, packed),
+               "Packing failed");
+        api_unpack_observations(packed, 4, 7, 7, flags, packing, unpacked);
+        for (size_t i = 0; i < size * 4; i++) {
+            int channel = (int)((i % size) / 49);
+            float diff = obs[i] > unpacked[i] ? obs[i] - unpacked[i] : unpacked[i] - obs[i];
+            if (channel < OBS_NUM_BASE_CHANNELS && channel != OBS_CHANNEL_CRYSTAL_COOLDOWN) {
+                binary_exact = binary_exact && diff == 0.0f;
+            } else {
+                close = close && diff <= 1.0f / 510.0f + 1e-6f;
+            }
+        }
+        free(packed);
+    }
+
+    // 6 bit planes of 7 bytes, 2 byte planes and the scalars
+    int bits_size = api_get_packed_observation_size(7, 7, flags, OBS_PACK_BITS);
+    ASSERT_EQ(bits_size, 6 * 7 + 2 * 49 + (int)sizeof(float) * OBS_NUM_SCALARS);
+
+    free(obs);
+    free(unpacked);
+    api_batch_free(engine);
+    api_game_free(&state);
+
+    ASSERT(binary_exact, "Binary channels and scalars should round-trip exactly");
+    ASSERT(close, "Quantized channels should round-trip within half a step");
+}
+
+// =============================================================================
+// Frame Stack Tests
+// =============================================================================
+
+// Push frames 1..count, with row r of frame f holding f * 10 + r
+static void push_frames(FrameStack* stack, int first, int count) {
+    for (int f = first; f < first + count; f++) {
+        float* frame = framestack_next(stack);
+        for (int r = 0; r < stack->num_rows; r++) {
+            for (int i = 0; i < stack->frame_size; i++) {
+                frame[r * stack->frame_size + i] = (float)(f * 10 + r);
+            }
+        }
+        framestack_push(stack);
+    }
+}
+
+TEST(test_framestack_window) {
+    // 3 rows of 5 floats: 60-byte frames, which straddle the page-sized
+    // double-mapped ring
+    for (int double_map = 1; double_map >= 0; double_map--) {
+        FrameStack* stack = framestack_create(3, 5, 4, double_map);
+        ASSERT(stack != NULL, "Stack should be created");
+        size_t offsets[4];
+        bool ordered = true, contiguous = true;
+        for (int step = 1; step <= 200; step++) {
+            push_frames(stack, step, 1);
+            const float* window = framestack_window(stack);
+            framestack_window_offsets(stack, offsets);
+            for (int i = 0; i < 4; i++) {
+                int expected = step - 3 + i > 0 ? (step - 3 + i) * 10 + 2 : 0;
+                const float* frame = framestack_frame(stack, i);
+                ordered = ordered && frame[2 * 5 + 4] == (float)expected &&
+                          (const float*)stack->base + offsets[i] == frame;
+                if (window) {
+                    contiguous = contiguous && window[i * 15 + 2 * 5 + 4] == (float)expected;
+                } else {
+                    contiguous = contiguous && !stack->double_mapped;
+                }
+            }
+        }
+        ASSERT(ordered, "Frames should be the last k pushed, oldest first");
+        ASSERT(contiguous, "Double-mapped window should always be contiguous");
+
+        // A reset row repeats its newest frame; other rows keep history
+        framestack_reset_row(stack, 1);
+        ASSERT(framestack_frame(stack, 0)[5] == 2001.0f, "Reset row should repeat newest");
+        ASSERT(framestack_frame(stack, 0)[0] == 1970.0f, "Other rows should keep history");
+        framestack_free(stack);
+    }
+}
+
 // =============================================================================
 // Main
 // =============================================================================
@@ -501,6 +2310,9 @@ int main(void) {
     RUN_TEST(test_arena_load_ascii);
     RUN_TEST(test_arena_load_utf8);
     RUN_TEST(test_arena_crystal);
+    RUN_TEST(test_arena_shared_map);
+    RUN_TEST(test_arena_load_too_large);
+    RUN_TEST(test_arena_runtime_sized_storage);
     printf("\n");
 
     printf(COLOR_CYAN "Player Tests:" COLOR_RESET "\n");
@@ -527,11 +2339,77 @@ int main(void) {
     RUN_TEST(test_game_movement_collision);
     RUN_TEST(test_game_crystal_collection);
     RUN_TEST(test_game_frag_and_respawn);
+    RUN_TEST(test_game_copy);
     printf("\n");
 
     printf(COLOR_CYAN "API Tests:" COLOR_RESET "\n");
     RUN_TEST(test_api_basic);
     RUN_TEST(test_api_step);
+    RUN_TEST(test_api_profile_stats);
+    RUN_TEST(test_api_trace_dump);
+    RUN_TEST(test_api_struct_layout);
+    printf("\n");
+
+    printf(COLOR_CYAN "Dataset Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_dataset_roundtrip);
+    RUN_TEST(test_dataset_rejects_truncated_column);
+    RUN_TEST(test_dataset_trajectory);
+    printf("\n");
+
+    printf(COLOR_CYAN "Delta Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_delta_roundtrip);
+    RUN_TEST(test_delta_file_roundtrip);
+    RUN_TEST(test_delta_rejects_corrupt_archive);
+    RUN_TEST(test_delta_rejects_bad_map);
+    RUN_TEST(test_delta_rejects_other_map);
+    printf("\n");
+
+    printf(COLOR_CYAN "Map Pack Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_map_pack_roundtrip);
+    RUN_TEST(test_map_pack_rejects_bad_file);
+    RUN_TEST(test_map_pack_rejects_bad_record);
+    printf("\n");
+
+    printf(COLOR_CYAN "Map Generator Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_mapgen_symmetric_and_valid);
+    RUN_TEST(test_mapgen_deterministic);
+    RUN_TEST(test_mapgen_validate_rejects);
+    RUN_TEST(test_api_reset_generated);
+    printf("\n");
+
+    printf(COLOR_CYAN "Distance Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_distance_fields_match_bfs);
+    RUN_TEST(test_distance_api_and_observation);
+    RUN_TEST(test_distance_beyond_uint16);
+    printf("\n");
+
+    printf(COLOR_CYAN "Multiplayer Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_multiplayer_set_num_players);
+    RUN_TEST(test_multiplayer_chain_moves);
+    RUN_TEST(test_multiplayer_cycle_blocked);
+    RUN_TEST(test_multiplayer_frag_attribution);
+    RUN_TEST(test_occupancy_tracks_players);
+    RUN_TEST(test_occupancy_shared_tile);
+    RUN_TEST(test_step_kernels_match_generic);
+    printf("\n");
+
+    printf(COLOR_CYAN "Batch Engine Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_batch_matches_game_step);
+    RUN_TEST(test_batch_respawns_before_moving);
+    RUN_TEST(test_batch_agents_mirror_seat1);
+    RUN_TEST(test_batch_action_masks);
+    RUN_TEST(test_batch_rejects_foreign_state);
+    printf("\n");
+
+    printf(COLOR_CYAN "Observation Crop Tests:" COLOR_RESET "\n");
+    RUN_TEST(test_crop_matches_full_observation);
+    RUN_TEST(test_crop_rotates_to_facing);
+    RUN_TEST(test_crop_batch_matches_single);
+    RUN_TEST(test_dihedral_transforms);
+    RUN_TEST(test_incremental_observation_matches_full);
+    RUN_TEST(test_incremental_observation_new_map);
+    RUN_TEST(test_packed_observation_round_trip);
+    RUN_TEST(test_framestack_window);
     printf("\n");
 
     printf("================================\n");
@@ -0,0 +1,976 @@
+// Differential tester: fast step paths against the reference kernel
+//
+// Usage: difftest [--episodes <n>] [--ticks <n>] [--seed <n>] [--maps <dir>]
+//        difftest --replay <repro.txt>
+//
+// The default 1000 episodes take a few seconds; CI runs 5000 (make
+// difftest DIFFTEST_EPISODES=5000).
+//
+// The reference is ref_step below, an independent plain copy of the rules.
+// Each episode runs it in lockstep with one fast path: the specialized
+// kernel for the state's shape, the generic kernel, or the batch engine on
+// its scalar or AVX2 path. After every tick the full game state (in a
+// canonical form: players, lasers, crystal cooldowns, tick, winner, game
+// over) and the StepInfo of the two are compared. The respawn RNGs are
+// seeded from the episode seed and tick before each side steps, so both
+// draw the same numbers as long as they agree.
+//
+// Episodes alternate between random actions and a scripted chase-and-shoot
+// policy, on the maps in --maps (default "maps") and on generated maps of
+// several sizes, with 2, 4 or 8 players for the kernels.
+//
+// On the first divergence the failing episode is shrunk: cut to the
+// divergent tick, batch envs dropped one at a time, then actions replaced
+// by no-ops one at a time, keeping each cut the divergence survives. The
+// result is printed as a repro file that --replay runs again. Exit status
+// is 1 on divergence.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/api.h"
+#include "../src/core/batch.h"
+#include "../src/core/game.h"
+#include "../src/core/map.h"
+#include "../src/core/mapgen.h"
+
+#define DIFF_MAX_MAPS  64
+#define DIFF_MAX_ENVS  16
+#define DIFF_SPEC_MAX  256
+
+typedef enum {
+    MODE_KERNEL,
+    MODE_GENERIC,
+    MODE_BATCH_SCALAR,
+    MODE_BATCH_AVX2,
+    NUM_MODES
+} DiffMode;
+
+static const char* const mode_names[NUM_MODES] = {"kernel", "generic", "batch_scalar",
+                                                 "batch_avx2"};
+
+// One episode: everything needed to run it again
+typedef struct {
+    char map_spec[DIFF_SPEC_MAX];  // map file path, or gen:<w>x<h>:<crystals>:<seed>
+    const MapData* map;
+    DiffMode mode;
+    int num_players;
+    int num_envs;       // > 1 for the batch modes only
+    unsigned int seed;  // respawn RNG, reseeded per tick
+    int ticks;
+    PlayerAction* actions;  // [ticks][num_envs][num_players]
+} Scenario;
+
+typedef struct {
+    int tick;  // -1 when the runs agree
+    int env;
+    const char* what;
+} Divergence;
+
+typedef enum { POLICY_RANDOM, POLICY_SCRIPTED, POLICY_REPLAY } Policy;
+
+static PlayerAction* action_at(const Scenario* sc, int tick, int env) {
+    return &sc->actions[((size_t)tick * sc->num_envs + env) * sc->num_players];
+}
+
+static unsigned int tick_seed(unsigned int seed, int tick) {
+    unsigned int x = seed * 2654435761u ^ (unsigned int)tick * 40503u;
+    return x ^ (x >> 15);
+}
+
+// Canonical copy of everything game_step may change, with pointers and
+// padding zeroed so two states compare with memcmp. The occupancy grid is
+// left out: stale entries there are ignored by design (occupancy.h).
+static void canonical_state(const GameState* state, GameState* out) {
+    memset(out, 0, sizeof(*out));
+    for (int c = 0; c < state->arena.map->num_crystals; c++) {
+        out->arena.crystal_cooldowns[c] = state->arena.crystal_cooldowns[c];
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        const Player* p = &state->players[i];
+        Player* q = &out->players[i];
+        q->pos = p->pos;
+        q->facing = p->facing;
+        q->health = p->health;
+        q->energy = p->energy;
+        q->move_cooldown_ticks = p->move_cooldown_ticks;
+        q->laser_cooldown_ticks = p->laser_cooldown_ticks;
+        q->energy_regen_ticks = p->energy_regen_ticks;
+        q->score = p->score;
+        q->last_hit_by = p->last_hit_by;
+        q->alive = p->alive;
+    }
+    // Inactive beams are never read, so whatever they hold is left out
+    for (int i = 0; i < MAX_LASERS; i++) {
+        const LaserBeam* l = &state->lasers[i];
+        LaserBeam* m = &out->lasers[i];
+        if (!l->active) {
+            continue;
+        }
+        m->start = l->start;
+        m->end = l->end;
+        m->player_idx = l->player_idx;
+        m->ticks_remaining = l->ticks_remaining;
+        m->active = l->active;
+    }
+    out->num_players = state->num_players;
+    out->current_tick = state->current_tick;
+    out->winner = state->winner;
+    out->game_over = state->game_over;
+}
+
+static const char* compare_states(const GameState* ref, const GameState* got) {
+    GameState a, b;
+    canonical_state(ref, &a);
+    canonical_state(got, &b);
+    if (memcmp(a.players, b.players, sizeof(a.players)) != 0) return "players";
+    if (memcmp(a.lasers, b.lasers, sizeof(a.lasers)) != 0) return "lasers";
+    if (memcmp(&a.arena, &b.arena, sizeof(a.arena)) != 0) return "crystal cooldowns";
+    if (memcmp(&a, &b, sizeof(a)) != 0) return "tick/winner/game over";
+    return NULL;
+}
+
+// =============================================================================
+// Reference step
+//
+// A frozen, deliberately plain copy of the game rules: every lookup is a
+// linear scan over the players, crystals or tiles, with no occupancy grid,
+// no claims table, no ray or crystal_at tables and none of game_kernel.h,
+// combat.c, player.c or the respawn code, so a bug in what the fast paths share
+// can't hide in the oracle too. Only map_get_tile and the state structs
+// are common. Change it only when the rules change.
+// =============================================================================
+
+// Same generator as game.c, with its own state
+static unsigned int ref_rand(unsigned int* rng) {
+    *rng = *rng * 1103515245u + 12345u;
+    return (*rng >> 16) & 0x7FFF;
+}
+
+static Position ref_offset(Position pos, ActionType action, int steps) {
+    switch (action) {
+        case ACTION_UP:    pos.y -= steps; break;
+        case ACTION_DOWN:  pos.y += steps; break;
+        case ACTION_LEFT:  pos.x -= steps; break;
+        case ACTION_RIGHT: pos.x += steps; break;
+        default: break;
+    }
+    return pos;
+}
+
+static bool ref_same(Position a, Position b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+static bool ref_in_bounds(const MapData* map, Position pos) {
+    return pos.x >= 0 && pos.x < map->width && pos.y >= 0 && pos.y < map->height;
+}
+
+// Lowest-index live player at pos other than skip, or -1
+static int ref_player_at(const GameState* state, Position pos, int skip) {
+    for (int j = 0; j < state->num_players; j++) {
+        const Player* p = &state->players[j];
+        if (j != skip && p->alive && ref_same(p->pos, pos)) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+static void ref_collect(GameState* state, int i, StepInfo* info) {
+    const MapData* map = state->arena.map;
+    Player* p = &state->players[i];
+    for (int c = 0; c < map->num_crystals; c++) {
+        if (ref_same(map->crystals[c], p->pos) && state->arena.crystal_cooldowns[c] == 0) {
+            p->energy = MAX_ENERGY;
+            p->energy_regen_ticks = ENERGY_REGEN_TICKS;
+            state->arena.crystal_cooldowns[c] = CRYSTAL_RESPAWN_TICKS;
+            info->crystal_collected[i] = true;
+            return;
+        }
+    }
+}
+
+static bool ref_respawn_ok(const GameState* state, int idx, Position pos, bool check_distance) {
+    if (ref_player_at(state, pos, idx) >= 0) {
+        return false;
+    }
+    for (int j = 0; check_distance && j < state->num_players; j++) {
+        Position o = state->players[j].pos;
+        if (j != idx && o.x >= 0 && abs(o.x - pos.x) + abs(o.y - pos.y) < RESPAWN_MIN_DISTANCE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Uniform over the row-major floor tiles that pass, relaxing the distance
+// rule if none do, else the origin
+static Position ref_respawn_position(const GameState* state, int idx, unsigned int* rng) {
+    const MapData* map = state->arena.map;
+    for (int pass = 0; pass < 2; pass++) {
+        bool check_distance = pass == 0;
+        int count = 0;
+        for (int y = 0; y < map->height; y++) {
+            for (int x = 0; x < map->width; x++) {
+                Position pos = {x, y};
+                count += map_get_tile(map, x, y) == TILE_FLOOR &&
+                         ref_respawn_ok(state, idx, pos, check_distance);
+            }
+        }
+        if (count == 0) {
+            continue;
+        }
+        int chosen = (int)(ref_rand(rng) % (unsigned int)count);
+        for (int y = 0; y < map->height; y++) {
+            for (int x = 0; x < map->width; x++) {
+                Position pos = {x, y};
+                if (map_get_tile(map, x, y) == TILE_FLOOR &&
+                    ref_respawn_ok(state, idx, pos, check_distance) && chosen-- == 0) {
+                    return pos;
+                }
+            }
+        }
+    }
+    return (Position){0, 0};
+}
+
+// Respawn the dead not yet handled this step, crediting their frags
+static void ref_respawn(GameState* state, StepInfo* info, unsigned int* rng) {
+    for (int i = 0; i < state->num_players; i++) {
+        Player* p = &state->players[i];
+        if (p->alive || info->player_fragged[i]) {
+            continue;
+        }
+        int killer = p->last_hit_by;
+        if (killer < 0 && state->num_players == 2) {
+            killer = 1 - i;
+        }
+        if (killer >= 0 && killer != i) {
+            state->players[killer].score++;
+            info->frags[killer]++;
+        }
+        info->player_fragged[i] = true;
+
+        Position pos = ref_respawn_position(state, i, rng);
+        *p = (Player){pos, DIR_DOWN, STARTING_HEALTH, STARTING_ENERGY, 0, 0,
+                      ENERGY_REGEN_TICKS, p->score, -1, true};
+    }
+}
+
+typedef struct {
+    bool fired;
+    int target;         // -1 = no player hit
+    Position end;       // where the beam stops
+    Position push_to;
+    bool push_fragged;  // pushed into void
+} RefShot;
+
+// Trace a shot from shooter's tile: the first live player before a wall
+// or the map edge is hit; void doesn't stop the beam
+static RefShot ref_trace(const GameState* state, int shooter, ActionType dir) {
+    const MapData* map = state->arena.map;
+    RefShot shot = {.fired = true, .target = -1};
+    Position origin = state->players[shooter].pos;
+    Position pos = origin;
+    if (ref_in_bounds(map, origin)) {
+        for (;;) {
+            pos = ref_offset(pos, dir, 1);
+            if (!ref_in_bounds(map, pos) || map_get_tile(map, pos.x, pos.y) == TILE_WALL) {
+                break;
+            }
+            int hit = ref_player_at(state, pos, shooter);
+            if (hit >= 0) {
+                shot.target = hit;
+                break;
+            }
+        }
+    } else {
+        pos = ref_offset(pos, dir, 1);
+    }
+    shot.end = pos;
+    if (shot.target < 0) {
+        return shot;
+    }
+
+    // Pushback, judged on the positions before any shot lands
+    Position at = state->players[shot.target].pos;
+    shot.push_to = at;
+    for (int step = 0; step < PUSHBACK_DISTANCE; step++) {
+        Position next = ref_offset(at, dir, 1);
+        TileType tile = map_get_tile(map, next.x, next.y);
+        if (tile == TILE_VOID) {
+            shot.push_fragged = true;
+            shot.push_to = next;
+            break;
+        }
+        if (tile == TILE_WALL || ref_player_at(state, next, shot.target) >= 0) {
+            break;
+        }
+        at = next;
+        shot.push_to = at;
+    }
+    return shot;
+}
+
+static void ref_shooting(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    RefShot shots[MAX_PLAYERS] = {{0}};
+    for (int i = 0; i < state->num_players; i++) {
+        Player* p = &state->players[i];
+        if (actions[i].shoot != ACTION_NOOP && p->alive && p->laser_cooldown_ticks == 0 &&
+            p->energy > 0) {
+            p->energy--;
+            p->laser_cooldown_ticks = LASER_COOLDOWN_TICKS;
+            shots[i] = ref_trace(state, i, actions[i].shoot);
+        }
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        for (int j = 0; shots[i].fired && j < MAX_LASERS; j++) {
+            LaserBeam* beam = &state->lasers[j];
+            if (!beam->active) {
+                *beam = (LaserBeam){state->players[i].pos, shots[i].end, i,
+                                    LASER_COOLDOWN_TICKS, true};
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        int t = shots[i].target;
+        if (shots[i].fired && t >= 0) {
+            Player* target = &state->players[t];
+            target->health -= LASER_DAMAGE;
+            if (target->health <= 0) {
+                target->health = 0;
+                target->alive = false;
+            }
+            target->last_hit_by = i;
+            info->player_hit[t] = true;
+            info->damage_dealt[i] += LASER_DAMAGE;
+            info->damage_taken[t] += LASER_DAMAGE;
+        }
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        int t = shots[i].target;
+        if (shots[i].fired && t >= 0 && state->players[t].alive) {
+            if (shots[i].push_fragged) {
+                state->players[t].alive = false;
+            } else {
+                state->players[t].pos = shots[i].push_to;
+            }
+        }
+    }
+}
+
+// Whether mover i's move happens: its target is claimed by no other mover,
+// and is free or held by a player whose own move happens. A cycle of
+// movers (a swap included) blocks.
+static bool ref_move_succeeds(const GameState* state, const Position* intended,
+                              const bool* wants_move, int i) {
+    int current = i;
+    for (int steps = 0; steps <= state->num_players; steps++) {
+        if (!wants_move[current]) {
+            return false;
+        }
+        for (int j = 0; j < state->num_players; j++) {
+            if (j != current && wants_move[j] && ref_same(intended[j], intended[current])) {
+                return false;
+            }
+        }
+        int blocker = ref_player_at(state, intended[current], -1);
+        if (blocker < 0) {
+            return true;
+        }
+        current = blocker;
+    }
+    return false;  // came back around: a cycle
+}
+
+static void ref_movement(GameState* state, const PlayerAction* actions, StepInfo* info) {
+    const MapData* map = state->arena.map;
+    Position intended[MAX_PLAYERS];
+    bool wants_move[MAX_PLAYERS] = {false};
+    bool could_move[MAX_PLAYERS] = {false};
+    for (int i = 0; i < state->num_players; i++) {
+        const Player* p = &state->players[i];
+        intended[i] = p->pos;
+        could_move[i] = p->alive && p->move_cooldown_ticks == 0;
+        if (actions[i].move != ACTION_NOOP && could_move[i]) {
+            Position target = ref_offset(p->pos, actions[i].move, 1);
+            if (map_get_tile(map, target.x, target.y) != TILE_WALL) {
+                intended[i] = target;
+                wants_move[i] = true;
+            }
+        }
+    }
+
+    bool moves[MAX_PLAYERS];
+    for (int i = 0; i < state->num_players; i++) {
+        moves[i] = ref_move_succeeds(state, intended, wants_move, i);
+    }
+
+    for (int i = 0; i < state->num_players; i++) {
+        Player* p = &state->players[i];
+        if (actions[i].move == ACTION_NOOP || !could_move[i]) {
+            continue;
+        }
+        // Walls and blocked moves still turn the player and start the cooldown
+        p->facing = (Direction)actions[i].move;
+        p->move_cooldown_ticks = MOVEMENT_COOLDOWN_TICKS;
+        if (moves[i]) {
+            if (map_get_tile(map, intended[i].x, intended[i].y) == TILE_VOID) {
+                p->alive = false;
+            } else {
+                p->pos = intended[i];
+            }
+        }
+    }
+
+    for (int i = 0; i < state->num_players; i++) {
+        if (state->players[i].alive) {
+            ref_collect(state, i, info);
+        }
+    }
+}
+
+static void ref_tick_timers(GameState* state) {
+    for (int i = 0; i < state->num_players; i++) {
+        Player* p = &state->players[i];
+        if (p->move_cooldown_ticks > 0) p->move_cooldown_ticks--;
+        if (p->laser_cooldown_ticks > 0) p->laser_cooldown_ticks--;
+        if (p->energy >= MAX_ENERGY) {
+            p->energy_regen_ticks = ENERGY_REGEN_TICKS;
+        } else if (--p->energy_regen_ticks <= 0) {
+            p->energy++;
+            p->energy_regen_ticks = ENERGY_REGEN_TICKS;
+        }
+    }
+    for (int c = 0; c < state->arena.map->num_crystals; c++) {
+        if (state->arena.crystal_cooldowns[c] > 0) {
+            state->arena.crystal_cooldowns[c]--;
+        }
+    }
+    for (int i = 0; i < MAX_LASERS; i++) {
+        LaserBeam* beam = &state->lasers[i];
+        if (beam->active && --beam->ticks_remaining <= 0) {
+            beam->active = false;
+        }
+    }
+}
+
+static void ref_check_win(GameState* state) {
+    for (int i = 0; i < state->num_players; i++) {
+        if (state->players[i].score >= WIN_SCORE) {
+            state->winner = i;
+            state->game_over = true;
+            return;
+        }
+    }
+    if (state->current_tick < EPISODE_LENGTH_TICKS) {
+        return;
+    }
+    state->game_over = true;
+    state->winner = -1;
+    int best = -1;
+    for (int i = 0; i < state->num_players; i++) {
+        int score = state->players[i].score;
+        if (best < 0 || score > best) {
+            best = score;
+            state->winner = i;
+        } else if (score == best) {
+            state->winner = -1;
+        }
+    }
+}
+
+// One tick of the rules, drawing respawn positions from rng
+static StepInfo ref_step(GameState* state, const PlayerAction* actions, unsigned int* rng) {
+    StepInfo info = {0};
+    if (state->game_over) {
+        return info;
+    }
+    for (int i = 0; i < state->num_players; i++) {
+        if (state->players[i].alive) {
+            ref_collect(state, i, &info);
+        }
+    }
+    ref_shooting(state, actions, &info);
+    ref_respawn(state, &info, rng);
+    ref_movement(state, actions, &info);
+    ref_respawn(state, &info, rng);
+    ref_tick_timers(state);
+    state->current_tick++;
+    ref_check_win(state);
+    return info;
+}
+
+// =============================================================================
+// Policies
+// =============================================================================
+
+static unsigned int next_random(unsigned int* rng) {
+    *rng = *rng * 1103515245u + 12345u;
+    return *rng >> 16;
+}
+
+// Chase the nearest live opponent along the longer axis; fire when lined up
+static void scripted_action(const GameState* state, int idx, PlayerAction* action) {
+    const Player* self = &state->players[idx];
+    int best = -1, best_dist = 0;
+    for (int j = 0; j < state->num_players; j++) {
+        const Player* o = &state->players[j];
+        int dist = abs(o->pos.x - self->pos.x) + abs(o->pos.y - self->pos.y);
+        if (j != idx && o->alive && (best < 0 || dist < best_dist)) {
+            best = j;
+            best_dist = dist;
+        }
+    }
+    action->move = ACTION_NOOP;
+    action->shoot = ACTION_NOOP;
+    if (best < 0) {
+        return;
+    }
+    int dx = state->players[best].pos.x - self->pos.x;
+    int dy = state->players[best].pos.y - self->pos.y;
+    if (abs(dx) >= abs(dy)) {
+        action->move = dx > 0 ? ACTION_RIGHT : dx < 0 ? ACTION_LEFT : ACTION_NOOP;
+    } else {
+        action->move = dy > 0 ? ACTION_DOWN : ACTION_UP;
+    }
+    if (dx == 0) {
+        action->shoot = dy > 0 ? ACTION_DOWN : ACTION_UP;
+    } else if (dy == 0) {
+        action->shoot = dx > 0 ? ACTION_RIGHT : ACTION_LEFT;
+    }
+}
+
+// Fill the actions of one env for this tick from the reference state
+static void choose_actions(const Scenario* sc, Policy policy, const GameState* ref, int tick,
+                           int env, unsigned int* rng) {
+    PlayerAction* actions = action_at(sc, tick, env);
+    for (int i = 0; i < sc->num_players; i++) {
+        if (policy == POLICY_RANDOM) {
+            actions[i].move = (ActionType)(next_random(rng) % 5);
+            actions[i].shoot = (ActionType)(next_random(rng) % 5);
+        } else if (policy == POLICY_SCRIPTED) {
+            scripted_action(ref, i, &actions[i]);
+        }
+    }
+}
+
+// =============================================================================
+// Lockstep runs
+// =============================================================================
+
+static Divergence diverged(int tick, int env, const char* what) {
+    return (Divergence){tick, env, what};
+}
+
+static Divergence run_kernel(const Scenario* sc, Policy policy, unsigned int* rng) {
+    GameState ref, fast;
+    api_game_set_seed(sc->seed);
+    game_init_map(&ref, sc->map);
+    game_set_num_players(&ref, sc->num_players);
+    api_game_set_seed(sc->seed);
+    game_init_map(&fast, sc->map);
+    game_set_num_players(&fast, sc->num_players);
+    game_select_step_kernel(&fast, sc->mode == MODE_KERNEL);
+
+    Divergence result = diverged(-1, 0, NULL);
+    const char* what = compare_states(&ref, &fast);
+    if (what) {
+        result = diverged(0, 0, what);
+    }
+    for (int t = 0; t < sc->ticks && result.tick < 0; t++) {
+        choose_actions(sc, policy, &ref, t, 0, rng);
+        unsigned int ref_rng = tick_seed(sc->seed, t);
+        StepInfo ref_info = ref_step(&ref, action_at(sc, t, 0), &ref_rng);
+        api_game_set_seed(tick_seed(sc->seed, t));
+        StepInfo fast_info = game_step(&fast, action_at(sc, t, 0));
+        if ((what = compare_states(&ref, &fast))) {
+            result = diverged(t, 0, what);
+        } else if (memcmp(&ref_info, &fast_info, sizeof(StepInfo)) != 0) {
+            result = diverged(t, 0, "step info");
+        }
+    }
+    game_free(&ref);
+    game_free(&fast);
+    return result;
+}
+
+// The references step env by env, which is the order the batch engine
+// draws respawn numbers in
+static Divergence run_batch(const Scenario* sc, Policy policy, unsigned int* rng) {
+    GameState refs[DIFF_MAX_ENVS];
+    StepInfo ref_infos[DIFF_MAX_ENVS], infos[DIFF_MAX_ENVS];
+    PlayerAction actions[DIFF_MAX_ENVS * BATCH_NUM_PLAYERS];
+
+    api_game_set_seed(sc->seed);
+    for (int e = 0; e < sc->num_envs; e++) {
+        game_init_map(&refs[e], sc->map);
+    }
+    api_game_set_seed(sc->seed);
+    BatchEngine* engine = batch_engine_create(sc->map, sc->num_envs);
+    if (!engine) {
+        for (int e = 0; e < sc->num_envs; e++) {
+            game_free(&refs[e]);
+        }
+        return diverged(0, 0, "batch engine creation failed");
+    }
+    engine->use_avx2 = sc->mode == MODE_BATCH_AVX2;
+
+    Divergence result = diverged(-1, 0, NULL);
+    for (int t = 0; t < sc->ticks && result.tick < 0; t++) {
+        unsigned int ref_rng = tick_seed(sc->seed, t);
+        for (int e = 0; e < sc->num_envs; e++) {
+            choose_actions(sc, policy, &refs[e], t, e, rng);
+            ref_infos[e] = ref_step(&refs[e], action_at(sc, t, e), &ref_rng);
+        }
+        memcpy(actions, action_at(sc, t, 0),
+               sizeof(PlayerAction) * BATCH_NUM_PLAYERS * (size_t)sc->num_envs);
+        api_game_set_seed(tick_seed(sc->seed, t));
+        batch_engine_step(engine, actions, infos);
+        for (int e = 0; e < sc->num_envs && result.tick < 0; e++) {
+            GameState got;
+            batch_engine_get_state(engine, e, &got);
+            const char* what = compare_states(&refs[e], &got);
+            if (what) {
+                result = diverged(t, e, what);
+            } else if (memcmp(&ref_infos[e], &infos[e], sizeof(StepInfo)) != 0) {
+                result = diverged(t, e, "step info");
+            }
+        }
+    }
+    batch_engine_free(engine);
+    for (int e = 0; e < sc->num_envs; e++) {
+        game_free(&refs[e]);
+    }
+    return result;
+}
+
+static Divergence run_scenario(const Scenario* sc, Policy policy, unsigned int* rng) {
+    return sc->mode <= MODE_GENERIC ? run_kernel(sc, policy, rng) : run_batch(sc, policy, rng);
+}
+
+static Divergence replay(const Scenario* sc) {
+    return run_scenario(sc, POLICY_REPLAY, NULL);
+}
+
+// =============================================================================
+// Shrinking and repro files
+// =============================================================================
+
+// Copy of sc without env skip
+static bool drop_env(const Scenario* sc, int skip, Scenario* out) {
+    *out = *sc;
+    out->num_envs = sc->num_envs - 1;
+    out->actions = malloc(sizeof(PlayerAction) * (size_t)sc->ticks * out->num_envs * sc->num_players);
+    if (!out->actions) {
+        return false;
+    }
+    for (int t = 0; t < sc->ticks; t++) {
+        for (int e = 0, k = 0; e < sc->num_envs; e++) {
+            if (e != skip) {
+                memcpy(action_at(out, t, k++), action_at(sc, t, e),
+                       sizeof(PlayerAction) * (size_t)sc->num_players);
+            }
+        }
+    }
+    return true;
+}
+
+// Reduce sc in place to a smaller episode that still diverges
+static Divergence shrink(Scenario* sc, Divergence div) {
+    sc->ticks = div.tick + 1;
+
+    // Drop envs, last first; other envs only matter through the order
+    // respawns draw from the RNG
+    for (int e = sc->num_envs - 1; e >= 0 && sc->num_envs > 1; e--) {
+        Scenario fewer;
+        if (e >= sc->num_envs || !drop_env(sc, e, &fewer)) {
+            continue;
+        }
+        Divergence d = replay(&fewer);
+        if (d.tick >= 0) {
+            free(sc->actions);
+            *sc = fewer;
+            sc->ticks = d.tick + 1;
+            div = d;
+        } else {
+            free(fewer.actions);
+        }
+    }
+
+    // No-op out actions, latest first, keeping each change that still
+    // diverges
+    for (int t = sc->ticks - 1; t >= 0; t--) {
+        for (int e = 0; e < sc->num_envs; e++) {
+            for (int i = 0; i < sc->num_players; i++) {
+                PlayerAction* a = &action_at(sc, t, e)[i];
+                PlayerAction saved = *a;
+                if (saved.move == ACTION_NOOP && saved.shoot == ACTION_NOOP) {
+                    continue;
+                }
+                *a = (PlayerAction){ACTION_NOOP, ACTION_NOOP};
+                Divergence d = t < sc->ticks ? replay(sc) : diverged(-1, 0, NULL);
+                if (d.tick >= 0) {
+                    sc->ticks = d.tick + 1;
+                    div = d;
+                } else {
+                    *a = saved;
+                }
+            }
+        }
+    }
+    return div;
+}
+
+static void write_repro(FILE* f, const Scenario* sc, Divergence div) {
+    fprintf(f, "# first divergence: tick %d, env %d, %s\n", div.tick, div.env, div.what);
+    fprintf(f, "map %s\nmode %s\nplayers %d\nenvs %d\nseed %u\nticks %d\n", sc->map_spec,
+            mode_names[sc->mode], sc->num_players, sc->num_envs, sc->seed, sc->ticks);
+    fprintf(f, "# per tick, per env: move shoot for each player\n");
+    for (int t = 0; t < sc->ticks; t++) {
+        for (int e = 0; e < sc->num_envs; e++) {
+            const PlayerAction* a = action_at(sc, t, e);
+            for (int i = 0; i < sc->num_players; i++) {
+                fprintf(f, "%s%d %d", i ? "  " : "", a[i].move, a[i].shoot);
+            }
+            fprintf(f, "\n");
+        }
+    }
+}
+
+// =============================================================================
+// Maps
+// =============================================================================
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+// A map file path, or gen:<w>x<h>:<crystals>:<seed>
+static const MapData* load_map_spec(const char* spec) {
+    MapGenParams params;
+    int w, h, crystals;
+    unsigned int seed;
+    if (sscanf(spec, "gen:%dx%d:%d:%u", &w, &h, &crystals, &seed) == 4) {
+        mapgen_default_params(&params, seed);
+        params.width = w;
+        params.height = h;
+        params.num_crystals = crystals;
+        params.num_spawns = MAX_SPAWN_POINTS;
+        return mapgen_generate(&params);
+    }
+    char* text = read_file(spec);
+    const MapData* map = text ? map_data_parse(text) : NULL;
+    free(text);
+    return map;
+}
+
+static bool has_suffix(const char* name, const char* suffix) {
+    size_t n = strlen(name), m = strlen(suffix);
+    return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+static int list_map_files(const char* dir_path, char specs[][DIFF_SPEC_MAX]) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) {
+        return 0;
+    }
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && count < DIFF_MAX_MAPS) {
+        if (has_suffix(entry->d_name, ".txt")) {
+            snprintf(specs[count++], DIFF_SPEC_MAX, "%s/%s", dir_path, entry->d_name);
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+static bool read_repro(const char* path, Scenario* sc) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    char line[1024], mode[32] = "";
+    int header = 0;
+    memset(sc, 0, sizeof(*sc));
+    while (header < 6 && fgets(line, sizeof(line), f)) {
+        header += sscanf(line, "map %255s", sc->map_spec) == 1;
+        header += sscanf(line, "mode %31s", mode) == 1;
+        header += sscanf(line, "players %d", &sc->num_players) == 1;
+        header += sscanf(line, "envs %d", &sc->num_envs) == 1;
+        header += sscanf(line, "seed %u", &sc->seed) == 1;
+        header += sscanf(line, "ticks %d", &sc->ticks) == 1;
+    }
+    sc->mode = NUM_MODES;
+    for (int m = 0; m < NUM_MODES; m++) {
+        if (strcmp(mode, mode_names[m]) == 0) {
+            sc->mode = (DiffMode)m;
+        }
+    }
+    bool ok = header == 6 && sc->mode != NUM_MODES && sc->ticks > 0 &&
+              sc->num_players >= 1 && sc->num_players <= MAX_PLAYERS &&
+              sc->num_envs >= 1 && sc->num_envs <= DIFF_MAX_ENVS;
+    size_t count = ok ? (size_t)sc->ticks * sc->num_envs * sc->num_players : 0;
+    sc->actions = ok ? calloc(count, sizeof(PlayerAction)) : NULL;
+    size_t read = 0;
+    while (sc->actions && read < count && fgets(line, sizeof(line), f)) {
+        const char* p = line;
+        char* end;
+        if (line[0] == '#') {
+            continue;
+        }
+        for (long v = strtol(p, &end, 10); end != p && read < count; v = strtol(p, &end, 10)) {
+            p = end;
+            long shoot = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            p = end;
+            sc->actions[read++] = (PlayerAction){(ActionType)v, (ActionType)shoot};
+        }
+    }
+    ok = ok && read == count;
+    fclose(f);
+    return ok && sc->actions;
+}
+
+static int replay_file(const char* path) {
+    Scenario sc;
+    if (!read_repro(path, &sc)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        free(sc.actions);
+        return 1;
+    }
+    sc.map = load_map_spec(sc.map_spec);
+    if (!sc.map) {
+        fprintf(stderr, "Failed to load map %s\n", sc.map_spec);
+        free(sc.actions);
+        return 1;
+    }
+    Divergence div = replay(&sc);
+    if (div.tick >= 0) {
+        printf("Diverges at tick %d, env %d: %s\n", div.tick, div.env, div.what);
+    } else {
+        printf("No divergence in %d ticks\n", sc.ticks);
+    }
+    map_data_release(sc.map);
+    free(sc.actions);
+    return div.tick >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    int episodes = 1000;
+    int max_ticks = 1000;
+    unsigned int seed = 1;
+    const char* maps_dir = "maps";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--episodes") == 0 && i + 1 < argc) {
+            episodes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            max_ticks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--maps") == 0 && i + 1 < argc) {
+            maps_dir = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            return replay_file(argv[++i]);
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--episodes <n>] [--ticks <n>] [--seed <n>] [--maps <dir>]\n"
+                    "       %s --replay <repro.txt>\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (max_ticks < 1) {
+        fprintf(stderr, "--ticks must be positive\n");
+        return 1;
+    }
+
+    static char map_files[DIFF_MAX_MAPS][DIFF_SPEC_MAX];
+    int num_map_files = list_map_files(maps_dir, map_files);
+    int num_modes = batch_engine_uses_avx2() ? NUM_MODES : MODE_BATCH_AVX2;
+    unsigned int rng = seed;
+    long long ticks_run = 0;
+
+    for (int ep = 0; ep < episodes; ep++) {
+        Scenario sc;
+        memset(&sc, 0, sizeof(sc));
+        sc.seed = next_random(&rng) ^ (unsigned int)ep << 16;
+        sc.mode = (DiffMode)(ep % num_modes);
+        Policy policy = (ep / num_modes) % 2 ? POLICY_SCRIPTED : POLICY_RANDOM;
+
+        // Every other episode on a map file when there are any; generated
+        // sizes straddle MAP_ROW_ALIGN to reach both kernel stride variants
+        if (num_map_files > 0 && ep % 2 == 0) {
+            snprintf(sc.map_spec, sizeof(sc.map_spec), "%s",
+                     map_files[next_random(&rng) % (unsigned)num_map_files]);
+        } else {
+            int w = 5 + (int)(next_random(&rng) % 76);
+            int h = 5 + (int)(next_random(&rng) % 40);
+            int crystals = 2 * (1 + (int)(next_random(&rng) % (MAX_CRYSTALS / 2)));
+            snprintf(sc.map_spec, sizeof(sc.map_spec), "gen:%dx%d:%d:%u", w, h, crystals,
+                     next_random(&rng));
+        }
+        sc.map = load_map_spec(sc.map_spec);
+        if (!sc.map) {
+            continue;  // generator found no valid layout
+        }
+
+        static const int player_counts[3] = {2, 4, 8};
+        sc.num_players = sc.mode <= MODE_GENERIC ? player_counts[next_random(&rng) % 3]
+                                                : BATCH_NUM_PLAYERS;
+        sc.num_envs = sc.mode <= MODE_GENERIC ? 1 : 1 + (int)(next_random(&rng) % DIFF_MAX_ENVS);
+        sc.ticks = max_ticks;
+        sc.actions = malloc(sizeof(PlayerAction) * (size_t)sc.ticks * sc.num_envs * sc.num_players);
+        if (!sc.actions) {
+            map_data_release(sc.map);
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+
+        Divergence div = run_scenario(&sc, policy, &rng);
+        ticks_run += (long long)sc.ticks * sc.num_envs;
+        if (div.tick >= 0) {
+            fprintf(stderr, "Episode %d diverged at tick %d (env %d, %s); shrinking\n", ep,
+                    div.tick, div.env, div.what);
+            div = shrink(&sc, div);
+            write_repro(stdout, &sc, div);
+            map_data_release(sc.map);
+            free(sc.actions);
+            return 1;
+        }
+        map_data_release(sc.map);
+        free(sc.actions);
+    }
+
+    printf("%d episodes, %lld env-ticks: no divergence\n", episodes, ticks_run);
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Map compiler: turns a directory of map text files into one binary pack
+//
+// Usage: mapc <maps_dir> <output.pack>
+//
+// Every *.txt file in maps_dir is parsed and fully built (derived tables
+// included), then written in file name order. The pack entry name is the
+// file name without extension.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/core/map.h"
+#include "../src/core/mappack.h"
+
+#define MAPC_MAX_MAPS 65536
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char* text = malloc((size_t)size + 1);
+    if (text && fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) {
+        text[size] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+static bool has_suffix(const char* name, const char* suffix) {
+    size_t n = strlen(name);
+    size_t k = strlen(suffix);
+    return n > k && strcmp(name + n - k, suffix) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <maps_dir> <output.pack>\n", argv[0]);
+        return 1;
+    }
+    const char* dir_path = argv[1];
+    const char* out_path = argv[2];
+
+    DIR* dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "Failed to open directory %s\n", dir_path);
+        return 1;
+    }
+
+    char** names = malloc(sizeof(char*) * MAPC_MAX_MAPS);
+    int num_files = 0;
+    struct dirent* entry;
+    while (names && (entry = readdir(dir)) != NULL && num_files < MAPC_MAX_MAPS) {
+        if (has_suffix(entry->d_name, ".txt")) {
+            names[num_files] = malloc(strlen(entry->d_name) + 1);
+            strcpy(names[num_files], entry->d_name);
+            num_files++;
+        }
+    }
+    closedir(dir);
+    if (!names) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    qsort(names, (size_t)num_files, sizeof(char*), compare_names);
+
+    const MapData** maps = malloc(sizeof(MapData*) * (size_t)(num_files + 1));
+    const char** map_names = malloc(sizeof(char*) * (size_t)(num_files + 1));
+    int num_maps = 0;
+    int status = 0;
+
+    for (int i = 0; i < num_files; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]);
+
+        char* text = read_file(path);
+        MapData* map = text ? map_data_parse(text) : NULL;
+        free(text);
+
+        if (!map) {
+            fprintf(stderr, "Failed to compile %s\n", path);
+            status = 1;
+            continue;
+        }
+
+        // Entry name is the file name without ".txt"
+        names[i][strlen(names[i]) - 4] = '\0';
+        if (strlen(names[i]) >= MAP_PACK_NAME_MAX) {
+            fprintf(stderr, "Warning: name of %s truncated in pack\n", path);
+        }
+
+        maps[num_maps] = map;
+        map_names[num_maps] = names[i];
+        num_maps++;
+        printf("  [%d] %s (%dx%d, %d crystals, %d spawns)\n", num_maps - 1, names[i],
+               map->width, map->height, map->num_crystals, map->num_spawn_points);
+    }
+
+    if (!map_pack_write(out_path, maps, map_names, num_maps)) {
+        fprintf(stderr, "Failed to write %s\n", out_path);
+        status = 1;
+    } else {
+        printf("Wrote %d maps to %s\n", num_maps, out_path);
+    }
+
+    for (int i = 0; i < num_maps; i++) {
+        map_data_release(maps[i]);
+    }
+    for (int i = 0; i < num_files; i++) {
+        free(names[i]);
+    }
+    free(names);
+    free(maps);
+    free(map_names);
+
+    return status;
+}